@@ -104,6 +104,7 @@ embedDBFileInterface *getDataflashInterface() {
     embedDBFileInterface *fileInterface = malloc(sizeof(embedDBFileInterface));
     fileInterface->close = DF_CLOSE;
     fileInterface->read = DF_READ;
+    fileInterface->readPages = NULL;
     fileInterface->write = DF_WRITE;
     fileInterface->erase = DF_ERASE;
     fileInterface->open = DF_OPEN;
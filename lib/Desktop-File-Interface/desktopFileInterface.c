@@ -1,5 +1,14 @@
+/* posix_fadvise and fileno are POSIX, so they are not declared with -std=c99 unless it is requested */
+#if defined(__linux__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L
+#endif
+
 #include "desktopFileInterface.h"
 
+#if defined(__linux__)
+#include <fcntl.h>
+#endif
+
 typedef struct {
     char *filename;
     FILE *file;
@@ -28,6 +37,19 @@ int8_t FILE_READ(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file)
     return fread(buffer, pageSize, 1, fileInfo->file);
 }
 
+int8_t FILE_READ_PAGES(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+    FILE_INFO *fileInfo = (FILE_INFO *)file;
+    if (fseek(fileInfo->file, pageSize * pageNum, SEEK_SET) != 0)
+        return 0;
+    int8_t success = fread(buffer, pageSize, numPages, fileInfo->file) == (size_t)numPages;
+
+#if defined(__linux__)
+    /* A scan usually reads the pages right after these next, so the kernel starts reading them while the caller works through this batch */
+    (void)posix_fadvise(fileno(fileInfo->file), (off_t)pageSize * (pageNum + numPages), (off_t)pageSize * numPages, POSIX_FADV_WILLNEED);
+#endif
+    return success;
+}
+
 int8_t FILE_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
     FILE_INFO *fileInfo = (FILE_INFO *)file;
     fseek(fileInfo->file, pageNum * pageSize, SEEK_SET);
@@ -35,6 +57,10 @@ int8_t FILE_WRITE(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file)
 }
 
 int8_t FILE_ERASE(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
+    (void)startPage;
+    (void)endPage;
+    (void)pageSize;
+    (void)file;
     return 1;
 }
 
@@ -105,6 +131,7 @@ embedDBFileInterface *getFileInterface() {
     embedDBFileInterface *fileInterface = malloc(sizeof(embedDBFileInterface));
     fileInterface->close = FILE_CLOSE;
     fileInterface->read = FILE_READ;
+    fileInterface->readPages = FILE_READ_PAGES;
     fileInterface->write = FILE_WRITE;
     fileInterface->erase = FILE_ERASE;
     fileInterface->open = FILE_OPEN;
@@ -118,6 +145,7 @@ embedDBFileInterface *getMockEraseFileInterface() {
     embedDBFileInterface *fileInterface = malloc(sizeof(embedDBFileInterface));
     fileInterface->close = FILE_CLOSE;
     fileInterface->read = FILE_READ;
+    fileInterface->readPages = FILE_READ_PAGES;
     fileInterface->write = FILE_WRITE;
     fileInterface->erase = MOCK_FILE_ERASE;
     fileInterface->open = FILE_OPEN;
@@ -0,0 +1,167 @@
+/******************************************************************************/
+/**
+ * @file        recoveryBenchmark.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Measures how long EmbedDB takes to recover the state of data files
+ *              of increasing size.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#ifndef PIO_UNIT_TESTING
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+
+#ifdef ARDUINO
+
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+
+#define clock millis
+#define RECOVERY_CLOCKS_PER_MS 1
+#define DATA_FILE_PATH "dataFile.bin"
+
+/* Data file sizes to recover, in pages */
+#define NUM_FILE_SIZES 4
+static const uint32_t recoveryFileSizes[NUM_FILE_SIZES] = {64, 256, 1024, 4096};
+
+#else
+
+#include "desktopFileInterface.h"
+#define RECOVERY_CLOCKS_PER_MS (CLOCKS_PER_SEC / 1000)
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+
+/* Data file sizes to recover, in pages */
+#define NUM_FILE_SIZES 6
+static const uint32_t recoveryFileSizes[NUM_FILE_SIZES] = {256, 1024, 4096, 16384, 65536, 262144};
+
+#endif
+
+/* Counts the pages read from storage during recovery */
+static int8_t (*recoveryStorageRead)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+static uint32_t recoveryPageReads = 0;
+
+int8_t recoveryCountingRead(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    recoveryPageReads++;
+    return recoveryStorageRead(buffer, pageNum, pageSize, file);
+}
+
+embedDBState *setupRecoveryBenchmarkState(uint32_t numDataPages, int16_t parameters) {
+    embedDBState *state = (embedDBState *)malloc(sizeof(embedDBState));
+    if (state == NULL) {
+        printf("Unable to allocate state. Exiting.\n");
+        return NULL;
+    }
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 2;
+    state->numSplinePoints = 32;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    if (state->buffer == NULL) {
+        printf("Unable to allocate buffer. Exiting.\n");
+        free(state);
+        return NULL;
+    }
+    state->numDataPages = numDataPages;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    recoveryStorageRead = state->fileInterface->read;
+    state->fileInterface->read = recoveryCountingRead;
+    char dataPath[] = DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    /* Binary search is used so that recovery time is not dominated by rebuilding the spline, which reads every page. There is no spline to clean in this mode. */
+    state->parameters = EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_DISABLE_SPLINE_CLEAN | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    if (embedDBInit(state, 1) != 0) {
+        printf("Initialization error.\n");
+        return NULL;
+    }
+    return state;
+}
+
+void tearDownRecoveryBenchmarkState(embedDBState *state) {
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+/**
+ * @brief	Fills data files of increasing size until they wrap, then measures the time and page reads needed to recover them.
+ */
+int recoveryBenchmark() {
+    printf("\nSTARTING EmbedDB RECOVERY BENCHMARK.\n");
+    printf("Pages\tRecords\tRecovery reads\tRecovery time (ms)\n");
+
+    for (uint32_t i = 0; i < NUM_FILE_SIZES; i++) {
+        uint32_t numDataPages = recoveryFileSizes[i];
+        embedDBState *state = setupRecoveryBenchmarkState(numDataPages, EMBEDDB_RESET_DATA);
+        if (state == NULL) {
+            return -1;
+        }
+
+        /* Write one and a half times the file size, so the write head is in the middle of a wrapped file */
+        uint32_t numRecords = numDataPages * 3 / 2 * state->maxRecordsPerPage;
+        for (uint32_t key = 0; key < numRecords; key++) {
+            uint32_t data = key % 100;
+            embedDBPut(state, &key, &data);
+        }
+        embedDBFlush(state);
+        id_t nextDataPageId = state->nextDataPageId;
+        tearDownRecoveryBenchmarkState(state);
+
+        recoveryPageReads = 0;
+        uint32_t start = clock();
+        state = setupRecoveryBenchmarkState(numDataPages, 0);
+        uint32_t end = clock();
+        if (state == NULL) {
+            return -1;
+        }
+        if (state->nextDataPageId != nextDataPageId) {
+            printf("ERROR: Recovered nextDataPageId %lu but expected %lu.\n", (unsigned long)state->nextDataPageId, (unsigned long)nextDataPageId);
+        }
+        printf("%lu\t%lu\t%lu\t%lu\n", (unsigned long)numDataPages, (unsigned long)numRecords, (unsigned long)recoveryPageReads, (unsigned long)((end - start) / RECOVERY_CLOCKS_PER_MS));
+        tearDownRecoveryBenchmarkState(state);
+    }
+
+    return 0;
+}
+
+#endif
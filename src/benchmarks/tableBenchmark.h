@@ -0,0 +1,206 @@
+/******************************************************************************/
+/**
+ * @file        tableBenchmark.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Compares the time per record of put, get and iterating with the
+ *              generic EmbedDB functions and with a table defined with
+ *              EMBEDDB_DEFINE_TABLE.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PIO_UNIT_TESTING
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "embedDB/embedDB.h"
+#include "embedDB/embedDBTable.h"
+#include "embedDBUtility.h"
+
+#ifdef ARDUINO
+
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+
+#define clock micros
+#define TABLE_CLOCKS_PER_SEC 1000000
+#define DATA_FILE_PATH "dataFile.bin"
+#define TABLE_NUM_RECORDS 20000
+#define TABLE_NUM_RUNS 3
+
+#else
+
+#include "desktopFileInterface.h"
+#define TABLE_CLOCKS_PER_SEC CLOCKS_PER_SEC
+#define DATA_FILE_PATH "build/artifacts/dataFile.bin"
+#define TABLE_NUM_RECORDS 1000000
+#define TABLE_NUM_RUNS 5
+
+#endif
+
+EMBEDDB_DEFINE_TABLE(benchmarkTable, uint32_t, int32_t)
+
+embedDBState *setupTableBenchmarkState(uint8_t typed) {
+    embedDBState *state = (embedDBState *)malloc(sizeof(embedDBState));
+    if (state == NULL) {
+        printf("Unable to allocate state. Exiting.\n");
+        return NULL;
+    }
+    if (typed) {
+        benchmarkTableConfigure(state);
+    } else {
+        state->keySize = 4;
+        state->dataSize = 4;
+        state->compareKey = int32Comparator;
+        state->compareData = int32Comparator;
+    }
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 2;
+    state->numSplinePoints = 300;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    if (state->buffer == NULL) {
+        printf("Unable to allocate buffer. Exiting.\n");
+        free(state);
+        return NULL;
+    }
+    state->numDataPages = TABLE_NUM_RECORDS / 50;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    char dataPath[] = DATA_FILE_PATH;
+    state->dataFile = setupFile(dataPath);
+    state->parameters = EMBEDDB_USE_MAX_MIN | EMBEDDB_RESET_DATA;
+    if (embedDBInit(state, 1) != 0) {
+        printf("Initialization error.\n");
+        return NULL;
+    }
+    return state;
+}
+
+void tearDownTableBenchmarkState(embedDBState *state) {
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->buffer);
+    free(state->fileInterface);
+    free(state);
+}
+
+/* Nanoseconds per record for a number of clock ticks */
+uint32_t tableNsPerRecord(uint32_t ticks, uint32_t numRecords) {
+    return (uint32_t)((double)ticks * 1e9 / TABLE_CLOCKS_PER_SEC / numRecords);
+}
+
+/**
+ * @brief	Times inserting records, looking up every tenth record and iterating over all records. Times are in nanoseconds per record.
+ * @param	typed	1 to use the functions of the table, 0 to use the generic functions
+ * @param	times	Return variable for the put, get and next times
+ * @return	0 if success, -1 if error.
+ */
+int8_t runTableBenchmark(uint8_t typed, uint32_t *times) {
+    embedDBState *state = setupTableBenchmarkState(typed);
+    if (state == NULL) {
+        return -1;
+    }
+
+    uint32_t numRecords = TABLE_NUM_RECORDS;
+    uint32_t start = clock();
+    for (uint32_t key = 0; key < numRecords; key++) {
+        int32_t data = (int32_t)(key % 1000) - 500;
+        if (typed) {
+            benchmarkTablePut(state, key, data);
+        } else {
+            embedDBPut(state, &key, &data);
+        }
+    }
+    times[0] = tableNsPerRecord(clock() - start, numRecords);
+
+    /* Looking up records in page order keeps the page reads out of the timing as much as possible */
+    uint32_t numGets = 0, errors = 0;
+    start = clock();
+    for (uint32_t key = 0; key < numRecords; key += 10) {
+        int32_t data = 0;
+        int8_t result = typed ? benchmarkTableGet(state, key, &data) : embedDBGet(state, &key, &data);
+        if (result != 0 || data != (int32_t)(key % 1000) - 500)
+            errors++;
+        numGets++;
+    }
+    times[1] = tableNsPerRecord(clock() - start, numGets);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key = 0, numFound = 0;
+    int32_t data = 0;
+    start = clock();
+    while (typed ? benchmarkTableNext(state, &it, &key, &data) : embedDBNext(state, &it, &key, &data)) {
+        numFound++;
+    }
+    times[2] = tableNsPerRecord(clock() - start, numRecords);
+    embedDBCloseIterator(&it);
+
+    if (errors != 0 || numFound != numRecords) {
+        printf("ERROR: %lu lookups failed and %lu of %lu records were iterated.\n", (unsigned long)errors, (unsigned long)numFound, (unsigned long)numRecords);
+    }
+    tearDownTableBenchmarkState(state);
+    return 0;
+}
+
+/**
+ * @brief	Compares the generic functions with the functions of a table defined with EMBEDDB_DEFINE_TABLE, keeping the best time of several runs.
+ */
+int tableBenchmark() {
+    printf("\nSTARTING EmbedDB TABLE BENCHMARK.\n");
+    printf("Records: %lu\n", (unsigned long)TABLE_NUM_RECORDS);
+    printf("Functions\tPut (ns/record)\tGet (ns/record)\tNext (ns/record)\n");
+
+    for (uint8_t typed = 0; typed <= 1; typed++) {
+        uint32_t best[3] = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+        for (uint32_t run = 0; run < TABLE_NUM_RUNS; run++) {
+            uint32_t times[3];
+            if (runTableBenchmark(typed, times) != 0) {
+                return -1;
+            }
+            for (uint8_t i = 0; i < 3; i++) {
+                if (times[i] < best[i])
+                    best[i] = times[i];
+            }
+        }
+        printf("%s\t%lu\t%lu\t%lu\n", typed ? "Table" : "Generic", (unsigned long)best[0], (unsigned long)best[1], (unsigned long)best[2]);
+    }
+
+    return 0;
+}
+
+#endif
@@ -3,6 +3,8 @@
 /**
  * 0 - 2 are for benchmarks
  * 3 is for the example program
+ * 4 is the recovery benchmark
+ * 5 is the table benchmark
  *
  */
 #ifndef WHICH_PROGRAM
@@ -17,6 +19,10 @@
 #include "benchmarks/variableDataBenchmark.h"
 #elif WHICH_PROGRAM == 3
 #include "benchmarks/queryInterfaceBenchmark.h"
+#elif WHICH_PROGRAM == 4
+#include "benchmarks/recoveryBenchmark.h"
+#elif WHICH_PROGRAM == 5
+#include "benchmarks/tableBenchmark.h"
 #endif
 
 int main() {
@@ -28,6 +34,10 @@ int main() {
     return test_vardata();
 #elif WHICH_PROGRAM == 3
     return advancedQueryExample();
+#elif WHICH_PROGRAM == 4
+    return recoveryBenchmark();
+#elif WHICH_PROGRAM == 5
+    return tableBenchmark();
 #endif
 }
 
@@ -48,22 +48,232 @@
 #include "serial_c_iface.h"
 #endif
 
+#if defined(EMBEDDB_SIMD_AVX2)
+#include <immintrin.h>
+#elif defined(EMBEDDB_SIMD_SSE2)
+#include <emmintrin.h>
+#endif
+
+#if defined(EMBEDDB_THREADS_SUPPORTED)
+#include <pthread.h>
+#endif
+
+#define EMBEDDB_CHECKPOINT_MAGIC 0x45444233 /* "EDB3". Change the last character when the checkpoint layout changes */
+
+/* Parameters that change the layout of the data, index, or variable data files. A checkpoint is only used if these match. */
+#define EMBEDDB_CHECKPOINT_LAYOUT_PARAMETERS (EMBEDDB_USE_INDEX | EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_SUM | EMBEDDB_USE_BMAP | EMBEDDB_USE_VDATA | EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_USE_COMPRESSION | EMBEDDB_USE_KEY_OFFSETS)
+
+/* Parameters that store data pages in the data file in a different form than in memory */
+#define EMBEDDB_ENCODED_DATA_PAGES (EMBEDDB_USE_COMPRESSION | EMBEDDB_USE_KEY_OFFSETS)
+
+/* Spline file pages start with a 4 byte logical page id and a 2 byte point count, the same as data pages */
+#define EMBEDDB_SPLINE_FILE_HEADER_SIZE 6
+
+/* A page cached in the buffer pool */
+typedef struct {
+    void *file;         /* File the page was read from. NULL if the frame is empty */
+    id_t pageNum;       /* Physical page number of the page in that file */
+    int32_t next;       /* Next frame in the same hash bucket, -1 at the end of the bucket */
+    uint8_t referenced; /* Set on every hit and cleared when the clock hand passes the frame */
+} embedDBBufferPoolFrame;
+
+/* Pages read from the data, index and variable data files, replaced with the CLOCK policy */
+typedef struct {
+    void *pages;                    /* One page of memory for each frame */
+    embedDBBufferPoolFrame *frames; /* Page held in each frame */
+    int32_t *buckets;               /* First frame in each hash bucket, -1 if the bucket is empty */
+    uint32_t numBuckets;            /* Number of hash buckets. Always a power of two. */
+    uint32_t clockHand;             /* Next frame considered for replacement */
+} embedDBBufferPool;
+
+/* Number of consecutive data pages that share one absolute key in the fence key directory */
+#define EMBEDDB_FENCE_KEY_GROUP_SIZE 16
+
+/* Smallest key of every data page written since firstPageId. Each page stores the difference from the first key of its group of EMBEDDB_FENCE_KEY_GROUP_SIZE pages. */
+typedef struct {
+    uint64_t *groupKeys; /* Key that the differences in each group are relative to, indexed by logical page id / EMBEDDB_FENCE_KEY_GROUP_SIZE % numGroups */
+    uint32_t *deltas;    /* Difference between the smallest key of each page and the key of its group, indexed by physical page id */
+    uint32_t numGroups;  /* Number of group keys. Enough for every group that can have a page in the data file at once */
+    id_t firstPageId;    /* Logical id of the first data page in the directory. Older pages are found with the spline or binary search */
+} embedDBFenceKeys;
+
+/* Smallest and largest data value of every data page written since firstPageId, so filtered iterators can skip pages without reading them */
+typedef struct {
+    void *ranges;     /* Minimum data value followed by maximum data value of each page, indexed by physical page id */
+    id_t firstPageId; /* Logical id of the first data page in the zone map. Older pages must be read to check their data range */
+} embedDBZoneMap;
+
+/* Most recent records, sorted by key, that are held back from the write buffer so records arriving a little late can still be put in order.
+ * Record i in key order is at position (start + i) % capacity, so the oldest record is removed without moving the others. */
+typedef struct {
+    void *records;     /* Key followed by data of each record */
+    uint32_t capacity; /* Number of records the buffer holds */
+    uint32_t start;    /* Position of the record with the smallest key */
+    uint32_t count;    /* Number of records in the buffer */
+} embedDBReorderBuffer;
+
+/* Aggregates of the records in a key range, filled in by rangeAggregate */
+typedef struct {
+    int64_t sum;       /* Sum of the data. Only added up if useSum is set */
+    uint32_t count;    /* Number of records */
+    void *minData;     /* Smallest data value. Only kept if useMinMax is set */
+    void *maxData;     /* Largest data value. Only kept if useMinMax is set */
+    uint8_t useSum;    /* 1 to add up the sum */
+    uint8_t useMinMax; /* 1 to keep the smallest and largest data values */
+} embedDBRangeAggregate;
+
+/* Metadata saved in a checkpoint. In the checkpoint file it is followed by the spline (if used) and a checksum. */
+typedef struct {
+    uint32_t magic;
+    uint32_t sequence;
+    uint32_t numDataPages;
+    uint32_t numIndexPages;
+    uint32_t numVarPages;
+    uint32_t numSplinePoints;
+    uint32_t layoutParameters;
+    count_t pageSize;
+    count_t eraseSizeInPages;
+    count_t dataFilePageSize;
+    int8_t keySize;
+    int8_t dataSize;
+    int8_t headerSize;
+    int8_t bitmapSize;
+    int8_t keyOffsetSize;
+    id_t nextDataPageId;
+    id_t minDataPageId;
+    uint32_t numAvailDataPages;
+    int32_t maxError;
+    id_t nextIdxPageId;
+    id_t minIndexPageId;
+    uint32_t numAvailIndexPages;
+    id_t nextVarPageId;
+    uint32_t numAvailVarPages;
+    uint64_t minVarRecordId;
+    uint32_t splineCount;
+    uint32_t splineLastLoc;
+    uint32_t splineNumAddCalls;
+    uint32_t splineTempLastPoint;
+    uint32_t splineEraseSize;
+} embedDBCheckpoint;
+
+/* Position in a checkpoint slot while it is being written or read a page at a time */
+typedef struct {
+    void *buffer;      /* Page buffer used to stage checkpoint pages */
+    id_t pageNum;      /* Physical page of the checkpoint file that is in the buffer */
+    count_t offset;    /* Offset of the next byte in the buffer */
+    uint32_t checksum; /* Checksum of every byte streamed so far */
+} embedDBCheckpointStream;
+
 /* Helper Functions */
-int8_t embedDBInitData(embedDBState *state);
+int8_t embedDBInitData(embedDBState *state, embedDBCheckpoint *checkpoint);
 int8_t embedDBInitDataFromFile(embedDBState *state);
 int8_t embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state);
-int8_t embedDBInitIndex(embedDBState *state);
+int8_t embedDBInitDataFromCheckpoint(embedDBState *state, embedDBCheckpoint *checkpoint);
+int8_t embedDBInitIndex(embedDBState *state, embedDBCheckpoint *checkpoint);
 int8_t embedDBInitIndexFromFile(embedDBState *state);
-int8_t embedDBInitVarData(embedDBState *state);
+int8_t embedDBInitIndexFromCheckpoint(embedDBState *state, embedDBCheckpoint *checkpoint);
+int8_t embedDBInitVarData(embedDBState *state, embedDBCheckpoint *checkpoint);
 int8_t embedDBInitVarDataFromFile(embedDBState *state);
+int8_t embedDBInitVarDataFromCheckpoint(embedDBState *state, embedDBCheckpoint *checkpoint);
+int8_t findWriteHead(embedDBState *state, uint32_t numPages, int8_t (*readLogicalPageId)(embedDBState *, id_t, id_t *), id_t *maxLogicalPageId, id_t *maxPhysicalPageId);
+int8_t readDataPageLogicalId(embedDBState *state, id_t physicalPageId, id_t *logicalPageId);
+int8_t readIndexPageLogicalId(embedDBState *state, id_t physicalPageId, id_t *logicalPageId);
+int8_t readVarPageLogicalId(embedDBState *state, id_t physicalPageId, id_t *logicalPageId);
+int8_t embedDBInitCheckpoint(embedDBState *state, embedDBCheckpoint *checkpoint);
+int8_t embedDBWriteCheckpoint(embedDBState *state);
+int8_t readCheckpointSlot(embedDBState *state, uint32_t slot, embedDBCheckpoint *checkpoint, uint8_t restoreSpline);
+uint32_t checkpointSlotSizeInPages(embedDBState *state);
 int8_t shiftRecordLevelConsistencyBlocks(embedDBState *state);
 void embedDBInitSplineFromFile(embedDBState *state);
+int8_t embedDBInitSplineFile(embedDBState *state);
+void embedDBInitSplineFromSplineFile(embedDBState *state);
+int8_t readSplinePageLogicalId(embedDBState *state, id_t physicalPageId, id_t *logicalPageId);
+count_t splineFilePointsPerPage(embedDBState *state);
+int8_t writeSplineFilePoint(embedDBState *state, void *point);
+int8_t writeSplineFilePage(embedDBState *state);
+int8_t flushSplineFile(embedDBState *state);
+void addToSpline(embedDBState *state, void *key, uint32_t pageNumber);
 int32_t getMaxError(embedDBState *state, void *buffer);
 void updateMaxiumError(embedDBState *state, void *buffer);
 int8_t embedDBSetupVarDataStream(embedDBState *state, void *key, embedDBVarDataStream **varData, id_t recordNumber);
 uint32_t cleanSpline(embedDBState *state, uint32_t minPageNumber);
 void readToWriteBuf(embedDBState *state);
 void readToWriteBufVar(embedDBState *state);
+int8_t writeFullDataPage(embedDBState *state);
+int8_t embedDBStartBackgroundWriter(embedDBState *state);
+void embedDBStopBackgroundWriter(embedDBState *state);
+int8_t embedDBWaitForBackgroundWriter(embedDBState *state);
+int8_t queueBackgroundPageWrite(embedDBState *state, void *file, void *buffer, id_t physicalPageNum, uint8_t eraseBlock);
+int8_t syncBackgroundWriterForRead(embedDBState *state, void *file, id_t physicalPageNum, void *buffer);
+int8_t embedDBInitBufferPool(embedDBState *state);
+void embedDBCloseBufferPool(embedDBState *state);
+int8_t bufferPoolRead(embedDBState *state, void *file, id_t pageNum, void *buffer);
+void bufferPoolInsert(embedDBState *state, void *file, id_t pageNum, void *buffer);
+void bufferPoolInvalidate(embedDBState *state, void *file, id_t firstPageNum, uint32_t numPages);
+uint32_t bufferPoolBucket(embedDBBufferPool *pool, void *file, id_t pageNum);
+int32_t bufferPoolFind(embedDBBufferPool *pool, void *file, id_t pageNum);
+void bufferPoolRemove(embedDBBufferPool *pool, int32_t frame);
+int8_t embedDBInitFenceKeys(embedDBState *state);
+void embedDBCloseFenceKeys(embedDBState *state);
+void fenceKeysAddPage(embedDBState *state, id_t pageNum, void *buffer);
+uint64_t fenceKeysGetKey(embedDBState *state, embedDBFenceKeys *fenceKeys, id_t pageNum);
+int8_t fenceKeysSearch(embedDBState *state, void *key, id_t *pageNum);
+id_t iteratorLastDataPage(embedDBState *state, void *maxKey);
+int8_t findFloorPage(embedDBState *state, void *key, id_t *pageNum);
+int16_t searchNodeFloor(embedDBState *state, void *buffer, void *key);
+id_t searchNodeUintKeys(embedDBState *state, void *buffer, void *key, int8_t range);
+uint64_t uintKeyAt(int8_t *records, int8_t recordSize, int8_t keySize, int32_t recordNum);
+int32_t countKeysAtMost(int8_t *records, int8_t recordSize, int8_t keySize, int32_t first, int32_t stride, int32_t numCandidates, uint64_t searchKey);
+int32_t countMaskBits(int32_t mask);
+count_t searchNodeFirstAtLeast(embedDBState *state, void *buffer, void *key);
+void copyRecord(embedDBState *state, void *buffer, int16_t recordNum, void *key, void *data);
+id_t iteratorFirstDataPage(embedDBState *state, void *minKey);
+void iteratorInitQueryBitmap(embedDBState *state, embedDBIterator *it);
+int8_t iteratorCanSkipPage(embedDBState *state, embedDBIterator *it, id_t pageNum);
+void *iteratorNextPageBuffer(embedDBState *state, embedDBIterator *it);
+void *iteratorReadPage(embedDBState *state, embedDBIterator *it, id_t pageNum);
+void *iteratorReadIndexPage(embedDBState *state, embedDBIterator *it, id_t pageNum);
+int8_t readPageIntoBuffer(embedDBState *state, void *file, id_t pageNum, void *buf, id_t *bufferedPageId, id_t *numReads);
+void *iteratorReadaheadPage(embedDBState *state, embedDBIterator *it, id_t pageNum);
+int8_t readPagesIntoBuffer(embedDBState *state, void *file, id_t pageNum, uint32_t numPages, void *buf);
+int8_t readFilePage(embedDBState *state, void *file, id_t pageNum, void *buf);
+void reverseIteratorPrevPage(embedDBState *state, embedDBIterator *it);
+int8_t embedDBInitZoneMap(embedDBState *state);
+void embedDBCloseZoneMap(embedDBState *state);
+void zoneMapAddPage(embedDBState *state, id_t pageNum, void *buffer);
+int8_t zoneMapOverlaps(embedDBState *state, id_t pageNum, void *minData, void *maxData);
+int8_t dataRangeOverlaps(embedDBState *state, void *pageMinData, void *pageMaxData, void *minData, void *maxData);
+void sortKeyOrder(embedDBState *state, void *keys, uint32_t *order, uint32_t n);
+int64_t embedDBDataToSum(embedDBState *state, void *data);
+void indexPageAddAggregates(embedDBState *state, void *indexBuffer, void *dataBuffer, id_t pageNum, count_t idxcount);
+void rangeAggregateAdd(embedDBState *state, embedDBRangeAggregate *aggregate, uint32_t count, void *sum, void *minData, void *maxData);
+int8_t rangeAggregatePage(embedDBState *state, void *buffer, void *minKey, void *maxKey, embedDBRangeAggregate *aggregate);
+int8_t rangeAggregate(embedDBState *state, void *minKey, void *maxKey, embedDBRangeAggregate *aggregate);
+int8_t commitRecordLevelConsistencyRecords(embedDBState *state, uint32_t numRecords);
+uint32_t getCurrentTimeMs(void);
+int8_t embedDBInitCompression(embedDBState *state);
+count_t dataFilePageSize(embedDBState *state);
+uint32_t encodeCompressedRecord(embedDBState *state, uint8_t *out, void *key, void *data, void *previousRecord, uint64_t previousDelta);
+int32_t compressDataPage(embedDBState *state, void *page, void *compressed);
+void decompressDataPage(embedDBState *state, void *compressed, void *page);
+uint64_t compressedKeyDelta(embedDBState *state, void *buffer, count_t recordNum);
+int8_t embedDBInitKeyOffsets(embedDBState *state);
+int8_t keyOffsetFits(embedDBState *state, void *minKey, void *key);
+void encodeKeyOffsetPage(embedDBState *state, void *page, void *encoded);
+void decodeKeyOffsetPage(embedDBState *state, void *encoded, void *page);
+void decodeKeyOffsets(uint8_t *offsets, int8_t offsetSize, uint64_t minKey, int8_t *records, int8_t recordSize, int8_t keySize, count_t count);
+int8_t putOrderedRecord(embedDBState *state, void *key, void *data);
+void *previousStoredKey(embedDBState *state);
+int8_t embedDBInitReorderBuffer(embedDBState *state);
+void releaseInitAllocations(embedDBState *state);
+void embedDBCloseReorderBuffer(embedDBState *state);
+void *reorderBufferRecord(embedDBState *state, embedDBReorderBuffer *reorder, uint32_t recordNum);
+uint32_t reorderBufferFirstAtLeast(embedDBState *state, embedDBReorderBuffer *reorder, void *key);
+int8_t reorderBufferPut(embedDBState *state, void *key, void *data);
+int8_t reorderBufferDrain(embedDBState *state);
+int8_t reorderBufferGet(embedDBState *state, void *key, void *data);
+int8_t iteratorNextBuffered(embedDBState *state, embedDBIterator *it, void *key, void *data);
+int8_t iteratorPrevBuffered(embedDBState *state, embedDBIterator *it, void *key, void *data);
 
 void printBitmap(char *bm) {
     for (int8_t i = 0; i <= 7; i++) {
@@ -137,6 +347,15 @@ void *embedDBGetMaxKey(embedDBState *state, void *buffer) {
  * @return  Return 0 if success. Non-zero value if error.
  */
 int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
+    state->backgroundWriter = NULL;
+    state->bufferPool = NULL;
+    state->fenceKeys = NULL;
+    state->zoneMap = NULL;
+    state->reorderBuffer = NULL;
+    state->splinePageBuffer = NULL;
+    state->bufferPoolHits = 0;
+    state->bufferPoolMisses = 0;
+
     if (state->keySize > 8) {
 #ifdef PRINT_ERRORS
         printf("ERROR: Key size is too large. Max key size is 8 bytes.\n");
@@ -144,6 +363,20 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
         return -1;
     }
 
+    if (EMBEDDB_USING_UINT_KEYS(state->parameters) && state->keySize != 4 && state->keySize != 8) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: EMBEDDB_USE_UINT_KEYS requires a key size of 4 or 8 bytes.\n");
+#endif
+        return -1;
+    }
+
+    if (EMBEDDB_USING_ZONE_MAP(state->parameters) && !EMBEDDB_USING_MAX_MIN(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: EMBEDDB_USE_ZONE_MAP requires EMBEDDB_USE_MAX_MIN, as the zone map is built from the data range in the page headers.\n");
+#endif
+        return -1;
+    }
+
     /* check the number of allocated pages is a multiple of the erase size */
     if (state->numDataPages % state->eraseSizeInPages != 0) {
 #ifdef PRINT_ERRORS
@@ -159,6 +392,30 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
         return -1;
     }
 
+    if (EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters) && !EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Group commit can only be used with record-level consistency.\n");
+#endif
+        return -1;
+    }
+
+    if (EMBEDDB_USING_CHECKPOINT(state->parameters) && EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Checkpoints can not be used with record-level consistency.\n");
+#endif
+        return -1;
+    }
+
+    if (EMBEDDB_USING_SPLINE_FILE(state->parameters) && EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: A spline file can not be used with binary search, as there is no spline.\n");
+#endif
+        return -1;
+    }
+    state->rlcUncommittedRecords = 0;
+    state->rlcFirstUncommittedTime = 0;
+    state->recordHasVarData = 0;
+
     state->recordSize = state->keySize + state->dataSize;
     if (EMBEDDB_USING_VDATA(state->parameters)) {
         if (state->numVarPages % state->eraseSizeInPages != 0) {
@@ -186,8 +443,21 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
         state->headerSize += state->bitmapSize;
     }
 
+    /* The min/max values start at a fixed offset after the bitmap, so the header must extend past them */
     if (EMBEDDB_USING_MAX_MIN(state->parameters))
-        state->headerSize += state->keySize * 2 + state->dataSize * 2;
+        state->headerSize = max(state->headerSize + state->keySize * 2 + state->dataSize * 2, EMBEDDB_MIN_OFFSET + state->keySize * 2 + state->dataSize * 2);
+
+    if (EMBEDDB_USING_SUM(state->parameters)) {
+        if (state->dataSize > 8) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: EMBEDDB_USE_SUM requires a data size of at most 8 bytes.\n");
+#endif
+            return -1;
+        }
+        /* The sum is placed after the min/max values, which start at a fixed offset */
+        int8_t sumEnd = EMBEDDB_MIN_OFFSET + (EMBEDDB_USING_MAX_MIN(state->parameters) ? state->keySize * 2 + state->dataSize * 2 : 0) + sizeof(int64_t);
+        state->headerSize = max(state->headerSize, sumEnd);
+    }
 
     /* Flags to show that these values have not been initalized with actual data yet */
     state->bufferedPageId = -1;
@@ -200,6 +470,29 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
     /* Initialize max error to maximum records per page */
     state->maxError = state->maxRecordsPerPage;
 
+    /* Compression and key offsets encode pages in the spare page buffers of state->buffer and allocate nothing, so only the steps from the reorder buffer on have memory to free when init fails */
+    if (EMBEDDB_USING_COMPRESSION(state->parameters)) {
+        int8_t compressionResult = embedDBInitCompression(state);
+        if (compressionResult != 0) {
+            return compressionResult;
+        }
+    }
+
+    if (EMBEDDB_USING_KEY_OFFSETS(state->parameters)) {
+        int8_t keyOffsetsResult = embedDBInitKeyOffsets(state);
+        if (keyOffsetsResult != 0) {
+            return keyOffsetsResult;
+        }
+    }
+
+    /* The reorder buffer starts empty. Records still in it when the database is closed without a flush are lost, like those in the write buffer. */
+    if (EMBEDDB_USING_REORDER_BUFFER(state->parameters)) {
+        int8_t reorderResult = embedDBInitReorderBuffer(state);
+        if (reorderResult != 0) {
+            return reorderResult;
+        }
+    }
+
     /* Allocate first page of buffer as output page */
     initBufferPage(state, 0);
 
@@ -207,6 +500,7 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
 #ifdef PRINT_ERRORS
         printf("ERROR: Number of pages allocated must be at least twice erase block size for embedDB and four times when using indexing. Memory pages: %d\n", state->numDataPages);
 #endif
+        releaseInitAllocations(state);
         return -1;
     }
 
@@ -216,20 +510,71 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
 #ifdef PRINT_ERRORS
             printf("ERROR: Unable to setup spline with less than 4 points.");
 #endif
+            releaseInitAllocations(state);
             return -1;
         }
         state->spl = malloc(sizeof(spline));
         splineInit(state->spl, state->numSplinePoints, indexMaxError, state->keySize);
     }
 
+    /* Open the spline file before the data file is recovered, as recovery loads the spline from it */
+    if (EMBEDDB_USING_SPLINE_FILE(state->parameters)) {
+        int8_t splineFileResult = embedDBInitSplineFile(state);
+        if (splineFileResult != 0) {
+            releaseInitAllocations(state);
+            return splineFileResult;
+        }
+    }
+
+    if (EMBEDDB_USING_BUFFER_POOL(state->parameters)) {
+        int8_t bufferPoolResult = embedDBInitBufferPool(state);
+        if (bufferPoolResult != 0) {
+            releaseInitAllocations(state);
+            return bufferPoolResult;
+        }
+    }
+
+    /* Find the most recent checkpoint, so that recovery only has to scan the pages written after it */
+    embedDBCheckpoint checkpoint;
+    embedDBCheckpoint *lastCheckpoint = NULL;
+    if (EMBEDDB_USING_CHECKPOINT(state->parameters)) {
+        int8_t checkpointResult = embedDBInitCheckpoint(state, &checkpoint);
+        if (checkpointResult == -1) {
+            releaseInitAllocations(state);
+            return -1;
+        }
+        if (checkpointResult == 1) {
+            lastCheckpoint = &checkpoint;
+        }
+    }
+
     /* Allocate file for data*/
     int8_t dataInitResult = 0;
-    dataInitResult = embedDBInitData(state);
+    dataInitResult = embedDBInitData(state, lastCheckpoint);
 
     if (dataInitResult != 0) {
+        releaseInitAllocations(state);
         return dataInitResult;
     }
 
+    /* The fence key directory covers pages written from now on. Recovered pages are found with the spline or binary search. */
+    if (EMBEDDB_USING_FENCE_KEYS(state->parameters)) {
+        int8_t fenceKeysResult = embedDBInitFenceKeys(state);
+        if (fenceKeysResult != 0) {
+            releaseInitAllocations(state);
+            return fenceKeysResult;
+        }
+    }
+
+    /* The zone map is built from the data range in the page headers, so it also only covers pages written from now on */
+    if (EMBEDDB_USING_ZONE_MAP(state->parameters)) {
+        int8_t zoneMapResult = embedDBInitZoneMap(state);
+        if (zoneMapResult != 0) {
+            releaseInitAllocations(state);
+            return zoneMapResult;
+        }
+    }
+
     /* Allocate file and buffer for index */
     int8_t indexInitResult = 0;
     if (EMBEDDB_USING_INDEX(state->parameters)) {
@@ -237,9 +582,10 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
 #ifdef PRINT_ERRORS
             printf("ERROR: embedDB using index requires at least 4 page buffers.\n");
 #endif
+            releaseInitAllocations(state);
             return -1;
         } else {
-            indexInitResult = embedDBInitIndex(state);
+            indexInitResult = embedDBInitIndex(state, lastCheckpoint);
         }
     } else {
         state->indexFile = NULL;
@@ -247,9 +593,19 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
     }
 
     if (indexInitResult != 0) {
+        releaseInitAllocations(state);
         return indexInitResult;
     }
 
+    /* Start the writer thread once recovery is done, as it takes over all page writes from here on */
+    if (EMBEDDB_USING_BACKGROUND_WRITER(state->parameters)) {
+        int8_t writerStartResult = embedDBStartBackgroundWriter(state);
+        if (writerStartResult != 0) {
+            releaseInitAllocations(state);
+            return writerStartResult;
+        }
+    }
+
     /* Allocate file and buffer for variable data */
     int8_t varDataInitResult = 0;
     if (EMBEDDB_USING_VDATA(state->parameters)) {
@@ -257,9 +613,13 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
 #ifdef PRINT_ERRORS
             printf("ERROR: embedDB using variable records requires at least 4 page buffers if there is no index and 6 if there is.\n");
 #endif
-            return -1;
+            varDataInitResult = -1;
         } else {
-            varDataInitResult = embedDBInitVarData(state);
+            varDataInitResult = embedDBInitVarData(state, lastCheckpoint);
+        }
+        if (varDataInitResult != 0) {
+            embedDBStopBackgroundWriter(state);
+            releaseInitAllocations(state);
         }
         return varDataInitResult;
     } else {
@@ -271,7 +631,20 @@ int8_t embedDBInit(embedDBState *state, size_t indexMaxError) {
     return 0;
 }
 
-int8_t embedDBInitData(embedDBState *state) {
+/**
+ * @brief	Frees the memory embedDBInit allocated before one of its later steps failed, as embedDBClose is not called after a failed init.
+ * @param	state	embedDB state structure
+ */
+void releaseInitAllocations(embedDBState *state) {
+    embedDBCloseBufferPool(state);
+    embedDBCloseReorderBuffer(state);
+    embedDBCloseFenceKeys(state);
+    embedDBCloseZoneMap(state);
+    free(state->splinePageBuffer);
+    state->splinePageBuffer = NULL;
+}
+
+int8_t embedDBInitData(embedDBState *state, embedDBCheckpoint *checkpoint) {
     state->nextDataPageId = 0;
     state->nextDataPageId = 0;
     state->numAvailDataPages = state->numDataPages;
@@ -297,6 +670,8 @@ int8_t embedDBInitData(embedDBState *state) {
         if (openStatus) {
             if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
                 return embedDBInitDataFromFileWithRecordLevelConsistency(state);
+            } else if (checkpoint != NULL) {
+                return embedDBInitDataFromCheckpoint(state, checkpoint);
             } else {
                 return embedDBInitDataFromFile(state);
             }
@@ -322,51 +697,17 @@ int8_t embedDBInitDataFromFile(embedDBState *state) {
     uint32_t count = 0;
     count_t blockSize = state->eraseSizeInPages;
     bool validData = false;
-    bool hasData = false;
     void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
 
-    /* This will become zero if there is no more to read */
-    int8_t moreToRead = !(readPage(state, physicalPageId));
-
-    /* this handles the case where the first page may have been erased, so has junk data and we actually need to start from the second page */
-    uint32_t i = 0;
-    int8_t numRecords = 0;
-    while (moreToRead && i < 2) {
-        memcpy(&logicalPageId, buffer, sizeof(id_t));
-        validData = logicalPageId % state->numDataPages == count;
-        numRecords = EMBEDDB_GET_COUNT(buffer);
-        if (validData && numRecords > 0 && numRecords < state->maxRecordsPerPage + 1) {
-            hasData = true;
-            maxLogicalPageId = logicalPageId;
-            physicalPageId++;
-            updateMaxiumError(state, buffer);
-            count++;
-            i = 2;
-        } else {
-            physicalPageId += blockSize;
-            count += blockSize;
-        }
-        moreToRead = !(readPage(state, physicalPageId));
-        i++;
-    }
-
     /* if we have no valid data, we just have an empty file can can start from the scratch */
-    if (!hasData)
+    if (!findWriteHead(state, state->numDataPages, readDataPageLogicalId, &maxLogicalPageId, &physicalPageId))
         return 0;
 
-    while (moreToRead && count < state->numDataPages) {
-        memcpy(&logicalPageId, buffer, sizeof(id_t));
-        validData = logicalPageId % state->numDataPages == count;
-        if (validData && logicalPageId == maxLogicalPageId + 1) {
-            maxLogicalPageId = logicalPageId;
-            physicalPageId++;
-            updateMaxiumError(state, buffer);
-            moreToRead = !(readPage(state, physicalPageId));
-            count++;
-        } else {
-            break;
-        }
-    }
+    physicalPageId++;
+    count = physicalPageId;
+
+    /* This will become zero if there is no more to read */
+    int8_t moreToRead = !(readPage(state, physicalPageId));
 
     /*
      * Now we need to find where the page with the smallest key that is still valid.
@@ -406,7 +747,9 @@ int8_t embedDBInitDataFromFile(embedDBState *state) {
     /* Put largest key back into the buffer */
     readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
 
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+    if (EMBEDDB_USING_SPLINE_FILE(state->parameters)) {
+        embedDBInitSplineFromSplineFile(state);
+    } else if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
         embedDBInitSplineFromFile(state);
     }
 
@@ -475,7 +818,8 @@ int8_t embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state) {
     id_t pagesToBlockBoundary = blockSize - (count % blockSize);
     /* if we are on a block-boundary, we erase the next page in case the erase failed and then skip to the start of the next block */
     if (pagesToBlockBoundary == blockSize) {
-        int8_t eraseSuccess = state->fileInterface->erase(count, count + blockSize, state->pageSize, state->dataFile);
+        bufferPoolInvalidate(state, state->dataFile, count, blockSize);
+        int8_t eraseSuccess = state->fileInterface->erase(count, count + blockSize, dataFilePageSize(state), state->dataFile);
         if (!eraseSuccess) {
 #ifdef PRINT_ERRORS
             printf("Error: Unable to erase data page during recovery!\n");
@@ -538,7 +882,8 @@ int8_t embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state) {
 
     for (uint32_t i = 0; i < numBlocksToErase; i++) {
         eraseEndingPage = eraseStartingPage + blockSize;
-        int8_t eraseSuccess = state->fileInterface->erase(eraseStartingPage, eraseEndingPage, state->pageSize, state->dataFile);
+        bufferPoolInvalidate(state, state->dataFile, eraseStartingPage, blockSize);
+        int8_t eraseSuccess = state->fileInterface->erase(eraseStartingPage, eraseEndingPage, dataFilePageSize(state), state->dataFile);
         if (!eraseSuccess) {
 #ifdef PRINT_ERRORS
             printf("Error: Unable to erase pages in data file!\n");
@@ -577,7 +922,9 @@ int8_t embedDBInitDataFromFileWithRecordLevelConsistency(embedDBState *state) {
 
     /* Put largest key back into the buffer */
     readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+    if (EMBEDDB_USING_SPLINE_FILE(state->parameters)) {
+        embedDBInitSplineFromSplineFile(state);
+    } else if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
         embedDBInitSplineFromFile(state);
     }
 
@@ -591,16 +938,315 @@ void embedDBInitSplineFromFile(embedDBState *state) {
     id_t numberOfPagesToRead = state->nextDataPageId - state->minDataPageId;
     while (pagesRead < numberOfPagesToRead) {
         readPage(state, pageNumberToRead % state->numDataPages);
-        splineAdd(state->spl, embedDBGetMinKey(state, buffer), pageNumberToRead++);
+        addToSpline(state, embedDBGetMinKey(state, buffer), pageNumberToRead++);
         pagesRead++;
     }
 }
 
-int8_t embedDBInitIndex(embedDBState *state) {
+/**
+ * @brief	Opens the spline file and finds the page that new spline points are added to.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitSplineFile(embedDBState *state) {
+    state->nextSplinePageId = 0;
+    state->numSplinePagePoints = 0;
+    state->lastSplineFilePointPage = UINT32_MAX;
+
+    if (state->splineFile == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: No spline file provided!\n");
+#endif
+        return -1;
+    }
+
+    if (state->numSplinePages % state->eraseSizeInPages != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: The number of allocated spline pages must be divisible by the erase size in pages.\n");
+#endif
+        return -1;
+    }
+
+    /* Every point that fits in the spline must still be in the spline file while the erase block after the write head is erased */
+    count_t pointsPerPage = splineFilePointsPerPage(state);
+    if (state->numSplinePages < 2 * state->eraseSizeInPages || (state->numSplinePages - state->eraseSizeInPages) * pointsPerPage < state->numSplinePoints) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: The spline file must have at least two erase blocks and room for numSplinePoints points outside of one erase block.\n");
+#endif
+        return -1;
+    }
+
+    state->splinePageBuffer = malloc(state->pageSize);
+    if (state->splinePageBuffer == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to allocate the spline file page.\n");
+#endif
+        return -1;
+    }
+
+    if (!EMBEDDB_RESETING_DATA(state->parameters)) {
+        int8_t openStatus = state->fileInterface->open(state->splineFile, EMBEDDB_FILE_MODE_R_PLUS_B);
+        if (openStatus) {
+            id_t maxLogicalPageId = 0;
+            id_t maxPhysicalPageId = 0;
+            if (findWriteHead(state, state->numSplinePages, readSplinePageLogicalId, &maxLogicalPageId, &maxPhysicalPageId) &&
+                readSplinePageLogicalId(state, maxPhysicalPageId, &maxLogicalPageId)) {
+                void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+                count_t numPoints = EMBEDDB_GET_COUNT(buffer);
+                void *lastPoint = (int8_t *)buffer + EMBEDDB_SPLINE_FILE_HEADER_SIZE + (numPoints - 1) * (state->keySize + sizeof(uint32_t));
+                memcpy(&state->lastSplineFilePointPage, (int8_t *)lastPoint + state->keySize, sizeof(uint32_t));
+                /* Pages are written once, so new points always start a new page */
+                state->nextSplinePageId = maxLogicalPageId + 1;
+            }
+            return 0;
+        }
+    }
+
+    int8_t openStatus = state->fileInterface->open(state->splineFile, EMBEDDB_FILE_MODE_W_PLUS_B);
+    if (!openStatus) {
+#ifdef PRINT_ERRORS
+        printf("Error: Can't open spline file!\n");
+#endif
+        return -1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief	Loads the spline points saved in the spline file, then adds only the data pages written after the last saved point.
+ *          Falls back to rebuilding the spline from every data page if the spline file has no usable points.
+ * @param	state	embedDB algorithm state structure
+ */
+void embedDBInitSplineFromSplineFile(embedDBState *state) {
+    spline *spl = state->spl;
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    uint32_t pointSize = state->keySize + sizeof(uint32_t);
+    count_t pointsPerPage = splineFilePointsPerPage(state);
+
+    /* Pages written by embedDBFlush may only be partly full, so every page outside the erase block ahead of the write head is loaded. The oldest points are dropped if they do not all fit. */
+    id_t numPagesWritten = state->nextSplinePageId;
+    id_t numPagesToLoad = min(numPagesWritten, state->numSplinePages - state->eraseSizeInPages);
+
+    uint32_t pointPage = 0;
+    uint32_t lastPointPage = 0;
+    for (id_t logicalPageId = numPagesWritten - numPagesToLoad; logicalPageId < numPagesWritten; logicalPageId++) {
+        id_t storedPageId = 0;
+        if (!readSplinePageLogicalId(state, logicalPageId % state->numSplinePages, &storedPageId) || storedPageId != logicalPageId) {
+            continue;
+        }
+
+        count_t numPoints = EMBEDDB_GET_COUNT(buffer);
+        for (count_t i = 0; i < numPoints; i++) {
+            void *point = (int8_t *)buffer + EMBEDDB_SPLINE_FILE_HEADER_SIZE + i * pointSize;
+            memcpy(&pointPage, (int8_t *)point + state->keySize, sizeof(uint32_t));
+
+            /* Points for data pages that were lost in a crash are dropped, as those pages will be written again */
+            if (pointPage >= state->nextDataPageId) {
+                continue;
+            }
+
+            /* Points written after such a crash replace the dropped points for the same data pages */
+            while (spl->count > 0) {
+                memcpy(&lastPointPage, (int8_t *)splinePointLocation(spl, spl->count - 1) + state->keySize, sizeof(uint32_t));
+                if (lastPointPage < pointPage) {
+                    break;
+                }
+                spl->count--;
+            }
+
+            /* Leave room for the temporary last point of the spline */
+            if (spl->count >= spl->size - 1) {
+                splineErase(spl, 1);
+            }
+            memcpy(splinePointLocation(spl, spl->count), point, pointSize);
+            spl->count++;
+        }
+    }
+
+    if (spl->count > 1 && !EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
+        cleanSpline(state, state->minDataPageId);
+    }
+
+    /* The data pages after the last saved point have to still be in the data file to rebuild the rest of the spline from */
+    if (spl->count > 0) {
+        memcpy(&lastPointPage, (int8_t *)splinePointLocation(spl, spl->count - 1) + state->keySize, sizeof(uint32_t));
+    }
+    if (spl->count == 0 || lastPointPage < state->minDataPageId) {
+        splineClose(spl);
+        splineInit(spl, state->numSplinePoints, state->indexMaxError, state->keySize);
+        state->lastSplineFilePointPage = UINT32_MAX;
+        embedDBInitSplineFromFile(state);
+        writeSplineFilePage(state);
+        return;
+    }
+
+    /* Restore the spline as it was right after the last saved point was added. The next page added starts a new error corridor. */
+    void *lastPoint = splinePointLocation(spl, spl->count - 1);
+    memcpy(spl->firstSplinePoint, splinePointLocation(spl, 0), pointSize);
+    memcpy(spl->lastKey, lastPoint, state->keySize);
+    spl->lastLoc = lastPointPage;
+    spl->tempLastPoint = 0;
+    spl->numAddCalls = 1;
+    state->lastSplineFilePointPage = lastPointPage;
+
+    for (id_t pageId = lastPointPage + 1; pageId < state->nextDataPageId; pageId++) {
+        readPage(state, pageId % state->numDataPages);
+        void *key = embedDBGetMinKey(state, buffer);
+
+        /* Pages starting with the key of the last saved point were skipped by the spline */
+        if (spl->numAddCalls == 1 && state->compareKey(key, spl->lastKey) <= 0) {
+            continue;
+        }
+        addToSpline(state, key, pageId);
+    }
+
+    /* Save the points for the replayed pages, so they are not rebuilt again on the next start */
+    writeSplineFilePage(state);
+
+    /* Put largest key back into the buffer */
+    readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
+}
+
+/**
+ * @brief	Reads the logical page id of a spline file page for findWriteHead. The page is read into the data read buffer.
+ * @return	Return 1 if the physical page holds a valid spline file page, 0 otherwise.
+ */
+int8_t readSplinePageLogicalId(embedDBState *state, id_t physicalPageId, id_t *logicalPageId) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    state->bufferedPageId = -1;
+    if (!state->fileInterface->read(buffer, physicalPageId, state->pageSize, state->splineFile))
+        return 0;
+
+    memcpy(logicalPageId, buffer, sizeof(id_t));
+    count_t numPoints = EMBEDDB_GET_COUNT(buffer);
+    return *logicalPageId % state->numSplinePages == physicalPageId && numPoints > 0 && numPoints <= splineFilePointsPerPage(state);
+}
+
+/**
+ * @brief	Returns the number of spline points that fit on a spline file page.
+ */
+count_t splineFilePointsPerPage(embedDBState *state) {
+    return (state->pageSize - EMBEDDB_SPLINE_FILE_HEADER_SIZE) / (state->keySize + sizeof(uint32_t));
+}
+
+/**
+ * @brief	Adds a spline point to the current spline file page, and writes the page once it is full.
+ * @param	state	embedDB algorithm state structure
+ * @param	point	Spline point to add
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t writeSplineFilePoint(embedDBState *state, void *point) {
+    void *buffer = state->splinePageBuffer;
+    uint32_t pointSize = state->keySize + sizeof(uint32_t);
+
+    /* The page is still full if writing it failed last time */
+    if (state->numSplinePagePoints == splineFilePointsPerPage(state) && writeSplineFilePage(state) != 0) {
+        return -1;
+    }
+
+    if (state->numSplinePagePoints == 0) {
+        memset(buffer, 0, state->pageSize);
+        memcpy(buffer, &state->nextSplinePageId, sizeof(id_t));
+    }
+    memcpy((int8_t *)buffer + EMBEDDB_SPLINE_FILE_HEADER_SIZE + state->numSplinePagePoints * pointSize, point, pointSize);
+    state->numSplinePagePoints++;
+    EMBEDDB_GET_COUNT(buffer) = state->numSplinePagePoints;
+    memcpy(&state->lastSplineFilePointPage, (int8_t *)point + state->keySize, sizeof(uint32_t));
+
+    if (state->numSplinePagePoints == splineFilePointsPerPage(state)) {
+        return writeSplineFilePage(state);
+    }
+    return 0;
+}
+
+/**
+ * @brief	Writes the current spline file page if it has any points. Each page is written once, so a partly full page written by
+ * 			embedDBFlush is not added to again. The erase block is erased before its first page is written.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t writeSplineFilePage(embedDBState *state) {
+    if (state->numSplinePagePoints == 0) {
+        return 0;
+    }
+
+    id_t physicalPageId = state->nextSplinePageId % state->numSplinePages;
+    if (physicalPageId % state->eraseSizeInPages == 0) {
+        int8_t eraseResult = state->fileInterface->erase(physicalPageId, physicalPageId + state->eraseSizeInPages, state->pageSize, state->splineFile);
+        if (eraseResult != 1) {
+#ifdef PRINT_ERRORS
+            printf("Failed to erase spline page: %i\n", physicalPageId);
+#endif
+            return -1;
+        }
+    }
+
+    if (!state->fileInterface->write(state->splinePageBuffer, physicalPageId, state->pageSize, state->splineFile)) {
+#ifdef PRINT_ERRORS
+        printf("Failed to write spline page: %i\n", physicalPageId);
+#endif
+        return -1;
+    }
+
+    state->nextSplinePageId++;
+    state->numSplinePagePoints = 0;
+    return 0;
+}
+
+/**
+ * @brief	Writes the spline points that are only in memory and flushes the spline file.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t flushSplineFile(embedDBState *state) {
+    if (writeSplineFilePage(state) != 0) {
+        return -1;
+    }
+    state->fileInterface->flush(state->splineFile);
+    return 0;
+}
+
+/**
+ * @brief	Adds the minimum key of a data page to the spline. With EMBEDDB_USE_SPLINE_FILE, any point the spline commits to is also written to the spline file.
+ * @param	state		embedDB algorithm state structure
+ * @param	key			Minimum key of the data page
+ * @param	pageNumber	Logical id of the data page
+ */
+void addToSpline(embedDBState *state, void *key, uint32_t pageNumber) {
+    spline *spl = state->spl;
+    if (!EMBEDDB_USING_SPLINE_FILE(state->parameters)) {
+        splineAdd(spl, key, pageNumber);
+        return;
+    }
+
+    /* Erasing points moves the start of the spline and its count together, so the end of the committed points only moves when a point is committed */
+    size_t committedEnd = (spl->pointsStartIndex + spl->count - spl->tempLastPoint) % spl->size;
+    splineAdd(spl, key, pageNumber);
+    if ((spl->pointsStartIndex + spl->count - spl->tempLastPoint) % spl->size == committedEnd) {
+        return;
+    }
+
+    /* Points already in the spline file are added again when pages after a checkpoint are replayed */
+    void *point = splinePointLocation(spl, spl->count - 1 - spl->tempLastPoint);
+    uint32_t pointPage = 0;
+    memcpy(&pointPage, (int8_t *)point + state->keySize, sizeof(uint32_t));
+    if (state->lastSplineFilePointPage != UINT32_MAX && pointPage <= state->lastSplineFilePointPage) {
+        return;
+    }
+
+    if (writeSplineFilePoint(state, point) != 0) {
+#ifdef PRINT_ERRORS
+        printf("Failed to save spline point for page %i\n", pointPage);
+#endif
+    }
+}
+
+int8_t embedDBInitIndex(embedDBState *state, embedDBCheckpoint *checkpoint) {
     /* Setup index file. */
 
-    /* 4 for id, 2 for count, 2 unused, 4 for minKey (pageId), 4 for maxKey (pageId) */
-    state->maxIdxRecordsPerPage = (state->pageSize - 16) / state->bitmapSize;
+    /* 4 for id, 2 for count, 2 unused, 4 for minKey (pageId), 4 for maxKey (pageId), then the sum if using EMBEDDB_USE_SUM */
+    state->maxIdxRecordsPerPage = (state->pageSize - EMBEDDB_GET_IDX_HEADER_SIZE(state)) / state->bitmapSize;
 
     /* Allocate third page of buffer as index output page */
     initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
@@ -638,6 +1284,9 @@ int8_t embedDBInitIndex(embedDBState *state) {
     if (!EMBEDDB_RESETING_DATA(state->parameters)) {
         int8_t openStatus = state->fileInterface->open(state->indexFile, EMBEDDB_FILE_MODE_R_PLUS_B);
         if (openStatus) {
+            if (checkpoint != NULL) {
+                return embedDBInitIndexFromCheckpoint(state, checkpoint);
+            }
             return embedDBInitIndexFromFile(state);
         }
     }
@@ -657,30 +1306,19 @@ int8_t embedDBInitIndexFromFile(embedDBState *state) {
     id_t logicalIndexPageId = 0;
     id_t maxLogicaIndexPageId = 0;
     id_t physicalIndexPageId = 0;
-
-    /* This will become zero if there is no more to read */
-    int8_t moreToRead = !(readIndexPage(state, physicalIndexPageId));
-
     bool haveWrappedInMemory = false;
-    int count = 0;
     void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
 
-    while (moreToRead && count < state->numIndexPages) {
+    if (!findWriteHead(state, state->numIndexPages, readIndexPageLogicalId, &maxLogicaIndexPageId, &physicalIndexPageId))
+        return 0;
+
+    /* The page after the last one written is the oldest page if the index has wrapped */
+    physicalIndexPageId++;
+    if (physicalIndexPageId < state->numIndexPages && readIndexPage(state, physicalIndexPageId) == 0) {
         memcpy(&logicalIndexPageId, buffer, sizeof(id_t));
-        if (count == 0 || logicalIndexPageId == maxLogicaIndexPageId + 1) {
-            maxLogicaIndexPageId = logicalIndexPageId;
-            physicalIndexPageId++;
-            moreToRead = !(readIndexPage(state, physicalIndexPageId));
-            count++;
-        } else {
-            haveWrappedInMemory = logicalIndexPageId == maxLogicaIndexPageId - state->numIndexPages + 1;
-            break;
-        }
+        haveWrappedInMemory = logicalIndexPageId == maxLogicaIndexPageId - state->numIndexPages + 1;
     }
 
-    if (count == 0)
-        return 0;
-
     state->nextIdxPageId = maxLogicaIndexPageId + 1;
     id_t physicalPageIDOfSmallestData = 0;
     if (haveWrappedInMemory) {
@@ -693,7 +1331,7 @@ int8_t embedDBInitIndexFromFile(embedDBState *state) {
     return 0;
 }
 
-int8_t embedDBInitVarData(embedDBState *state) {
+int8_t embedDBInitVarData(embedDBState *state, embedDBCheckpoint *checkpoint) {
     // Initialize variable data outpt buffer
     initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
 
@@ -706,6 +1344,9 @@ int8_t embedDBInitVarData(embedDBState *state) {
     if (!EMBEDDB_RESETING_DATA(state->parameters) && (state->nextDataPageId > 0 || EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters))) {
         int8_t openResult = state->fileInterface->open(state->varFile, EMBEDDB_FILE_MODE_R_PLUS_B);
         if (openResult) {
+            if (checkpoint != NULL) {
+                return embedDBInitVarDataFromCheckpoint(state, checkpoint);
+            }
             return embedDBInitVarDataFromFile(state);
         }
     }
@@ -728,57 +1369,17 @@ int8_t embedDBInitVarDataFromFile(embedDBState *state) {
     id_t count = 0;
     count_t blockSize = state->eraseSizeInPages;
     bool validData = false;
-    bool hasData = false;
     void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
 
-    /* This will equal 0 if there are no pages to read */
-    int8_t moreToRead = !(readVariablePage(state, physicalVariablePageId));
-
-    /* this handles the case where the first page may have been erased, so has junk data and we actually need to start from the second page */
-    uint32_t i = 0;
-    while (moreToRead && i < 2) {
-        memcpy(&logicalVariablePageId, buffer, sizeof(id_t));
-        validData = logicalVariablePageId % state->numVarPages == count;
-        if (validData) {
-            uint64_t largestVarRecordId = 0;
-            /* Fetch the largest key value for which we have data on this page */
-            memcpy(&largestVarRecordId, (int8_t *)buffer + sizeof(id_t), state->keySize);
-            /*
-             * Since 0 is a valid first page and a valid record key, we may have a case where this data is valid.
-             * So we go to the next page to check if it is valid as well.
-             */
-            if (logicalVariablePageId != 0 || largestVarRecordId != 0) {
-                i = 2;
-                hasData = true;
-                maxLogicalVariablePageId = logicalVariablePageId;
-            }
-            physicalVariablePageId++;
-            count++;
-        } else {
-            id_t pagesToBlockBoundary = blockSize - (count % blockSize);
-            physicalVariablePageId += pagesToBlockBoundary;
-            count += pagesToBlockBoundary;
-            i++;
-        }
-        moreToRead = !(readVariablePage(state, physicalVariablePageId));
-    }
-
     /* if we have no valid data, we just have an empty file can can start from the scratch */
-    if (!hasData)
+    if (!findWriteHead(state, state->numVarPages, readVarPageLogicalId, &maxLogicalVariablePageId, &physicalVariablePageId))
         return 0;
 
-    while (moreToRead && count < state->numVarPages) {
-        memcpy(&logicalVariablePageId, buffer, sizeof(id_t));
-        validData = logicalVariablePageId % state->numVarPages == count;
-        if (validData && logicalVariablePageId == maxLogicalVariablePageId + 1) {
-            maxLogicalVariablePageId = logicalVariablePageId;
-            physicalVariablePageId++;
-            moreToRead = !(readVariablePage(state, physicalVariablePageId));
-            count++;
-        } else {
-            break;
-        }
-    }
+    physicalVariablePageId++;
+    count = physicalVariablePageId;
+
+    /* This will equal 0 if there are no pages to read */
+    int8_t moreToRead = !(readVariablePage(state, physicalVariablePageId));
 
     /*
      * Now we need to find where the page with the smallest key that is still valid.
@@ -858,1467 +1459,4781 @@ int8_t embedDBInitVarDataFromFile(embedDBState *state) {
 }
 
 /**
- * @brief   Prints the initialization stats of the given embedDB state
- * @param   state   embedDB state structure
- */
-void embedDBPrintInit(embedDBState *state) {
-    printf("EmbedDB State Initialization Stats:\n");
-    printf("Buffer size: %d  Page size: %d\n", state->bufferSizeInBlocks, state->pageSize);
-    printf("Key size: %d Data size: %d %sRecord size: %d\n", state->keySize, state->dataSize, EMBEDDB_USING_VDATA(state->parameters) ? "Variable data pointer size: 4 " : "", state->recordSize);
-    printf("Use index: %d  Max/min: %d Sum: %d Bmap: %d\n", EMBEDDB_USING_INDEX(state->parameters), EMBEDDB_USING_MAX_MIN(state->parameters), EMBEDDB_USING_SUM(state->parameters), EMBEDDB_USING_BMAP(state->parameters));
-    printf("Header size: %d  Records per page: %d\n", state->headerSize, state->maxRecordsPerPage);
-}
-
-/**
- * @brief	Given a state, uses the first and last keys to estimate a slope of keys
- * @param	state	embedDB algorithm state structure
- * @param	buffer	Pointer to in-memory buffer holding node
- * @return	Returns slope estimate float
+ * @brief	Finds the last page written to a circular file (data, index, or variable data) during recovery.
+ *          Pages are written in order of their logical page id, so the blocks written since the file last wrapped
+ *          hold consecutive ids and are followed by blocks that are erased, not written yet, or left over from the
+ *          previous pass. This lets the write head be found with a binary search over erase blocks, then over the
+ *          pages of the last block, using O(log numPages) page reads.
+ * @param	state				embedDB algorithm state structure
+ * @param	numPages			Number of pages in the file
+ * @param	readLogicalPageId	Reads the logical id of a physical page. Returns 1 if it is a valid page, 0 otherwise.
+ * @param	maxLogicalPageId	Return variable for the largest logical page id in the file
+ * @param	maxPhysicalPageId	Return variable for the physical page holding maxLogicalPageId
+ * @return	Return 1 if the file has valid pages, 0 if it is empty.
  */
-float embedDBCalculateSlope(embedDBState *state, void *buffer) {
-    // simplistic slope calculation where the first two entries are used, should be improved
+int8_t findWriteHead(embedDBState *state, uint32_t numPages, int8_t (*readLogicalPageId)(embedDBState *, id_t, id_t *), id_t *maxLogicalPageId, id_t *maxPhysicalPageId) {
+    count_t blockSize = state->eraseSizeInPages;
+    uint32_t numBlocks = numPages / blockSize;
+    id_t logicalPageId = 0;
 
-    uint32_t slopeX1, slopeX2;
-    slopeX1 = 0;
-    slopeX2 = EMBEDDB_GET_COUNT(buffer) - 1;
+    /* The first block may have been erased right before a crash, in which case we start from the second block */
+    id_t firstBlock = 0;
+    id_t firstLogicalPageId = 0;
+    if (!readLogicalPageId(state, 0, &firstLogicalPageId)) {
+        firstBlock = 1;
+        if (numBlocks < 2 || !readLogicalPageId(state, blockSize, &firstLogicalPageId)) {
+            return 0;
+        }
+    }
 
-    if (state->keySize <= 4) {
-        uint32_t slopeY1 = 0, slopeY2 = 0;
+    /* Find the last block that continues the run of logical ids from the first block */
+    uint32_t low = firstBlock, high = numBlocks - 1;
+    while (low < high) {
+        uint32_t mid = low + (high - low + 1) / 2;
+        if (readLogicalPageId(state, mid * blockSize, &logicalPageId) && logicalPageId == firstLogicalPageId + (mid - firstBlock) * blockSize) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
 
-        // check if both points are the same
-        if (slopeX1 == slopeX2) {
-            return 1;
+    /* Then find the last page in that block that continues the run */
+    id_t blockStart = low * blockSize;
+    id_t blockStartLogicalPageId = firstLogicalPageId + (low - firstBlock) * blockSize;
+    low = 0;
+    high = blockSize - 1;
+    while (low < high) {
+        uint32_t mid = low + (high - low + 1) / 2;
+        if (readLogicalPageId(state, blockStart + mid, &logicalPageId) && logicalPageId == blockStartLogicalPageId + mid) {
+            low = mid;
+        } else {
+            high = mid - 1;
         }
+    }
 
-        // convert to keys
-        memcpy(&slopeY1, ((int8_t *)buffer + state->headerSize + state->recordSize * slopeX1), state->keySize);
-        memcpy(&slopeY2, ((int8_t *)buffer + state->headerSize + state->recordSize * slopeX2), state->keySize);
+    *maxLogicalPageId = blockStartLogicalPageId + low;
+    *maxPhysicalPageId = blockStart + low;
+    return 1;
+}
 
-        // return slope of keys
-        return (float)(slopeY2 - slopeY1) / (float)(slopeX2 - slopeX1);
-    } else {
-        uint64_t slopeY1 = 0, slopeY2 = 0;
+/**
+ * @brief	Reads the logical page id of a data page for findWriteHead.
+ * @return	Return 1 if the physical page holds a valid data page, 0 otherwise.
+ */
+int8_t readDataPageLogicalId(embedDBState *state, id_t physicalPageId, id_t *logicalPageId) {
+    if (readPage(state, physicalPageId) != 0)
+        return 0;
 
-        // check if both points are the same
-        if (slopeX1 == slopeX2) {
-            return 1;
-        }
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    memcpy(logicalPageId, buffer, sizeof(id_t));
+    count_t numRecords = EMBEDDB_GET_COUNT(buffer);
+    return *logicalPageId % state->numDataPages == physicalPageId && numRecords > 0 && numRecords <= state->maxRecordsPerPage;
+}
 
-        // convert to keys
-        memcpy(&slopeY1, ((int8_t *)buffer + state->headerSize + state->recordSize * slopeX1), state->keySize);
-        memcpy(&slopeY2, ((int8_t *)buffer + state->headerSize + state->recordSize * slopeX2), state->keySize);
+/**
+ * @brief	Reads the logical page id of an index page for findWriteHead.
+ * @return	Return 1 if the physical page holds a valid index page, 0 otherwise.
+ */
+int8_t readIndexPageLogicalId(embedDBState *state, id_t physicalPageId, id_t *logicalPageId) {
+    if (readIndexPage(state, physicalPageId) != 0)
+        return 0;
 
-        // return slope of keys
-        return (float)(slopeY2 - slopeY1) / (float)(slopeX2 - slopeX1);
-    }
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
+    memcpy(logicalPageId, buffer, sizeof(id_t));
+    return *logicalPageId % state->numIndexPages == physicalPageId;
 }
 
 /**
- * @brief	Returns the maximum error for current page.
- * @param	state	embedDB algorithm state structure
- * @return	Returns max error integer.
+ * @brief	Reads the logical page id of a variable data page for findWriteHead.
+ * @return	Return 1 if the physical page holds a valid variable data page, 0 otherwise.
  */
-int32_t getMaxError(embedDBState *state, void *buffer) {
-    if (state->keySize <= 4) {
-        int32_t maxError = 0, currentError;
-        uint32_t minKey = 0, currentKey = 0;
-        memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
+int8_t readVarPageLogicalId(embedDBState *state, id_t physicalPageId, id_t *logicalPageId) {
+    if (readVariablePage(state, physicalPageId) != 0)
+        return 0;
 
-        // get slope of keys within page
-        float slope = embedDBCalculateSlope(state, buffer);
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+    memcpy(logicalPageId, buffer, sizeof(id_t));
+    if (*logicalPageId % state->numVarPages != physicalPageId)
+        return 0;
 
-        for (int i = 0; i < state->maxRecordsPerPage; i++) {
-            // loop all keys in page
-            memcpy(&currentKey, ((int8_t *)buffer + state->headerSize + state->recordSize * i), state->keySize);
+    /*
+     * Since 0 is a valid first page and a valid record key, an empty first page looks like page 0 with a largest key of 0.
+     * So it only counts as data if the next page is valid as well.
+     */
+    uint64_t largestVarRecordId = 0;
+    memcpy(&largestVarRecordId, (int8_t *)buffer + sizeof(id_t), state->keySize);
+    if (*logicalPageId == 0 && largestVarRecordId == 0) {
+        id_t nextLogicalPageId = 0;
+        return state->numVarPages > 1 && readVarPageLogicalId(state, 1, &nextLogicalPageId) && nextLogicalPageId == 1;
+    }
+    return 1;
+}
 
-            // make currentKey value relative to current page
-            currentKey = currentKey - minKey;
+/**
+ * @brief	Recovers the data file state from a checkpoint. Only the pages written after the checkpoint are read.
+ *          Falls back to scanning the whole data file if the checkpoint does not match what is in storage.
+ * @param	state		embedDB algorithm state structure
+ * @param	checkpoint	Most recent valid checkpoint
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitDataFromCheckpoint(embedDBState *state, embedDBCheckpoint *checkpoint) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    id_t logicalPageId = 0;
+    count_t numRecords = 0;
+
+    state->nextDataPageId = checkpoint->nextDataPageId;
+    state->minDataPageId = checkpoint->minDataPageId;
+    state->numAvailDataPages = checkpoint->numAvailDataPages;
+    state->maxError = checkpoint->maxError;
+
+    /* The checkpoint is only trusted if the last page it covers is still in storage */
+    bool validCheckpoint = true;
+    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters) && readCheckpointSlot(state, checkpoint->sequence % 2, checkpoint, 1) != 0) {
+        validCheckpoint = false;
+    } else if (state->nextDataPageId > 0) {
+        validCheckpoint = readPage(state, (state->nextDataPageId - 1) % state->numDataPages) == 0;
+        memcpy(&logicalPageId, buffer, sizeof(id_t));
+        validCheckpoint = validCheckpoint && logicalPageId == state->nextDataPageId - 1;
+    }
 
-            // Guard against integer underflow
-            if ((currentKey / slope) >= i) {
-                currentError = (currentKey / slope) - i;
-            } else {
-                currentError = i - (currentKey / slope);
-            }
-            if (currentError > maxError) {
-                maxError = currentError;
-            }
+    if (!validCheckpoint) {
+#ifdef PRINT_ERRORS
+        printf("WARNING: Checkpoint does not match the data file. Recovering from the data file instead.\n");
+#endif
+        state->nextDataPageId = 0;
+        state->minDataPageId = 0;
+        state->numAvailDataPages = state->numDataPages;
+        state->maxError = state->maxRecordsPerPage;
+        if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+            splineClose(state->spl);
+            splineInit(state->spl, state->numSplinePoints, state->indexMaxError, state->keySize);
         }
+        return embedDBInitDataFromFile(state);
+    }
 
-        if (maxError > state->maxRecordsPerPage) {
-            return state->maxRecordsPerPage;
+    /* Replay the bookkeeping of writePage for every page written after the checkpoint */
+    id_t pagesRead = 0;
+    while (pagesRead < state->numDataPages && readPage(state, state->nextDataPageId % state->numDataPages) == 0) {
+        memcpy(&logicalPageId, buffer, sizeof(id_t));
+        numRecords = EMBEDDB_GET_COUNT(buffer);
+        if (logicalPageId != state->nextDataPageId || numRecords == 0 || numRecords > state->maxRecordsPerPage) {
+            break;
         }
 
-        return maxError;
-    } else {
-        int32_t maxError = 0, currentError;
-        uint64_t currentKey = 0, minKey = 0;
-        memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
-
-        // get slope of keys within page
-        float slope = embedDBCalculateSlope(state, state->buffer);  // this is incorrect, should be buffer. TODO: fix
-
-        for (int i = 0; i < state->maxRecordsPerPage; i++) {
-            // loop all keys in page
-            memcpy(&currentKey, ((int8_t *)buffer + state->headerSize + state->recordSize * i), state->keySize);
-
-            // make currentKey value relative to current page
-            currentKey = currentKey - minKey;
-
-            // Guard against integer underflow
-            if ((currentKey / slope) >= i) {
-                currentError = (currentKey / slope) - i;
-            } else {
-                currentError = i - (currentKey / slope);
-            }
-            if (currentError > maxError) {
-                maxError = currentError;
+        if (state->numAvailDataPages <= 0) {
+            state->numAvailDataPages += state->eraseSizeInPages;
+            state->minDataPageId += state->eraseSizeInPages;
+            if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters) && !EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
+                cleanSpline(state, state->minDataPageId);
             }
         }
+        state->numAvailDataPages--;
+        state->nextDataPageId++;
 
-        if (maxError > state->maxRecordsPerPage) {
-            return state->maxRecordsPerPage;
+        if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+            addToSpline(state, embedDBGetMinKey(state, buffer), logicalPageId);
         }
-
-        return maxError;
+        updateMaxiumError(state, buffer);
+        pagesRead++;
     }
-}
 
-/**
- * @brief	Adds an entry for the current page into the search structure
- * @param	state	embedDB algorithm state structure
- */
-void indexPage(embedDBState *state, uint32_t pageNumber) {
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
-        splineAdd(state->spl, embedDBGetMinKey(state, state->buffer), pageNumber);
+    /* Put largest key back into the buffer */
+    if (state->nextDataPageId > 0) {
+        readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
     }
+
+    return 0;
 }
 
 /**
- * @brief	Puts a given key, data pair into structure.
- * @param	state	embedDB algorithm state structure
- * @param	key		Key for record
- * @param	data	Data for record
+ * @brief	Recovers the index file state from a checkpoint. Only the index pages written after the checkpoint are read.
+ *          Falls back to scanning the whole index file if the checkpoint does not match what is in storage.
+ * @param	state		embedDB algorithm state structure
+ * @param	checkpoint	Most recent valid checkpoint
  * @return	Return 0 if success. Non-zero value if error.
  */
-int8_t embedDBPut(embedDBState *state, void *key, void *data) {
-    /* Copy record into block */
+int8_t embedDBInitIndexFromCheckpoint(embedDBState *state, embedDBCheckpoint *checkpoint) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
+    id_t logicalIndexPageId = 0;
 
-    count_t count = EMBEDDB_GET_COUNT(state->buffer);
-    if (state->nextDataPageId > 0 || count > 0) {
-        void *previousKey = NULL;
-        if (count == 0) {
-            readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
-            previousKey = ((int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER) +
-                          (state->recordSize * (state->maxRecordsPerPage - 1)) + state->headerSize;
-        } else {
-            previousKey = (int8_t *)state->buffer + (state->recordSize * (count - 1)) + state->headerSize;
-        }
-        if (state->compareKey(key, previousKey) != 1) {
+    if (checkpoint->nextIdxPageId > 0) {
+        int8_t readResult = readIndexPage(state, (checkpoint->nextIdxPageId - 1) % state->numIndexPages);
+        memcpy(&logicalIndexPageId, buffer, sizeof(id_t));
+        if (readResult != 0 || logicalIndexPageId != checkpoint->nextIdxPageId - 1) {
 #ifdef PRINT_ERRORS
-            printf("Keys must be strictly ascending order. Insert Failed.\n");
+            printf("WARNING: Checkpoint does not match the index file. Recovering from the index file instead.\n");
 #endif
-            return 1;
+            return embedDBInitIndexFromFile(state);
         }
     }
 
-    /* Write current page if full */
-    bool wrotePage = false;
-    if (count >= state->maxRecordsPerPage) {
-        // As the first buffer is the data write buffer, no manipulation is required
-        id_t pageNum = writePage(state, state->buffer);
-
-        indexPage(state, pageNum);
+    state->nextIdxPageId = checkpoint->nextIdxPageId;
+    state->minIndexPageId = checkpoint->minIndexPageId;
+    state->numAvailIndexPages = checkpoint->numAvailIndexPages;
 
-        /* Save record in index file */
-        if (state->indexFile != NULL) {
-            void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
-            count_t idxcount = EMBEDDB_GET_COUNT(buf);
-            if (idxcount >= state->maxIdxRecordsPerPage) {
-                /* Save index page */
-                writeIndexPage(state, buf);
+    /* Replay the bookkeeping of writeIndexPage for every index page written after the checkpoint */
+    id_t pagesRead = 0;
+    while (pagesRead < state->numIndexPages && readIndexPage(state, state->nextIdxPageId % state->numIndexPages) == 0) {
+        memcpy(&logicalIndexPageId, buffer, sizeof(id_t));
+        if (logicalIndexPageId != state->nextIdxPageId) {
+            break;
+        }
 
-                idxcount = 0;
-                initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
+        if (state->numAvailIndexPages <= 0) {
+            state->numAvailIndexPages += state->eraseSizeInPages;
+            state->minIndexPageId += state->eraseSizeInPages;
+        }
+        state->numAvailIndexPages--;
+        state->nextIdxPageId++;
+        pagesRead++;
+    }
 
-                /* Add page id to minimum value spot in page */
-                id_t *ptr = (id_t *)((int8_t *)buf + 8);
-                *ptr = pageNum;
-            }
+    return 0;
+}
 
-            EMBEDDB_INC_COUNT(buf);
+/**
+ * @brief	Recovers the variable data file state from a checkpoint. Only the variable data pages written after the checkpoint are read.
+ *          Falls back to scanning the whole variable data file if the checkpoint does not match what is in storage.
+ * @param	state		embedDB algorithm state structure
+ * @param	checkpoint	Most recent valid checkpoint
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitVarDataFromCheckpoint(embedDBState *state, embedDBCheckpoint *checkpoint) {
+    void *buffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+    id_t logicalVariablePageId = 0;
 
-            /* Copy record onto index page */
-            void *bm = EMBEDDB_GET_BITMAP(state->buffer);
-            memcpy((void *)((int8_t *)buf + EMBEDDB_IDX_HEADER_SIZE + state->bitmapSize * idxcount), bm, state->bitmapSize);
+    if (checkpoint->nextVarPageId > 0) {
+        int8_t readResult = readVariablePage(state, (checkpoint->nextVarPageId - 1) % state->numVarPages);
+        memcpy(&logicalVariablePageId, buffer, sizeof(id_t));
+        if (readResult != 0 || logicalVariablePageId != checkpoint->nextVarPageId - 1) {
+#ifdef PRINT_ERRORS
+            printf("WARNING: Checkpoint does not match the variable data file. Recovering from the variable data file instead.\n");
+#endif
+            return embedDBInitVarDataFromFile(state);
         }
+    }
 
-        updateMaxiumError(state, state->buffer);
+    state->nextVarPageId = checkpoint->nextVarPageId;
+    state->numAvailVarPages = checkpoint->numAvailVarPages;
+    state->minVarRecordId = checkpoint->minVarRecordId;
 
-        count = 0;
-        initBufferPage(state, 0);
-        wrotePage = true;
-    }
+    /* Replay the bookkeeping of writeVariablePage for every variable data page written after the checkpoint */
+    bool erasedBlock = false;
+    id_t pagesRead = 0;
+    while (pagesRead < state->numVarPages && readVariablePage(state, state->nextVarPageId % state->numVarPages) == 0) {
+        memcpy(&logicalVariablePageId, buffer, sizeof(id_t));
+        if (logicalVariablePageId != state->nextVarPageId) {
+            break;
+        }
 
-    /* Copy record onto page */
-    memcpy((int8_t *)state->buffer + (state->recordSize * count) + state->headerSize, key, state->keySize);
-    memcpy((int8_t *)state->buffer + (state->recordSize * count) + state->headerSize + state->keySize, data, state->dataSize);
+        if (state->numAvailVarPages <= 0) {
+            state->numAvailVarPages += state->eraseSizeInPages;
+            erasedBlock = true;
+        }
+        state->numAvailVarPages--;
+        state->nextVarPageId++;
+        pagesRead++;
+    }
 
-    /* Copy variable data offset if using variable data*/
-    if (EMBEDDB_USING_VDATA(state->parameters)) {
-        uint32_t dataLocation;
-        if (state->recordHasVarData) {
-            dataLocation = state->currentVarLoc % (state->numVarPages * state->pageSize);
-        } else {
-            dataLocation = EMBEDDB_NO_VAR_DATA;
+    /* The last page of an erased block is gone, so like a full scan we only keep the records after the oldest page still in storage */
+    if (erasedBlock) {
+        id_t oldestPageId = state->nextVarPageId - (state->numVarPages - state->numAvailVarPages);
+        if (readVariablePage(state, oldestPageId % state->numVarPages) != 0) {
+#ifdef PRINT_ERRORS
+            printf("Error reading variable page with smallest data. \n");
+#endif
+            return -1;
         }
-        memcpy((int8_t *)state->buffer + (state->recordSize * count) + state->headerSize + state->keySize + state->dataSize, &dataLocation, sizeof(uint32_t));
+        state->minVarRecordId = 0;
+        memcpy(&(state->minVarRecordId), (int8_t *)buffer + sizeof(id_t), state->keySize);
+        state->minVarRecordId++;
     }
 
-    /* Update count */
-    EMBEDDB_INC_COUNT(state->buffer);
+    /* The partially filled page that was in the write buffer never reached storage, so writing resumes on a new page */
+    state->currentVarLoc = state->nextVarPageId % state->numVarPages * state->pageSize + state->variableDataHeaderSize;
 
-    if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
-        /* Update MIN/MAX */
-        void *ptr;
-        if (count != 0) {
-            /* Since keys are inserted in ascending order, every insert will
-             * update max. Min will never change after first record. */
-            ptr = EMBEDDB_GET_MAX_KEY(state->buffer, state);
-            memcpy(ptr, key, state->keySize);
-
-            ptr = EMBEDDB_GET_MIN_DATA(state->buffer, state);
-            if (state->compareData(data, ptr) < 0)
-                memcpy(ptr, data, state->dataSize);
-            ptr = EMBEDDB_GET_MAX_DATA(state->buffer, state);
-            if (state->compareData(data, ptr) > 0)
-                memcpy(ptr, data, state->dataSize);
-        } else {
-            /* First record inserted */
-            ptr = EMBEDDB_GET_MIN_KEY(state->buffer);
-            memcpy(ptr, key, state->keySize);
-            ptr = EMBEDDB_GET_MAX_KEY(state->buffer, state);
-            memcpy(ptr, key, state->keySize);
+    return 0;
+}
 
-            ptr = EMBEDDB_GET_MIN_DATA(state->buffer, state);
-            memcpy(ptr, data, state->dataSize);
-            ptr = EMBEDDB_GET_MAX_DATA(state->buffer, state);
-            memcpy(ptr, data, state->dataSize);
-        }
+/**
+ * @brief	Returns the number of pages in each of the two checkpoint slots. Slots are a whole number of erase blocks.
+ * @param	state	embedDB algorithm state structure
+ * @return	Number of pages per checkpoint slot
+ */
+uint32_t checkpointSlotSizeInPages(embedDBState *state) {
+    uint32_t numBytes = sizeof(embedDBCheckpoint) + sizeof(uint32_t);
+    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+        uint32_t pointSize = state->keySize + sizeof(uint32_t);
+        numBytes += 3 * pointSize + state->keySize + state->numSplinePoints * pointSize;
     }
+    uint32_t numPages = (numBytes + state->pageSize - 1) / state->pageSize;
+    return (numPages + state->eraseSizeInPages - 1) / state->eraseSizeInPages * state->eraseSizeInPages;
+}
 
-    if (EMBEDDB_USING_BMAP(state->parameters)) {
-        /* Update bitmap */
-        char *bm = (char *)EMBEDDB_GET_BITMAP(state->buffer);
-        state->updateBitmap(data, bm);
+/**
+ * @brief	Adds bytes to a running FNV-1a checksum.
+ */
+void checkpointChecksum(uint32_t *checksum, void *bytes, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        *checksum ^= ((uint8_t *)bytes)[i];
+        *checksum *= 16777619;
     }
+}
 
-    /* If using record level consistency, we need to immediately write the updated page to storage */
-    if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
-        /* Need to move record level consistency pointers if on a block boundary */
-        if (wrotePage && state->nextDataPageId % state->eraseSizeInPages == 0) {
-            /* move record-level consistency blocks */
-            shiftRecordLevelConsistencyBlocks(state);
+/**
+ * @brief	Appends bytes to a checkpoint, writing out each page of the slot as it fills.
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t checkpointStreamWrite(embedDBState *state, embedDBCheckpointStream *stream, void *bytes, uint32_t length) {
+    checkpointChecksum(&stream->checksum, bytes, length);
+    while (length > 0) {
+        count_t numBytes = min(length, (uint32_t)(state->pageSize - stream->offset));
+        memcpy((int8_t *)stream->buffer + stream->offset, bytes, numBytes);
+        bytes = (int8_t *)bytes + numBytes;
+        length -= numBytes;
+        stream->offset += numBytes;
+        if (stream->offset == state->pageSize) {
+            if (!state->fileInterface->write(stream->buffer, stream->pageNum, state->pageSize, state->checkpointFile)) {
+                return -1;
+            }
+            stream->pageNum++;
+            stream->offset = 0;
         }
-        return writeTemporaryPage(state, state->buffer);
     }
-
     return 0;
 }
 
-int8_t shiftRecordLevelConsistencyBlocks(embedDBState *state) {
-    /* erase the record-level consistency blocks */
-
-    /* TODO: Likely an optimisation here where we don't always need to erase the second block, but that will make this algorithm more complicated and the savings could be minimal */
-    uint32_t numRecordLevelConsistencyPages = state->eraseSizeInPages * 2;
-    uint32_t eraseStartingPage = state->rlcPhysicalStartingPage;
-    uint32_t eraseEndingPage = 0;
-
-    /* if we have wraped, we need to erase an additional block as the block we are shifting into is not empty */
-    bool haveWrapped = (state->minDataPageId % state->numDataPages) == ((state->rlcPhysicalStartingPage + numRecordLevelConsistencyPages) % state->numDataPages);
-    uint32_t numBlocksToErase = haveWrapped ? 2 : 3;
-
-    /* Erase pages to make space for new data */
-    for (size_t i = 0; i < numBlocksToErase; i++) {
-        eraseEndingPage = eraseStartingPage + state->eraseSizeInPages;
-        int8_t eraseSuccess = state->fileInterface->erase(eraseStartingPage, eraseEndingPage, state->pageSize, state->dataFile);
-        if (!eraseSuccess) {
-#ifdef PRINT_ERRORS
-            printf("Error: Unable to erase pages in data file when shifting record level consistency blocks!\n");
-#endif
+/**
+ * @brief	Reads the next bytes of a checkpoint, reading in each page of the slot as it is needed.
+ * @param	bytes	Return variable for the bytes. NULL to only add them to the checksum.
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t checkpointStreamRead(embedDBState *state, embedDBCheckpointStream *stream, void *bytes, uint32_t length) {
+    while (length > 0) {
+        if (stream->offset == 0 && !state->fileInterface->read(stream->buffer, stream->pageNum, state->pageSize, state->checkpointFile)) {
             return -1;
         }
-        eraseStartingPage = eraseEndingPage % state->numDataPages;
+        count_t numBytes = min(length, (uint32_t)(state->pageSize - stream->offset));
+        checkpointChecksum(&stream->checksum, (int8_t *)stream->buffer + stream->offset, numBytes);
+        if (bytes != NULL) {
+            memcpy(bytes, (int8_t *)stream->buffer + stream->offset, numBytes);
+            bytes = (int8_t *)bytes + numBytes;
+        }
+        length -= numBytes;
+        stream->offset += numBytes;
+        if (stream->offset == state->pageSize) {
+            stream->pageNum++;
+            stream->offset = 0;
+        }
     }
+    return 0;
+}
 
-    /* shift min data page if needed */
-    if (haveWrapped) {
-        /* Flag the pages as usable to EmbedDB */
-        state->numAvailDataPages += state->eraseSizeInPages;
-        state->minDataPageId += state->eraseSizeInPages;
+/**
+ * @brief	Reads and validates the checkpoint in one of the two checkpoint slots.
+ * @param	state			embedDB algorithm state structure
+ * @param	slot			Slot to read (0 or 1)
+ * @param	checkpoint		Return variable for the checkpoint metadata
+ * @param	restoreSpline	1 to load the saved spline into state->spl, 0 to only validate it
+ * @return	Return 0 if the slot holds a valid checkpoint for this configuration, -1 otherwise.
+ */
+int8_t readCheckpointSlot(embedDBState *state, uint32_t slot, embedDBCheckpoint *checkpoint, uint8_t restoreSpline) {
+    embedDBCheckpointStream stream = {(int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER, slot * checkpointSlotSizeInPages(state), 0, 2166136261u};
+    state->bufferedPageId = -1;
 
-        /* remove any spline points related to these pages */
-        if (!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
-            cleanSpline(state, state->minDataPageId);
-        }
+    if (checkpointStreamRead(state, &stream, checkpoint, sizeof(embedDBCheckpoint)) != 0) {
+        return -1;
     }
 
-    /* shift record-level consistency blocks */
-    state->rlcPhysicalStartingPage = (state->rlcPhysicalStartingPage + state->eraseSizeInPages) % state->numDataPages;
-    state->nextRLCPhysicalPageLocation = state->rlcPhysicalStartingPage;
+    bool matchesLayout = checkpoint->magic == EMBEDDB_CHECKPOINT_MAGIC &&
+                         checkpoint->numDataPages == state->numDataPages &&
+                         checkpoint->numIndexPages == (EMBEDDB_USING_INDEX(state->parameters) ? state->numIndexPages : 0) &&
+                         checkpoint->numVarPages == (EMBEDDB_USING_VDATA(state->parameters) ? state->numVarPages : 0) &&
+                         checkpoint->numSplinePoints == state->numSplinePoints &&
+                         checkpoint->pageSize == state->pageSize &&
+                         checkpoint->eraseSizeInPages == state->eraseSizeInPages &&
+                         checkpoint->dataFilePageSize == dataFilePageSize(state) &&
+                         checkpoint->layoutParameters == (state->parameters & EMBEDDB_CHECKPOINT_LAYOUT_PARAMETERS) &&
+                         checkpoint->keySize == state->keySize &&
+                         checkpoint->dataSize == state->dataSize &&
+                         checkpoint->headerSize == state->headerSize &&
+                         checkpoint->bitmapSize == state->bitmapSize &&
+                         checkpoint->keyOffsetSize == (EMBEDDB_USING_KEY_OFFSETS(state->parameters) ? state->keyOffsetSize : 0) &&
+                         checkpoint->splineCount <= state->numSplinePoints;
+    if (!matchesLayout) {
+        return -1;
+    }
 
-    return 0;
-}
+    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+        spline *spl = state->spl;
+        uint32_t pointSize = state->keySize + sizeof(uint32_t);
+        if (restoreSpline) {
+            spl->pointsStartIndex = 0;
+        }
+        int8_t readResult = checkpointStreamRead(state, &stream, restoreSpline ? spl->upper : NULL, pointSize);
+        readResult |= checkpointStreamRead(state, &stream, restoreSpline ? spl->lower : NULL, pointSize);
+        readResult |= checkpointStreamRead(state, &stream, restoreSpline ? spl->firstSplinePoint : NULL, pointSize);
+        readResult |= checkpointStreamRead(state, &stream, restoreSpline ? spl->lastKey : NULL, state->keySize);
+        for (uint32_t i = 0; i < checkpoint->splineCount; i++) {
+            readResult |= checkpointStreamRead(state, &stream, restoreSpline ? splinePointLocation(spl, i) : NULL, pointSize);
+        }
+        if (readResult != 0) {
+            return -1;
+        }
+        if (restoreSpline) {
+            spl->count = checkpoint->splineCount;
+            spl->lastLoc = checkpoint->splineLastLoc;
+            spl->numAddCalls = checkpoint->splineNumAddCalls;
+            spl->tempLastPoint = checkpoint->splineTempLastPoint;
+            spl->eraseSize = checkpoint->splineEraseSize;
+        }
+    }
 
-void updateMaxiumError(embedDBState *state, void *buffer) {
-    // Calculate error within the page
-    int32_t maxError = getMaxError(state, buffer);
-    if (state->maxError < maxError) {
-        state->maxError = maxError;
+    uint32_t expectedChecksum = stream.checksum;
+    uint32_t savedChecksum = 0;
+    if (checkpointStreamRead(state, &stream, &savedChecksum, sizeof(uint32_t)) != 0) {
+        return -1;
     }
+    return savedChecksum == expectedChecksum ? 0 : -1;
 }
 
 /**
- * @brief	Puts the given key, data, and variable length data into the structure.
- * @param	state			embedDB algorithm state structure
- * @param	key				Key for record
- * @param	data			Data for record
- * @param	variableData	Variable length data for record
- * @param	length			Length of the variable length data in bytes
- * @return	Return 0 if success. Non-zero value if error.
+ * @brief	Opens the checkpoint file and finds the most recent valid checkpoint in it.
+ * @param	state		embedDB algorithm state structure
+ * @param	checkpoint	Return variable for the most recent checkpoint
+ * @return	Return 1 if a checkpoint was found, 0 if there is none, and -1 if error.
  */
-int8_t embedDBPutVar(embedDBState *state, void *key, void *data, void *variableData, uint32_t length) {
-    if (!EMBEDDB_USING_VDATA(state->parameters)) {
+int8_t embedDBInitCheckpoint(embedDBState *state, embedDBCheckpoint *checkpoint) {
+    state->checkpointSequence = 0;
+    state->lastCheckpointDataPageId = 0;
+
+    if (state->checkpointFile == NULL) {
 #ifdef PRINT_ERRORS
-        printf("Error: Can't insert variable data because it is not enabled\n");
+        printf("ERROR: No checkpoint file provided!\n");
 #endif
         return -1;
     }
 
-    // Insert their data
-
-    /*
-     * Check that there is enough space remaining in this page to start the insert of the variable
-     * data here and if the data page will be written in embedDBGet
-     */
-    void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
-    if (state->currentVarLoc % state->pageSize > state->pageSize - 4 || (!(EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) && EMBEDDB_GET_COUNT(state->buffer) >= state->maxRecordsPerPage)) {
-        writeVariablePage(state, buf);
-        initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
-        // Move data writing location to the beginning of the next page, leaving the room for the header
-        state->currentVarLoc += state->pageSize - state->currentVarLoc % state->pageSize + state->variableDataHeaderSize;
+    if (!EMBEDDB_RESETING_DATA(state->parameters)) {
+        int8_t openStatus = state->fileInterface->open(state->checkpointFile, EMBEDDB_FILE_MODE_R_PLUS_B);
+        if (openStatus) {
+            embedDBCheckpoint slotCheckpoint;
+            int8_t found = 0;
+            for (uint32_t slot = 0; slot < 2; slot++) {
+                if (readCheckpointSlot(state, slot, &slotCheckpoint, 0) == 0 && (!found || slotCheckpoint.sequence > checkpoint->sequence)) {
+                    memcpy(checkpoint, &slotCheckpoint, sizeof(embedDBCheckpoint));
+                    found = 1;
+                }
+            }
+            if (found) {
+                state->checkpointSequence = checkpoint->sequence;
+                state->lastCheckpointDataPageId = checkpoint->nextDataPageId;
+            }
+            return found;
+        }
     }
 
-    if (variableData == NULL) {
-        // Var data enabled, but not provided
-        state->recordHasVarData = 0;
-        return embedDBPut(state, key, data);
+    int8_t openStatus = state->fileInterface->open(state->checkpointFile, EMBEDDB_FILE_MODE_W_PLUS_B);
+    if (!openStatus) {
+#ifdef PRINT_ERRORS
+        printf("Error: Can't open checkpoint file!\n");
+#endif
+        return -1;
     }
 
-    // Perform the regular insert
-    state->recordHasVarData = 1;
-    int8_t r;
-    if ((r = embedDBPut(state, key, data)) != 0) {
-        return r;
-    }
+    return 0;
+}
 
-    if (state->minVarRecordId == UINT64_MAX) {
-        memcpy(&state->minVarRecordId, key, state->keySize);
+/**
+ * @brief	Writes a checkpoint of the current page counters and spline, so that the next embedDBInit only has to scan pages written after it.
+ *          Checkpoints alternate between two slots, so a failed write never destroys the previous checkpoint.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBWriteCheckpoint(embedDBState *state) {
+    /* Every page the checkpoint covers has to reach storage before the checkpoint does */
+    if (embedDBWaitForBackgroundWriter(state) != 0) {
+        return -1;
+    }
+    state->fileInterface->flush(state->dataFile);
+    if (state->indexFile != NULL) {
+        state->fileInterface->flush(state->indexFile);
+    }
+    if (state->varFile != NULL) {
+        state->fileInterface->flush(state->varFile);
     }
 
-    // Update the header to include the maximum key value stored on this page
-    memcpy((int8_t *)buf + sizeof(id_t), key, state->keySize);
-
-    // Write the length of the data item into the buffer
-    memcpy((uint8_t *)buf + state->currentVarLoc % state->pageSize, &length, sizeof(uint32_t));
-    state->currentVarLoc += 4;
-
-    // Check if we need to write after doing that
-    if (state->currentVarLoc % state->pageSize == 0) {
-        writeVariablePage(state, buf);
-        initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
-
-        // Update the header to include the maximum key value stored on this page
-        memcpy((int8_t *)buf + sizeof(id_t), key, state->keySize);
-        state->currentVarLoc += state->variableDataHeaderSize;
+    embedDBCheckpoint checkpoint;
+    memset(&checkpoint, 0, sizeof(embedDBCheckpoint));
+    checkpoint.magic = EMBEDDB_CHECKPOINT_MAGIC;
+    checkpoint.sequence = state->checkpointSequence + 1;
+    checkpoint.numDataPages = state->numDataPages;
+    checkpoint.numIndexPages = EMBEDDB_USING_INDEX(state->parameters) ? state->numIndexPages : 0;
+    checkpoint.numVarPages = EMBEDDB_USING_VDATA(state->parameters) ? state->numVarPages : 0;
+    checkpoint.numSplinePoints = state->numSplinePoints;
+    checkpoint.pageSize = state->pageSize;
+    checkpoint.eraseSizeInPages = state->eraseSizeInPages;
+    checkpoint.dataFilePageSize = dataFilePageSize(state);
+    checkpoint.layoutParameters = state->parameters & EMBEDDB_CHECKPOINT_LAYOUT_PARAMETERS;
+    checkpoint.keySize = state->keySize;
+    checkpoint.dataSize = state->dataSize;
+    checkpoint.headerSize = state->headerSize;
+    checkpoint.bitmapSize = state->bitmapSize;
+    checkpoint.keyOffsetSize = EMBEDDB_USING_KEY_OFFSETS(state->parameters) ? state->keyOffsetSize : 0;
+    checkpoint.nextDataPageId = state->nextDataPageId;
+    checkpoint.minDataPageId = state->minDataPageId;
+    checkpoint.numAvailDataPages = state->numAvailDataPages;
+    checkpoint.maxError = state->maxError;
+    checkpoint.nextIdxPageId = state->nextIdxPageId;
+    checkpoint.minIndexPageId = state->minIndexPageId;
+    checkpoint.numAvailIndexPages = state->numAvailIndexPages;
+    checkpoint.nextVarPageId = state->nextVarPageId;
+    checkpoint.numAvailVarPages = state->numAvailVarPages;
+    checkpoint.minVarRecordId = state->minVarRecordId;
+    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+        checkpoint.splineCount = state->spl->count;
+        checkpoint.splineLastLoc = state->spl->lastLoc;
+        checkpoint.splineNumAddCalls = state->spl->numAddCalls;
+        checkpoint.splineTempLastPoint = state->spl->tempLastPoint;
+        checkpoint.splineEraseSize = state->spl->eraseSize;
     }
 
-    int amtWritten = 0;
-    while (length > 0) {
-        // Copy data into the buffer. Write the min of the space left in this page and the remaining length of the data
-        uint16_t amtToWrite = min(state->pageSize - state->currentVarLoc % state->pageSize, length);
-        memcpy((uint8_t *)buf + (state->currentVarLoc % state->pageSize), (uint8_t *)variableData + amtWritten, amtToWrite);
-        length -= amtToWrite;
-        amtWritten += amtToWrite;
-        state->currentVarLoc += amtToWrite;
+    uint32_t slotSize = checkpointSlotSizeInPages(state);
+    id_t firstPage = (checkpoint.sequence % 2) * slotSize;
+    int8_t eraseResult = state->fileInterface->erase(firstPage, firstPage + slotSize, state->pageSize, state->checkpointFile);
+    if (eraseResult != 1) {
+#ifdef PRINT_ERRORS
+        printf("Failed to erase checkpoint slot starting at page %i\n", firstPage);
+#endif
+        return -1;
+    }
 
-        // If we need to write the buffer to file
-        if (state->currentVarLoc % state->pageSize == 0) {
-            writeVariablePage(state, buf);
-            initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+    /* The checkpoint is staged in the data read buffer */
+    embedDBCheckpointStream stream = {(int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER, firstPage, 0, 2166136261u};
+    state->bufferedPageId = -1;
 
-            // Update the header to include the maximum key value stored on this page and account for page number
-            memcpy((int8_t *)buf + sizeof(id_t), key, state->keySize);
-            state->currentVarLoc += state->variableDataHeaderSize;
+    int8_t writeResult = checkpointStreamWrite(state, &stream, &checkpoint, sizeof(embedDBCheckpoint));
+    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+        spline *spl = state->spl;
+        uint32_t pointSize = state->keySize + sizeof(uint32_t);
+        writeResult |= checkpointStreamWrite(state, &stream, spl->upper, pointSize);
+        writeResult |= checkpointStreamWrite(state, &stream, spl->lower, pointSize);
+        writeResult |= checkpointStreamWrite(state, &stream, spl->firstSplinePoint, pointSize);
+        writeResult |= checkpointStreamWrite(state, &stream, spl->lastKey, state->keySize);
+        for (uint32_t i = 0; i < spl->count; i++) {
+            writeResult |= checkpointStreamWrite(state, &stream, splinePointLocation(spl, i), pointSize);
         }
     }
+    uint32_t checksum = stream.checksum;
+    writeResult |= checkpointStreamWrite(state, &stream, &checksum, sizeof(uint32_t));
 
-    if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
-        embedDBFlushVar(state);
+    /* Write out the last partially filled page */
+    if (writeResult == 0 && stream.offset > 0) {
+        memset((int8_t *)stream.buffer + stream.offset, 0, state->pageSize - stream.offset);
+        writeResult = state->fileInterface->write(stream.buffer, stream.pageNum, state->pageSize, state->checkpointFile) ? 0 : -1;
+    }
+
+    if (writeResult != 0) {
+#ifdef PRINT_ERRORS
+        printf("Failed to write checkpoint %i\n", checkpoint.sequence);
+#endif
+        return -1;
     }
 
+    state->fileInterface->flush(state->checkpointFile);
+    state->checkpointSequence = checkpoint.sequence;
+    state->lastCheckpointDataPageId = state->nextDataPageId;
     return 0;
 }
 
 /**
- * @brief	Given a key, estimates the location of the key within the node.
- * @param	state	embedDB algorithm state structure
- * @param	buffer	Pointer to in-memory buffer holding node
- * @param	key		Key for record
+ * @brief   Prints the initialization stats of the given embedDB state
+ * @param   state   embedDB state structure
  */
-int16_t embedDBEstimateKeyLocation(embedDBState *state, void *buffer, void *key) {
-    // get slope to use for linear estimation of key location
-    // return estimated location of the key
-    float slope = embedDBCalculateSlope(state, buffer);
-
-    uint64_t minKey = 0, thisKey = 0;
-    memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
-    memcpy(&thisKey, key, state->keySize);
-
-    return (thisKey - minKey) / slope;
+void embedDBPrintInit(embedDBState *state) {
+    printf("EmbedDB State Initialization Stats:\n");
+    printf("Buffer size: %d  Page size: %d\n", state->bufferSizeInBlocks, state->pageSize);
+    printf("Key size: %d Data size: %d %sRecord size: %d\n", state->keySize, state->dataSize, EMBEDDB_USING_VDATA(state->parameters) ? "Variable data pointer size: 4 " : "", state->recordSize);
+    printf("Use index: %d  Max/min: %d Sum: %d Bmap: %d\n", EMBEDDB_USING_INDEX(state->parameters), EMBEDDB_USING_MAX_MIN(state->parameters), EMBEDDB_USING_SUM(state->parameters), EMBEDDB_USING_BMAP(state->parameters));
+    printf("Header size: %d  Records per page: %d\n", state->headerSize, state->maxRecordsPerPage);
 }
 
 /**
- * @brief	Given a key, searches the node for the key. If interior node, returns child record number containing next page id to follow. If leaf node, returns if of first record with that key or (<= key). Returns -1 if key is not found.
+ * @brief	Given a state, uses the first and last keys to estimate a slope of keys
  * @param	state	embedDB algorithm state structure
  * @param	buffer	Pointer to in-memory buffer holding node
- * @param	key		Key for record
- * @param	range	1 if range query so return pointer to first record <= key, 0 if exact query so much return first exact match record
+ * @return	Returns slope estimate float
  */
-id_t embedDBSearchNode(embedDBState *state, void *buffer, void *key, int8_t range) {
-    int16_t first, last, middle, count;
-    int8_t compare;
-    void *mkey;
+float embedDBCalculateSlope(embedDBState *state, void *buffer) {
+    // simplistic slope calculation where the first two entries are used, should be improved
 
-    count = EMBEDDB_GET_COUNT(buffer);
-    middle = embedDBEstimateKeyLocation(state, buffer, key);
+    uint32_t slopeX1, slopeX2;
+    slopeX1 = 0;
+    slopeX2 = EMBEDDB_GET_COUNT(buffer) - 1;
 
-    // check that maxError was calculated and middle is valid (searches full node otherwise)
-    if (state->maxError == -1 || middle >= count || middle <= 0) {
-        first = 0;
-        last = count - 1;
-        middle = (first + last) / 2;
-    } else {
-        first = 0;
-        last = count - 1;
-    }
+    if (state->keySize <= 4) {
+        uint32_t slopeY1 = 0, slopeY2 = 0;
+
+        // check if both points are the same
+        if (slopeX1 == slopeX2) {
+            return 1;
+        }
+
+        // convert to keys
+        memcpy(&slopeY1, ((int8_t *)buffer + state->headerSize + state->recordSize * slopeX1), state->keySize);
+        memcpy(&slopeY2, ((int8_t *)buffer + state->headerSize + state->recordSize * slopeX2), state->keySize);
+
+        // return slope of keys
+        return (float)(slopeY2 - slopeY1) / (float)(slopeX2 - slopeX1);
+    } else {
+        uint64_t slopeY1 = 0, slopeY2 = 0;
+
+        // check if both points are the same
+        if (slopeX1 == slopeX2) {
+            return 1;
+        }
+
+        // convert to keys
+        memcpy(&slopeY1, ((int8_t *)buffer + state->headerSize + state->recordSize * slopeX1), state->keySize);
+        memcpy(&slopeY2, ((int8_t *)buffer + state->headerSize + state->recordSize * slopeX2), state->keySize);
+
+        // return slope of keys
+        return (float)(slopeY2 - slopeY1) / (float)(slopeX2 - slopeX1);
+    }
+}
+
+/**
+ * @brief	Returns the maximum error for current page.
+ * @param	state	embedDB algorithm state structure
+ * @return	Returns max error integer.
+ */
+int32_t getMaxError(embedDBState *state, void *buffer) {
+    if (state->keySize <= 4) {
+        int32_t maxError = 0, currentError;
+        uint32_t minKey = 0, currentKey = 0;
+        memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
+
+        // get slope of keys within page
+        float slope = embedDBCalculateSlope(state, buffer);
+
+        for (int i = 0; i < state->maxRecordsPerPage; i++) {
+            // loop all keys in page
+            memcpy(&currentKey, ((int8_t *)buffer + state->headerSize + state->recordSize * i), state->keySize);
+
+            // make currentKey value relative to current page
+            currentKey = currentKey - minKey;
+
+            // Guard against integer underflow
+            if ((currentKey / slope) >= i) {
+                currentError = (currentKey / slope) - i;
+            } else {
+                currentError = i - (currentKey / slope);
+            }
+            if (currentError > maxError) {
+                maxError = currentError;
+            }
+        }
+
+        if (maxError > state->maxRecordsPerPage) {
+            return state->maxRecordsPerPage;
+        }
+
+        return maxError;
+    } else {
+        int32_t maxError = 0, currentError;
+        uint64_t currentKey = 0, minKey = 0;
+        memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
+
+        // get slope of keys within page
+        float slope = embedDBCalculateSlope(state, state->buffer);  // this is incorrect, should be buffer. TODO: fix
+
+        for (int i = 0; i < state->maxRecordsPerPage; i++) {
+            // loop all keys in page
+            memcpy(&currentKey, ((int8_t *)buffer + state->headerSize + state->recordSize * i), state->keySize);
+
+            // make currentKey value relative to current page
+            currentKey = currentKey - minKey;
+
+            // Guard against integer underflow
+            if ((currentKey / slope) >= i) {
+                currentError = (currentKey / slope) - i;
+            } else {
+                currentError = i - (currentKey / slope);
+            }
+            if (currentError > maxError) {
+                maxError = currentError;
+            }
+        }
+
+        if (maxError > state->maxRecordsPerPage) {
+            return state->maxRecordsPerPage;
+        }
+
+        return maxError;
+    }
+}
+
+/**
+ * @brief	Adds an entry for the current page into the search structure
+ * @param	state	embedDB algorithm state structure
+ */
+void indexPage(embedDBState *state, uint32_t pageNumber) {
+    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+        addToSpline(state, embedDBGetMinKey(state, state->buffer), pageNumber);
+    }
+}
+
+/**
+ * @brief	Puts a given key, data pair into structure.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for record
+ * @param	data	Data for record
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBPut(embedDBState *state, void *key, void *data) {
+    if (state->reorderBuffer != NULL) {
+        return reorderBufferPut(state, key, data);
+    }
+    return putOrderedRecord(state, key, data);
+}
+
+/**
+ * @brief	Returns the key of the last record stored, in the write buffer or on the last data page written.
+ * @param	state	embedDB algorithm state structure
+ * @return	Pointer to the key in the write buffer or the data read buffer. NULL if no record has been stored.
+ */
+void *previousStoredKey(embedDBState *state) {
+    count_t count = EMBEDDB_GET_COUNT(state->buffer);
+    if (count > 0) {
+        return (int8_t *)state->buffer + (state->recordSize * (count - 1)) + state->headerSize;
+    }
+    if (state->nextDataPageId == 0) {
+        return NULL;
+    }
+
+    /* The last stored page is not full when it was flushed or compressed */
+    readPage(state, (state->nextDataPageId - 1) % state->numDataPages);
+    void *readBuffer = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    return (int8_t *)readBuffer + (state->recordSize * (EMBEDDB_GET_COUNT(readBuffer) - 1)) + state->headerSize;
+}
+
+/**
+ * @brief	Adds a record to the write buffer, writing the page first if it is full. The key must be larger than any key already stored.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for record
+ * @param	data	Data for record
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t putOrderedRecord(embedDBState *state, void *key, void *data) {
+    /* Copy record into block */
+
+    count_t count = EMBEDDB_GET_COUNT(state->buffer);
+    void *previousKey = previousStoredKey(state);
+    if (previousKey != NULL && state->compareKey(key, previousKey) != 1) {
+#ifdef PRINT_ERRORS
+        printf("Keys must be strictly ascending order. Insert Failed.\n");
+#endif
+        return 1;
+    }
+
+    /* A compressed page is also full when the record would not fit in the compressed page size */
+    uint32_t compressedSize = state->recordSize;
+    if (EMBEDDB_USING_COMPRESSION(state->parameters) && count > 0) {
+        void *previousRecord = (int8_t *)state->buffer + state->headerSize + state->recordSize * (count - 1);
+        compressedSize = encodeCompressedRecord(state, NULL, key, data, previousRecord, compressedKeyDelta(state, state->buffer, count - 1));
+    }
+
+    /* Write current page if full. A page with key offsets is also full when the key is too far from the first key on the page */
+    int8_t pageFull = count >= state->maxRecordsPerPage;
+    if (count > 0 && EMBEDDB_USING_COMPRESSION(state->parameters) && state->headerSize + state->compressedPageBytes + compressedSize > state->compressedPageSize)
+        pageFull = 1;
+    if (count > 0 && EMBEDDB_USING_KEY_OFFSETS(state->parameters) && !keyOffsetFits(state, (int8_t *)state->buffer + state->headerSize, key))
+        pageFull = 1;
+    if (pageFull) {
+        int8_t writeResult = writeFullDataPage(state);
+        if (writeResult != 0) {
+            return writeResult;
+        }
+        count = 0;
+        compressedSize = state->recordSize;
+    }
+    state->compressedPageBytes = count == 0 ? compressedSize : state->compressedPageBytes + compressedSize;
+
+    /* Copy record onto page */
+    memcpy((int8_t *)state->buffer + (state->recordSize * count) + state->headerSize, key, state->keySize);
+    memcpy((int8_t *)state->buffer + (state->recordSize * count) + state->headerSize + state->keySize, data, state->dataSize);
+
+    /* Copy variable data offset if using variable data*/
+    if (EMBEDDB_USING_VDATA(state->parameters)) {
+        uint32_t dataLocation;
+        if (state->recordHasVarData) {
+            dataLocation = state->currentVarLoc % (state->numVarPages * state->pageSize);
+        } else {
+            dataLocation = EMBEDDB_NO_VAR_DATA;
+        }
+        memcpy((int8_t *)state->buffer + (state->recordSize * count) + state->headerSize + state->keySize + state->dataSize, &dataLocation, sizeof(uint32_t));
+    }
+
+    /* Update count */
+    EMBEDDB_INC_COUNT(state->buffer);
+
+    if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
+        /* Update MIN/MAX */
+        void *ptr;
+        if (count != 0) {
+            /* Since keys are inserted in ascending order, every insert will
+             * update max. Min will never change after first record. */
+            ptr = EMBEDDB_GET_MAX_KEY(state->buffer, state);
+            memcpy(ptr, key, state->keySize);
+
+            ptr = EMBEDDB_GET_MIN_DATA(state->buffer, state);
+            if (state->compareData(data, ptr) < 0)
+                memcpy(ptr, data, state->dataSize);
+            ptr = EMBEDDB_GET_MAX_DATA(state->buffer, state);
+            if (state->compareData(data, ptr) > 0)
+                memcpy(ptr, data, state->dataSize);
+        } else {
+            /* First record inserted */
+            ptr = EMBEDDB_GET_MIN_KEY(state->buffer);
+            memcpy(ptr, key, state->keySize);
+            ptr = EMBEDDB_GET_MAX_KEY(state->buffer, state);
+            memcpy(ptr, key, state->keySize);
+
+            ptr = EMBEDDB_GET_MIN_DATA(state->buffer, state);
+            memcpy(ptr, data, state->dataSize);
+            ptr = EMBEDDB_GET_MAX_DATA(state->buffer, state);
+            memcpy(ptr, data, state->dataSize);
+        }
+    }
+
+    if (EMBEDDB_USING_SUM(state->parameters)) {
+        /* Update SUM. The record count is already kept in the header. */
+        int64_t sum = 0;
+        if (count != 0) {
+            memcpy(&sum, EMBEDDB_GET_SUM(state->buffer, state), sizeof(int64_t));
+        }
+        sum += embedDBDataToSum(state, data);
+        memcpy(EMBEDDB_GET_SUM(state->buffer, state), &sum, sizeof(int64_t));
+    }
+
+    if (EMBEDDB_USING_BMAP(state->parameters)) {
+        /* Update bitmap */
+        char *bm = (char *)EMBEDDB_GET_BITMAP(state->buffer);
+        state->updateBitmap(data, bm);
+    }
+
+    /* If using record level consistency, we need to immediately write the updated page to storage */
+    if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+        /* With group commit, records with variable data are committed by embedDBPutVar once the variable data is buffered */
+        if (EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters) && EMBEDDB_USING_VDATA(state->parameters) && state->recordHasVarData) {
+            return 0;
+        }
+        return commitRecordLevelConsistencyRecords(state, 1);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief	Writes the full data write buffer to storage, adds the page to the search structure and index file,
+ *          and resets the write buffer for the next page.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t writeFullDataPage(embedDBState *state) {
+    // As the first buffer is the data write buffer, no manipulation is required
+    id_t pageNum = writePage(state, state->buffer);
+    if (pageNum == (id_t)-1) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Failed to write full data page.\n");
+#endif
+        return -1;
+    }
+
+    indexPage(state, pageNum);
+
+    /* Save record in index file */
+    if (state->indexFile != NULL) {
+        void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
+        count_t idxcount = EMBEDDB_GET_COUNT(buf);
+        if (idxcount >= state->maxIdxRecordsPerPage) {
+            /* Save index page */
+            writeIndexPage(state, buf);
+
+            idxcount = 0;
+            initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
+
+            /* Add page id to minimum value spot in page */
+            id_t *ptr = (id_t *)((int8_t *)buf + 8);
+            *ptr = pageNum;
+        }
+
+        EMBEDDB_INC_COUNT(buf);
+
+        /* Copy record onto index page */
+        void *bm = EMBEDDB_GET_BITMAP(state->buffer);
+        memcpy((void *)((int8_t *)buf + EMBEDDB_GET_IDX_HEADER_SIZE(state) + state->bitmapSize * idxcount), bm, state->bitmapSize);
+        indexPageAddAggregates(state, buf, state->buffer, pageNum, idxcount);
+    }
+
+    updateMaxiumError(state, state->buffer);
+
+    initBufferPage(state, EMBEDDB_DATA_WRITE_BUFFER);
+
+    /* Every record inserted so far is now on a permanent page */
+    state->rlcUncommittedRecords = 0;
+
+    if (EMBEDDB_USING_CHECKPOINT(state->parameters) && state->checkpointInterval > 0 && state->nextDataPageId - state->lastCheckpointDataPageId >= state->checkpointInterval) {
+        int8_t checkpointResult = embedDBWriteCheckpoint(state);
+        if (checkpointResult != 0) {
+            return checkpointResult;
+        }
+    }
+
+    /* Need to move record level consistency pointers if on a block boundary */
+    if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) && state->nextDataPageId % state->eraseSizeInPages == 0) {
+        return shiftRecordLevelConsistencyBlocks(state);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief	Puts an array of key, data pairs into structure. Keys must be in strictly ascending order and larger than any key already stored.
+ *          Records are copied directly into the data write buffer a page at a time, with the page header (min/max, bitmap) updated in the same pass.
+ * @param	state	embedDB algorithm state structure
+ * @param	keys	Array of n keys, each state->keySize bytes
+ * @param	datas	Array of n data values, each state->dataSize bytes
+ * @param	n		Number of records to insert
+ * @return	Return 0 if success. Non-zero value if error. No records are inserted if the keys are not in ascending order.
+ */
+int8_t embedDBPutBatch(embedDBState *state, void *keys, void *datas, uint32_t n) {
+    if (n == 0) {
+        return 0;
+    }
+
+    int8_t *keyPtr = (int8_t *)keys;
+    int8_t *dataPtr = (int8_t *)datas;
+
+    /* Records go through the reorder buffer one at a time, so the batch does not need to be in order */
+    if (state->reorderBuffer != NULL) {
+        for (uint32_t i = 0; i < n; i++) {
+            int8_t putResult = reorderBufferPut(state, keyPtr + i * state->keySize, dataPtr + i * state->dataSize);
+            if (putResult != 0) {
+                return putResult;
+            }
+        }
+        return 0;
+    }
+
+    /* Validate ordering for the whole batch before inserting anything */
+    count_t count = EMBEDDB_GET_COUNT(state->buffer);
+    void *previousKey = previousStoredKey(state);
+    if (previousKey != NULL && state->compareKey(keyPtr, previousKey) != 1) {
+#ifdef PRINT_ERRORS
+        printf("Keys must be strictly ascending order. Insert Failed.\n");
+#endif
+        return 1;
+    }
+    for (uint32_t i = 1; i < n; i++) {
+        if (state->compareKey(keyPtr + i * state->keySize, keyPtr + (i - 1) * state->keySize) != 1) {
+#ifdef PRINT_ERRORS
+            printf("Keys must be strictly ascending order. Insert Failed.\n");
+#endif
+            return 1;
+        }
+    }
+
+    /* Compressed pages fill up by their compressed size, which embedDBPut tracks record by record */
+    if (EMBEDDB_USING_COMPRESSION(state->parameters)) {
+        for (uint32_t i = 0; i < n; i++) {
+            int8_t putResult = embedDBPut(state, keyPtr + i * state->keySize, dataPtr + i * state->dataSize);
+            if (putResult != 0) {
+                return putResult;
+            }
+        }
+        return 0;
+    }
+
+    uint32_t numInserted = 0;
+    while (numInserted < n) {
+        count = EMBEDDB_GET_COUNT(state->buffer);
+        int8_t pageFull = count >= state->maxRecordsPerPage;
+        if (count > 0 && EMBEDDB_USING_KEY_OFFSETS(state->parameters) && !keyOffsetFits(state, (int8_t *)state->buffer + state->headerSize, keyPtr + numInserted * state->keySize))
+            pageFull = 1;
+        if (pageFull) {
+            /* Keep variable data pages aligned with data pages the same way embedDBPutVar does */
+            if (EMBEDDB_USING_VDATA(state->parameters) && state->currentVarLoc % state->pageSize != (id_t)state->variableDataHeaderSize) {
+                id_t varWriteResult = writeVariablePage(state, (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+                if (varWriteResult == (id_t)-1) {
+#ifdef PRINT_ERRORS
+                    printf("Failed to write variable data page during embedDBPutBatch.");
+#endif
+                    return -1;
+                }
+                initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+                state->currentVarLoc += state->pageSize - state->currentVarLoc % state->pageSize + state->variableDataHeaderSize;
+            }
+
+            int8_t writeResult = writeFullDataPage(state);
+            if (writeResult != 0) {
+                return writeResult;
+            }
+            count = 0;
+        }
+
+        /* Copy as many records as fit on this page */
+        uint32_t runLength = min(n - numInserted, (uint32_t)(state->maxRecordsPerPage - count));
+        int8_t *record = (int8_t *)state->buffer + state->headerSize + state->recordSize * count;
+        int8_t *key = keyPtr + numInserted * state->keySize;
+        int8_t *data = dataPtr + numInserted * state->dataSize;
+
+        /* With key offsets, the page ends before the first key too far from the first key on the page */
+        if (EMBEDDB_USING_KEY_OFFSETS(state->parameters)) {
+            void *pageMinKey = count == 0 ? (void *)key : (int8_t *)state->buffer + state->headerSize;
+            uint32_t numFit = 1;
+            while (numFit < runLength && keyOffsetFits(state, pageMinKey, key + numFit * state->keySize))
+                numFit++;
+            runLength = numFit;
+        }
+
+        void *minData = NULL, *maxData = NULL;
+        if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
+            minData = EMBEDDB_GET_MIN_DATA(state->buffer, state);
+            maxData = EMBEDDB_GET_MAX_DATA(state->buffer, state);
+            if (count == 0) {
+                memcpy(EMBEDDB_GET_MIN_KEY(state->buffer), key, state->keySize);
+                memcpy(minData, data, state->dataSize);
+                memcpy(maxData, data, state->dataSize);
+            }
+        }
+        void *bm = EMBEDDB_USING_BMAP(state->parameters) ? EMBEDDB_GET_BITMAP(state->buffer) : NULL;
+        uint32_t noVarData = EMBEDDB_NO_VAR_DATA;
+        int64_t sum = 0;
+        if (EMBEDDB_USING_SUM(state->parameters) && count != 0) {
+            memcpy(&sum, EMBEDDB_GET_SUM(state->buffer, state), sizeof(int64_t));
+        }
+
+        for (uint32_t i = 0; i < runLength; i++) {
+            memcpy(record, key, state->keySize);
+            memcpy(record + state->keySize, data, state->dataSize);
+            if (EMBEDDB_USING_VDATA(state->parameters)) {
+                memcpy(record + state->keySize + state->dataSize, &noVarData, sizeof(uint32_t));
+            }
+            if (minData != NULL) {
+                if (state->compareData(data, minData) < 0)
+                    memcpy(minData, data, state->dataSize);
+                if (state->compareData(data, maxData) > 0)
+                    memcpy(maxData, data, state->dataSize);
+            }
+            if (bm != NULL) {
+                state->updateBitmap(data, bm);
+            }
+            if (EMBEDDB_USING_SUM(state->parameters)) {
+                sum += embedDBDataToSum(state, data);
+            }
+            record += state->recordSize;
+            key += state->keySize;
+            data += state->dataSize;
+        }
+
+        if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
+            /* Keys are ascending so the last record copied is the largest */
+            memcpy(EMBEDDB_GET_MAX_KEY(state->buffer, state), key - state->keySize, state->keySize);
+        }
+        if (EMBEDDB_USING_SUM(state->parameters)) {
+            memcpy(EMBEDDB_GET_SUM(state->buffer, state), &sum, sizeof(int64_t));
+        }
+
+        EMBEDDB_GET_COUNT(state->buffer) = count + runLength;
+        numInserted += runLength;
+    }
+
+    /* With record level consistency the partially filled page is written once for the whole batch. Only the records after the last full page are uncommitted. */
+    if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+        return commitRecordLevelConsistencyRecords(state, min(n, EMBEDDB_GET_COUNT(state->buffer)));
+    }
+
+    return 0;
+}
+
+int8_t shiftRecordLevelConsistencyBlocks(embedDBState *state) {
+    /* erase the record-level consistency blocks */
+
+    /* TODO: Likely an optimisation here where we don't always need to erase the second block, but that will make this algorithm more complicated and the savings could be minimal */
+    uint32_t numRecordLevelConsistencyPages = state->eraseSizeInPages * 2;
+    uint32_t eraseStartingPage = state->rlcPhysicalStartingPage;
+    uint32_t eraseEndingPage = 0;
+
+    /* if we have wraped, we need to erase an additional block as the block we are shifting into is not empty */
+    bool haveWrapped = (state->minDataPageId % state->numDataPages) == ((state->rlcPhysicalStartingPage + numRecordLevelConsistencyPages) % state->numDataPages);
+    uint32_t numBlocksToErase = haveWrapped ? 2 : 3;
+
+    if (embedDBWaitForBackgroundWriter(state) != 0) {
+        return -1;
+    }
+
+    /* Erase pages to make space for new data */
+    for (size_t i = 0; i < numBlocksToErase; i++) {
+        eraseEndingPage = eraseStartingPage + state->eraseSizeInPages;
+        bufferPoolInvalidate(state, state->dataFile, eraseStartingPage, state->eraseSizeInPages);
+        int8_t eraseSuccess = state->fileInterface->erase(eraseStartingPage, eraseEndingPage, dataFilePageSize(state), state->dataFile);
+        if (!eraseSuccess) {
+#ifdef PRINT_ERRORS
+            printf("Error: Unable to erase pages in data file when shifting record level consistency blocks!\n");
+#endif
+            return -1;
+        }
+        eraseStartingPage = eraseEndingPage % state->numDataPages;
+    }
+
+    /* shift min data page if needed */
+    if (haveWrapped) {
+        /* Flag the pages as usable to EmbedDB */
+        state->numAvailDataPages += state->eraseSizeInPages;
+        state->minDataPageId += state->eraseSizeInPages;
+
+        /* remove any spline points related to these pages */
+        if (!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
+            cleanSpline(state, state->minDataPageId);
+        }
+    }
+
+    /* shift record-level consistency blocks */
+    state->rlcPhysicalStartingPage = (state->rlcPhysicalStartingPage + state->eraseSizeInPages) % state->numDataPages;
+    state->nextRLCPhysicalPageLocation = state->rlcPhysicalStartingPage;
+
+    return 0;
+}
+
+void updateMaxiumError(embedDBState *state, void *buffer) {
+    // Calculate error within the page
+    int32_t maxError = getMaxError(state, buffer);
+    if (state->maxError < maxError) {
+        state->maxError = maxError;
+    }
+}
+
+/**
+ * @brief	Puts the given key, data, and variable length data into the structure.
+ * @param	state			embedDB algorithm state structure
+ * @param	key				Key for record
+ * @param	data			Data for record
+ * @param	variableData	Variable length data for record
+ * @param	length			Length of the variable length data in bytes
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBPutVar(embedDBState *state, void *key, void *data, void *variableData, uint32_t length) {
+    if (!EMBEDDB_USING_VDATA(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("Error: Can't insert variable data because it is not enabled\n");
+#endif
+        return -1;
+    }
+
+    // Insert their data
+
+    /*
+     * Check that there is enough space remaining in this page to start the insert of the variable
+     * data here and if the data page will be written in embedDBGet
+     */
+    void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+    bool varPageFlushedPerRecord = EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) && !EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters);
+    if (state->currentVarLoc % state->pageSize > state->pageSize - 4 || (!varPageFlushedPerRecord && EMBEDDB_GET_COUNT(state->buffer) >= state->maxRecordsPerPage)) {
+        writeVariablePage(state, buf);
+        initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+        // Move data writing location to the beginning of the next page, leaving the room for the header
+        state->currentVarLoc += state->pageSize - state->currentVarLoc % state->pageSize + state->variableDataHeaderSize;
+    }
+
+    if (variableData == NULL) {
+        // Var data enabled, but not provided
+        state->recordHasVarData = 0;
+        return embedDBPut(state, key, data);
+    }
+
+    // Perform the regular insert
+    state->recordHasVarData = 1;
+    int8_t r;
+    if ((r = embedDBPut(state, key, data)) != 0) {
+        return r;
+    }
+
+    if (state->minVarRecordId == UINT64_MAX) {
+        memcpy(&state->minVarRecordId, key, state->keySize);
+    }
+
+    // Update the header to include the maximum key value stored on this page
+    memcpy((int8_t *)buf + sizeof(id_t), key, state->keySize);
+
+    // Write the length of the data item into the buffer
+    memcpy((uint8_t *)buf + state->currentVarLoc % state->pageSize, &length, sizeof(uint32_t));
+    state->currentVarLoc += 4;
+
+    // Check if we need to write after doing that
+    if (state->currentVarLoc % state->pageSize == 0) {
+        writeVariablePage(state, buf);
+        initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+
+        // Update the header to include the maximum key value stored on this page
+        memcpy((int8_t *)buf + sizeof(id_t), key, state->keySize);
+        state->currentVarLoc += state->variableDataHeaderSize;
+    }
+
+    int amtWritten = 0;
+    while (length > 0) {
+        // Copy data into the buffer. Write the min of the space left in this page and the remaining length of the data
+        uint16_t amtToWrite = min(state->pageSize - state->currentVarLoc % state->pageSize, length);
+        memcpy((uint8_t *)buf + (state->currentVarLoc % state->pageSize), (uint8_t *)variableData + amtWritten, amtToWrite);
+        length -= amtToWrite;
+        amtWritten += amtToWrite;
+        state->currentVarLoc += amtToWrite;
+
+        // If we need to write the buffer to file
+        if (state->currentVarLoc % state->pageSize == 0) {
+            writeVariablePage(state, buf);
+            initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+
+            // Update the header to include the maximum key value stored on this page and account for page number
+            memcpy((int8_t *)buf + sizeof(id_t), key, state->keySize);
+            state->currentVarLoc += state->variableDataHeaderSize;
+        }
+    }
+
+    state->recordHasVarData = 0;
+
+    if (EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+        if (EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters)) {
+            return commitRecordLevelConsistencyRecords(state, 1);
+        }
+        embedDBFlushVar(state);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief	Records that records were inserted into the write buffer when using record-level consistency. Without group commit,
+ *          the write buffer is written as a temporary page straight away. With group commit, it is only written once the
+ *          configured number of records or time window since the last sync has been reached.
+ * @param	state		embedDB algorithm state structure
+ * @param	numRecords	Number of records that were inserted
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t commitRecordLevelConsistencyRecords(embedDBState *state, uint32_t numRecords) {
+    if (!EMBEDDB_USING_RLC_GROUP_COMMIT(state->parameters)) {
+        return writeTemporaryPage(state, state->buffer);
+    }
+
+    if (state->rlcUncommittedRecords == 0) {
+        state->rlcFirstUncommittedTime = getCurrentTimeMs();
+    }
+    state->rlcUncommittedRecords += numRecords;
+
+    bool recordLimitReached = state->rlcGroupCommitRecords > 0 && state->rlcUncommittedRecords >= state->rlcGroupCommitRecords;
+    bool timeLimitReached = state->rlcGroupCommitWindow > 0 && getCurrentTimeMs() - state->rlcFirstUncommittedTime >= state->rlcGroupCommitWindow;
+    if (recordLimitReached || timeLimitReached) {
+        return embedDBSync(state);
+    }
+    return 0;
+}
+
+/**
+ * @brief	Makes every record inserted so far durable when using record-level consistency, by writing the write buffer
+ *          (and the variable data buffer, if used) to storage. Used to commit a group of records with EMBEDDB_RLC_GROUP_COMMIT.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBSync(embedDBState *state) {
+    if (!EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBSync requires record-level consistency. Use embedDBFlush instead.\n");
+#endif
+        return -1;
+    }
+
+    if (state->rlcUncommittedRecords > 0) {
+        /* Variable data goes first so that a temporary page never references variable data that is not in storage */
+        if (EMBEDDB_USING_VDATA(state->parameters) && embedDBFlushVar(state) != 0) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: Failed to write variable data page during embedDBSync.\n");
+#endif
+            return -1;
+        }
+
+        int8_t writeResult = writeTemporaryPage(state, state->buffer);
+        if (writeResult != 0) {
+            return writeResult;
+        }
+        state->rlcUncommittedRecords = 0;
+    }
+
+    state->fileInterface->flush(state->dataFile);
+    return 0;
+}
+
+/**
+ * @brief	Returns a timestamp in milliseconds of elapsed time used for the record-level consistency group commit window.
+ *          Uses millis() on Arduino and the monotonic clock on POSIX hosts. Other hosts fall back to time(), with a resolution of one second.
+ * @return	Current time in milliseconds
+ */
+uint32_t getCurrentTimeMs(void) {
+#if defined(ARDUINO)
+    return millis();
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint32_t)((uint64_t)now.tv_sec * 1000 + (uint64_t)now.tv_nsec / 1000000);
+#else
+    return (uint32_t)((uint64_t)time(NULL) * 1000);
+#endif
+}
+
+/**
+ * @brief	Given a key, estimates the location of the key within the node.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to in-memory buffer holding node
+ * @param	key		Key for record
+ */
+int16_t embedDBEstimateKeyLocation(embedDBState *state, void *buffer, void *key) {
+    // get slope to use for linear estimation of key location
+    // return estimated location of the key
+    float slope = embedDBCalculateSlope(state, buffer);
+
+    uint64_t minKey = 0, thisKey = 0;
+    memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
+    memcpy(&thisKey, key, state->keySize);
+
+    return (thisKey - minKey) / slope;
+}
+
+/**
+ * @brief	Given a key, searches the node for the key. If interior node, returns child record number containing next page id to follow. If leaf node, returns if of first record with that key or (<= key). Returns -1 if key is not found.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to in-memory buffer holding node
+ * @param	key		Key for record
+ * @param	range	1 if range query so return pointer to first record <= key, 0 if exact query so much return first exact match record
+ */
+id_t embedDBSearchNode(embedDBState *state, void *buffer, void *key, int8_t range) {
+    int16_t first, last, middle, count;
+    int8_t compare;
+    void *mkey;
+
+    if (EMBEDDB_USING_UINT_KEYS(state->parameters))
+        return searchNodeUintKeys(state, buffer, key, range);
+
+    count = EMBEDDB_GET_COUNT(buffer);
+    middle = embedDBEstimateKeyLocation(state, buffer, key);
+
+    // check that maxError was calculated and middle is valid (searches full node otherwise)
+    if (state->maxError == -1 || middle >= count || middle <= 0) {
+        first = 0;
+        last = count - 1;
+        middle = (first + last) / 2;
+    } else {
+        first = 0;
+        last = count - 1;
+    }
 
     if (middle > last) {
         middle = last;
     }
 
-    while (first <= last) {
-        mkey = (int8_t *)buffer + state->headerSize + (state->recordSize * middle);
-        compare = state->compareKey(mkey, key);
-        if (compare < 0) {
-            first = middle + 1;
-        } else if (compare == 0) {
-            return middle;
-        } else {
-            last = middle - 1;
+    while (first <= last) {
+        mkey = (int8_t *)buffer + state->headerSize + (state->recordSize * middle);
+        compare = state->compareKey(mkey, key);
+        if (compare < 0) {
+            first = middle + 1;
+        } else if (compare == 0) {
+            return middle;
+        } else {
+            last = middle - 1;
+        }
+        middle = (first + last) / 2;
+    }
+    if (range)
+        return middle;
+    return -1;
+}
+
+/**
+ * @brief	Reads the key of a record as an unsigned integer of 4 or 8 bytes.
+ */
+uint64_t uintKeyAt(int8_t *records, int8_t recordSize, int8_t keySize, int32_t recordNum) {
+    if (keySize == 4) {
+        uint32_t key;
+        memcpy(&key, records + recordNum * recordSize, sizeof(uint32_t));
+        return key;
+    }
+    uint64_t key;
+    memcpy(&key, records + recordNum * recordSize, sizeof(uint64_t));
+    return key;
+}
+
+/**
+ * @brief	embedDBSearchNode for EMBEDDB_USE_UINT_KEYS. Estimates the position of the key from the first and last key on the page with integer math,
+ * 			gallops out from the estimate until the key is bracketed, then narrows the bracket 16 ways at a time comparing keys directly instead of with compareKey.
+ * 			A page whose keys are close to evenly spaced is searched in a few comparisons.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Pointer to in-memory buffer holding node
+ * @param	key		Key for record
+ * @param	range	1 to return the last record <= key (0 if every key is larger), 0 to return the record equal to key
+ * @return	Record number, or -1 if range is 0 and the key is not on the page
+ */
+id_t searchNodeUintKeys(embedDBState *state, void *buffer, void *key, int8_t range) {
+    int32_t count = EMBEDDB_GET_COUNT(buffer);
+    if (count == 0)
+        return range ? 0 : -1;
+
+    int8_t *records = (int8_t *)buffer + state->headerSize;
+    int8_t recordSize = state->recordSize, keySize = state->keySize;
+    uint64_t searchKey = 0;
+    memcpy(&searchKey, key, keySize);
+
+    uint64_t firstKey = uintKeyAt(records, recordSize, keySize, 0);
+    uint64_t lastKey = uintKeyAt(records, recordSize, keySize, count - 1);
+    if (searchKey < firstKey)
+        return range ? 0 : -1;
+    if (searchKey >= lastKey)
+        return range || searchKey == lastKey ? count - 1 : -1;
+
+    /* Estimate the position by interpolating between the first and last key. With keys over 48 bits apart, the spacing is divided out first so the product cannot overflow */
+    uint64_t keySpan = lastKey - firstKey, keyOffset = searchKey - firstKey;
+    int32_t estimate;
+    if ((keySpan >> 48) == 0) {
+        estimate = (int32_t)(keyOffset * (uint64_t)(count - 1) / keySpan);
+    } else {
+        estimate = (int32_t)(keyOffset / (keySpan / (uint64_t)(count - 1) + 1));
+    }
+
+    /* Gallop from the estimate until low <= key < high, where low is a record number and high is a record number or count */
+    int32_t low, high, step = 1;
+    if (uintKeyAt(records, recordSize, keySize, estimate) <= searchKey) {
+        low = estimate;
+        high = estimate + 1;
+        while (high < count && uintKeyAt(records, recordSize, keySize, high) <= searchKey) {
+            low = high;
+            step *= 2;
+            high = low + step;
+        }
+        if (high > count)
+            high = count;
+    } else {
+        high = estimate;
+        low = estimate - 1;
+        while (uintKeyAt(records, recordSize, keySize, low) > searchKey) {
+            high = low;
+            step *= 2;
+            low = high - step > 0 ? high - step : 0;
+        }
+    }
+
+    /* Narrow the bracket to the last record <= key by checking up to 15 evenly spaced records in it at a time. Their keys are in order, so the number <= key says which gap the key is in */
+    while (high - low > 1) {
+        int32_t stride = (high - low + 15) / 16;
+        int32_t numCandidates = (high - low - 1) / stride;
+        low += countKeysAtMost(records, recordSize, keySize, low + stride, stride, numCandidates, searchKey) * stride;
+        high = low + stride < high ? low + stride : high;
+    }
+
+    if (range || uintKeyAt(records, recordSize, keySize, low) == searchKey)
+        return low;
+    return -1;
+}
+
+/**
+ * @brief	Counts how many of a set of evenly spaced records on a page have a key <= searchKey, comparing 8 keys per instruction with AVX2 or 4 with SSE2.
+ * @param	records			First record on the page
+ * @param	recordSize		Size of a record in bytes
+ * @param	keySize			Size of a key in bytes. Keys are unsigned integers of 4 or 8 bytes
+ * @param	first			Record number of the first record to check
+ * @param	stride			Number of records from one record checked to the next
+ * @param	numCandidates	Number of records to check
+ * @param	searchKey		Key to compare with
+ * @return	Number of the records checked with a key <= searchKey
+ */
+int32_t countKeysAtMost(int8_t *records, int8_t recordSize, int8_t keySize, int32_t first, int32_t stride, int32_t numCandidates, uint64_t searchKey) {
+    int32_t numAtMost = 0, i = 0;
+#if defined(EMBEDDB_SIMD_AVX2)
+    /* Flipping the sign bit makes the signed compare order the keys as unsigned integers */
+    if (keySize == 4) {
+        __m256i signBit = _mm256_set1_epi32(INT32_MIN);
+        __m256i key = _mm256_xor_si256(_mm256_set1_epi32((int32_t)(uint32_t)searchKey), signBit);
+        __m256i laneOffsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride * recordSize));
+        for (; i + 8 <= numCandidates; i += 8) {
+            __m256i offsets = _mm256_add_epi32(_mm256_set1_epi32((first + i * stride) * recordSize), laneOffsets);
+            __m256i keys = _mm256_xor_si256(_mm256_i32gather_epi32((const int *)records, offsets, 1), signBit);
+            numAtMost += 8 - countMaskBits(_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_cmpgt_epi32(keys, key))));
+        }
+    } else {
+        __m256i signBit = _mm256_set1_epi64x(INT64_MIN);
+        __m256i key = _mm256_xor_si256(_mm256_set1_epi64x((int64_t)searchKey), signBit);
+        __m128i laneOffsets = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(stride * recordSize));
+        for (; i + 4 <= numCandidates; i += 4) {
+            __m128i offsets = _mm_add_epi32(_mm_set1_epi32((first + i * stride) * recordSize), laneOffsets);
+            __m256i keys = _mm256_xor_si256(_mm256_i32gather_epi64((const long long *)records, offsets, 1), signBit);
+            numAtMost += 4 - countMaskBits(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(keys, key))));
+        }
+    }
+#elif defined(EMBEDDB_SIMD_SSE2)
+    /* SSE2 has no gather or 64-bit compare, so only 4 byte keys are loaded one at a time and compared together */
+    if (keySize == 4) {
+        __m128i signBit = _mm_set1_epi32(INT32_MIN);
+        __m128i key = _mm_xor_si128(_mm_set1_epi32((int32_t)(uint32_t)searchKey), signBit);
+        for (; i + 4 <= numCandidates; i += 4) {
+            int32_t record = first + i * stride;
+            __m128i keys = _mm_setr_epi32((int32_t)uintKeyAt(records, recordSize, 4, record), (int32_t)uintKeyAt(records, recordSize, 4, record + stride),
+                                          (int32_t)uintKeyAt(records, recordSize, 4, record + 2 * stride), (int32_t)uintKeyAt(records, recordSize, 4, record + 3 * stride));
+            keys = _mm_xor_si128(keys, signBit);
+            numAtMost += 4 - countMaskBits(_mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(keys, key))));
+        }
+    }
+#endif
+    for (; i < numCandidates; i++)
+        numAtMost += uintKeyAt(records, recordSize, keySize, first + i * stride) <= searchKey;
+    return numAtMost;
+}
+
+/**
+ * @brief	Counts the bits set in a compare mask of at most 8 bits.
+ */
+int32_t countMaskBits(int32_t mask) {
+    mask = mask - ((mask >> 1) & 0x55);
+    mask = (mask & 0x33) + ((mask >> 2) & 0x33);
+    return (mask + (mask >> 4)) & 0x0F;
+}
+
+/**
+ * @brief	Finds the first record on a page with a key greater than or equal to a key.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Buffer holding the page
+ * @param	key		Key to search for
+ * @return	Record number on the page. The number of records on the page if every record has a smaller key.
+ */
+count_t searchNodeFirstAtLeast(embedDBState *state, void *buffer, void *key) {
+    int16_t floorRecord = searchNodeFloor(state, buffer, key);
+    if (floorRecord >= 0 && state->compareKey((int8_t *)buffer + state->headerSize + floorRecord * state->recordSize, key) < 0)
+        floorRecord++;
+    return floorRecord < 0 ? 0 : (count_t)floorRecord;
+}
+
+/**
+ * @brief	Linear search function to be used with an approximate range of pages.
+ * 			If the desired key is found, the page containing that record is loaded
+ * 			into the passed buffer pointer.
+ * @param	state		embedDB algorithm state structure
+ * @param 	numReads	Tracks total number of reads for statistics
+ * @param	buf			buffer to store page with desired record
+ * @param	key			Key for the record to search for
+ * @param	pageId		Page id to start search from
+ * @param 	low			Lower bound for the page the record could be found on
+ * @param 	high		Uper bound for the page the record could be found on
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t linearSearch(embedDBState *state, void *buf, void *key, int32_t pageId, int32_t low, int32_t high) {
+    int32_t pageError = 0;
+    int32_t physPageId;
+    while (1) {
+        /* Move logical page number to physical page id based on location of first data page */
+        physPageId = pageId % state->numDataPages;
+
+        if (pageId > high || pageId < low || low > high || pageId < state->minDataPageId || pageId >= state->nextDataPageId) {
+            return -1;
+        }
+
+        /* Read page into buffer. If 0 not returned, there was an error */
+        if (readPage(state, physPageId) != 0) {
+            return -1;
+        }
+
+        if (state->compareKey(key, embedDBGetMinKey(state, buf)) < 0) { /* Key is less than smallest record in block. */
+            high = --pageId;
+            pageError++;
+        } else if (state->compareKey(key, embedDBGetMaxKey(state, buf)) > 0) { /* Key is larger than largest record in block. */
+            low = ++pageId;
+            pageError++;
+        } else {
+            /* Found correct block */
+            return 0;
+        }
+    }
+}
+
+int8_t binarySearch(embedDBState *state, void *buffer, void *key) {
+    uint32_t first = state->minDataPageId, last = state->nextDataPageId - 1;
+    uint32_t pageId = (first + last) / 2;
+    while (1) {
+        /* Read page into buffer */
+        if (readPage(state, pageId % state->numDataPages) != 0)
+            return -1;
+
+        if (first >= last)
+            break;
+
+        if (state->compareKey(key, embedDBGetMinKey(state, buffer)) < 0) {
+            /* Key is less than smallest record in block. */
+            last = pageId - 1;
+            pageId = (first + last) / 2;
+        } else if (state->compareKey(key, embedDBGetMaxKey(state, buffer)) > 0) {
+            /* Key is larger than largest record in block. */
+            first = pageId + 1;
+            pageId = (first + last) / 2;
+        } else {
+            /* Found correct block */
+            return 0;
+        }
+    }
+    /* Only one page is left that could hold the key */
+    return 0;
+}
+
+int8_t splineSearch(embedDBState *state, void *buffer, void *key) {
+    /* Spline search */
+    uint32_t location, lowbound, highbound;
+    splineFind(state->spl, key, state->compareKey, &location, &lowbound, &highbound);
+
+    /* If the spline thinks the data is on a page smaller than the smallest data page we have, we know we don't have the data */
+    if (highbound < state->minDataPageId) {
+        return -1;
+    }
+
+    /* if the spline returns a lowbound lower than than the smallest page we have, we can move the lowbound and location up */
+    if (lowbound < state->minDataPageId) {
+        lowbound = state->minDataPageId;
+        location = (lowbound + highbound) / 2;
+    }
+
+    // Check if the currently buffered page is the correct one
+    if (!(lowbound <= state->bufferedPageId &&
+          highbound >= state->bufferedPageId &&
+          state->compareKey(embedDBGetMinKey(state, buffer), key) <= 0 &&
+          state->compareKey(embedDBGetMaxKey(state, buffer), key) >= 0)) {
+        if (linearSearch(state, buffer, key, location, lowbound, highbound) == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief	Given a key, searches for data associated with
+ *          that key in embedDB buffer using embedDBSearchNode.
+ *          Note: Space for data must be already allocated.
+ * @param	state	embedDB algorithm state structure
+ * @param   buffer  pointer to embedDB buffer
+ * @param	key		Key for record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return non-negative integer representing offset if success. Non-zero value if error.
+ */
+int8_t searchBuffer(embedDBState *state, void *buffer, void *key, void *data) {
+    // return -1 if there is nothing in the buffer
+    if (EMBEDDB_GET_COUNT(buffer) == 0) {
+        return NO_RECORD_FOUND;
+    }
+    // find index of record inside of the write buffer
+    id_t nextId = embedDBSearchNode(state, buffer, key, 0);
+    // return 0 if found
+    if (nextId != NO_RECORD_FOUND) {
+        // Key found
+        memcpy(data, (void *)((int8_t *)buffer + state->headerSize + state->recordSize * nextId + state->keySize), state->dataSize);
+        return nextId;
+    }
+    // Key not found
+    return NO_RECORD_FOUND;
+}
+
+/**
+ * @brief	Finds the data page that can hold a key and makes sure it is in memory.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @return	The write buffer or the data read buffer holding the page. NULL if no page can hold the key or the page could not be read.
+ */
+void *embedDBGetPage(embedDBState *state, void *key) {
+    void *outputBuffer = state->buffer;
+    if (state->nextDataPageId == 0) {
+        return EMBEDDB_GET_COUNT(outputBuffer) != 0 ? outputBuffer : NULL;
+    }
+
+    uint64_t thisKey = 0;
+    memcpy(&thisKey, key, state->keySize);
+
+    void *buf = (int8_t *)state->buffer + state->pageSize;
+
+    // if write buffer is not empty
+    if ((EMBEDDB_GET_COUNT(outputBuffer) != 0)) {
+        // get the max/min key from output buffer
+        uint64_t bufMaxKey = 0;
+        uint64_t bufMinKey = 0;
+        memcpy(&bufMaxKey, embedDBGetMaxKey(state, outputBuffer), state->keySize);
+        memcpy(&bufMinKey, embedDBGetMinKey(state, outputBuffer), state->keySize);
+
+        // no page can hold a key larger than every key in the buffer
+        if (thisKey > bufMaxKey) return NULL;
+
+        // if key >= buffer's min, only the buffer can hold it
+        if (thisKey >= bufMinKey) {
+            return outputBuffer;
+        }
+    }
+
+    int8_t searchResult = 0;
+    id_t fenceKeyPage = 0;
+    int8_t fenceKeyResult = fenceKeysSearch(state, key, &fenceKeyPage);
+    if (fenceKeyResult == 1) {
+        /* Key is smaller than every stored key */
+        return NULL;
+    } else if (fenceKeyResult == 0) {
+        /* Only the page that can contain the key is read */
+        searchResult = readPage(state, fenceKeyPage % state->numDataPages);
+    } else if (EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+        /* Regular binary search */
+        searchResult = binarySearch(state, buf, key);
+    } else {
+        /* Spline search */
+        searchResult = splineSearch(state, buf, key);
+    }
+
+    if (searchResult != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBGet was unable to find page to search for record\n");
+#endif
+        return NULL;
+    }
+    return buf;
+}
+
+/**
+ * @brief	Given a key, returns data associated with key.
+ * 			Note: Space for data must be already allocated.
+ * 			Data is copied from database into data buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if success. Returns -2 if requested key is less than the minimum stored key. Non-zero value if error.
+ */
+int8_t embedDBGet(embedDBState *state, void *key, void *data) {
+    /* Records in the reorder buffer have larger keys than any stored record */
+    if (state->reorderBuffer != NULL && reorderBufferGet(state, key, data) == 0) {
+        return 0;
+    }
+
+    int8_t *buf = (int8_t *)embedDBGetPage(state, key);
+    if (buf == NULL) {
+        return -1;
+    }
+
+    id_t nextId = embedDBSearchNode(state, buf, key, 0);
+
+    if (nextId != -1) {
+        /* Key found */
+        memcpy(data, (void *)(buf + state->headerSize + state->recordSize * nextId + state->keySize), state->dataSize);
+        return 0;
+    }
+    // Key not found
+    return -1;
+}
+
+/**
+ * @brief	Finds the record with the largest key less than or equal to a key.
+ * 			Note: Space for foundKey and data must be already allocated.
+ * @param	state		embedDB algorithm state structure
+ * @param	key			Key to search for
+ * @param	foundKey	Return variable for the key of the record found
+ * @param	data		Return variable for the data of the record found
+ * @return	Return 0 if success. 1 if every record has a larger key. -1 if error.
+ */
+int8_t embedDBGetFloor(embedDBState *state, void *key, void *foundKey, void *data) {
+    /* The write buffer holds the largest keys, so check it first */
+    void *outputBuffer = state->buffer;
+    if (EMBEDDB_GET_COUNT(outputBuffer) != 0 && state->compareKey(key, embedDBGetMinKey(state, outputBuffer)) >= 0) {
+        copyRecord(state, outputBuffer, searchNodeFloor(state, outputBuffer, key), foundKey, data);
+        return 0;
+    }
+
+    id_t pageNum = 0;
+    int8_t pageResult = findFloorPage(state, key, &pageNum);
+    if (pageResult != 0)
+        return pageResult;
+
+    if (readPage(state, pageNum % state->numDataPages) != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBGetFloor failed to read data page %lu\n", (unsigned long)pageNum);
+#endif
+        return -1;
+    }
+    void *buf = (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize;
+    copyRecord(state, buf, searchNodeFloor(state, buf, key), foundKey, data);
+    return 0;
+}
+
+/**
+ * @brief	Finds the record with the smallest key greater than or equal to a key.
+ * 			Note: Space for foundKey and data must be already allocated.
+ * @param	state		embedDB algorithm state structure
+ * @param	key			Key to search for
+ * @param	foundKey	Return variable for the key of the record found
+ * @param	data		Return variable for the data of the record found
+ * @return	Return 0 if success. 1 if every record has a smaller key. -1 if error.
+ */
+int8_t embedDBGetCeiling(embedDBState *state, void *key, void *foundKey, void *data) {
+    void *outputBuffer = state->buffer;
+    count_t bufferCount = EMBEDDB_GET_COUNT(outputBuffer);
+    if (bufferCount != 0 && state->compareKey(key, embedDBGetMinKey(state, outputBuffer)) >= 0) {
+        if (state->compareKey(key, embedDBGetMaxKey(state, outputBuffer)) > 0)
+            return 1;
+        int16_t recordNum = searchNodeFloor(state, outputBuffer, key);
+        if (state->compareKey((int8_t *)outputBuffer + state->headerSize + recordNum * state->recordSize, key) < 0)
+            recordNum++;
+        copyRecord(state, outputBuffer, recordNum, foundKey, data);
+        return 0;
+    }
+
+    /* The ceiling is on the page that holds the floor, or is the first record after it. Without a floor, it is the oldest record. */
+    id_t pageNum = 0;
+    int8_t pageResult = findFloorPage(state, key, &pageNum);
+    if (pageResult == -1)
+        return -1;
+    int16_t recordNum = 0;
+    if (pageResult == 1) {
+        pageNum = state->minDataPageId;
+    } else {
+        if (readPage(state, pageNum % state->numDataPages) != 0) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: embedDBGetCeiling failed to read data page %lu\n", (unsigned long)pageNum);
+#endif
+            return -1;
+        }
+        void *buf = (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize;
+        recordNum = searchNodeFloor(state, buf, key);
+        if (state->compareKey((int8_t *)buf + state->headerSize + recordNum * state->recordSize, key) < 0)
+            recordNum++;
+        if (recordNum == EMBEDDB_GET_COUNT(buf)) {
+            pageNum++;
+            recordNum = 0;
+        }
+    }
+
+    if (pageNum == state->nextDataPageId) {
+        if (bufferCount == 0)
+            return 1;
+        copyRecord(state, outputBuffer, 0, foundKey, data);
+        return 0;
+    }
+
+    if (readPage(state, pageNum % state->numDataPages) != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBGetCeiling failed to read data page %lu\n", (unsigned long)pageNum);
+#endif
+        return -1;
+    }
+    copyRecord(state, (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize, recordNum, foundKey, data);
+    return 0;
+}
+
+/**
+ * @brief	Finds the data page with the largest smallest key that is not larger than a key, which is the page that holds the floor of the key.
+ * 			Uses the fence key directory if it covers the key. Otherwise the pages within the spline bounds, or every page with binary search, are searched with a binary search on their smallest keys.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @param	pageNum	Return variable for the logical id of the data page
+ * @return	Return 0 if the page was found. 1 if the key is smaller than every key in the data file, or there are no data pages. -1 if a page could not be read.
+ */
+int8_t findFloorPage(embedDBState *state, void *key, id_t *pageNum) {
+    if (state->nextDataPageId == state->minDataPageId)
+        return 1;
+
+    int8_t fenceKeysResult = fenceKeysSearch(state, key, pageNum);
+    if (fenceKeysResult != -1)
+        return fenceKeysResult;
+
+    id_t low = state->minDataPageId, high = state->nextDataPageId - 1;
+    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters) && state->spl->count != 0) {
+        uint32_t location, lowbound, highbound;
+        splineFind(state->spl, key, state->compareKey, &location, &lowbound, &highbound);
+        /* Keys past the last spline point can be on any later page */
+        if (state->compareKey(key, splinePointLocation(state->spl, state->spl->count - 1)) >= 0)
+            highbound = high;
+        if (lowbound > low && lowbound <= high)
+            low = lowbound;
+        if (highbound >= low && highbound < high)
+            high = highbound;
+    }
+
+    void *buf = (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize;
+    while (1) {
+        if (readPage(state, low % state->numDataPages) != 0) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: Failed to read data page %lu while searching for the floor of a key\n", (unsigned long)low);
+#endif
+            return -1;
+        }
+        if (state->compareKey(embedDBGetMinKey(state, buf), key) <= 0)
+            break;
+
+        /* The spline bounds missed the key, so search the pages before them */
+        if (low == state->minDataPageId)
+            return 1;
+        high = low - 1;
+        low = state->minDataPageId;
+    }
+
+    /* Find the last page with a smallest key not larger than the key */
+    while (low < high) {
+        id_t middle = low + (high - low + 1) / 2;
+        if (readPage(state, middle % state->numDataPages) != 0) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: Failed to read data page %lu while searching for the floor of a key\n", (unsigned long)middle);
+#endif
+            return -1;
+        }
+        if (state->compareKey(embedDBGetMinKey(state, buf), key) <= 0) {
+            low = middle;
+        } else {
+            high = middle - 1;
+        }
+    }
+    *pageNum = low;
+    return 0;
+}
+
+/**
+ * @brief	Finds the last record on a page with a key less than or equal to a key.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Buffer holding the page
+ * @param	key		Key to search for
+ * @return	Record number on the page. -1 if every record on the page has a larger key.
+ */
+int16_t searchNodeFloor(embedDBState *state, void *buffer, void *key) {
+    int16_t recordNum = (int16_t)embedDBSearchNode(state, buffer, key, 1);
+    /* The range search returns the first record when every key on the page is larger */
+    if (recordNum == 0 && state->compareKey((int8_t *)buffer + state->headerSize, key) > 0)
+        return -1;
+    return recordNum;
+}
+
+/**
+ * @brief	Copies the key and data of a record on a page.
+ */
+void copyRecord(embedDBState *state, void *buffer, int16_t recordNum, void *key, void *data) {
+    int8_t *record = (int8_t *)buffer + state->headerSize + recordNum * state->recordSize;
+    memcpy(key, record, state->keySize);
+    memcpy(data, record + state->keySize, state->dataSize);
+}
+
+/**
+ * @brief	Reads a data value as a signed integer of state->dataSize bytes, for EMBEDDB_USE_SUM.
+ */
+int64_t embedDBDataToSum(embedDBState *state, void *data) {
+    int64_t value = 0;
+    memcpy(&value, data, state->dataSize);
+    /* Sign extend values smaller than 8 bytes */
+    if (state->dataSize < 8 && (((int8_t *)data)[state->dataSize - 1] < 0)) {
+        value |= (int64_t)(UINT64_MAX << (state->dataSize * 8));
+    }
+    return value;
+}
+
+/**
+ * @brief	Adds the sum, record count, key range and, with EMBEDDB_USE_MAX_MIN, data range of a data page to the header of the index page it was just added to.
+ * @param	state		embedDB algorithm state structure
+ * @param	indexBuffer	Index write buffer
+ * @param	dataBuffer	Data page that was just added to the index page
+ * @param	pageNum		Logical page id of the data page
+ * @param	idxcount	Position of the data page on the index page
+ */
+void indexPageAddAggregates(embedDBState *state, void *indexBuffer, void *dataBuffer, id_t pageNum, count_t idxcount) {
+    if (!EMBEDDB_USING_SUM(state->parameters))
+        return;
+
+    int64_t pageSum = 0, sum = 0;
+    uint32_t count = 0;
+    memcpy(&pageSum, EMBEDDB_GET_SUM(dataBuffer, state), sizeof(int64_t));
+    if (idxcount == 0) {
+        /* The index page may have been reset by embedDBFlush, so also record which data page it starts at */
+        memcpy((int8_t *)indexBuffer + 8, &pageNum, sizeof(id_t));
+        memcpy(EMBEDDB_GET_IDX_MIN_KEY(indexBuffer), embedDBGetMinKey(state, dataBuffer), state->keySize);
+        if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
+            memcpy(EMBEDDB_GET_IDX_MIN_DATA(indexBuffer, state), EMBEDDB_GET_MIN_DATA(dataBuffer, state), state->dataSize);
+            memcpy(EMBEDDB_GET_IDX_MAX_DATA(indexBuffer, state), EMBEDDB_GET_MAX_DATA(dataBuffer, state), state->dataSize);
+        }
+    } else {
+        memcpy(&sum, EMBEDDB_GET_IDX_SUM(indexBuffer), sizeof(int64_t));
+        memcpy(&count, EMBEDDB_GET_IDX_SUM_COUNT(indexBuffer), sizeof(uint32_t));
+        if (EMBEDDB_USING_MAX_MIN(state->parameters)) {
+            if (state->compareData(EMBEDDB_GET_MIN_DATA(dataBuffer, state), EMBEDDB_GET_IDX_MIN_DATA(indexBuffer, state)) < 0)
+                memcpy(EMBEDDB_GET_IDX_MIN_DATA(indexBuffer, state), EMBEDDB_GET_MIN_DATA(dataBuffer, state), state->dataSize);
+            if (state->compareData(EMBEDDB_GET_MAX_DATA(dataBuffer, state), EMBEDDB_GET_IDX_MAX_DATA(indexBuffer, state)) > 0)
+                memcpy(EMBEDDB_GET_IDX_MAX_DATA(indexBuffer, state), EMBEDDB_GET_MAX_DATA(dataBuffer, state), state->dataSize);
+        }
+    }
+    sum += pageSum;
+    count += EMBEDDB_GET_COUNT(dataBuffer);
+    memcpy(EMBEDDB_GET_IDX_SUM(indexBuffer), &sum, sizeof(int64_t));
+    memcpy(EMBEDDB_GET_IDX_SUM_COUNT(indexBuffer), &count, sizeof(uint32_t));
+    memcpy(EMBEDDB_GET_IDX_MAX_KEY(indexBuffer, state), embedDBGetMaxKey(state, dataBuffer), state->keySize);
+}
+
+/**
+ * @brief	Adds a group of records to a range aggregate.
+ * @param	state		embedDB algorithm state structure
+ * @param	aggregate	Aggregate to add to
+ * @param	count		Number of records in the group
+ * @param	sum			Sum of the group as an int64_t. Only used if the aggregate adds up the sum.
+ * @param	minData		Smallest data value in the group. Only used if the aggregate keeps the data range.
+ * @param	maxData		Largest data value in the group. Only used if the aggregate keeps the data range.
+ */
+void rangeAggregateAdd(embedDBState *state, embedDBRangeAggregate *aggregate, uint32_t count, void *sum, void *minData, void *maxData) {
+    if (count == 0)
+        return;
+
+    if (aggregate->useSum) {
+        int64_t groupSum = 0;
+        memcpy(&groupSum, sum, sizeof(int64_t));
+        aggregate->sum += groupSum;
+    }
+    if (aggregate->useMinMax) {
+        if (aggregate->count == 0 || state->compareData(minData, aggregate->minData) < 0)
+            memcpy(aggregate->minData, minData, state->dataSize);
+        if (aggregate->count == 0 || state->compareData(maxData, aggregate->maxData) > 0)
+            memcpy(aggregate->maxData, maxData, state->dataSize);
+    }
+    aggregate->count += count;
+}
+
+/**
+ * @brief	Adds the records of a data page that are in a key range to an aggregate. Uses the page header if the whole page is in the range.
+ * @param	state		embedDB algorithm state structure
+ * @param	buffer		Data page
+ * @param	minKey		Smallest key in the range. NULL for no lower bound.
+ * @param	maxKey		Largest key in the range. NULL for no upper bound.
+ * @param	aggregate	Aggregate to add to
+ * @return	Return 1 if the page starts after the range, so no later page can be in it. 0 otherwise.
+ */
+int8_t rangeAggregatePage(embedDBState *state, void *buffer, void *minKey, void *maxKey, embedDBRangeAggregate *aggregate) {
+    count_t numRecords = EMBEDDB_GET_COUNT(buffer);
+    if (numRecords == 0)
+        return 0;
+
+    if (maxKey != NULL && state->compareKey(embedDBGetMinKey(state, buffer), maxKey) > 0)
+        return 1;
+    if (minKey != NULL && state->compareKey(embedDBGetMaxKey(state, buffer), minKey) < 0)
+        return 0;
+
+    if ((minKey == NULL || state->compareKey(embedDBGetMinKey(state, buffer), minKey) >= 0) &&
+        (maxKey == NULL || state->compareKey(embedDBGetMaxKey(state, buffer), maxKey) <= 0)) {
+        rangeAggregateAdd(state, aggregate, numRecords, EMBEDDB_GET_SUM(buffer, state), EMBEDDB_GET_MIN_DATA(buffer, state), EMBEDDB_GET_MAX_DATA(buffer, state));
+        return 0;
+    }
+
+    /* Page at an end of the range */
+    int8_t *record = (int8_t *)buffer + state->headerSize;
+    for (count_t i = 0; i < numRecords; i++, record += state->recordSize) {
+        if (minKey != NULL && state->compareKey(record, minKey) < 0)
+            continue;
+        if (maxKey != NULL && state->compareKey(record, maxKey) > 0)
+            break;
+        int64_t sum = aggregate->useSum ? embedDBDataToSum(state, record + state->keySize) : 0;
+        rangeAggregateAdd(state, aggregate, 1, &sum, record + state->keySize, record + state->keySize);
+    }
+    return 0;
+}
+
+/**
+ * @brief	Aggregates every record with a key in a range. Data pages, and index pages with aggregates, that are entirely inside the range are added from their headers.
+ * @param	state		embedDB algorithm state structure
+ * @param	minKey		Smallest key in the range. NULL for no lower bound.
+ * @param	maxKey		Largest key in the range. NULL for no upper bound.
+ * @param	aggregate	Aggregate to fill in. The sum and count are reset first.
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t rangeAggregate(embedDBState *state, void *minKey, void *maxKey, embedDBRangeAggregate *aggregate) {
+    aggregate->sum = 0;
+    aggregate->count = 0;
+
+    /* Find the first data page that can hold minKey */
+    id_t pageId = state->minDataPageId;
+    if (minKey != NULL) {
+        id_t fenceKeyPage = 0;
+        if (fenceKeysSearch(state, minKey, &fenceKeyPage) == 0) {
+            pageId = fenceKeyPage;
+        } else if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters) && state->spl->count != 0) {
+            uint32_t location, lowbound, highbound;
+            splineFind(state->spl, minKey, state->compareKey, &location, &lowbound, &highbound);
+            pageId = max(lowbound, state->minDataPageId);
+        }
+    }
+
+    /* Index pages only hold aggregates when using EMBEDDB_USE_SUM */
+    uint8_t useIndex = state->indexFile != NULL && EMBEDDB_USING_SUM(state->parameters);
+    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    void *indexBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
+    while (pageId < state->nextDataPageId) {
+        /* An index page with every one of its data pages in the range adds them all without reading them */
+        id_t indexPageId = useIndex ? pageId / state->maxIdxRecordsPerPage : 0;
+        if (useIndex && pageId % state->maxIdxRecordsPerPage == 0 && indexPageId >= state->minIndexPageId && indexPageId < state->nextIdxPageId) {
+            if (readIndexPage(state, indexPageId % state->numIndexPages) != 0) {
+#ifdef PRINT_ERRORS
+                printf("ERROR: Failed to read index page %i (%i)\n", indexPageId, indexPageId % state->numIndexPages);
+#endif
+                return -1;
+            }
+            id_t firstIndexedPage = 0;
+            memcpy(&firstIndexedPage, (int8_t *)indexBuf + 8, sizeof(id_t));
+            count_t numIndexedPages = EMBEDDB_GET_COUNT(indexBuf);
+            if (firstIndexedPage == pageId && numIndexedPages > 0 && pageId + numIndexedPages <= state->nextDataPageId &&
+                (minKey == NULL || state->compareKey(EMBEDDB_GET_IDX_MIN_KEY(indexBuf), minKey) >= 0) &&
+                (maxKey == NULL || state->compareKey(EMBEDDB_GET_IDX_MAX_KEY(indexBuf, state), maxKey) <= 0)) {
+                uint32_t indexCount = 0;
+                memcpy(&indexCount, EMBEDDB_GET_IDX_SUM_COUNT(indexBuf), sizeof(uint32_t));
+                rangeAggregateAdd(state, aggregate, indexCount, EMBEDDB_GET_IDX_SUM(indexBuf), EMBEDDB_GET_IDX_MIN_DATA(indexBuf, state), EMBEDDB_GET_IDX_MAX_DATA(indexBuf, state));
+                pageId += numIndexedPages;
+                continue;
+            }
+        }
+
+        if (readPage(state, pageId % state->numDataPages) != 0) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: Failed to read data page %i (%i)\n", pageId, pageId % state->numDataPages);
+#endif
+            return -1;
+        }
+        if (rangeAggregatePage(state, buf, minKey, maxKey, aggregate) == 1)
+            return 0;
+        pageId++;
+    }
+
+    /* Records that have not been written to storage yet */
+    rangeAggregatePage(state, state->buffer, minKey, maxKey, aggregate);
+    return 0;
+}
+
+/**
+ * @brief	Sums the data of every record with a key in a range. Requires EMBEDDB_USE_SUM.
+ *          Data pages, and with an index file whole index pages, that are entirely inside the range are added from their headers. Only the pages at the ends of the range are searched record by record.
+ * @param	state	embedDB algorithm state structure
+ * @param	minKey	Smallest key in the range. NULL for no lower bound.
+ * @param	maxKey	Largest key in the range. NULL for no upper bound.
+ * @param	sum		Return variable for the sum of the data, read as signed integers of state->dataSize bytes
+ * @param	count	Return variable for the number of records in the range
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBRangeSum(embedDBState *state, void *minKey, void *maxKey, int64_t *sum, uint32_t *count) {
+    if (!EMBEDDB_USING_SUM(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBRangeSum called when not using EMBEDDB_USE_SUM\n");
+#endif
+        return -1;
+    }
+
+    embedDBRangeAggregate aggregate = {0};
+    aggregate.useSum = 1;
+    int8_t result = rangeAggregate(state, minKey, maxKey, &aggregate);
+    *sum = aggregate.sum;
+    *count = aggregate.count;
+    return result;
+}
+
+/**
+ * @brief	Counts the records with a key in a range. Data pages entirely inside the range are counted from their headers,
+ *          and with EMBEDDB_USE_SUM and an index file, so are whole index pages.
+ * @param	state	embedDB algorithm state structure
+ * @param	minKey	Smallest key in the range. NULL for no lower bound.
+ * @param	maxKey	Largest key in the range. NULL for no upper bound.
+ * @param	count	Return variable for the number of records in the range
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBRangeCount(embedDBState *state, void *minKey, void *maxKey, uint32_t *count) {
+    embedDBRangeAggregate aggregate = {0};
+    int8_t result = rangeAggregate(state, minKey, maxKey, &aggregate);
+    *count = aggregate.count;
+    return result;
+}
+
+/**
+ * @brief	Finds the smallest and largest data values of the records with a key in a range. Requires EMBEDDB_USE_MAX_MIN.
+ *          Data pages entirely inside the range use the data range in their headers, and with EMBEDDB_USE_SUM and an index file, so do whole index pages.
+ *          Only the pages at the ends of the range are searched record by record.
+ * @param	state	embedDB algorithm state structure
+ * @param	minKey	Smallest key in the range. NULL for no lower bound.
+ * @param	maxKey	Largest key in the range. NULL for no upper bound.
+ * @param	minData	Pre-allocated memory to copy the smallest data value into. NULL if not needed.
+ * @param	maxData	Pre-allocated memory to copy the largest data value into. NULL if not needed.
+ * @return	Return 0 if success, 1 if there are no records in the range (minData and maxData are not changed). -1 if error.
+ */
+int8_t embedDBRangeMinMax(embedDBState *state, void *minKey, void *maxKey, void *minData, void *maxData) {
+    if (!EMBEDDB_USING_MAX_MIN(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBRangeMinMax called when not using EMBEDDB_USE_MAX_MIN\n");
+#endif
+        return -1;
+    }
+
+    /* Values are only copied to the caller once the whole range is done, so they are not changed if it is empty */
+    embedDBRangeAggregate aggregate = {0};
+    aggregate.useMinMax = 1;
+    aggregate.minData = malloc(state->dataSize * 2);
+    if (aggregate.minData == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBRangeMinMax was unable to allocate memory.\n");
+#endif
+        return -1;
+    }
+    aggregate.maxData = (int8_t *)aggregate.minData + state->dataSize;
+
+    int8_t result = rangeAggregate(state, minKey, maxKey, &aggregate);
+    if (result == 0 && aggregate.count == 0) {
+        result = 1;
+    } else if (result == 0) {
+        if (minData != NULL)
+            memcpy(minData, aggregate.minData, state->dataSize);
+        if (maxData != NULL)
+            memcpy(maxData, aggregate.maxData, state->dataSize);
+    }
+    free(aggregate.minData);
+    return result;
+}
+
+/**
+ * @brief	Sorts the positions of an array of keys by key, so the keys can be visited in order without moving them.
+ * @param	state	embedDB algorithm state structure
+ * @param	keys	Array of n keys, each state->keySize bytes
+ * @param	order	Array of n positions that is filled with the sorted order of the keys
+ * @param	n		Number of keys
+ */
+void sortKeyOrder(embedDBState *state, void *keys, uint32_t *order, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        order[i] = i;
+    }
+
+    /* Shell sort. Keys that are already sorted, which is the usual case, take a single comparison per key for each gap. */
+    uint32_t gap = 1;
+    while (gap < n / 3) {
+        gap = gap * 3 + 1;
+    }
+    for (; gap > 0; gap /= 3) {
+        for (uint32_t i = gap; i < n; i++) {
+            uint32_t position = order[i];
+            void *key = (int8_t *)keys + (size_t)position * state->keySize;
+            uint32_t j = i;
+            while (j >= gap && state->compareKey((int8_t *)keys + (size_t)order[j - gap] * state->keySize, key) > 0) {
+                order[j] = order[j - gap];
+                j -= gap;
+            }
+            order[j] = position;
+        }
+    }
+}
+
+/**
+ * @brief	Given an array of keys, returns the data associated with each key.
+ *          The keys are looked up in sorted order, so each data page is read at most once no matter how many of the keys are on it.
+ * @param	state		embedDB algorithm state structure
+ * @param	keys		Array of n keys, each state->keySize bytes. The keys do not need to be sorted.
+ * @param	n			Number of keys
+ * @param	outData		Pre-allocated array of n data values, each state->dataSize bytes. The data for each key is copied to the same position as the key.
+ * @param	outStatus	Pre-allocated array of n results. Set to 0 for each key that was found and -1 for each key that was not, the same as embedDBGet.
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBGetMany(embedDBState *state, void *keys, uint32_t n, void *outData, int8_t *outStatus) {
+    if (n == 0)
+        return 0;
+
+    uint32_t *order = (uint32_t *)malloc((size_t)n * sizeof(uint32_t));
+    if (order == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBGetMany was unable to allocate memory to sort %lu keys.\n", (unsigned long)n);
+#endif
+        return -1;
+    }
+    sortKeyOrder(state, keys, order, n);
+
+    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    void *lastKey = NULL;
+    void *lastData = NULL;
+    for (uint32_t i = 0; i < n; i++) {
+        void *key = (int8_t *)keys + (size_t)order[i] * state->keySize;
+        void *data = (int8_t *)outData + (size_t)order[i] * state->dataSize;
+
+        /* Repeated keys get the result of the first lookup */
+        if (lastKey != NULL && state->compareKey(key, lastKey) == 0) {
+            outStatus[order[i]] = outStatus[order[i - 1]];
+            memcpy(data, lastData, state->dataSize);
+            continue;
+        }
+        lastKey = key;
+        lastData = data;
+
+        /* Keys on the page read for the previous key do not need to go through the spline or read a page again */
+        id_t bufferedPage = 0;
+        memcpy(&bufferedPage, buf, sizeof(id_t));
+        if (state->bufferedPageId != -1 && EMBEDDB_GET_COUNT(buf) > 0 &&
+            bufferedPage >= state->minDataPageId && bufferedPage < state->nextDataPageId &&
+            state->compareKey(key, embedDBGetMinKey(state, buf)) >= 0 &&
+            state->compareKey(key, embedDBGetMaxKey(state, buf)) <= 0) {
+            outStatus[order[i]] = searchBuffer(state, buf, key, data) != NO_RECORD_FOUND ? 0 : -1;
+        } else {
+            outStatus[order[i]] = embedDBGet(state, key, data) == 0 ? 0 : -1;
+        }
+    }
+
+    free(order);
+    return 0;
+}
+
+/**
+ * @brief	Given a key, returns data associated with key.
+ * 			Data is copied from database into data buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key for record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @param	varData	Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream after you are done with it**
+ * @return	Return 0 if success. Non-zero value if error.
+ * 			-1 : Error reading file or failed memory allocation
+ * 			1  : Variable data was deleted to make room for newer data
+ */
+int8_t embedDBGetVar(embedDBState *state, void *key, void *data, embedDBVarDataStream **varData) {
+    if (!EMBEDDB_USING_VDATA(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBGetVar called when not using variable data\n");
+#endif
+        return 0;
+    }
+    void *outputBuffer = (int8_t *)state->buffer;
+
+    // search output buffer for record, mem copy fixed record into data
+    int8_t recordNum = searchBuffer(state, outputBuffer, key, data);
+
+    // if there are records found in the output buffer
+    if (recordNum != NO_RECORD_FOUND) {
+        // flush variable record buffer to storage to read later on
+        embedDBFlushVar(state);
+        // copy contents of write buffer to read buffer for embedDBSetupVarDataStream()
+        readToWriteBuf(state);
+        // else if there are records in the file system, mem cpy fixed record into data
+    } else if (embedDBGet(state, key, data) == RECORD_FOUND) {
+        // get pointer from the read buffer
+        void *buf = (int8_t *)state->buffer + (state->pageSize * EMBEDDB_DATA_READ_BUFFER);
+        // retrieve offset
+        recordNum = embedDBSearchNode(state, buf, key, 0);
+    } else {
+        return NO_RECORD_FOUND;
+    }
+
+    int8_t setupResult = embedDBSetupVarDataStream(state, key, varData, recordNum);
+
+    switch (setupResult) {
+        case 0:
+            /* code */
+            return 0;
+        case 1:
+            return 1;
+        case 2:
+        case 3:
+            return -1;
+    }
+
+    return -1;
+}
+
+/**
+ * @brief	Initialize iterator on embedDB structure.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ */
+void embedDBInitIterator(embedDBState *state, embedDBIterator *it) {
+    iteratorInitQueryBitmap(state, it);
+
+    /* Determine which data page should be the first examined if there is a min key and that we have spline points */
+    it->nextDataPage = iteratorFirstDataPage(state, it->minKey);
+    it->nextDataRec = 0;
+
+    /* Pages past the one that can hold the max key are never read, and neither are their index pages */
+    it->lastDataPage = iteratorLastDataPage(state, it->maxKey);
+    it->buffer = NULL;
+    it->readaheadBuffer = NULL;
+}
+
+/**
+ * @brief	Initialize iterator on embedDB structure that returns records from the largest key to the smallest. Use embedDBPrev to read it.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ */
+void embedDBInitReverseIterator(embedDBState *state, embedDBIterator *it) {
+    iteratorInitQueryBitmap(state, it);
+
+    /* Start at the page that can hold the max key, or at the write buffer if the max key can be in it. The reorder buffer comes after the write buffer. */
+    id_t startPage = iteratorLastDataPage(state, it->maxKey);
+    it->nextDataPage = startPage < state->nextDataPageId ? startPage : state->nextDataPageId + (state->reorderBuffer != NULL ? 1 : 0);
+    it->nextDataRec = 0;
+
+    /* Pages before the one that can hold the min key are never read, and neither are their index pages */
+    it->lastDataPage = iteratorFirstDataPage(state, it->minKey);
+    it->buffer = NULL;
+    it->readaheadBuffer = NULL;
+}
+
+/**
+ * @brief	Gives an iterator its own data and index read buffers, so other iterators and lookups do not evict its pages. Call after initializing the iterator.
+ * @param	it		embedDB iterator state structure
+ * @param	buffer	Buffer of two pages: the data page read buffer followed by the index page read buffer. NULL to use the shared read buffers again
+ */
+void embedDBIteratorSetBuffer(embedDBIterator *it, void *buffer) {
+    it->buffer = buffer;
+    it->bufferedPageId = -1;
+    it->bufferedIndexPageId = -1;
+}
+
+/**
+ * @brief	Gives a forward iterator a readahead window, so embedDBNext and embedDBNextPage read runs of consecutive data pages with one storage request. Call after initializing the iterator.
+ * @param	it			embedDB iterator state structure
+ * @param	buffer		Buffer of numPages pages for the readahead window. NULL to read data pages one at a time again
+ * @param	numPages	Number of pages in buffer
+ */
+void embedDBIteratorSetReadahead(embedDBIterator *it, void *buffer, uint32_t numPages) {
+    it->readaheadBuffer = numPages > 0 ? buffer : NULL;
+    it->readaheadPages = numPages;
+    it->readaheadFirstPage = 0;
+    it->readaheadCount = 0;
+}
+
+/**
+ * @brief	Returns a data page from the readahead window of a forward iterator. When the page is not in the window, the window is refilled
+ * 			with the page and the pages after it that the scan will read, stopping at pages the zone map or the index bitmaps can skip.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	pageNum	Logical id of the data page
+ * @return	The page in the readahead window. NULL if the pages could not be read.
+ */
+void *iteratorReadaheadPage(embedDBState *state, embedDBIterator *it, id_t pageNum) {
+    if (it->readaheadCount > 0 && pageNum >= it->readaheadFirstPage && pageNum - it->readaheadFirstPage < it->readaheadCount) {
+        state->bufferHits++;
+        return (int8_t *)it->readaheadBuffer + (pageNum - it->readaheadFirstPage) * state->pageSize;
+    }
+
+    /* The window never wraps around the end of the file, and never holds the write buffer or pages past the end of the scan */
+    id_t physicalPageId = pageNum % state->numDataPages;
+    uint32_t numPages = 1;
+    while (numPages < it->readaheadPages && physicalPageId + numPages < state->numDataPages && pageNum + numPages < state->nextDataPageId &&
+           pageNum + numPages <= it->lastDataPage && iteratorCanSkipPage(state, it, pageNum + numPages) == 0) {
+        numPages++;
+    }
+
+    it->readaheadCount = 0;
+    if (readPagesIntoBuffer(state, state->dataFile, physicalPageId, numPages, it->readaheadBuffer) != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Failed to read %i data pages starting at page %i (%i)\n", numPages, pageNum, physicalPageId);
+#endif
+        return NULL;
+    }
+    it->readaheadFirstPage = pageNum;
+    it->readaheadCount = numPages;
+    return it->readaheadBuffer;
+}
+
+/**
+ * @brief	Reads a data page into the read buffer of an iterator, or into the shared data read buffer if the iterator has none.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	pageNum	Logical id of the data page
+ * @return	The buffer holding the page. NULL if the page could not be read.
+ */
+void *iteratorReadPage(embedDBState *state, embedDBIterator *it, id_t pageNum) {
+    id_t physicalPageId = pageNum % state->numDataPages;
+    int8_t readResult;
+    void *buf;
+    if (it->buffer == NULL) {
+        readResult = readPage(state, physicalPageId);
+        buf = (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize;
+    } else {
+        buf = it->buffer;
+        readResult = readPageIntoBuffer(state, state->dataFile, physicalPageId, buf, &it->bufferedPageId, &state->numReads);
+    }
+
+    if (readResult != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Failed to read data page %i (%i)\n", pageNum, physicalPageId);
+#endif
+        return NULL;
+    }
+    return buf;
+}
+
+/**
+ * @brief	Reads an index page into the index read buffer of an iterator, or into the shared index read buffer if the iterator has none.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	pageNum	Logical id of the index page
+ * @return	The buffer holding the page. NULL if the page could not be read.
+ */
+void *iteratorReadIndexPage(embedDBState *state, embedDBIterator *it, id_t pageNum) {
+    id_t physicalPageId = pageNum % state->numIndexPages;
+    int8_t readResult;
+    void *buf;
+    if (it->buffer == NULL) {
+        readResult = readIndexPage(state, physicalPageId);
+        buf = (int8_t *)state->buffer + EMBEDDB_INDEX_READ_BUFFER * state->pageSize;
+    } else {
+        buf = (int8_t *)it->buffer + state->pageSize;
+        readResult = readPageIntoBuffer(state, state->indexFile, physicalPageId, buf, &it->bufferedIndexPageId, &state->numIdxReads);
+    }
+
+    if (readResult != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Failed to read index page %i (%i)\n", pageNum, physicalPageId);
+#endif
+        return NULL;
+    }
+    return buf;
+}
+
+/**
+ * @brief	Builds the query bitmap of an iterator from its data range, if using bitmaps.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ */
+void iteratorInitQueryBitmap(embedDBState *state, embedDBIterator *it) {
+    /* Build query bitmap (if used) */
+    it->queryBitmap = NULL;
+    if (EMBEDDB_USING_BMAP(state->parameters)) {
+        /* Verify that bitmap index is useful (must have set either min or max data value) */
+        if (it->minData != NULL || it->maxData != NULL) {
+            it->queryBitmap = calloc(1, state->bitmapSize);
+            state->buildBitmapFromRange(it->minData, it->maxData, it->queryBitmap);
+        }
+    }
+
+#ifdef PRINT_ERRORS
+    if (!EMBEDDB_USING_BMAP(state->parameters)) {
+        printf("WARN: Iterator not using index. If this is not intended, ensure that the embedDBState is using a bitmap and was initialized with an index file\n");
+    } else if (!EMBEDDB_USING_INDEX(state->parameters)) {
+        printf("WARN: Iterator not using index to full extent. If this is not intended, ensure that the embedDBState was initialized with an index file\n");
+    }
+#endif
+}
+
+/**
+ * @brief	Finds the first data page that can hold a key, using the fence key directory or the spline.
+ * @param	state	embedDB algorithm state structure
+ * @param	minKey	Smallest key of the scan. NULL if there is no lower bound.
+ * @return	Logical id of the first page to scan
+ */
+id_t iteratorFirstDataPage(embedDBState *state, void *minKey) {
+    if (minKey == NULL)
+        return state->minDataPageId;
+
+    id_t pageNum = 0;
+    if (fenceKeysSearch(state, minKey, &pageNum) == 0)
+        return pageNum;
+
+    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters) && state->spl->count != 0) {
+        /* Spline search */
+        uint32_t location, lowbound, highbound = 0;
+        splineFind(state->spl, minKey, state->compareKey, &location, &lowbound, &highbound);
+
+        // Use the low bound as the start for our search
+        return max(lowbound, state->minDataPageId);
+    }
+    return state->minDataPageId;
+}
+
+/**
+ * @brief	Finds the last data page that can hold a key, using the fence key directory or the spline.
+ * @param	state	embedDB algorithm state structure
+ * @param	maxKey	Largest key of the scan. NULL if there is no upper bound.
+ * @return	Logical id of the last page to scan. UINT32_MAX if the key can be on the last page written, in the write buffer, or on pages not yet written.
+ */
+id_t iteratorLastDataPage(embedDBState *state, void *maxKey) {
+    if (maxKey == NULL || state->nextDataPageId == 0)
+        return UINT32_MAX;
+
+    id_t pageNum = 0;
+    int8_t fenceKeysResult = fenceKeysSearch(state, maxKey, &pageNum);
+    if (fenceKeysResult == 1)
+        return state->minDataPageId;
+    if (fenceKeysResult == 0)
+        return pageNum < state->nextDataPageId - 1 ? pageNum : UINT32_MAX;
+
+    if (EMBEDDB_USING_BINARY_SEARCH(state->parameters) || state->spl->count == 0)
+        return UINT32_MAX;
+
+    /* Keys past the last spline point can be on any later page */
+    if (state->compareKey(maxKey, splinePointLocation(state->spl, state->spl->count - 1)) >= 0)
+        return UINT32_MAX;
+
+    uint32_t location, lowbound, highbound = 0;
+    splineFind(state->spl, maxKey, state->compareKey, &location, &lowbound, &highbound);
+    if (highbound < state->minDataPageId)
+        return state->minDataPageId;
+    return highbound < state->nextDataPageId - 1 ? highbound : UINT32_MAX;
+}
+
+/**
+ * @brief	Estimates how many data pages an iterator has left to scan, from the spline or fence key bound on the page of its max key.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @return	Number of data pages left, counting the write buffer as a page when the scan can reach it
+ */
+uint32_t embedDBIteratorEstimatePages(embedDBState *state, embedDBIterator *it) {
+    id_t lastPage = it->lastDataPage < state->nextDataPageId ? it->lastDataPage : state->nextDataPageId;
+    if (it->nextDataPage > lastPage)
+        return 0;
+    return lastPage - it->nextDataPage + 1;
+}
+
+/**
+ * @brief	Close iterator after use.
+ * @param	it		embedDB iterator structure
+ */
+void embedDBCloseIterator(embedDBIterator *it) {
+    if (it->queryBitmap != NULL) {
+        free(it->queryBitmap);
+    }
+}
+
+/**
+ * @brief	Flushes output buffer.
+ * @param	state	algorithm state structure
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+int8_t embedDBFlushVar(embedDBState *state) {
+    /* Check if we actually have any variable data in the buffer */
+    if (state->currentVarLoc % state->pageSize == state->variableDataHeaderSize) {
+        return 0;
+    }
+
+    // only flush variable buffer
+    id_t writeResult = writeVariablePage(state, (int8_t *)state->buffer + EMBEDDB_VAR_WRITE_BUFFER(state->parameters) * state->pageSize);
+    if (writeResult == (id_t)-1) {
+#ifdef PRINT_ERRORS
+        printf("Failed to write variable data page during embedDBFlushVar.");
+#endif
+        return -1;
+    }
+
+    state->fileInterface->flush(state->varFile);
+    // init new buffer
+    initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
+    // determine how many bytes are left
+    int temp = state->pageSize - (state->currentVarLoc % state->pageSize);
+    // create new offset
+    state->currentVarLoc += temp + state->variableDataHeaderSize;
+    return 0;
+}
+
+/**
+ * @brief	Flushes output buffer.
+ * @param	state	algorithm state structure
+ * @returns 0 if successul and a non-zero value otherwise
+ */
+int8_t embedDBFlush(embedDBState *state) {
+    /* Records held back for reordering are stored first */
+    if (state->reorderBuffer != NULL && reorderBufferDrain(state) != 0) {
+#ifdef PRINT_ERRORS
+        printf("Failed to store the reorder buffer during embedDBFlush.");
+#endif
+        return -1;
+    }
+
+    // As the first buffer is the data write buffer, no address change is required
+    int8_t *buffer = (int8_t *)state->buffer + EMBEDDB_DATA_WRITE_BUFFER * state->pageSize;
+    if (EMBEDDB_GET_COUNT(buffer) < 1) {
+        /* Pages written since the last flush may have added spline points */
+        if (EMBEDDB_USING_SPLINE_FILE(state->parameters) && flushSplineFile(state) != 0) {
+#ifdef PRINT_ERRORS
+            printf("Failed to write spline file page during embedDBFlush.");
+#endif
+            return -1;
+        }
+        /* Pages may still have been written since the last checkpoint */
+        if (EMBEDDB_USING_CHECKPOINT(state->parameters) && state->nextDataPageId != state->lastCheckpointDataPageId) {
+            return embedDBWriteCheckpoint(state);
+        }
+        return 0;
+    }
+
+    id_t pageNum = writePage(state, buffer);
+    if (pageNum == (id_t)-1) {
+#ifdef PRINT_ERRORS
+        printf("Failed to write page during embedDBFlush.");
+#endif
+        return -1;
+    }
+    state->rlcUncommittedRecords = 0;
+
+    /* Make sure the page has actually reached storage before flushing the file */
+    if (embedDBWaitForBackgroundWriter(state) != 0) {
+#ifdef PRINT_ERRORS
+        printf("Background writer failed to write a page before embedDBFlush.");
+#endif
+        return -1;
+    }
+
+    state->fileInterface->flush(state->dataFile);
+
+    indexPage(state, pageNum);
+    if (EMBEDDB_USING_SPLINE_FILE(state->parameters) && flushSplineFile(state) != 0) {
+#ifdef PRINT_ERRORS
+        printf("Failed to write spline file page during embedDBFlush.");
+#endif
+        return -1;
+    }
+
+    if (EMBEDDB_USING_INDEX(state->parameters)) {
+        void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
+        count_t idxcount = EMBEDDB_GET_COUNT(buf);
+        EMBEDDB_INC_COUNT(buf);
+
+        /* Copy record onto index page */
+        void *bm = EMBEDDB_GET_BITMAP(state->buffer);
+        memcpy((void *)((int8_t *)buf + EMBEDDB_GET_IDX_HEADER_SIZE(state) + state->bitmapSize * idxcount), bm, state->bitmapSize);
+        indexPageAddAggregates(state, buf, state->buffer, pageNum, idxcount);
+
+        id_t writeResult = writeIndexPage(state, buf);
+        if (writeResult == (id_t)-1) {
+#ifdef PRINT_ERRORS
+            printf("Failed to write index page during embedDBFlush.");
+#endif
+            return -1;
+        }
+
+        if (embedDBWaitForBackgroundWriter(state) != 0) {
+#ifdef PRINT_ERRORS
+            printf("Background writer failed to write an index page before embedDBFlush.");
+#endif
+            return -1;
+        }
+
+        state->fileInterface->flush(state->indexFile);
+
+        /* Reinitialize buffer */
+        initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
+    }
+
+    /* Reinitialize buffer */
+    initBufferPage(state, EMBEDDB_DATA_WRITE_BUFFER);
+
+    // Flush var data page
+    if (EMBEDDB_USING_VDATA(state->parameters)) {
+        int8_t varFlushResult = embedDBFlushVar(state);
+        if (varFlushResult != 0) {
+#ifdef PRINT_ERRORS
+            printf("Failed to flush variable data page");
+#endif
+            return -1;
+        }
+    }
+
+    if (EMBEDDB_USING_CHECKPOINT(state->parameters)) {
+        int8_t checkpointResult = embedDBWriteCheckpoint(state);
+        if (checkpointResult != 0) {
+#ifdef PRINT_ERRORS
+            printf("Failed to write checkpoint during embedDBFlush");
+#endif
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief	Checks the zone map and the index bitmaps for whether a data page has any records in the data range of an iterator.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	pageNum	Logical id of the data page
+ * @return	1 if the page can be skipped without reading it, 0 if it must be read, -1 if the index page could not be read
+ */
+int8_t iteratorCanSkipPage(embedDBState *state, embedDBIterator *it, id_t pageNum) {
+    if ((it->minData != NULL || it->maxData != NULL) && !zoneMapOverlaps(state, pageNum, it->minData, it->maxData))
+        return 1;
+
+    if (it->queryBitmap == NULL || state->indexFile == NULL)
+        return 0;
+
+    // Find what index page determines if we should read the data page
+    uint32_t indexPage = pageNum / state->maxIdxRecordsPerPage;
+    uint16_t indexRec = pageNum % state->maxIdxRecordsPerPage;
+
+    // If the index page that contains this data page does not exist, we must read the data page regardless cause we don't have the index saved for it
+    if (indexPage < state->minIndexPageId || indexPage >= state->nextIdxPageId)
+        return 0;
+
+    int8_t *indexBuf = (int8_t *)iteratorReadIndexPage(state, it, indexPage);
+    if (indexBuf == NULL)
+        return -1;
+
+    // Get bitmap for data page in question
+    void *indexBM = indexBuf + EMBEDDB_GET_IDX_HEADER_SIZE(state) + indexRec * state->bitmapSize;
+    return !bitmapOverlap(it->queryBitmap, indexBM, state->bitmapSize);
+}
+
+/**
+ * @brief	Moves a forward iterator to the next data page that can have records matching its query, and makes sure the page is in memory.
+ * 			Pages are skipped using the zone map, the index bitmaps and the data range in the page headers.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @return	The readahead window or read buffer of the iterator, the shared read buffer or the write buffer holding the page at it->nextDataPage. NULL if there are no more pages or a page could not be read.
+ */
+void *iteratorNextPageBuffer(embedDBState *state, embedDBIterator *it) {
+    while (1) {
+        if (it->nextDataPage > state->nextDataPageId || it->nextDataPage > it->lastDataPage) {
+            return NULL;
+        }
+        if (it->nextDataPage == state->nextDataPageId) {
+            return (int8_t *)state->buffer + EMBEDDB_DATA_WRITE_BUFFER * state->pageSize;
+        }
+
+        // If we are just starting to read a new page, the zone map or the index can tell us it has no data in the query range without reading it
+        if (it->nextDataRec == 0) {
+            int8_t skipResult = iteratorCanSkipPage(state, it, it->nextDataPage);
+            if (skipResult == -1)
+                return NULL;
+            if (skipResult == 1) {
+                it->nextDataPage++;
+                continue;
+            }
+        }
+
+        int8_t *buf = it->readaheadBuffer != NULL ? (int8_t *)iteratorReadaheadPage(state, it, it->nextDataPage) : (int8_t *)iteratorReadPage(state, it, it->nextDataPage);
+        if (buf == NULL)
+            return NULL;
+
+        // The page header has the range of data on the page, so a page with no data in the query range is skipped without checking each record
+        if (it->nextDataRec == 0 && EMBEDDB_USING_MAX_MIN(state->parameters) && (it->minData != NULL || it->maxData != NULL) &&
+            !dataRangeOverlaps(state, EMBEDDB_GET_MIN_DATA(buf, state), EMBEDDB_GET_MAX_DATA(buf, state), it->minData, it->maxData)) {
+            if (it->maxKey != NULL && state->compareKey(embedDBGetMinKey(state, buf), it->maxKey) > 0)
+                return NULL;
+            it->nextDataPage++;
+            continue;
+        }
+        return buf;
+    }
+}
+
+/**
+ * @brief	Returns the page holding the next records of a forward iterator. On a new page, it->nextDataRec is moved to the first record at or after minKey.
+ * 			The caller reads records from it->nextDataRec up to the page count, then moves to the next page by incrementing it->nextDataPage and setting it->nextDataRec to 0.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @return	Buffer holding the page, only valid until the next call that reads a data page or inserts a record. NULL if there are no more pages.
+ */
+void *embedDBIteratorPage(embedDBState *state, embedDBIterator *it) {
+    int8_t *buf = (int8_t *)iteratorNextPageBuffer(state, it);
+    if (buf == NULL) {
+        return NULL;
+    }
+
+    // On a page that starts below the min key, search for the first record in range instead of checking the records before it one at a time
+    if (it->nextDataRec == 0 && it->minKey != NULL && EMBEDDB_GET_COUNT(buf) > 0 && state->compareKey(buf + state->headerSize, it->minKey) < 0) {
+        it->nextDataRec = searchNodeFirstAtLeast(state, buf, it->minKey);
+    }
+    return buf;
+}
+
+/**
+ * @brief	Return next key, data pair for iterator.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBNext(embedDBState *state, embedDBIterator *it, void *key, void *data) {
+    while (1) {
+        int8_t *buf = (int8_t *)embedDBIteratorPage(state, it);
+        if (buf == NULL) {
+            /* The reorder buffer holds the records after the write buffer */
+            if (state->reorderBuffer != NULL && it->nextDataPage == state->nextDataPageId + 1)
+                return iteratorNextBuffered(state, it, key, data);
+            return 0;
+        }
+        uint32_t pageRecordCount = EMBEDDB_GET_COUNT(buf);
+
+        // Keep reading record until we find one that matches the query
+        while (it->nextDataRec < pageRecordCount) {
+            // Get record
+            memcpy(key, buf + state->headerSize + it->nextDataRec * state->recordSize, state->keySize);
+            memcpy(data, buf + state->headerSize + it->nextDataRec * state->recordSize + state->keySize, state->dataSize);
+            it->nextDataRec++;
+
+            // Check record
+            if (it->minKey != NULL && state->compareKey(key, it->minKey) < 0)
+                continue;
+            if (it->maxKey != NULL && state->compareKey(key, it->maxKey) > 0)
+                return 0;
+            if (it->minData != NULL && state->compareData(data, it->minData) < 0)
+                continue;
+            if (it->maxData != NULL && state->compareData(data, it->maxData) > 0)
+                continue;
+
+            // If we make it here, the record matches the query
+            return 1;
+        }
+
+        // Finished reading through whole data page and didn't find a match
+        it->nextDataPage++;
+        it->nextDataRec = 0;
+
+        // Try next data page by looping back to top
+    }
+}
+
+/**
+ * @brief	Returns the records on the next data page of an iterator that are within its key range, without copying them.
+ * 			Data filters are only used to skip whole pages, so the records in the batch must still be checked against minData and maxData.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	batch	Return variable for the page and the range of records on it
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBNextPage(embedDBState *state, embedDBIterator *it, embedDBPageBatch *batch) {
+    while (1) {
+        int8_t *buf = (int8_t *)iteratorNextPageBuffer(state, it);
+        if (buf == NULL) {
+            return 0;
+        }
+
+        count_t count = EMBEDDB_GET_COUNT(buf);
+        count_t start = it->nextDataRec, end = count;
+        it->nextDataPage++;
+        it->nextDataRec = 0;
+        if (count == 0) {
+            continue;
+        }
+
+        /* Narrow the records to the key range with a search of the page */
+        if (it->minKey != NULL) {
+            count_t firstInRange = searchNodeFirstAtLeast(state, buf, it->minKey);
+            if (firstInRange > start)
+                start = firstInRange;
+        }
+        if (it->maxKey != NULL) {
+            end = (count_t)(searchNodeFloor(state, buf, it->maxKey) + 1);
+            if (end < count) {
+                /* The rest of the records are past the max key, so this is the last page */
+                it->nextDataPage = UINT32_MAX;
+            }
+        }
+        if (start >= end) {
+            continue;
+        }
+
+        batch->page = buf;
+        batch->records = buf + state->headerSize;
+        batch->start = start;
+        batch->end = end;
+        batch->recordSize = state->recordSize;
+        return 1;
+    }
+}
+
+/**
+ * @brief	Return previous key, data pair for an iterator initialized with embedDBInitReverseIterator.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBPrev(embedDBState *state, embedDBIterator *it, void *key, void *data) {
+    while (1) {
+        if (state->reorderBuffer != NULL && it->nextDataPage == state->nextDataPageId + 1 && iteratorPrevBuffered(state, it, key, data)) {
+            return 1;
+        }
+
+        // A reverse iterator counts nextDataRec down to the start of the page. 0 means the page has not been started yet.
+        if (it->nextDataPage > state->nextDataPageId || it->nextDataPage < state->minDataPageId || it->nextDataPage < it->lastDataPage) {
+            return 0;
+        }
+        int searchWriteBuf = it->nextDataPage == state->nextDataPageId;
+
+        if (it->nextDataRec == 0 && searchWriteBuf == 0) {
+            int8_t skipResult = iteratorCanSkipPage(state, it, it->nextDataPage);
+            if (skipResult == -1)
+                return 0;
+            if (skipResult == 1) {
+                reverseIteratorPrevPage(state, it);
+                continue;
+            }
+        }
+
+        int8_t *buf = searchWriteBuf == 0 ? (int8_t *)iteratorReadPage(state, it, it->nextDataPage) : (int8_t *)state->buffer + EMBEDDB_DATA_WRITE_BUFFER * state->pageSize;
+        if (buf == NULL)
+            return 0;
+        if (it->nextDataRec == 0) {
+            if (EMBEDDB_GET_COUNT(buf) == 0) {
+                reverseIteratorPrevPage(state, it);
+                continue;
+            }
+
+            // Skip pages with no data in the query range, unless all of their keys are already below the min key
+            if (searchWriteBuf == 0 && EMBEDDB_USING_MAX_MIN(state->parameters) && (it->minData != NULL || it->maxData != NULL) &&
+                !dataRangeOverlaps(state, EMBEDDB_GET_MIN_DATA(buf, state), EMBEDDB_GET_MAX_DATA(buf, state), it->minData, it->maxData)) {
+                if (it->minKey != NULL && state->compareKey(embedDBGetMaxKey(state, buf), it->minKey) < 0)
+                    return 0;
+                reverseIteratorPrevPage(state, it);
+                continue;
+            }
+            it->nextDataRec = EMBEDDB_GET_COUNT(buf);
+
+            // On a page that ends above the max key, search for the last record in range instead of checking the records after it one at a time
+            if (it->maxKey != NULL && state->compareKey(buf + state->headerSize + (it->nextDataRec - 1) * state->recordSize, it->maxKey) > 0) {
+                it->nextDataRec = (count_t)(searchNodeFloor(state, buf, it->maxKey) + 1);
+            }
+        }
+
+        // Keep reading records backwards until we find one that matches the query
+        while (it->nextDataRec > 0) {
+            it->nextDataRec--;
+            memcpy(key, buf + state->headerSize + it->nextDataRec * state->recordSize, state->keySize);
+            memcpy(data, buf + state->headerSize + it->nextDataRec * state->recordSize + state->keySize, state->dataSize);
+
+            // Check record
+            if (it->maxKey != NULL && state->compareKey(key, it->maxKey) > 0)
+                continue;
+            if (it->minKey != NULL && state->compareKey(key, it->minKey) < 0)
+                return 0;
+            if (it->minData != NULL && state->compareData(data, it->minData) < 0)
+                continue;
+            if (it->maxData != NULL && state->compareData(data, it->maxData) > 0)
+                continue;
+
+            // The first record on the page was returned, so the next call starts on the previous page
+            if (it->nextDataRec == 0)
+                reverseIteratorPrevPage(state, it);
+            return 1;
+        }
+
+        // Finished reading through whole data page and didn't find a match
+        reverseIteratorPrevPage(state, it);
+    }
+}
+
+/**
+ * @brief	Moves a reverse iterator to the start of the previous data page. Past the oldest page, the iterator is left at a page id it never reads.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ */
+void reverseIteratorPrevPage(embedDBState *state, embedDBIterator *it) {
+    it->nextDataPage = it->nextDataPage > state->minDataPageId ? it->nextDataPage - 1 : UINT32_MAX;
+    it->nextDataRec = 0;
+}
+
+/**
+ * @brief	Return next key, data, variable data set for iterator
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @param	varData	Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream after you are done with it**
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBNextVar(embedDBState *state, embedDBIterator *it, void *key, void *data, embedDBVarDataStream **varData) {
+    if (!EMBEDDB_USING_VDATA(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDBNextVar called when not using variable data\n");
+#endif
+        return 0;
+    }
+
+    // ensure record exists
+    int8_t r = embedDBNext(state, it, key, data);
+    if (!r) {
+        return 0;
+    }
+
+    /* The variable data address is read from the shared data read buffer, so the page is copied there from the iterator's own buffer */
+    if (it->nextDataPage < state->nextDataPageId && (it->readaheadBuffer != NULL || it->buffer != NULL)) {
+        void *readBuf = (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize;
+        if (it->readaheadBuffer != NULL) {
+            memcpy(readBuf, (int8_t *)it->readaheadBuffer + (it->nextDataPage - it->readaheadFirstPage) * state->pageSize, state->pageSize);
+            state->bufferedPageId = it->nextDataPage % state->numDataPages;
+        } else {
+            memcpy(readBuf, it->buffer, state->pageSize);
+            state->bufferedPageId = it->bufferedPageId;
+        }
+    }
+
+    void *outputBuffer = (int8_t *)state->buffer;
+    if (it->nextDataPage == 0 && (EMBEDDB_GET_COUNT(outputBuffer) > 0)) {
+        readToWriteBuf(state);
+        embedDBFlushVar(state);
+    }
+
+    // Get the vardata address from the record
+    count_t recordNum = it->nextDataRec - 1;
+    int8_t setupResult = embedDBSetupVarDataStream(state, key, varData, recordNum);
+    switch (setupResult) {
+        case 0:
+        case 1:
+            return 1;
+        case 2:
+        case 3:
+            return 0;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Setup varDataStream object to return the variable data for a record
+ * @param	state	embedDB algorithm state structure
+ * @param   key     Key for the record
+ * @param   varData Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream after you are done with it**
+ * @return  Returns 0 if sucessfull or no variable data for the record, 1 if the records variable data was overwritten, 2 if the page failed to read, and 3 if the memorey failed to allocate.
+ */
+int8_t embedDBSetupVarDataStream(embedDBState *state, void *key, embedDBVarDataStream **varData, id_t recordNumber) {
+    void *dataBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    void *record = (int8_t *)dataBuf + state->headerSize + recordNumber * state->recordSize;
+
+    uint32_t varDataAddr = 0;
+    memcpy(&varDataAddr, (int8_t *)record + state->keySize + state->dataSize, sizeof(uint32_t));
+    if (varDataAddr == EMBEDDB_NO_VAR_DATA) {
+        *varData = NULL;
+        return 0;
+    }
+
+    // Check if the variable data associated with this key has been overwritten due to file wrap around
+    if (state->compareKey(key, &state->minVarRecordId) < 0) {
+        *varData = NULL;
+        return 1;
+    }
+
+    uint32_t pageNum = (varDataAddr / state->pageSize) % state->numVarPages;
+
+    // Read in page
+    if (readVariablePage(state, pageNum) != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: embedDB failed to read variable page\n");
+#endif
+        return 2;
+    }
+
+    // Get length of variable data
+    void *varBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+    uint32_t pageOffset = varDataAddr % state->pageSize;
+    uint32_t dataLen = 0;
+    memcpy(&dataLen, (int8_t *)varBuf + pageOffset, sizeof(uint32_t));
+
+    // Move var data address to the beginning of the data, past the data length
+    varDataAddr = (varDataAddr + sizeof(uint32_t)) % (state->numVarPages * state->pageSize);
+
+    // If we end up on the page boundary, we need to move past the header
+    if (varDataAddr % state->pageSize == 0) {
+        varDataAddr += state->variableDataHeaderSize;
+        varDataAddr %= (state->numVarPages * state->pageSize);
+    }
+
+    // Create varDataStream
+    embedDBVarDataStream *varDataStream = malloc(sizeof(embedDBVarDataStream));
+    if (varDataStream == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Failed to alloc memory for embedDBVarDataStream\n");
+#endif
+        return 3;
+    }
+
+    varDataStream->dataStart = varDataAddr;
+    varDataStream->totalBytes = dataLen;
+    varDataStream->bytesRead = 0;
+    varDataStream->fileOffset = varDataAddr;
+
+    *varData = varDataStream;
+    return 0;
+}
+
+/**
+ * @brief	Reads data from variable data stream into the given buffer.
+ * @param	state	embedDB algorithm state structure
+ * @param	stream	Variable data stream
+ * @param	buffer	Buffer to read data into
+ * @param	length	Number of bytes to read (Must be <= buffer size)
+ * @return	Number of bytes read
+ */
+uint32_t embedDBVarDataStreamRead(embedDBState *state, embedDBVarDataStream *stream, void *buffer, uint32_t length) {
+    if (buffer == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Cannot pass null buffer to embedDBVarDataStreamRead\n");
+#endif
+        return 0;
+    }
+
+    // Read in var page containing the data to read
+    uint32_t pageNum = (stream->fileOffset / state->pageSize) % state->numVarPages;
+    if (readVariablePage(state, pageNum) != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Couldn't read variable data page %d\n", pageNum);
+#endif
+        return 0;
+    }
+
+    // Keep reading in data until the buffer is full
+    void *varDataBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+    uint32_t amtRead = 0;
+    while (amtRead < length && stream->bytesRead < stream->totalBytes) {
+        uint16_t pageOffset = stream->fileOffset % state->pageSize;
+        uint32_t amtToRead = min(stream->totalBytes - stream->bytesRead, min(state->pageSize - pageOffset, length - amtRead));
+        memcpy((int8_t *)buffer + amtRead, (int8_t *)varDataBuf + pageOffset, amtToRead);
+        amtRead += amtToRead;
+        stream->bytesRead += amtToRead;
+        stream->fileOffset += amtToRead;
+
+        // If we need to keep reading, read the next page
+        if (amtRead < length && stream->bytesRead < stream->totalBytes) {
+            pageNum = (pageNum + 1) % state->numVarPages;
+            if (readVariablePage(state, pageNum) != 0) {
+#ifdef PRINT_ERRORS
+                printf("ERROR: Couldn't read variable data page %d\n", pageNum);
+#endif
+                return 0;
+            }
+            // Skip past the header
+            stream->fileOffset += state->variableDataHeaderSize;
         }
-        middle = (first + last) / 2;
     }
-    if (range)
-        return middle;
-    return -1;
+
+    return amtRead;
 }
 
 /**
- * @brief	Linear search function to be used with an approximate range of pages.
- * 			If the desired key is found, the page containing that record is loaded
- * 			into the passed buffer pointer.
- * @param	state		embedDB algorithm state structure
- * @param 	numReads	Tracks total number of reads for statistics
- * @param	buf			buffer to store page with desired record
- * @param	key			Key for the record to search for
- * @param	pageId		Page id to start search from
- * @param 	low			Lower bound for the page the record could be found on
- * @param 	high		Uper bound for the page the record could be found on
- * @return	Return 0 if success. Non-zero value if error.
+ * @brief	Prints statistics.
+ * @param	state	embedDB state structure
  */
-int8_t linearSearch(embedDBState *state, void *buf, void *key, int32_t pageId, int32_t low, int32_t high) {
-    int32_t pageError = 0;
-    int32_t physPageId;
-    while (1) {
-        /* Move logical page number to physical page id based on location of first data page */
-        physPageId = pageId % state->numDataPages;
+void embedDBPrintStats(embedDBState *state) {
+    printf("Num reads: %d\n", state->numReads);
+    printf("Buffer hits: %d\n", state->bufferHits);
+    if (EMBEDDB_USING_BUFFER_POOL(state->parameters)) {
+        printf("Buffer pool hits: %d\n", state->bufferPoolHits);
+        printf("Buffer pool misses: %d\n", state->bufferPoolMisses);
+    }
+    printf("Num writes: %d\n", state->numWrites);
+    printf("Num index reads: %d\n", state->numIdxReads);
+    printf("Num index writes: %d\n", state->numIdxWrites);
+    printf("Max Error: %d\n", state->maxError);
 
-        if (pageId > high || pageId < low || low > high || pageId < state->minDataPageId || pageId >= state->nextDataPageId) {
-            return -1;
-        }
+    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
+        splinePrint(state->spl);
+    }
+}
 
-        /* Read page into buffer. If 0 not returned, there was an error */
-        if (readPage(state, physPageId) != 0) {
+/**
+ * @brief	Writes page in buffer to storage. Returns page number.
+ * @param	state	embedDB algorithm state structure
+ * @param	buffer	Buffer for writing out page
+ * @return	Return page number if success, -1 if error.
+ */
+id_t writePage(embedDBState *state, void *buffer) {
+    if (state->dataFile == NULL)
+        return -1;
+
+    /* Always writes to next page number. Returned to user. */
+    id_t pageNum = state->nextDataPageId;
+    id_t physicalPageNum = pageNum % state->numDataPages;
+
+    /* Setup page number in header */
+    memcpy(buffer, &(pageNum), sizeof(id_t));
+
+    /* Compressed pages and pages with key offsets are written from the compression buffer */
+    void *storedPage = buffer;
+    if (EMBEDDB_USING_COMPRESSION(state->parameters)) {
+        storedPage = (int8_t *)state->buffer + state->pageSize * EMBEDDB_COMPRESSION_BUFFER(state->parameters);
+        if (compressDataPage(state, buffer, storedPage) < 0)
             return -1;
+    } else if (EMBEDDB_USING_KEY_OFFSETS(state->parameters)) {
+        storedPage = (int8_t *)state->buffer + state->pageSize * EMBEDDB_COMPRESSION_BUFFER(state->parameters);
+        encodeKeyOffsetPage(state, buffer, storedPage);
+    }
+    state->nextDataPageId++;
+
+    uint8_t eraseBlock = state->numAvailDataPages <= 0;
+    if (eraseBlock) {
+        /* Erase pages to make space for new data. The background writer erases the block right before writing the page instead. */
+        if (state->backgroundWriter == NULL) {
+            int8_t eraseResult = state->fileInterface->erase(physicalPageNum, physicalPageNum + state->eraseSizeInPages, dataFilePageSize(state), state->dataFile);
+            if (eraseResult != 1) {
+#ifdef PRINT_ERRORS
+                printf("Failed to erase data page: %i (%i)\n", pageNum, physicalPageNum);
+#endif
+                return -1;
+            }
         }
 
-        if (state->compareKey(key, embedDBGetMinKey(state, buf)) < 0) { /* Key is less than smallest record in block. */
-            high = --pageId;
-            pageError++;
-        } else if (state->compareKey(key, embedDBGetMaxKey(state, buf)) > 0) { /* Key is larger than largest record in block. */
-            low = ++pageId;
-            pageError++;
-        } else {
-            /* Found correct block */
-            return 0;
+        /* Flag the pages as usable to EmbedDB */
+        state->numAvailDataPages += state->eraseSizeInPages;
+        state->minDataPageId += state->eraseSizeInPages;
+
+        /* remove any spline points related to these pages */
+        if (!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
+            cleanSpline(state, state->minDataPageId);
         }
     }
-}
 
-int8_t binarySearch(embedDBState *state, void *buffer, void *key) {
-    uint32_t first = state->minDataPageId, last = state->nextDataPageId - 1;
-    uint32_t pageId = (first + last) / 2;
-    while (1) {
-        /* Read page into buffer */
-        if (readPage(state, pageId % state->numDataPages) != 0)
-            return -1;
+    /* Seek to page location in file */
+    bufferPoolInvalidate(state, state->dataFile, physicalPageNum, eraseBlock ? state->eraseSizeInPages : 1);
+    int32_t val;
+    if (state->backgroundWriter != NULL) {
+        val = queueBackgroundPageWrite(state, state->dataFile, buffer, physicalPageNum, eraseBlock) == 0;
+    } else {
+        val = state->fileInterface->write(storedPage, physicalPageNum, dataFilePageSize(state), state->dataFile);
+    }
+    if (val == 0) {
+#ifdef PRINT_ERRORS
+        printf("Failed to write data page: %i (%i)\n", pageNum, physicalPageNum);
+#endif
+        return -1;
+    }
 
-        if (first >= last)
-            break;
+    state->numAvailDataPages--;
+    state->numWrites++;
+    fenceKeysAddPage(state, pageNum, buffer);
+    zoneMapAddPage(state, pageNum, buffer);
 
-        if (state->compareKey(key, embedDBGetMinKey(state, buffer)) < 0) {
-            /* Key is less than smallest record in block. */
-            last = pageId - 1;
-            pageId = (first + last) / 2;
-        } else if (state->compareKey(key, embedDBGetMaxKey(state, buffer)) > 0) {
-            /* Key is larger than largest record in block. */
-            first = pageId + 1;
-            pageId = (first + last) / 2;
-        } else {
-            /* Found correct block */
-            return 0;
-        }
-    }
+    return pageNum;
 }
 
-int8_t splineSearch(embedDBState *state, void *buffer, void *key) {
-    /* Spline search */
-    uint32_t location, lowbound, highbound;
-    splineFind(state->spl, key, state->compareKey, &location, &lowbound, &highbound);
+int8_t writeTemporaryPage(embedDBState *state, void *buffer) {
+    if (state->dataFile == NULL) {
+#ifdef PRINT_ERRORS
+        printf("The dataFile in embedDBState was null.");
+#endif
+        return -3;
+    }
 
-    /* If the spline thinks the data is on a page smaller than the smallest data page we have, we know we don't have the data */
-    if (highbound < state->minDataPageId) {
+    /* Temporary pages share the data file with the background writer, so it must be idle first */
+    if (embedDBWaitForBackgroundWriter(state) != 0) {
         return -1;
     }
 
-    /* if the spline returns a lowbound lower than than the smallest page we have, we can move the lowbound and location up */
-    if (lowbound < state->minDataPageId) {
-        lowbound = state->minDataPageId;
-        location = (lowbound + highbound) / 2;
+    /* Setup page number in header */
+    /* TODO: Maybe talk to Ramon about optimizing this */
+    memcpy(buffer, &(state->nextDataPageId), sizeof(id_t));
+
+    /* Wrap if needed */
+    state->nextRLCPhysicalPageLocation %= state->numDataPages;
+
+    /* If the nextPhysicalPage wrapped, we need to add the numDataPages to it to properly compare the page numbers below */
+    uint32_t nextPage = state->nextRLCPhysicalPageLocation + (state->nextRLCPhysicalPageLocation < state->rlcPhysicalStartingPage ? state->numDataPages : 0);
+
+    /* if the nextRLC physical page number would be outside the block, we wrap to the start of our record-level consistency blocks */
+    if (nextPage - state->rlcPhysicalStartingPage >= state->eraseSizeInPages * 2) {
+        state->nextRLCPhysicalPageLocation = state->rlcPhysicalStartingPage;
     }
 
-    // Check if the currently buffered page is the correct one
-    if (!(lowbound <= state->bufferedPageId &&
-          highbound >= state->bufferedPageId &&
-          state->compareKey(embedDBGetMinKey(state, buffer), key) <= 0 &&
-          state->compareKey(embedDBGetMaxKey(state, buffer), key) >= 0)) {
-        if (linearSearch(state, buffer, key, location, lowbound, highbound) == -1) {
-            return -1;
+    /* If in pageNum is second page in block, we erase the other record-level consistency block */
+    if (state->nextRLCPhysicalPageLocation % state->eraseSizeInPages == 1) {
+        uint32_t eraseStartingPage = state->rlcPhysicalStartingPage;
+        count_t blockSize = state->eraseSizeInPages;
+        if (state->nextRLCPhysicalPageLocation == eraseStartingPage + 1) {
+            eraseStartingPage = (eraseStartingPage + blockSize) % state->numDataPages;
+        }
+        uint32_t eraseEndingPage = eraseStartingPage + blockSize;
+
+        bufferPoolInvalidate(state, state->dataFile, eraseStartingPage, blockSize);
+        int8_t eraseSuccess = state->fileInterface->erase(eraseStartingPage, eraseEndingPage, dataFilePageSize(state), state->dataFile);
+        if (!eraseSuccess) {
+#ifdef PRINT_ERRORS
+            printf("Failed to erase block starting at physical page %i in the data file.", state->nextRLCPhysicalPageLocation);
+            return -2;
+#endif
         }
     }
+
+    /* Write temporary page to storage */
+    bufferPoolInvalidate(state, state->dataFile, state->nextRLCPhysicalPageLocation, 1);
+    int8_t writeSuccess = state->fileInterface->write(buffer, state->nextRLCPhysicalPageLocation++, state->pageSize, state->dataFile);
+    if (!writeSuccess) {
+#ifdef PRINT_ERRORS
+        printf("Failed to write temporary page for record-level-consistency: Logical Page Number %i - Physical Page (%i)\n", state->nextDataPageId, state->nextRLCPhysicalPageLocation - 1);
+#endif
+        return -1;
+    }
+
     return 0;
 }
 
 /**
- * @brief	Given a key, searches for data associated with
- *          that key in embedDB buffer using embedDBSearchNode.
- *          Note: Space for data must be already allocated.
+ * @brief	Calculates the number of spline points not in use by embedDB and deletes them
  * @param	state	embedDB algorithm state structure
- * @param   buffer  pointer to embedDB buffer
- * @param	key		Key for record
- * @param	data	Pre-allocated memory to copy data for record
- * @return	Return non-negative integer representing offset if success. Non-zero value if error.
+ * @param	key 	The minimim key embedDB still needs points for
+ * @return	Returns the number of points deleted
  */
-int8_t searchBuffer(embedDBState *state, void *buffer, void *key, void *data) {
-    // return -1 if there is nothing in the buffer
-    if (EMBEDDB_GET_COUNT(buffer) == 0) {
-        return NO_RECORD_FOUND;
-    }
-    // find index of record inside of the write buffer
-    id_t nextId = embedDBSearchNode(state, buffer, key, 0);
-    // return 0 if found
-    if (nextId != NO_RECORD_FOUND) {
-        // Key found
-        memcpy(data, (void *)((int8_t *)buffer + state->headerSize + state->recordSize * nextId + state->keySize), state->dataSize);
-        return nextId;
+uint32_t cleanSpline(embedDBState *state, uint32_t minPageNumber) {
+    uint32_t numPointsErased = 0;
+    void *nextPoint;
+    uint32_t currentPageNumber = 0;
+    for (size_t i = 0; i < state->spl->count; i++) {
+        nextPoint = splinePointLocation(state->spl, i + 1);
+        memcpy(&currentPageNumber, (int8_t *)nextPoint + state->keySize, sizeof(uint32_t));
+        if (currentPageNumber < minPageNumber) {
+            numPointsErased++;
+        } else {
+            break;
+        }
     }
-    // Key not found
-    return NO_RECORD_FOUND;
+    if (state->spl->count - numPointsErased < 2)
+        numPointsErased -= 2 - (state->spl->count - numPointsErased);
+    if (numPointsErased <= 0)
+        return 0;
+    splineErase(state->spl, numPointsErased);
+    return numPointsErased;
 }
 
 /**
- * @brief	Given a key, returns data associated with key.
- * 			Note: Space for data must be already allocated.
- * 			Data is copied from database into data buffer.
+ * @brief	Writes index page in buffer to storage. Returns page number.
  * @param	state	embedDB algorithm state structure
- * @param	key		Key for record
- * @param	data	Pre-allocated memory to copy data for record
- * @return	Return 0 if success. Returns -2 if requested key is less than the minimum stored key. Non-zero value if error.
- */
-int8_t embedDBGet(embedDBState *state, void *key, void *data) {
-    void *outputBuffer = state->buffer;
-    if (state->nextDataPageId == 0) {
-        int8_t success = searchBuffer(state, outputBuffer, key, data);
-        if (success != NO_RECORD_FOUND) {
-            return 0;
-        }
+ * @param	buffer	Buffer to use for writing index page
+ * @return	Return page number if success, -1 if error.
+ */
+id_t writeIndexPage(embedDBState *state, void *buffer) {
+    if (state->indexFile == NULL)
         return -1;
-    }
-
-    uint64_t thisKey = 0;
-    memcpy(&thisKey, key, state->keySize);
-
-    void *buf = (int8_t *)state->buffer + state->pageSize;
-    int16_t numReads = 0;
 
-    // if write buffer is not empty
-    if ((EMBEDDB_GET_COUNT(outputBuffer) != 0)) {
-        // get the max/min key from output buffer
-        uint64_t bufMaxKey = 0;
-        uint64_t bufMinKey = 0;
-        memcpy(&bufMaxKey, embedDBGetMaxKey(state, outputBuffer), state->keySize);
-        memcpy(&bufMinKey, embedDBGetMinKey(state, outputBuffer), state->keySize);
+    /* Always writes to next page number. Returned to user. */
+    id_t pageNum = state->nextIdxPageId++;
+    id_t physicalPageNumber = pageNum % state->numIndexPages;
 
-        // return -1 if key is not in buffer
-        if (thisKey > bufMaxKey) return -1;
+    /* Setup page number in header */
+    memcpy(buffer, &(pageNum), sizeof(id_t));
 
-        // if key >= buffer's min, check buffer
-        if (thisKey >= bufMinKey) {
-            return (searchBuffer(state, outputBuffer, key, data) != NO_RECORD_FOUND) ? 0 : NO_RECORD_FOUND;
+    uint8_t eraseBlock = state->numAvailIndexPages <= 0;
+    if (eraseBlock) {
+        // Erase index pages to make room for new page
+        if (state->backgroundWriter == NULL) {
+            int8_t eraseResult = state->fileInterface->erase(physicalPageNumber, physicalPageNumber + state->eraseSizeInPages, state->pageSize, state->indexFile);
+            if (eraseResult != 1) {
+#ifdef PRINT_ERRORS
+                printf("Failed to erase data page: %i (%i)\n", pageNum, physicalPageNumber);
+#endif
+                return -1;
+            }
         }
+        state->numAvailIndexPages += state->eraseSizeInPages;
+        state->minIndexPageId += state->eraseSizeInPages;
     }
 
-    int8_t searchResult = 0;
-    if (EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
-        /* Regular binary search */
-        searchResult = binarySearch(state, buf, key);
+    /* Seek to page location in file */
+    bufferPoolInvalidate(state, state->indexFile, physicalPageNumber, eraseBlock ? state->eraseSizeInPages : 1);
+    int32_t val;
+    if (state->backgroundWriter != NULL) {
+        val = queueBackgroundPageWrite(state, state->indexFile, buffer, physicalPageNumber, eraseBlock) == 0;
     } else {
-        /* Spline search */
-        searchResult = splineSearch(state, buf, key);
+        val = state->fileInterface->write(buffer, physicalPageNumber, state->pageSize, state->indexFile);
     }
-
-    if (searchResult != 0) {
+    if (val == 0) {
 #ifdef PRINT_ERRORS
-        printf("ERROR: embedDBGet was unable to find page to search for record\n");
+        printf("Failed to write index page: %i (%i)\n", pageNum, physicalPageNumber);
 #endif
         return -1;
     }
 
-    id_t nextId = embedDBSearchNode(state, buf, key, 0);
+    state->numAvailIndexPages--;
+    state->numIdxWrites++;
 
-    if (nextId != -1) {
-        /* Key found */
-        memcpy(data, (void *)((int8_t *)buf + state->headerSize + state->recordSize * nextId + state->keySize), state->dataSize);
-        return 0;
-    }
-    // Key not found
-    return -1;
+    return pageNum;
 }
 
 /**
- * @brief	Given a key, returns data associated with key.
- * 			Data is copied from database into data buffer.
+ * @brief	Writes variable data page in buffer to storage. Returns page number.
  * @param	state	embedDB algorithm state structure
- * @param	key		Key for record
- * @param	data	Pre-allocated memory to copy data for record
- * @param	varData	Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream after you are done with it**
- * @return	Return 0 if success. Non-zero value if error.
- * 			-1 : Error reading file or failed memory allocation
- * 			1  : Variable data was deleted to make room for newer data
+ * @param	buffer	Buffer to use to write page to storage
+ * @return	Return page number if success, -1 if error.
  */
-int8_t embedDBGetVar(embedDBState *state, void *key, void *data, embedDBVarDataStream **varData) {
-    if (!EMBEDDB_USING_VDATA(state->parameters)) {
+id_t writeVariablePage(embedDBState *state, void *buffer) {
+    if (state->varFile == NULL) {
+        return -1;
+    }
+
+    // Make sure the address being witten to wraps around
+    id_t physicalPageId = state->nextVarPageId % state->numVarPages;
+
+    // Erase data if needed
+    if (state->numAvailVarPages <= 0) {
+        bufferPoolInvalidate(state, state->varFile, physicalPageId, state->eraseSizeInPages);
+        int8_t eraseResult = state->fileInterface->erase(physicalPageId, physicalPageId + state->eraseSizeInPages, state->pageSize, state->varFile);
+        if (eraseResult != 1) {
 #ifdef PRINT_ERRORS
-        printf("ERROR: embedDBGetVar called when not using variable data\n");
+            printf("Failed to erase data page: %i (%i)\n", state->nextVarPageId, physicalPageId);
 #endif
-        return 0;
+            return -1;
+        }
+        state->numAvailVarPages += state->eraseSizeInPages;
+        // Last page that is deleted
+        id_t pageNum = (physicalPageId + state->eraseSizeInPages - 1) % state->numVarPages;
+
+        // Read in that page so we can update which records we still have the data for
+        if (readVariablePage(state, pageNum) != 0) {
+            return -1;
+        }
+        void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters) + sizeof(id_t);
+        memcpy(&state->minVarRecordId, buf, state->keySize);
+        state->minVarRecordId += 1;  // Add one because the result from the last line is a record that is erased
     }
-    void *outputBuffer = (int8_t *)state->buffer;
 
-    // search output buffer for record, mem copy fixed record into data
-    int8_t recordNum = searchBuffer(state, outputBuffer, key, data);
+    // Add logical page number to data page
+    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_WRITE_BUFFER(state->parameters);
+    memcpy(buf, &state->nextVarPageId, sizeof(id_t));
 
-    // if there are records found in the output buffer
-    if (recordNum != NO_RECORD_FOUND) {
-        // flush variable record buffer to storage to read later on
-        embedDBFlushVar(state);
-        // copy contents of write buffer to read buffer for embedDBSetupVarDataStream()
-        readToWriteBuf(state);
-        // else if there are records in the file system, mem cpy fixed record into data
-    } else if (embedDBGet(state, key, data) == RECORD_FOUND) {
-        // get pointer from the read buffer
-        void *buf = (int8_t *)state->buffer + (state->pageSize * EMBEDDB_DATA_READ_BUFFER);
-        // retrieve offset
-        recordNum = embedDBSearchNode(state, buf, key, 0);
-    } else {
-        return NO_RECORD_FOUND;
+    // Write to file
+    bufferPoolInvalidate(state, state->varFile, physicalPageId, 1);
+    uint32_t val = state->fileInterface->write(buffer, physicalPageId, state->pageSize, state->varFile);
+    if (val == 0) {
+#ifndef PRINT
+        printf("Failed to write vardata page: %i\n", state->nextVarPageId);
+#endif
+        return -1;
     }
 
-    int8_t setupResult = embedDBSetupVarDataStream(state, key, varData, recordNum);
+    state->nextVarPageId++;
+    state->numAvailVarPages--;
+    state->numWrites++;
 
-    switch (setupResult) {
-        case 0:
-            /* code */
-            return 0;
-        case 1:
-            return 1;
-        case 2:
-        case 3:
-            return -1;
-    }
+    return state->nextVarPageId - 1;
+}
 
-    return -1;
+/**
+ * @brief	Memcopies write buffer to the read buffer.
+ * @param	state	embedDB algorithm state structure
+ */
+void readToWriteBuf(embedDBState *state) {
+    // point to read buffer
+    void *readBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    // point to write buffer
+    void *writeBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_WRITE_BUFFER;
+    // copy write buffer to the read buffer.
+    memcpy(readBuf, writeBuf, state->pageSize);
 }
 
 /**
- * @brief	Initialize iterator on embedDB structure.
+ * @brief	Memcopies variable write buffer to the read buffer.
  * @param	state	embedDB algorithm state structure
- * @param	it		embedDB iterator state structure
  */
-void embedDBInitIterator(embedDBState *state, embedDBIterator *it) {
-    /* Build query bitmap (if used) */
-    it->queryBitmap = NULL;
-    if (EMBEDDB_USING_BMAP(state->parameters)) {
-        /* Verify that bitmap index is useful (must have set either min or max data value) */
-        if (it->minData != NULL || it->maxData != NULL) {
-            it->queryBitmap = calloc(1, state->bitmapSize);
-            state->buildBitmapFromRange(it->minData, it->maxData, it->queryBitmap);
-        }
+void readToWriteBufVar(embedDBState *state) {
+    // point to read buffer
+    void *readBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
+    // point to write buffer
+    void *writeBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_WRITE_BUFFER(state->parameters);
+    // copy write buffer to the read buffer.
+    memcpy(readBuf, writeBuf, state->pageSize);
+}
+
+/**
+ * @brief	Reads given page from storage.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageNum	Page number to read
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t readPage(embedDBState *state, id_t pageNum) {
+    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    return readPageIntoBuffer(state, state->dataFile, pageNum, buf, &state->bufferedPageId, &state->numReads);
+}
+
+/**
+ * @brief	Reads given index page from storage.
+ * @param	state	embedDB algorithm state structure
+ * @param	pageNum	Page number to read
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t readIndexPage(embedDBState *state, id_t pageNum) {
+    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
+    return readPageIntoBuffer(state, state->indexFile, pageNum, buf, &state->bufferedIndexPageId, &state->numIdxReads);
+}
+
+/**
+ * @brief	Reads a data or index page into a read buffer, unless the buffer already holds it.
+ * @param	state			embedDB algorithm state structure
+ * @param	file			File to read the page from
+ * @param	pageNum			Physical page number to read
+ * @param	buf				Read buffer to hold the page
+ * @param	bufferedPageId	Page id currently in buf. Set to pageNum on success
+ * @param	numReads		Read counter to increment when the page is read from storage
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t readPageIntoBuffer(embedDBState *state, void *file, id_t pageNum, void *buf, id_t *bufferedPageId, id_t *numReads) {
+    /* Check if page is currently in buffer */
+    if (pageNum == *bufferedPageId) {
+        state->bufferHits++;
+        return 0;
     }
 
-#ifdef PRINT_ERRORS
-    if (!EMBEDDB_USING_BMAP(state->parameters)) {
-        printf("WARN: Iterator not using index. If this is not intended, ensure that the embedDBState is using a bitmap and was initialized with an index file\n");
-    } else if (!EMBEDDB_USING_INDEX(state->parameters)) {
-        printf("WARN: Iterator not using index to full extent. If this is not intended, ensure that the embedDBState was initialized with an index file\n");
+    if (bufferPoolRead(state, file, pageNum, buf)) {
+        *bufferedPageId = pageNum;
+        return 0;
     }
-#endif
 
-    /* Determine which data page should be the first examined if there is a min key and that we have spline points */
-    if (state->spl->count != 0 && it->minKey != NULL && !(EMBEDDB_USING_BINARY_SEARCH(state->parameters))) {
-        /* Spline search */
-        uint32_t location, lowbound, highbound = 0;
-        splineFind(state->spl, it->minKey, state->compareKey, &location, &lowbound, &highbound);
+    /* The page may still be waiting to be written by the background writer */
+    int8_t syncResult = syncBackgroundWriterForRead(state, file, pageNum, buf);
+    if (syncResult == -1)
+        return -1;
 
-        // Use the low bound as the start for our search
-        it->nextDataPage = max(lowbound, state->minDataPageId);
-    } else {
-        it->nextDataPage = state->minDataPageId;
+    /* Page is not in buffer. Read from storage. */
+    if (syncResult == 0 && readFilePage(state, file, pageNum, buf) != 0)
+        return -1;
+
+    (*numReads)++;
+    *bufferedPageId = pageNum;
+    bufferPoolInsert(state, file, pageNum, buf);
+    return 0;
+}
+
+/**
+ * @brief	Reads a page from storage. Pages of the data file are decompressed when using EMBEDDB_USE_COMPRESSION, and their keys restored when using EMBEDDB_USE_KEY_OFFSETS.
+ * @param	state	embedDB algorithm state structure
+ * @param	file	File to read the page from
+ * @param	pageNum	Physical page number to read
+ * @param	buf		Buffer to hold the page
+ * @return	Return 0 if success, -1 if error.
+ */
+int8_t readFilePage(embedDBState *state, void *file, id_t pageNum, void *buf) {
+    if ((state->parameters & EMBEDDB_ENCODED_DATA_PAGES) && file == state->dataFile) {
+        void *encoded = (int8_t *)state->buffer + state->pageSize * EMBEDDB_COMPRESSION_BUFFER(state->parameters);
+        if (0 == state->fileInterface->read(encoded, pageNum, state->compressedPageSize, file))
+            return -1;
+        if (EMBEDDB_USING_COMPRESSION(state->parameters)) {
+            decompressDataPage(state, encoded, buf);
+        } else {
+            decodeKeyOffsetPage(state, encoded, buf);
+        }
+        return 0;
     }
-    it->nextDataRec = 0;
+    return state->fileInterface->read(buf, pageNum, state->pageSize, file) != 0 ? 0 : -1;
 }
 
 /**
- * @brief	Close iterator after use.
- * @param	it		embedDB iterator structure
+ * @brief	Reads consecutive pages with the readPages function of the file interface, or one page at a time if it has none.
+ * 			The pages bypass the buffer pool, so a long scan does not replace the pages cached for lookups.
+ * @param	state		embedDB algorithm state structure
+ * @param	file		File to read the pages from
+ * @param	pageNum		Physical page number of the first page
+ * @param	numPages	Number of pages to read. The pages must not wrap around the end of the file
+ * @param	buf			Buffer of numPages pages to hold the pages
+ * @return	Return 0 if success, -1 if error.
  */
-void embedDBCloseIterator(embedDBIterator *it) {
-    if (it->queryBitmap != NULL) {
-        free(it->queryBitmap);
+int8_t readPagesIntoBuffer(embedDBState *state, void *file, id_t pageNum, uint32_t numPages, void *buf) {
+    /* Queued writes to the file have to reach storage before the pages are read */
+    if (syncBackgroundWriterForRead(state, file, UINT32_MAX, buf) == -1)
+        return -1;
+
+    /* Encoded pages are a different size in the file than in memory, so they are read and decoded one at a time */
+    if (state->fileInterface->readPages != NULL && numPages > 1 && !((state->parameters & EMBEDDB_ENCODED_DATA_PAGES) && file == state->dataFile)) {
+        if (0 == state->fileInterface->readPages(buf, pageNum, numPages, state->pageSize, file))
+            return -1;
+    } else {
+        for (uint32_t i = 0; i < numPages; i++) {
+            if (readFilePage(state, file, pageNum + i, (int8_t *)buf + i * state->pageSize) != 0)
+                return -1;
+        }
     }
+
+    state->numReads += numPages;
+    return 0;
 }
 
 /**
- * @brief	Flushes output buffer.
- * @param	state	algorithm state structure
- * @returns 0 if successul and a non-zero value otherwise
+ * @brief	Reads given variable data page from storage
+ * @param 	state 	embedDB algorithm state structure
+ * @param 	pageNum Page number to read
+ * @return 	Return 0 if success, -1 if error
  */
-int8_t embedDBFlushVar(embedDBState *state) {
-    /* Check if we actually have any variable data in the buffer */
-    if (state->currentVarLoc % state->pageSize == state->variableDataHeaderSize) {
+int8_t readVariablePage(embedDBState *state, id_t pageNum) {
+    // Check if page is currently in buffer
+    if (pageNum == state->bufferedVarPage) {
+        state->bufferHits++;
+        return 0;
+    }
+
+    // Get buffer to read into
+    void *buf = (int8_t *)state->buffer + EMBEDDB_VAR_READ_BUFFER(state->parameters) * state->pageSize;
+
+    if (bufferPoolRead(state, state->varFile, pageNum, buf)) {
+        state->bufferedVarPage = pageNum;
         return 0;
     }
 
-    // only flush variable buffer
-    id_t writeResult = writeVariablePage(state, (int8_t *)state->buffer + EMBEDDB_VAR_WRITE_BUFFER(state->parameters) * state->pageSize);
-    if (writeResult == -1) {
-#ifdef PRINT_ERRORS
-        printf("Failed to write variable data page during embedDBFlushVar.");
-#endif
+    // Read in one page worth of data
+    if (state->fileInterface->read(buf, pageNum, state->pageSize, state->varFile) == 0) {
         return -1;
     }
 
-    state->fileInterface->flush(state->varFile);
-    // init new buffer
-    initBufferPage(state, EMBEDDB_VAR_WRITE_BUFFER(state->parameters));
-    // determine how many bytes are left
-    int temp = state->pageSize - (state->currentVarLoc % state->pageSize);
-    // create new offset
-    state->currentVarLoc += temp + state->variableDataHeaderSize;
+    // Track stats
+    state->numReads++;
+    state->bufferedVarPage = pageNum;
+    bufferPoolInsert(state, state->varFile, pageNum, buf);
     return 0;
 }
 
 /**
- * @brief	Flushes output buffer.
- * @param	state	algorithm state structure
- * @returns 0 if successul and a non-zero value otherwise
+ * @brief	Allocates the buffer pool. Its pages are allocated separately from state->buffer.
+ * @param	state	embedDB state structure
+ * @return	Return 0 if success. Non-zero value if error.
  */
-int8_t embedDBFlush(embedDBState *state) {
-    // As the first buffer is the data write buffer, no address change is required
-    int8_t *buffer = (int8_t *)state->buffer + EMBEDDB_DATA_WRITE_BUFFER * state->pageSize;
-    if (EMBEDDB_GET_COUNT(buffer) < 1)
-        return 0;
-
-    id_t pageNum = writePage(state, buffer);
-    if (pageNum == -1) {
+int8_t embedDBInitBufferPool(embedDBState *state) {
+    if (state->bufferPoolSizeInPages == 0 || state->bufferPoolSizeInPages > INT32_MAX) {
 #ifdef PRINT_ERRORS
-        printf("Failed to write page during embedDBFlush.");
+        printf("ERROR: The buffer pool must have between 1 and %li pages.\n", (long)INT32_MAX);
 #endif
         return -1;
     }
 
-    state->fileInterface->flush(state->dataFile);
-
-    indexPage(state, pageNum);
-
-    if (EMBEDDB_USING_INDEX(state->parameters)) {
-        void *buf = (int8_t *)state->buffer + state->pageSize * (EMBEDDB_INDEX_WRITE_BUFFER);
-        count_t idxcount = EMBEDDB_GET_COUNT(buf);
-        EMBEDDB_INC_COUNT(buf);
-
-        /* Copy record onto index page */
-        void *bm = EMBEDDB_GET_BITMAP(state->buffer);
-        memcpy((void *)((int8_t *)buf + EMBEDDB_IDX_HEADER_SIZE + state->bitmapSize * idxcount), bm, state->bitmapSize);
-
-        id_t writeResult = writeIndexPage(state, buf);
-        if (writeResult == -1) {
+    embedDBBufferPool *pool = (embedDBBufferPool *)malloc(sizeof(embedDBBufferPool));
+    if (pool == NULL) {
 #ifdef PRINT_ERRORS
-            printf("Failed to write index page during embedDBFlush.");
+        printf("ERROR: Unable to allocate the buffer pool.\n");
 #endif
-            return -1;
-        }
-
-        state->fileInterface->flush(state->indexFile);
-
-        /* Reinitialize buffer */
-        initBufferPage(state, EMBEDDB_INDEX_WRITE_BUFFER);
+        return -1;
     }
 
-    /* Reinitialize buffer */
-    initBufferPage(state, EMBEDDB_DATA_WRITE_BUFFER);
-
-    // Flush var data page
-    if (EMBEDDB_USING_VDATA(state->parameters)) {
-        int8_t varFlushResult = embedDBFlushVar(state);
-        if (varFlushResult != 0) {
+    /* At least as many buckets as frames keeps the buckets short */
+    pool->numBuckets = 1;
+    while (pool->numBuckets < state->bufferPoolSizeInPages && pool->numBuckets < (UINT32_MAX >> 1) + 1) {
+        pool->numBuckets <<= 1;
+    }
+    pool->pages = malloc((size_t)state->bufferPoolSizeInPages * state->pageSize);
+    pool->frames = (embedDBBufferPoolFrame *)malloc((size_t)state->bufferPoolSizeInPages * sizeof(embedDBBufferPoolFrame));
+    pool->buckets = (int32_t *)malloc((size_t)pool->numBuckets * sizeof(int32_t));
+    if (pool->pages == NULL || pool->frames == NULL || pool->buckets == NULL) {
 #ifdef PRINT_ERRORS
-            printf("Failed to flush variable data page");
+        printf("ERROR: Unable to allocate %lu pages for the buffer pool.\n", (unsigned long)state->bufferPoolSizeInPages);
 #endif
-            return -1;
-        }
+        free(pool->pages);
+        free(pool->frames);
+        free(pool->buckets);
+        free(pool);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < state->bufferPoolSizeInPages; i++) {
+        pool->frames[i].file = NULL;
+        pool->frames[i].next = -1;
+        pool->frames[i].referenced = 0;
+    }
+    for (uint32_t i = 0; i < pool->numBuckets; i++) {
+        pool->buckets[i] = -1;
     }
+    pool->clockHand = 0;
+    state->bufferPool = pool;
     return 0;
 }
 
 /**
- * @brief	Return next key, data pair for iterator.
- * @param	state	embedDB algorithm state structure
- * @param	it		embedDB iterator state structure
- * @param	key		Return variable for key (Pre-allocated)
- * @param	data	Return variable for data (Pre-allocated)
- * @return	1 if successful, 0 if no more records
+ * @brief	Frees the buffer pool.
+ * @param	state	embedDB state structure
  */
-int8_t embedDBNext(embedDBState *state, embedDBIterator *it, void *key, void *data) {
-    int searchWriteBuf = 0;
-    while (1) {
-        if (it->nextDataPage > state->nextDataPageId) {
-            return 0;
-        }
-        if (it->nextDataPage == state->nextDataPageId) {
-            searchWriteBuf = 1;
-        }
-
-        // If we are just starting to read a new page and we have a query bitmap
-        if (it->nextDataRec == 0 && it->queryBitmap != NULL) {
-            // Find what index page determines if we should read the data page
-            uint32_t indexPage = it->nextDataPage / state->maxIdxRecordsPerPage;
-            uint16_t indexRec = it->nextDataPage % state->maxIdxRecordsPerPage;
+void embedDBCloseBufferPool(embedDBState *state) {
+    embedDBBufferPool *pool = (embedDBBufferPool *)state->bufferPool;
+    if (pool == NULL)
+        return;
+
+    free(pool->pages);
+    free(pool->frames);
+    free(pool->buckets);
+    free(pool);
+    state->bufferPool = NULL;
+}
 
-            if (state->indexFile != NULL && indexPage >= state->minIndexPageId && indexPage < state->nextIdxPageId) {
-                // If the index page that contains this data page exists, else we must read the data page regardless cause we don't have the index saved for it
+/**
+ * @brief	Returns the hash bucket that a page of a file belongs in.
+ */
+uint32_t bufferPoolBucket(embedDBBufferPool *pool, void *file, id_t pageNum) {
+    uint32_t hash = pageNum * 2654435761u ^ (uint32_t)((uintptr_t)file >> 4) * 40503u;
+    return hash & (pool->numBuckets - 1);
+}
 
-                if (readIndexPage(state, indexPage % state->numIndexPages) != 0) {
-#ifdef PRINT_ERRORS
-                    printf("ERROR: Failed to read index page %i (%i)\n", indexPage, indexPage % state->numIndexPages);
-#endif
-                    return 0;
-                }
+/**
+ * @brief	Returns the frame holding a page of a file, or -1 if the page is not in the buffer pool.
+ */
+int32_t bufferPoolFind(embedDBBufferPool *pool, void *file, id_t pageNum) {
+    int32_t frame = pool->buckets[bufferPoolBucket(pool, file, pageNum)];
+    while (frame != -1 && (pool->frames[frame].file != file || pool->frames[frame].pageNum != pageNum)) {
+        frame = pool->frames[frame].next;
+    }
+    return frame;
+}
 
-                // Get bitmap for data page in question
-                void *indexBM = (int8_t *)state->buffer + EMBEDDB_INDEX_READ_BUFFER * state->pageSize + EMBEDDB_IDX_HEADER_SIZE + indexRec * state->bitmapSize;
+/**
+ * @brief	Removes the page in a frame from its hash bucket and marks the frame empty.
+ */
+void bufferPoolRemove(embedDBBufferPool *pool, int32_t frame) {
+    int32_t *link = &pool->buckets[bufferPoolBucket(pool, pool->frames[frame].file, pool->frames[frame].pageNum)];
+    while (*link != frame) {
+        link = &pool->frames[*link].next;
+    }
+    *link = pool->frames[frame].next;
+    pool->frames[frame].file = NULL;
+    pool->frames[frame].next = -1;
+    pool->frames[frame].referenced = 0;
+}
 
-                // Determine if we should read the data page
-                if (!bitmapOverlap(it->queryBitmap, indexBM, state->bitmapSize)) {
-                    // Do not read this data page, try the next one
-                    it->nextDataPage++;
-                    continue;
-                }
-            }
-        }
+/**
+ * @brief	Copies a page from the buffer pool if it is cached there.
+ * @param	state	embedDB state structure
+ * @param	file	File the page belongs to
+ * @param	pageNum	Physical page number
+ * @param	buffer	Buffer to copy the page into
+ * @return	Return 1 if the page was in the buffer pool, 0 if it has to be read from storage.
+ */
+int8_t bufferPoolRead(embedDBState *state, void *file, id_t pageNum, void *buffer) {
+    embedDBBufferPool *pool = (embedDBBufferPool *)state->bufferPool;
+    if (pool == NULL)
+        return 0;
 
-        if (searchWriteBuf == 0 && readPage(state, it->nextDataPage % state->numDataPages) != 0) {
-#ifdef PRINT_ERRORS
-            printf("ERROR: Failed to read data page %i (%i)\n", it->nextDataPage, it->nextDataPage % state->numDataPages);
-#endif
-            return 0;
-        }
+    int32_t frame = bufferPoolFind(pool, file, pageNum);
+    if (frame == -1) {
+        state->bufferPoolMisses++;
+        return 0;
+    }
 
-        // Keep reading record until we find one that matches the query
-        int8_t *buf = searchWriteBuf == 0 ? (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize : (int8_t *)state->buffer + EMBEDDB_DATA_WRITE_BUFFER * state->pageSize;
-        uint32_t pageRecordCount = EMBEDDB_GET_COUNT(buf);
-        while (it->nextDataRec < pageRecordCount) {
-            // Get record
-            memcpy(key, buf + state->headerSize + it->nextDataRec * state->recordSize, state->keySize);
-            memcpy(data, buf + state->headerSize + it->nextDataRec * state->recordSize + state->keySize, state->dataSize);
-            it->nextDataRec++;
+    memcpy(buffer, (int8_t *)pool->pages + (size_t)frame * state->pageSize, state->pageSize);
+    pool->frames[frame].referenced = 1;
+    state->bufferPoolHits++;
+    return 1;
+}
 
-            // Check record
-            if (it->minKey != NULL && state->compareKey(key, it->minKey) < 0)
-                continue;
-            if (it->maxKey != NULL && state->compareKey(key, it->maxKey) > 0)
-                return 0;
-            if (it->minData != NULL && state->compareData(data, it->minData) < 0)
-                continue;
-            if (it->maxData != NULL && state->compareData(data, it->maxData) > 0)
-                continue;
+/**
+ * @brief	Adds a page just read from storage to the buffer pool. The clock hand skips over recently used pages to pick the frame to replace.
+ * @param	state	embedDB state structure
+ * @param	file	File the page belongs to
+ * @param	pageNum	Physical page number
+ * @param	buffer	Contents of the page
+ */
+void bufferPoolInsert(embedDBState *state, void *file, id_t pageNum, void *buffer) {
+    embedDBBufferPool *pool = (embedDBBufferPool *)state->bufferPool;
+    if (pool == NULL)
+        return;
+
+    while (pool->frames[pool->clockHand].file != NULL && pool->frames[pool->clockHand].referenced) {
+        pool->frames[pool->clockHand].referenced = 0;
+        pool->clockHand = (pool->clockHand + 1) % state->bufferPoolSizeInPages;
+    }
 
-            // If we make it here, the record matches the query
-            return 1;
-        }
+    int32_t frame = (int32_t)pool->clockHand;
+    pool->clockHand = (pool->clockHand + 1) % state->bufferPoolSizeInPages;
+    if (pool->frames[frame].file != NULL) {
+        bufferPoolRemove(pool, frame);
+    }
 
-        // Finished reading through whole data page and didn't find a match
-        it->nextDataPage++;
-        it->nextDataRec = 0;
+    uint32_t bucket = bufferPoolBucket(pool, file, pageNum);
+    pool->frames[frame].file = file;
+    pool->frames[frame].pageNum = pageNum;
+    pool->frames[frame].referenced = 1;
+    pool->frames[frame].next = pool->buckets[bucket];
+    pool->buckets[bucket] = frame;
+    memcpy((int8_t *)pool->pages + (size_t)frame * state->pageSize, buffer, state->pageSize);
+}
 
-        // Try next data page by looping back to top
+/**
+ * @brief	Drops pages of a file from the buffer pool before they are written or erased.
+ * @param	state			embedDB state structure
+ * @param	file			File the pages belong to
+ * @param	firstPageNum	First physical page number
+ * @param	numPages		Number of pages
+ */
+void bufferPoolInvalidate(embedDBState *state, void *file, id_t firstPageNum, uint32_t numPages) {
+    embedDBBufferPool *pool = (embedDBBufferPool *)state->bufferPool;
+    if (pool == NULL)
+        return;
+
+    for (uint32_t i = 0; i < numPages; i++) {
+        int32_t frame = bufferPoolFind(pool, file, firstPageNum + i);
+        if (frame != -1) {
+            bufferPoolRemove(pool, frame);
+        }
     }
 }
 
 /**
- * @brief	Return next key, data, variable data set for iterator
- * @param	state	embedDB algorithm state structure
- * @param	it		embedDB iterator state structure
- * @param	key		Return variable for key (Pre-allocated)
- * @param	data	Return variable for data (Pre-allocated)
- * @param	varData	Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream after you are done with it**
- * @return	1 if successful, 0 if no more records
+ * @brief	Allocates the fence key directory. It starts empty, at the next data page to be written.
+ * @param	state	embedDB state structure
+ * @return	Return 0 if success. Non-zero value if error.
  */
-int8_t embedDBNextVar(embedDBState *state, embedDBIterator *it, void *key, void *data, embedDBVarDataStream **varData) {
-    if (!EMBEDDB_USING_VDATA(state->parameters)) {
+int8_t embedDBInitFenceKeys(embedDBState *state) {
+    embedDBFenceKeys *fenceKeys = (embedDBFenceKeys *)malloc(sizeof(embedDBFenceKeys));
+    if (fenceKeys == NULL) {
 #ifdef PRINT_ERRORS
-        printf("ERROR: embedDBNextVar called when not using variable data\n");
+        printf("ERROR: Unable to allocate the fence key directory.\n");
 #endif
-        return 0;
+        return -1;
     }
 
-    // ensure record exists
-    int8_t r = embedDBNext(state, it, key, data);
-    if (!r) {
-        return 0;
+    /* The pages in the data file can start part way through a group and end part way through another */
+    fenceKeys->numGroups = state->numDataPages / EMBEDDB_FENCE_KEY_GROUP_SIZE + 2;
+    fenceKeys->groupKeys = (uint64_t *)malloc((size_t)fenceKeys->numGroups * sizeof(uint64_t));
+    fenceKeys->deltas = (uint32_t *)malloc((size_t)state->numDataPages * sizeof(uint32_t));
+    if (fenceKeys->groupKeys == NULL || fenceKeys->deltas == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to allocate the fence key directory for %lu data pages.\n", (unsigned long)state->numDataPages);
+#endif
+        free(fenceKeys->groupKeys);
+        free(fenceKeys->deltas);
+        free(fenceKeys);
+        return -1;
     }
 
-    void *outputBuffer = (int8_t *)state->buffer;
-    if (it->nextDataPage == 0 && (EMBEDDB_GET_COUNT(outputBuffer) > 0)) {
-        readToWriteBuf(state);
-        embedDBFlushVar(state);
+    fenceKeys->firstPageId = state->nextDataPageId;
+    state->fenceKeys = fenceKeys;
+    return 0;
+}
+
+/**
+ * @brief	Frees the fence key directory.
+ * @param	state	embedDB state structure
+ */
+void embedDBCloseFenceKeys(embedDBState *state) {
+    embedDBFenceKeys *fenceKeys = (embedDBFenceKeys *)state->fenceKeys;
+    if (fenceKeys == NULL)
+        return;
+
+    free(fenceKeys->groupKeys);
+    free(fenceKeys->deltas);
+    free(fenceKeys);
+    state->fenceKeys = NULL;
+}
+
+/**
+ * @brief	Adds the smallest key of a data page that was just written to the fence key directory.
+ * @param	state	embedDB state structure
+ * @param	pageNum	Logical page id of the page
+ * @param	buffer	Buffer holding the page
+ */
+void fenceKeysAddPage(embedDBState *state, id_t pageNum, void *buffer) {
+    embedDBFenceKeys *fenceKeys = (embedDBFenceKeys *)state->fenceKeys;
+    if (fenceKeys == NULL)
+        return;
+
+    uint64_t minKey = 0;
+    memcpy(&minKey, embedDBGetMinKey(state, buffer), state->keySize);
+    uint64_t *groupKey = &fenceKeys->groupKeys[pageNum / EMBEDDB_FENCE_KEY_GROUP_SIZE % fenceKeys->numGroups];
+    if (pageNum % EMBEDDB_FENCE_KEY_GROUP_SIZE == 0 || pageNum == fenceKeys->firstPageId) {
+        *groupKey = minKey;
     }
 
-    // Get the vardata address from the record
-    count_t recordNum = it->nextDataRec - 1;
-    int8_t setupResult = embedDBSetupVarDataStream(state, key, varData, recordNum);
-    switch (setupResult) {
-        case 0:
-        case 1:
-            return 1;
-        case 2:
-        case 3:
-            return 0;
+    /* Keys too far apart to store as a difference restart the directory at this page */
+    if (minKey - *groupKey > UINT32_MAX) {
+        fenceKeys->firstPageId = pageNum;
+        *groupKey = minKey;
     }
+    fenceKeys->deltas[pageNum % state->numDataPages] = (uint32_t)(minKey - *groupKey);
+}
 
-    return 0;
+/**
+ * @brief	Returns the smallest key of a data page in the fence key directory.
+ */
+uint64_t fenceKeysGetKey(embedDBState *state, embedDBFenceKeys *fenceKeys, id_t pageNum) {
+    return fenceKeys->groupKeys[pageNum / EMBEDDB_FENCE_KEY_GROUP_SIZE % fenceKeys->numGroups] + fenceKeys->deltas[pageNum % state->numDataPages];
 }
 
 /**
- * @brief Setup varDataStream object to return the variable data for a record
- * @param	state	embedDB algorithm state structure
- * @param   key     Key for the record
- * @param   varData Return variable for variable data as a embedDBVarDataStream (Unallocated). Returns NULL if no variable data. **Be sure to free the stream after you are done with it**
- * @return  Returns 0 if sucessfull or no variable data for the record, 1 if the records variable data was overwritten, 2 if the page failed to read, and 3 if the memorey failed to allocate.
+ * @brief	Finds the only data page that can contain a key with a binary search of the fence key directory.
+ * @param	state	embedDB state structure
+ * @param	key		Key to search for
+ * @param	pageNum	Return variable for the logical id of the data page
+ * @return	Return 0 if the page was found. 1 if the key is smaller than every key in the data file.
+ *          -1 if the directory is not used or does not cover the pages the key could be on.
  */
-int8_t embedDBSetupVarDataStream(embedDBState *state, void *key, embedDBVarDataStream **varData, id_t recordNumber) {
-    void *dataBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
-    void *record = (int8_t *)dataBuf + state->headerSize + recordNumber * state->recordSize;
+int8_t fenceKeysSearch(embedDBState *state, void *key, id_t *pageNum) {
+    embedDBFenceKeys *fenceKeys = (embedDBFenceKeys *)state->fenceKeys;
+    if (fenceKeys == NULL)
+        return -1;
 
-    uint32_t varDataAddr = 0;
-    memcpy(&varDataAddr, (int8_t *)record + state->keySize + state->dataSize, sizeof(uint32_t));
-    if (varDataAddr == EMBEDDB_NO_VAR_DATA) {
-        *varData = NULL;
-        return 0;
-    }
+    /* Pages before minDataPageId have been erased */
+    id_t first = fenceKeys->firstPageId > state->minDataPageId ? fenceKeys->firstPageId : state->minDataPageId;
+    if (first >= state->nextDataPageId)
+        return -1;
 
-    // Check if the variable data associated with this key has been overwritten due to file wrap around
-    if (state->compareKey(key, &state->minVarRecordId) < 0) {
-        *varData = NULL;
-        return 1;
+    uint64_t thisKey = 0;
+    memcpy(&thisKey, key, state->keySize);
+    if (thisKey < fenceKeysGetKey(state, fenceKeys, first))
+        return first == state->minDataPageId ? 1 : -1;
+
+    /* Find the last page with a smallest key not larger than the key */
+    id_t last = state->nextDataPageId - 1;
+    while (first < last) {
+        id_t middle = first + (last - first + 1) / 2;
+        if (fenceKeysGetKey(state, fenceKeys, middle) <= thisKey) {
+            first = middle;
+        } else {
+            last = middle - 1;
+        }
     }
+    *pageNum = first;
+    return 0;
+}
 
-    uint32_t pageNum = (varDataAddr / state->pageSize) % state->numVarPages;
+/**
+ * @brief	Allocates the zone map. It starts empty, at the next data page to be written.
+ * @param	state	embedDB state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitZoneMap(embedDBState *state) {
+    embedDBZoneMap *zoneMap = (embedDBZoneMap *)malloc(sizeof(embedDBZoneMap));
+    if (zoneMap == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to allocate the zone map.\n");
+#endif
+        return -1;
+    }
 
-    // Read in page
-    if (readVariablePage(state, pageNum) != 0) {
+    zoneMap->ranges = malloc((size_t)state->numDataPages * state->dataSize * 2);
+    if (zoneMap->ranges == NULL) {
 #ifdef PRINT_ERRORS
-        printf("ERROR: embedDB failed to read variable page\n");
+        printf("ERROR: Unable to allocate the zone map for %lu data pages.\n", (unsigned long)state->numDataPages);
 #endif
-        return 2;
+        free(zoneMap);
+        return -1;
     }
 
-    // Get length of variable data
-    void *varBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
-    uint32_t pageOffset = varDataAddr % state->pageSize;
-    uint32_t dataLen = 0;
-    memcpy(&dataLen, (int8_t *)varBuf + pageOffset, sizeof(uint32_t));
+    zoneMap->firstPageId = state->nextDataPageId;
+    state->zoneMap = zoneMap;
+    return 0;
+}
 
-    // Move var data address to the beginning of the data, past the data length
-    varDataAddr = (varDataAddr + sizeof(uint32_t)) % (state->numVarPages * state->pageSize);
+/**
+ * @brief	Frees the zone map.
+ * @param	state	embedDB state structure
+ */
+void embedDBCloseZoneMap(embedDBState *state) {
+    embedDBZoneMap *zoneMap = (embedDBZoneMap *)state->zoneMap;
+    if (zoneMap == NULL)
+        return;
+
+    free(zoneMap->ranges);
+    free(zoneMap);
+    state->zoneMap = NULL;
+}
 
-    // If we end up on the page boundary, we need to move past the header
-    if (varDataAddr % state->pageSize == 0) {
-        varDataAddr += state->variableDataHeaderSize;
-        varDataAddr %= (state->numVarPages * state->pageSize);
-    }
+/**
+ * @brief	Copies the data range from the header of a data page that was just written to the zone map.
+ * @param	state	embedDB state structure
+ * @param	pageNum	Logical page id of the page
+ * @param	buffer	Buffer holding the page
+ */
+void zoneMapAddPage(embedDBState *state, id_t pageNum, void *buffer) {
+    embedDBZoneMap *zoneMap = (embedDBZoneMap *)state->zoneMap;
+    if (zoneMap == NULL)
+        return;
+
+    int8_t *range = (int8_t *)zoneMap->ranges + (size_t)(pageNum % state->numDataPages) * state->dataSize * 2;
+    memcpy(range, EMBEDDB_GET_MIN_DATA(buffer, state), state->dataSize);
+    memcpy(range + state->dataSize, EMBEDDB_GET_MAX_DATA(buffer, state), state->dataSize);
+}
 
-    // Create varDataStream
-    embedDBVarDataStream *varDataStream = malloc(sizeof(embedDBVarDataStream));
-    if (varDataStream == NULL) {
-#ifdef PRINT_ERRORS
-        printf("ERROR: Failed to alloc memory for embedDBVarDataStream\n");
-#endif
-        return 3;
-    }
+/**
+ * @brief	Checks the zone map for whether a data page may have data in a range.
+ * @param	state	embedDB state structure
+ * @param	pageNum	Logical page id of the page
+ * @param	minData	Smallest data value in the range. NULL if there is no lower bound.
+ * @param	maxData	Largest data value in the range. NULL if there is no upper bound.
+ * @return	0 if the page has no data in the range. 1 if it may, including when the page is not in the zone map.
+ */
+int8_t zoneMapOverlaps(embedDBState *state, id_t pageNum, void *minData, void *maxData) {
+    embedDBZoneMap *zoneMap = (embedDBZoneMap *)state->zoneMap;
+    if (zoneMap == NULL || pageNum < zoneMap->firstPageId || pageNum < state->minDataPageId || pageNum >= state->nextDataPageId)
+        return 1;
 
-    varDataStream->dataStart = varDataAddr;
-    varDataStream->totalBytes = dataLen;
-    varDataStream->bytesRead = 0;
-    varDataStream->fileOffset = varDataAddr;
+    int8_t *range = (int8_t *)zoneMap->ranges + (size_t)(pageNum % state->numDataPages) * state->dataSize * 2;
+    return dataRangeOverlaps(state, range, range + state->dataSize, minData, maxData);
+}
 
-    *varData = varDataStream;
-    return 0;
+/**
+ * @brief	Checks whether the data values of a page overlap a range.
+ * @param	state		embedDB state structure
+ * @param	pageMinData	Smallest data value on the page
+ * @param	pageMaxData	Largest data value on the page
+ * @param	minData		Smallest data value in the range. NULL if there is no lower bound.
+ * @param	maxData		Largest data value in the range. NULL if there is no upper bound.
+ * @return	1 if they overlap, 0 otherwise
+ */
+int8_t dataRangeOverlaps(embedDBState *state, void *pageMinData, void *pageMaxData, void *minData, void *maxData) {
+    if (minData != NULL && state->compareData(pageMaxData, minData) < 0)
+        return 0;
+    if (maxData != NULL && state->compareData(pageMinData, maxData) > 0)
+        return 0;
+    return 1;
 }
 
 /**
- * @brief	Reads data from variable data stream into the given buffer.
- * @param	state	embedDB algorithm state structure
- * @param	stream	Variable data stream
- * @param	buffer	Buffer to read data into
- * @param	length	Number of bytes to read (Must be <= buffer size)
- * @return	Number of bytes read
+ * @brief	Checks the settings for compressed data pages.
+ * @param	state	embedDB state structure
+ * @return	Return 0 if success. Non-zero value if error.
  */
-uint32_t embedDBVarDataStreamRead(embedDBState *state, embedDBVarDataStream *stream, void *buffer, uint32_t length) {
-    if (buffer == NULL) {
+int8_t embedDBInitCompression(embedDBState *state) {
+    if (state->keySize > 8) {
 #ifdef PRINT_ERRORS
-        printf("ERROR: Cannot pass null buffer to embedDBVarDataStreamRead\n");
+        printf("ERROR: EMBEDDB_USE_COMPRESSION requires a key size of at most 8 bytes.\n");
 #endif
-        return 0;
+        return -1;
     }
-
-    // Read in var page containing the data to read
-    uint32_t pageNum = (stream->fileOffset / state->pageSize) % state->numVarPages;
-    if (readVariablePage(state, pageNum) != 0) {
+    if (EMBEDDB_USING_VDATA(state->parameters) || EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) || EMBEDDB_USING_BACKGROUND_WRITER(state->parameters)) {
 #ifdef PRINT_ERRORS
-        printf("ERROR: Couldn't read variable data page %d\n", pageNum);
+        printf("ERROR: EMBEDDB_USE_COMPRESSION can not be used with variable data, record-level consistency or the background writer.\n");
 #endif
-        return 0;
+        return -1;
     }
-
-    // Keep reading in data until the buffer is full
-    void *varDataBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
-    uint32_t amtRead = 0;
-    while (amtRead < length && stream->bytesRead < stream->totalBytes) {
-        uint16_t pageOffset = stream->fileOffset % state->pageSize;
-        uint32_t amtToRead = min(stream->totalBytes - stream->bytesRead, min(state->pageSize - pageOffset, length - amtRead));
-        memcpy((int8_t *)buffer + amtRead, (int8_t *)varDataBuf + pageOffset, amtToRead);
-        amtRead += amtToRead;
-        stream->bytesRead += amtToRead;
-        stream->fileOffset += amtToRead;
-
-        // If we need to keep reading, read the next page
-        if (amtRead < length && stream->bytesRead < stream->totalBytes) {
-            pageNum = (pageNum + 1) % state->numVarPages;
-            if (readVariablePage(state, pageNum) != 0) {
+    if (state->compressedPageSize > state->pageSize || state->compressedPageSize < state->headerSize + state->recordSize) {
 #ifdef PRINT_ERRORS
-                printf("ERROR: Couldn't read variable data page %d\n", pageNum);
+        printf("ERROR: The compressed page size must be at most the page size and hold the page header and a record.\n");
 #endif
-                return 0;
-            }
-            // Skip past the header
-            stream->fileOffset += state->variableDataHeaderSize;
-        }
+        return -1;
     }
-
-    return amtRead;
+    if (state->bufferSizeInBlocks < EMBEDDB_COMPRESSION_BUFFER(state->parameters) + 1) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: EMBEDDB_USE_COMPRESSION requires %d page buffers.\n", EMBEDDB_COMPRESSION_BUFFER(state->parameters) + 1);
+#endif
+        return -1;
+    }
+    state->compressedPageBytes = 0;
+    return 0;
 }
 
 /**
- * @brief	Prints statistics.
+ * @brief	Returns the size of the pages in the data file.
  * @param	state	embedDB state structure
+ * @return	compressedPageSize when using EMBEDDB_USE_COMPRESSION or EMBEDDB_USE_KEY_OFFSETS, otherwise pageSize
  */
-void embedDBPrintStats(embedDBState *state) {
-    printf("Num reads: %d\n", state->numReads);
-    printf("Buffer hits: %d\n", state->bufferHits);
-    printf("Num writes: %d\n", state->numWrites);
-    printf("Num index reads: %d\n", state->numIdxReads);
-    printf("Num index writes: %d\n", state->numIdxWrites);
-    printf("Max Error: %d\n", state->maxError);
+count_t dataFilePageSize(embedDBState *state) {
+    return (state->parameters & EMBEDDB_ENCODED_DATA_PAGES) ? state->compressedPageSize : state->pageSize;
+}
 
-    if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
-        splinePrint(state->spl);
+/**
+ * @brief	Encodes a record of a compressed data page relative to the record before it.
+ * 			The key is stored as the change in the difference between keys, as a zigzag varint. The data is XORed with the
+ * 			data before it, and only the bytes between the unchanged bytes at each end are stored after a count of those bytes.
+ * @param	state			embedDB state structure
+ * @param	out				Buffer for the encoded record. NULL to only count its size
+ * @param	key				Key of the record
+ * @param	data			Data of the record
+ * @param	previousRecord	Record before it on the page
+ * @param	previousDelta	Difference between the keys of the previous record and the record before that. 0 for the second record on a page
+ * @return	Size of the encoded record in bytes
+ */
+uint32_t encodeCompressedRecord(embedDBState *state, uint8_t *out, void *key, void *data, void *previousRecord, uint64_t previousDelta) {
+    uint64_t thisKey = 0, previousKey = 0;
+    memcpy(&thisKey, key, state->keySize);
+    memcpy(&previousKey, previousRecord, state->keySize);
+    int64_t deltaOfDelta = (int64_t)(thisKey - previousKey - previousDelta);
+    uint64_t zigzag = ((uint64_t)deltaOfDelta << 1) ^ (uint64_t)(deltaOfDelta >> 63);
+
+    uint32_t size = 0;
+    do {
+        uint8_t byte = zigzag & 0x7F;
+        zigzag >>= 7;
+        if (out != NULL)
+            out[size] = zigzag != 0 ? (byte | 0x80) : byte;
+        size++;
+    } while (zigzag != 0);
+
+    uint8_t *thisData = (uint8_t *)data, *previousData = (uint8_t *)previousRecord + state->keySize;
+    int8_t dataSize = state->dataSize, lowSame = 0, highSame = 0;
+    while (lowSame < dataSize && thisData[lowSame] == previousData[lowSame])
+        lowSame++;
+    while (lowSame + highSame < dataSize && thisData[dataSize - 1 - highSame] == previousData[dataSize - 1 - highSame])
+        highSame++;
+
+    /* Data of up to 15 bytes has both counts in one byte */
+    if (out != NULL) {
+        if (dataSize <= 15) {
+            out[size] = (uint8_t)(lowSame << 4 | highSame);
+        } else {
+            out[size] = (uint8_t)lowSame;
+            out[size + 1] = (uint8_t)highSame;
+        }
     }
+    size += dataSize <= 15 ? 1 : 2;
+    for (int8_t i = lowSame; i < dataSize - highSame; i++) {
+        if (out != NULL)
+            out[size] = thisData[i] ^ previousData[i];
+        size++;
+    }
+    return size;
 }
 
 /**
- * @brief	Writes page in buffer to storage. Returns page number.
- * @param	state	embedDB algorithm state structure
- * @param	buffer	Buffer for writing out page
- * @return	Return page number if success, -1 if error.
+ * @brief	Returns the difference between the key of a record in a page buffer and the key before it.
+ * @param	state		embedDB state structure
+ * @param	buffer		Buffer holding the page
+ * @param	recordNum	Record number on the page
+ * @return	Difference between the keys. 0 for the first record
  */
-id_t writePage(embedDBState *state, void *buffer) {
-    if (state->dataFile == NULL)
-        return -1;
-
-    /* Always writes to next page number. Returned to user. */
-    id_t pageNum = state->nextDataPageId++;
-    id_t physicalPageNum = pageNum % state->numDataPages;
+uint64_t compressedKeyDelta(embedDBState *state, void *buffer, count_t recordNum) {
+    if (recordNum == 0)
+        return 0;
+    uint64_t thisKey = 0, previousKey = 0;
+    int8_t *record = (int8_t *)buffer + state->headerSize + state->recordSize * recordNum;
+    memcpy(&thisKey, record, state->keySize);
+    memcpy(&previousKey, record - state->recordSize, state->keySize);
+    return thisKey - previousKey;
+}
 
-    /* Setup page number in header */
-    memcpy(buffer, &(pageNum), sizeof(id_t));
+/**
+ * @brief	Compresses a data page for the data file. The header is kept as it is, so the page id, count and data range can be read without decompressing.
+ * 			The first record is stored as it is and the others with encodeCompressedRecord. The rest of the compressed page is zeroed.
+ * @param	state		embedDB state structure
+ * @param	page		Buffer holding the page
+ * @param	compressed	Buffer of compressedPageSize bytes for the compressed page
+ * @return	Size of the compressed page. -1 if it does not fit in compressedPageSize bytes.
+ */
+int32_t compressDataPage(embedDBState *state, void *page, void *compressed) {
+    uint8_t *out = (uint8_t *)compressed;
+    int8_t *records = (int8_t *)page + state->headerSize;
+    count_t count = EMBEDDB_GET_COUNT(page);
+    uint32_t size = state->headerSize;
+    memcpy(out, page, state->headerSize);
+    if (count > 0) {
+        memcpy(out + size, records, state->recordSize);
+        size += state->recordSize;
+    }
 
-    if (state->numAvailDataPages <= 0) {
-        /* Erase pages to make space for new data */
-        int8_t eraseResult = state->fileInterface->erase(physicalPageNum, physicalPageNum + state->eraseSizeInPages, state->pageSize, state->dataFile);
-        if (eraseResult != 1) {
+    for (count_t i = 1; i < count; i++) {
+        int8_t *record = records + state->recordSize * i;
+        uint64_t previousDelta = compressedKeyDelta(state, page, i - 1);
+        uint32_t recordSize = encodeCompressedRecord(state, NULL, record, record + state->keySize, record - state->recordSize, previousDelta);
+        if (size + recordSize > state->compressedPageSize) {
 #ifdef PRINT_ERRORS
-            printf("Failed to erase data page: %i (%i)\n", pageNum, physicalPageNum);
+            printf("ERROR: Data page does not fit in the compressed page size.\n");
 #endif
             return -1;
         }
+        encodeCompressedRecord(state, out + size, record, record + state->keySize, record - state->recordSize, previousDelta);
+        size += recordSize;
+    }
 
-        /* Flag the pages as usable to EmbedDB */
-        state->numAvailDataPages += state->eraseSizeInPages;
-        state->minDataPageId += state->eraseSizeInPages;
+    memset(out + size, 0, state->compressedPageSize - size);
+    return (int32_t)size;
+}
 
-        /* remove any spline points related to these pages */
-        if (!EMBEDDB_DISABLED_SPLINE_CLEAN(state->parameters)) {
-            cleanSpline(state, state->minDataPageId);
+/**
+ * @brief	Decompresses a page from the data file. Pages that were never written or are damaged keep the records that could be decoded,
+ * 			and their count is reduced to match, so the page header can still be checked.
+ * @param	state		embedDB state structure
+ * @param	compressed	Buffer holding the compressed page
+ * @param	page		Buffer for the page
+ */
+void decompressDataPage(embedDBState *state, void *compressed, void *page) {
+    uint8_t *in = (uint8_t *)compressed;
+    int8_t *records = (int8_t *)page + state->headerSize;
+    int8_t dataSize = state->dataSize;
+    uint32_t pos = state->headerSize, end = state->compressedPageSize;
+    memcpy(page, in, state->headerSize);
+
+    count_t count = EMBEDDB_GET_COUNT(page), numDecoded = 0;
+    if (count > state->maxRecordsPerPage)
+        count = state->maxRecordsPerPage;
+    if (count > 0 && pos + state->recordSize <= end) {
+        memcpy(records, in + pos, state->recordSize);
+        pos += state->recordSize;
+        numDecoded = 1;
+    }
+
+    uint64_t previousKey = 0, previousDelta = 0;
+    memcpy(&previousKey, records, state->keySize);
+    while (numDecoded < count) {
+        uint64_t zigzag = 0;
+        uint8_t shift = 0, byte = 0x80;
+        while ((byte & 0x80) && pos < end && shift < 64) {
+            byte = in[pos++];
+            zigzag |= (uint64_t)(byte & 0x7F) << shift;
+            shift += 7;
         }
+        uint8_t controlSize = dataSize <= 15 ? 1 : 2;
+        if ((byte & 0x80) || pos + controlSize > end)
+            break;
+        int8_t lowSame = dataSize <= 15 ? in[pos] >> 4 : (int8_t)in[pos];
+        int8_t highSame = dataSize <= 15 ? in[pos] & 0x0F : (int8_t)in[pos + 1];
+        pos += controlSize;
+        if (lowSame < 0 || highSame < 0 || lowSame + highSame > dataSize || pos + (dataSize - lowSame - highSame) > end)
+            break;
+
+        int64_t deltaOfDelta = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+        previousDelta += (uint64_t)deltaOfDelta;
+        previousKey += previousDelta;
+        int8_t *record = records + state->recordSize * numDecoded;
+        memcpy(record, &previousKey, state->keySize);
+        memcpy(record + state->keySize, record - state->recordSize + state->keySize, dataSize);
+        for (int8_t i = lowSame; i < dataSize - highSame; i++)
+            record[state->keySize + i] ^= in[pos++];
+        numDecoded++;
     }
 
-    /* Seek to page location in file */
-    int32_t val = state->fileInterface->write(buffer, physicalPageNum, state->pageSize, state->dataFile);
-    if (val == 0) {
+    if (numDecoded != EMBEDDB_GET_COUNT(page))
+        *((count_t *)((int8_t *)page + EMBEDDB_COUNT_OFFSET)) = numDecoded;
+}
+
+/**
+ * @brief	Checks the settings for key offsets and limits the records on a page to the number that fit in the data file.
+ * @param	state	embedDB state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitKeyOffsets(embedDBState *state) {
+    if (!EMBEDDB_USING_MAX_MIN(state->parameters)) {
 #ifdef PRINT_ERRORS
-        printf("Failed to write data page: %i (%i)\n", pageNum, physicalPageNum);
+        printf("ERROR: EMBEDDB_USE_KEY_OFFSETS requires EMBEDDB_USE_MAX_MIN, as keys are stored as offsets from the smallest key in the page header.\n");
 #endif
         return -1;
     }
-
-    state->numAvailDataPages--;
-    state->numWrites++;
-
-    return pageNum;
-}
-
-int8_t writeTemporaryPage(embedDBState *state, void *buffer) {
-    if (state->dataFile == NULL) {
+    if (state->keyOffsetSize != 2 && state->keyOffsetSize != 4) {
 #ifdef PRINT_ERRORS
-        printf("The dataFile in embedDBState was null.");
+        printf("ERROR: The key offset size must be 2 or 4 bytes.\n");
 #endif
-        return -3;
+        return -1;
     }
-
-    /* Setup page number in header */
-    /* TODO: Maybe talk to Ramon about optimizing this */
-    memcpy(buffer, &(state->nextDataPageId), sizeof(id_t));
-
-    /* Wrap if needed */
-    state->nextRLCPhysicalPageLocation %= state->numDataPages;
-
-    /* If the nextPhysicalPage wrapped, we need to add the numDataPages to it to properly compare the page numbers below */
-    uint32_t nextPage = state->nextRLCPhysicalPageLocation + (state->nextRLCPhysicalPageLocation < state->rlcPhysicalStartingPage ? state->numDataPages : 0);
-
-    /* if the nextRLC physical page number would be outside the block, we wrap to the start of our record-level consistency blocks */
-    if (nextPage - state->rlcPhysicalStartingPage >= state->eraseSizeInPages * 2) {
-        state->nextRLCPhysicalPageLocation = state->rlcPhysicalStartingPage;
+    if (state->keyOffsetSize >= state->keySize) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: The key offset size must be smaller than the key size.\n");
+#endif
+        return -1;
     }
-
-    /* If in pageNum is second page in block, we erase the other record-level consistency block */
-    if (state->nextRLCPhysicalPageLocation % state->eraseSizeInPages == 1) {
-        uint32_t eraseStartingPage = state->rlcPhysicalStartingPage;
-        count_t blockSize = state->eraseSizeInPages;
-        if (state->nextRLCPhysicalPageLocation == eraseStartingPage + 1) {
-            eraseStartingPage = (eraseStartingPage + blockSize) % state->numDataPages;
-        }
-        uint32_t eraseEndingPage = eraseStartingPage + blockSize;
-
-        int8_t eraseSuccess = state->fileInterface->erase(eraseStartingPage, eraseEndingPage, state->pageSize, state->dataFile);
-        if (!eraseSuccess) {
+    if (EMBEDDB_USING_COMPRESSION(state->parameters) || EMBEDDB_USING_VDATA(state->parameters) || EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters) ||
+        EMBEDDB_USING_BACKGROUND_WRITER(state->parameters)) {
 #ifdef PRINT_ERRORS
-            printf("Failed to erase block starting at physical page %i in the data file.", state->nextRLCPhysicalPageLocation);
-            return -2;
+        printf("ERROR: EMBEDDB_USE_KEY_OFFSETS can not be used with compression, variable data, record-level consistency or the background writer.\n");
 #endif
-        }
+        return -1;
     }
-
-    /* Write temporary page to storage */
-    int8_t writeSuccess = state->fileInterface->write(buffer, state->nextRLCPhysicalPageLocation++, state->pageSize, state->dataFile);
-    if (!writeSuccess) {
+    if (state->compressedPageSize > state->pageSize || state->compressedPageSize < state->headerSize + state->keyOffsetSize + state->dataSize) {
 #ifdef PRINT_ERRORS
-        printf("Failed to write temporary page for record-level-consistency: Logical Page Number %i - Physical Page (%i)\n", state->nextDataPageId, state->nextRLCPhysicalPageLocation - 1);
+        printf("ERROR: The compressed page size must be at most the page size and hold the page header and a record.\n");
+#endif
+        return -1;
+    }
+    if (state->bufferSizeInBlocks < EMBEDDB_COMPRESSION_BUFFER(state->parameters) + 1) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: EMBEDDB_USE_KEY_OFFSETS requires %d page buffers.\n", EMBEDDB_COMPRESSION_BUFFER(state->parameters) + 1);
 #endif
         return -1;
     }
 
+    count_t storedRecordsPerPage = (state->compressedPageSize - state->headerSize) / (state->keyOffsetSize + state->dataSize);
+    if (storedRecordsPerPage < state->maxRecordsPerPage) {
+        state->maxRecordsPerPage = storedRecordsPerPage;
+        state->maxError = storedRecordsPerPage;
+    }
     return 0;
 }
 
 /**
- * @brief	Calculates the number of spline points not in use by embedDB and deletes them
- * @param	state	embedDB algorithm state structure
- * @param	key 	The minimim key embedDB still needs points for
- * @return	Returns the number of points deleted
+ * @brief	Checks if a key can be stored as an offset from the smallest key on a page.
+ * @param	state	embedDB state structure
+ * @param	minKey	Smallest key on the page
+ * @param	key		Key to check. Must not be smaller than minKey
+ * @return	1 if the offset fits in keyOffsetSize bytes, 0 otherwise
  */
-uint32_t cleanSpline(embedDBState *state, uint32_t minPageNumber) {
-    uint32_t numPointsErased = 0;
-    void *nextPoint;
-    uint32_t currentPageNumber = 0;
-    for (size_t i = 0; i < state->spl->count; i++) {
-        nextPoint = splinePointLocation(state->spl, i + 1);
-        memcpy(&currentPageNumber, (int8_t *)nextPoint + state->keySize, sizeof(uint32_t));
-        if (currentPageNumber < minPageNumber) {
-            numPointsErased++;
+int8_t keyOffsetFits(embedDBState *state, void *minKey, void *key) {
+    uint64_t thisKey = 0, pageMinKey = 0;
+    memcpy(&thisKey, key, state->keySize);
+    memcpy(&pageMinKey, minKey, state->keySize);
+    uint64_t offset = thisKey - pageMinKey;
+    if (state->keySize < 8)
+        offset &= ((uint64_t)1 << (state->keySize * 8)) - 1;
+    return offset <= (state->keyOffsetSize == 2 ? UINT16_MAX : UINT32_MAX);
+}
+
+/**
+ * @brief	Encodes a data page for the data file with EMBEDDB_USE_KEY_OFFSETS. The header is kept as it is, followed by the offset of every key from
+ * 			the smallest key in the header, then the data of every record. The rest of the encoded page is zeroed.
+ * @param	state	embedDB state structure
+ * @param	page	Buffer holding the page. Every key must fit with keyOffsetFits
+ * @param	encoded	Buffer of compressedPageSize bytes for the encoded page
+ */
+void encodeKeyOffsetPage(embedDBState *state, void *page, void *encoded) {
+    uint8_t *out = (uint8_t *)encoded;
+    int8_t *records = (int8_t *)page + state->headerSize;
+    count_t count = EMBEDDB_GET_COUNT(page);
+    uint64_t minKey = 0;
+    memcpy(out, page, state->headerSize);
+    memcpy(&minKey, EMBEDDB_GET_MIN_KEY(page), state->keySize);
+
+    uint8_t *offsets = out + state->headerSize;
+    uint8_t *datas = offsets + count * state->keyOffsetSize;
+    for (count_t i = 0; i < count; i++) {
+        int8_t *record = records + state->recordSize * i;
+        uint64_t key = 0;
+        memcpy(&key, record, state->keySize);
+        uint32_t offset = (uint32_t)(key - minKey);
+        if (state->keyOffsetSize == 2) {
+            uint16_t shortOffset = (uint16_t)offset;
+            memcpy(offsets + i * 2, &shortOffset, sizeof(uint16_t));
         } else {
-            break;
+            memcpy(offsets + i * 4, &offset, sizeof(uint32_t));
         }
+        memcpy(datas + state->dataSize * i, record + state->keySize, state->dataSize);
     }
-    if (state->spl->count - numPointsErased < 2)
-        numPointsErased -= 2 - (state->spl->count - numPointsErased);
-    if (numPointsErased <= 0)
-        return 0;
-    splineErase(state->spl, numPointsErased);
-    return numPointsErased;
+
+    uint32_t size = state->headerSize + count * (state->keyOffsetSize + state->dataSize);
+    memset(out + size, 0, state->compressedPageSize - size);
 }
 
 /**
- * @brief	Writes index page in buffer to storage. Returns page number.
- * @param	state	embedDB algorithm state structure
- * @param	buffer	Buffer to use for writing index page
- * @return	Return page number if success, -1 if error.
+ * @brief	Decodes a page from the data file with EMBEDDB_USE_KEY_OFFSETS. A count larger than the page can hold, as on a page that was never written, is reduced to fit.
+ * @param	state	embedDB state structure
+ * @param	encoded	Buffer holding the encoded page
+ * @param	page	Buffer for the page
  */
-id_t writeIndexPage(embedDBState *state, void *buffer) {
-    if (state->indexFile == NULL)
-        return -1;
+void decodeKeyOffsetPage(embedDBState *state, void *encoded, void *page) {
+    uint8_t *in = (uint8_t *)encoded;
+    int8_t *records = (int8_t *)page + state->headerSize;
+    memcpy(page, in, state->headerSize);
+
+    count_t count = EMBEDDB_GET_COUNT(page);
+    if (count > state->maxRecordsPerPage) {
+        count = state->maxRecordsPerPage;
+        *((count_t *)((int8_t *)page + EMBEDDB_COUNT_OFFSET)) = count;
+    }
+    uint64_t minKey = 0;
+    memcpy(&minKey, EMBEDDB_GET_MIN_KEY(page), state->keySize);
+
+    uint8_t *offsets = in + state->headerSize;
+    uint8_t *datas = offsets + count * state->keyOffsetSize;
+    decodeKeyOffsets(offsets, state->keyOffsetSize, minKey, records, state->recordSize, state->keySize, count);
+
+    /* Copies of a constant size are done inline */
+    int8_t *recordData = records + state->keySize;
+    int32_t recordSize = state->recordSize, dataSize = state->dataSize;
+    if (dataSize == 4) {
+        for (count_t i = 0; i < count; i++)
+            memcpy(recordData + recordSize * i, datas + 4 * i, 4);
+    } else if (dataSize == 8) {
+        for (count_t i = 0; i < count; i++)
+            memcpy(recordData + recordSize * i, datas + 8 * i, 8);
+    } else {
+        for (count_t i = 0; i < count; i++)
+            memcpy(recordData + recordSize * i, datas + dataSize * i, dataSize);
+    }
+}
 
-    /* Always writes to next page number. Returned to user. */
-    id_t pageNum = state->nextIdxPageId++;
-    id_t physicalPageNumber = pageNum % state->numIndexPages;
+/**
+ * @brief	Adds key offsets to the smallest key on a page and stores the keys in the records, widening 8 offsets per instruction with AVX2 or 4 with SSE2.
+ * @param	offsets		Key offsets of 2 or 4 bytes
+ * @param	offsetSize	Size of a key offset in bytes
+ * @param	minKey		Smallest key on the page
+ * @param	records		First record on the page
+ * @param	recordSize	Size of a record in bytes
+ * @param	keySize		Size of a key in bytes. Only the low keySize bytes of each sum are stored
+ * @param	count		Number of keys
+ */
+void decodeKeyOffsets(uint8_t *offsets, int8_t offsetSize, uint64_t minKey, int8_t *records, int8_t recordSize, int8_t keySize, count_t count) {
+    count_t i = 0;
+#if defined(EMBEDDB_SIMD_AVX2)
+    if (keySize == 4) {
+        /* Offsets of 4 byte keys are 2 bytes */
+        uint32_t keys[8];
+        __m256i base = _mm256_set1_epi32((int32_t)minKey);
+        for (; i + 8 <= count; i += 8) {
+            __m256i sums = _mm256_add_epi32(_mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *)(offsets + i * 2))), base);
+            _mm256_storeu_si256((__m256i *)keys, sums);
+            for (int8_t j = 0; j < 8; j++)
+                memcpy(records + (i + j) * recordSize, keys + j, sizeof(uint32_t));
+        }
+    } else if (keySize == 8) {
+        uint64_t keys[4];
+        __m256i base = _mm256_set1_epi64x((int64_t)minKey);
+        for (; i + 4 <= count; i += 4) {
+            __m128i packed = offsetSize == 2 ? _mm_loadl_epi64((const __m128i *)(offsets + i * 2)) : _mm_loadu_si128((const __m128i *)(offsets + i * 4));
+            __m256i sums = _mm256_add_epi64(offsetSize == 2 ? _mm256_cvtepu16_epi64(packed) : _mm256_cvtepu32_epi64(packed), base);
+            _mm256_storeu_si256((__m256i *)keys, sums);
+            for (int8_t j = 0; j < 4; j++)
+                memcpy(records + (i + j) * recordSize, keys + j, sizeof(uint64_t));
+        }
+    }
+#elif defined(EMBEDDB_SIMD_SSE2)
+    uint32_t keys[4];
+    if (keySize == 4) {
+        /* Offsets of 4 byte keys are 2 bytes, widened by interleaving them with zeros */
+        __m128i base = _mm_set1_epi32((int32_t)minKey);
+        for (; i + 4 <= count; i += 4) {
+            __m128i widened = _mm_unpacklo_epi16(_mm_loadl_epi64((const __m128i *)(offsets + i * 2)), _mm_setzero_si128());
+            _mm_storeu_si128((__m128i *)keys, _mm_add_epi32(widened, base));
+            for (int8_t j = 0; j < 4; j++)
+                memcpy(records + (i + j) * recordSize, keys + j, sizeof(uint32_t));
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        uint64_t key = minKey;
+        if (offsetSize == 2) {
+            uint16_t offset;
+            memcpy(&offset, offsets + i * 2, sizeof(uint16_t));
+            key += offset;
+        } else {
+            uint32_t offset;
+            memcpy(&offset, offsets + i * 4, sizeof(uint32_t));
+            key += offset;
+        }
+        /* Copies of a constant size are done inline */
+        if (keySize == 8) {
+            memcpy(records + i * recordSize, &key, sizeof(uint64_t));
+        } else if (keySize == 4) {
+            uint32_t shortKey = (uint32_t)key;
+            memcpy(records + i * recordSize, &shortKey, sizeof(uint32_t));
+        } else {
+            memcpy(records + i * recordSize, &key, keySize);
+        }
+    }
+}
 
-    /* Setup page number in header */
-    memcpy(buffer, &(pageNum), sizeof(id_t));
+/**
+ * @brief	Checks the settings for the reorder buffer and allocates it.
+ * @param	state	embedDB state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBInitReorderBuffer(embedDBState *state) {
+    if (state->reorderBufferSize == 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: The reorder buffer must hold at least one record.\n");
+#endif
+        return -1;
+    }
+    if (EMBEDDB_USING_VDATA(state->parameters) || EMBEDDB_USING_RECORD_LEVEL_CONSISTENCY(state->parameters)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: EMBEDDB_USE_REORDER_BUFFER can not be used with variable data or record-level consistency.\n");
+#endif
+        return -1;
+    }
 
-    if (state->numAvailIndexPages <= 0) {
-        // Erase index pages to make room for new page
-        int8_t eraseResult = state->fileInterface->erase(physicalPageNumber, physicalPageNumber + state->eraseSizeInPages, state->pageSize, state->indexFile);
-        if (eraseResult != 1) {
+    embedDBReorderBuffer *reorder = (embedDBReorderBuffer *)malloc(sizeof(embedDBReorderBuffer));
+    if (reorder == NULL) {
 #ifdef PRINT_ERRORS
-            printf("Failed to erase data page: %i (%i)\n", pageNum, physicalPageNumber);
+        printf("ERROR: Unable to allocate the reorder buffer.\n");
 #endif
-            return -1;
-        }
-        state->numAvailIndexPages += state->eraseSizeInPages;
-        state->minIndexPageId += state->eraseSizeInPages;
+        return -1;
     }
 
-    /* Seek to page location in file */
-    int32_t val = state->fileInterface->write(buffer, physicalPageNumber, state->pageSize, state->indexFile);
-    if (val == 0) {
+    reorder->records = malloc((size_t)state->reorderBufferSize * state->recordSize);
+    if (reorder->records == NULL) {
 #ifdef PRINT_ERRORS
-        printf("Failed to write index page: %i (%i)\n", pageNum, physicalPageNumber);
+        printf("ERROR: Unable to allocate the reorder buffer for %u records.\n", (unsigned int)state->reorderBufferSize);
 #endif
+        free(reorder);
         return -1;
     }
 
-    state->numAvailIndexPages--;
-    state->numIdxWrites++;
+    reorder->capacity = state->reorderBufferSize;
+    reorder->start = 0;
+    reorder->count = 0;
+    state->reorderBuffer = reorder;
+    return 0;
+}
 
-    return pageNum;
+/**
+ * @brief	Frees the reorder buffer. Records still in it are not stored.
+ * @param	state	embedDB state structure
+ */
+void embedDBCloseReorderBuffer(embedDBState *state) {
+    embedDBReorderBuffer *reorder = (embedDBReorderBuffer *)state->reorderBuffer;
+    if (reorder == NULL)
+        return;
+
+    free(reorder->records);
+    free(reorder);
+    state->reorderBuffer = NULL;
 }
 
 /**
- * @brief	Writes variable data page in buffer to storage. Returns page number.
- * @param	state	embedDB algorithm state structure
- * @param	buffer	Buffer to use to write page to storage
- * @return	Return page number if success, -1 if error.
+ * @brief	Returns a record of the reorder buffer.
+ * @param	state		embedDB state structure
+ * @param	reorder		Reorder buffer
+ * @param	recordNum	Position of the record in key order. 0 is the record with the smallest key
+ * @return	Pointer to the key of the record, followed by its data
  */
-id_t writeVariablePage(embedDBState *state, void *buffer) {
-    if (state->varFile == NULL) {
-        return -1;
+void *reorderBufferRecord(embedDBState *state, embedDBReorderBuffer *reorder, uint32_t recordNum) {
+    return (int8_t *)reorder->records + (size_t)((reorder->start + recordNum) % reorder->capacity) * state->recordSize;
+}
+
+/**
+ * @brief	Binary searches the reorder buffer for the first record with a key greater than or equal to a key.
+ * @param	state	embedDB state structure
+ * @param	reorder	Reorder buffer
+ * @param	key		Key to search for
+ * @return	Position of the record in key order. reorder->count if every record has a smaller key
+ */
+uint32_t reorderBufferFirstAtLeast(embedDBState *state, embedDBReorderBuffer *reorder, void *key) {
+    uint32_t first = 0, last = reorder->count;
+    while (first < last) {
+        uint32_t middle = first + (last - first) / 2;
+        if (state->compareKey(reorderBufferRecord(state, reorder, middle), key) < 0) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
     }
+    return first;
+}
 
-    // Make sure the address being witten to wraps around
-    id_t physicalPageId = state->nextVarPageId % state->numVarPages;
+/**
+ * @brief	Adds a record to the reorder buffer in key order. When the buffer is full, the record with the smallest key is stored first to make room.
+ * @param	state	embedDB state structure
+ * @param	key		Key for record. Must be larger than every key already stored and not in the reorder buffer
+ * @param	data	Data for record
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t reorderBufferPut(embedDBState *state, void *key, void *data) {
+    embedDBReorderBuffer *reorder = (embedDBReorderBuffer *)state->reorderBuffer;
 
-    // Erase data if needed
-    if (state->numAvailVarPages <= 0) {
-        int8_t eraseResult = state->fileInterface->erase(physicalPageId, physicalPageId + state->eraseSizeInPages, state->pageSize, state->varFile);
-        if (eraseResult != 1) {
+    void *previousKey = previousStoredKey(state);
+    if (previousKey != NULL && state->compareKey(key, previousKey) != 1) {
 #ifdef PRINT_ERRORS
-            printf("Failed to erase data page: %i (%i)\n", state->nextVarPageId, physicalPageId);
+        printf("Key is older than the records already moved out of the reorder buffer. Insert Failed.\n");
 #endif
-            return -1;
-        }
-        state->numAvailVarPages += state->eraseSizeInPages;
-        // Last page that is deleted
-        id_t pageNum = (physicalPageId + state->eraseSizeInPages - 1) % state->numVarPages;
-
-        // Read in that page so we can update which records we still have the data for
-        if (readVariablePage(state, pageNum) != 0) {
-            return -1;
-        }
-        void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters) + sizeof(id_t);
-        memcpy(&state->minVarRecordId, buf, state->keySize);
-        state->minVarRecordId += 1;  // Add one because the result from the last line is a record that is erased
+        return 1;
     }
 
-    // Add logical page number to data page
-    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_WRITE_BUFFER(state->parameters);
-    memcpy(buf, &state->nextVarPageId, sizeof(id_t));
-
-    // Write to file
-    uint32_t val = state->fileInterface->write(buffer, physicalPageId, state->pageSize, state->varFile);
-    if (val == 0) {
-#ifndef PRINT
-        printf("Failed to write vardata page: %i\n", state->nextVarPageId);
+    uint32_t position = reorderBufferFirstAtLeast(state, reorder, key);
+    if (position < reorder->count && state->compareKey(reorderBufferRecord(state, reorder, position), key) == 0) {
+#ifdef PRINT_ERRORS
+        printf("Key is already in the reorder buffer. Insert Failed.\n");
 #endif
-        return -1;
+        return 1;
     }
 
-    state->nextVarPageId++;
-    state->numAvailVarPages--;
-    state->numWrites++;
+    if (reorder->count == reorder->capacity) {
+        /* A record older than everything in the buffer is the next one in order, so it is stored straight away */
+        if (position == 0) {
+            return putOrderedRecord(state, key, data);
+        }
 
-    return state->nextVarPageId - 1;
-}
+        void *oldest = reorderBufferRecord(state, reorder, 0);
+        int8_t putResult = putOrderedRecord(state, oldest, (int8_t *)oldest + state->keySize);
+        if (putResult != 0) {
+            return putResult;
+        }
+        reorder->start = (reorder->start + 1) % reorder->capacity;
+        reorder->count--;
+        position--;
+    }
 
-/**
- * @brief	Memcopies write buffer to the read buffer.
- * @param	state	embedDB algorithm state structure
- */
-void readToWriteBuf(embedDBState *state) {
-    // point to read buffer
-    void *readBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
-    // point to write buffer
-    void *writeBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_WRITE_BUFFER;
-    // copy write buffer to the read buffer.
-    memcpy(readBuf, writeBuf, state->pageSize);
+    /* Records with larger keys move up one place, starting from the newest. The records are contiguous except where the ring wraps around,
+     * so they are moved with at most two memmoves and one record copy. */
+    int8_t *records = (int8_t *)reorder->records;
+    uint32_t slot = (reorder->start + reorder->count) % reorder->capacity;
+    uint32_t numToMove = reorder->count - position;
+    while (numToMove > 0) {
+        if (slot == 0) {
+            memcpy(records, records + (size_t)(reorder->capacity - 1) * state->recordSize, state->recordSize);
+            slot = reorder->capacity - 1;
+            numToMove--;
+            continue;
+        }
+        uint32_t numContiguous = numToMove < slot ? numToMove : slot;
+        memmove(records + (size_t)(slot - numContiguous + 1) * state->recordSize, records + (size_t)(slot - numContiguous) * state->recordSize, (size_t)numContiguous * state->recordSize);
+        slot -= numContiguous;
+        numToMove -= numContiguous;
+    }
+    int8_t *record = records + (size_t)slot * state->recordSize;
+    memcpy(record, key, state->keySize);
+    memcpy(record + state->keySize, data, state->dataSize);
+    reorder->count++;
+    return 0;
 }
 
 /**
- * @brief	Memcopies variable write buffer to the read buffer.
- * @param	state	embedDB algorithm state structure
+ * @brief	Stores every record in the reorder buffer, in key order.
+ * @param	state	embedDB state structure
+ * @return	Return 0 if success. Non-zero value if error. Records that could not be stored stay in the buffer.
  */
-void readToWriteBufVar(embedDBState *state) {
-    // point to read buffer
-    void *readBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_READ_BUFFER(state->parameters);
-    // point to write buffer
-    void *writeBuf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_VAR_WRITE_BUFFER(state->parameters);
-    // copy write buffer to the read buffer.
-    memcpy(readBuf, writeBuf, state->pageSize);
+int8_t reorderBufferDrain(embedDBState *state) {
+    embedDBReorderBuffer *reorder = (embedDBReorderBuffer *)state->reorderBuffer;
+    while (reorder->count > 0) {
+        void *oldest = reorderBufferRecord(state, reorder, 0);
+        int8_t putResult = putOrderedRecord(state, oldest, (int8_t *)oldest + state->keySize);
+        if (putResult != 0) {
+            return putResult;
+        }
+        reorder->start = (reorder->start + 1) % reorder->capacity;
+        reorder->count--;
+    }
+    return 0;
 }
 
 /**
- * @brief	Reads given page from storage.
- * @param	state	embedDB algorithm state structure
- * @param	pageNum	Page number to read
- * @return	Return 0 if success, -1 if error.
+ * @brief	Looks up a key in the reorder buffer.
+ * @param	state	embedDB state structure
+ * @param	key		Key for record
+ * @param	data	Pre-allocated memory to copy data for record
+ * @return	Return 0 if the key was found. -1 if it is not in the reorder buffer.
  */
-int8_t readPage(embedDBState *state, id_t pageNum) {
-    /* Check if page is currently in buffer */
-    if (pageNum == state->bufferedPageId) {
-        state->bufferHits++;
-        return 0;
-    }
-
-    void *buf = (int8_t *)state->buffer + state->pageSize;
-
-    /* Page is not in buffer. Read from storage. */
-    /* Read page into start of buffer 1 */
-    if (0 == state->fileInterface->read(buf, pageNum, state->pageSize, state->dataFile))
+int8_t reorderBufferGet(embedDBState *state, void *key, void *data) {
+    embedDBReorderBuffer *reorder = (embedDBReorderBuffer *)state->reorderBuffer;
+    uint32_t position = reorderBufferFirstAtLeast(state, reorder, key);
+    if (position == reorder->count)
         return -1;
 
-    state->numReads++;
-    state->bufferedPageId = pageNum;
+    int8_t *record = (int8_t *)reorderBufferRecord(state, reorder, position);
+    if (state->compareKey(record, key) != 0)
+        return -1;
+    memcpy(data, record + state->keySize, state->dataSize);
     return 0;
 }
 
 /**
- * @brief	Reads given index page from storage.
+ * @brief	Returns the next record of a forward iterator from the reorder buffer, once the iterator has passed the write buffer.
+ * 			it->nextDataRec is the position of the next record in key order.
  * @param	state	embedDB algorithm state structure
- * @param	pageNum	Page number to read
- * @return	Return 0 if success, -1 if error.
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if no more records
  */
-int8_t readIndexPage(embedDBState *state, id_t pageNum) {
-    /* Check if page is currently in buffer */
-    if (pageNum == state->bufferedIndexPageId) {
-        state->bufferHits++;
-        return 0;
+int8_t iteratorNextBuffered(embedDBState *state, embedDBIterator *it, void *key, void *data) {
+    embedDBReorderBuffer *reorder = (embedDBReorderBuffer *)state->reorderBuffer;
+    if (it->nextDataRec == 0 && it->minKey != NULL) {
+        it->nextDataRec = (uint16_t)reorderBufferFirstAtLeast(state, reorder, it->minKey);
     }
 
-    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER;
-
-    /* Page is not in buffer. Read from storage. */
-    /* Read page into start of buffer */
-    if (0 == state->fileInterface->read(buf, pageNum, state->pageSize, state->indexFile))
-        return -1;
+    while (it->nextDataRec < reorder->count) {
+        int8_t *record = (int8_t *)reorderBufferRecord(state, reorder, it->nextDataRec);
+        memcpy(key, record, state->keySize);
+        memcpy(data, record + state->keySize, state->dataSize);
+        it->nextDataRec++;
 
-    state->numIdxReads++;
-    state->bufferedIndexPageId = pageNum;
+        if (it->maxKey != NULL && state->compareKey(key, it->maxKey) > 0)
+            return 0;
+        if (it->minData != NULL && state->compareData(data, it->minData) < 0)
+            continue;
+        if (it->maxData != NULL && state->compareData(data, it->maxData) > 0)
+            continue;
+        return 1;
+    }
     return 0;
 }
 
 /**
- * @brief	Reads given variable data page from storage
- * @param 	state 	embedDB algorithm state structure
- * @param 	pageNum Page number to read
- * @return 	Return 0 if success, -1 if error
+ * @brief	Returns the next record of a reverse iterator from the reorder buffer, before the iterator moves on to the write buffer.
+ * 			it->nextDataRec counts down from the number of records in range, and 0 means the reorder buffer has not been started yet.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if there are no more records in the reorder buffer. The iterator is then on the write buffer, unless it has reached the min key.
  */
-int8_t readVariablePage(embedDBState *state, id_t pageNum) {
-    // Check if page is currently in buffer
-    if (pageNum == state->bufferedVarPage) {
-        state->bufferHits++;
-        return 0;
+int8_t iteratorPrevBuffered(embedDBState *state, embedDBIterator *it, void *key, void *data) {
+    embedDBReorderBuffer *reorder = (embedDBReorderBuffer *)state->reorderBuffer;
+    if (it->nextDataRec == 0) {
+        it->nextDataRec = (uint16_t)reorder->count;
+        if (it->maxKey != NULL) {
+            uint32_t position = reorderBufferFirstAtLeast(state, reorder, it->maxKey);
+            if (position < reorder->count && state->compareKey(reorderBufferRecord(state, reorder, position), it->maxKey) == 0)
+                position++;
+            it->nextDataRec = (uint16_t)position;
+        }
     }
 
-    // Get buffer to read into
-    void *buf = (int8_t *)state->buffer + EMBEDDB_VAR_READ_BUFFER(state->parameters) * state->pageSize;
+    while (it->nextDataRec > 0) {
+        it->nextDataRec--;
+        int8_t *record = (int8_t *)reorderBufferRecord(state, reorder, it->nextDataRec);
+        memcpy(key, record, state->keySize);
+        memcpy(data, record + state->keySize, state->dataSize);
 
-    // Read in one page worth of data
-    if (state->fileInterface->read(buf, pageNum, state->pageSize, state->varFile) == 0) {
-        return -1;
+        if (it->minKey != NULL && state->compareKey(key, it->minKey) < 0)
+            return 0;
+        if (it->minData != NULL && state->compareData(data, it->minData) < 0)
+            continue;
+        if (it->maxData != NULL && state->compareData(data, it->maxData) > 0)
+            continue;
+
+        // The first record was returned, so the next call starts on the write buffer
+        if (it->nextDataRec == 0)
+            it->nextDataPage = state->nextDataPageId;
+        return 1;
     }
 
-    // Track stats
-    state->numReads++;
-    state->bufferedVarPage = pageNum;
+    it->nextDataPage = state->nextDataPageId;
     return 0;
 }
 
@@ -2332,6 +6247,8 @@ void embedDBResetStats(embedDBState *state) {
     state->bufferHits = 0;
     state->numIdxReads = 0;
     state->numIdxWrites = 0;
+    state->bufferPoolHits = 0;
+    state->bufferPoolMisses = 0;
 }
 
 /**
@@ -2339,6 +6256,8 @@ void embedDBResetStats(embedDBState *state) {
  * @param	state	embedDB state structure
  */
 void embedDBClose(embedDBState *state) {
+    /* Finish any queued page writes before the files are closed */
+    embedDBStopBackgroundWriter(state);
     if (state->dataFile != NULL) {
         state->fileInterface->close(state->dataFile);
     }
@@ -2348,9 +6267,271 @@ void embedDBClose(embedDBState *state) {
     if (state->varFile != NULL) {
         state->fileInterface->close(state->varFile);
     }
+    if (EMBEDDB_USING_CHECKPOINT(state->parameters)) {
+        state->fileInterface->close(state->checkpointFile);
+    }
+    if (EMBEDDB_USING_SPLINE_FILE(state->parameters)) {
+        state->fileInterface->close(state->splineFile);
+        free(state->splinePageBuffer);
+        state->splinePageBuffer = NULL;
+    }
+    embedDBCloseBufferPool(state);
+    embedDBCloseFenceKeys(state);
+    embedDBCloseZoneMap(state);
+    embedDBCloseReorderBuffer(state);
     if (!EMBEDDB_USING_BINARY_SEARCH(state->parameters)) {
         splineClose(state->spl);
         free(state->spl);
         state->spl = NULL;
     }
 }
+
+#if defined(EMBEDDB_THREADS_SUPPORTED)
+
+/* A full page handed off to the background writer */
+typedef struct {
+    void *buffer;          /* Staging copy of the page, so the write buffer can be reused straight away */
+    void *file;            /* File the page is written to */
+    id_t physicalPageNum;  /* Physical page number to write to */
+    uint8_t eraseBlock;    /* 1 if the erase block starting at physicalPageNum must be erased before writing */
+    uint8_t pending;       /* 1 while the page is waiting for or being written by the writer thread */
+} embedDBPendingPage;
+
+typedef struct {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;      /* Signalled whenever a page is queued, a page finishes writing, or the writer is asked to stop */
+    embedDBPendingPage dataPage;
+    embedDBPendingPage indexPage;
+    int8_t error;                /* Set once a background erase or write fails. Reported by every later write, read, and flush */
+    uint8_t stop;
+} embedDBBackgroundWriter;
+
+void *backgroundWriterLoop(void *arg) {
+    embedDBState *state = (embedDBState *)arg;
+    embedDBBackgroundWriter *writer = (embedDBBackgroundWriter *)state->backgroundWriter;
+
+    pthread_mutex_lock(&writer->lock);
+    while (1) {
+        while (!writer->dataPage.pending && !writer->indexPage.pending && !writer->stop)
+            pthread_cond_wait(&writer->changed, &writer->lock);
+
+        /* Queued pages are always drained before stopping */
+        embedDBPendingPage *page = writer->dataPage.pending ? &writer->dataPage : writer->indexPage.pending ? &writer->indexPage
+                                                                                                             : NULL;
+        if (page == NULL)
+            break;
+
+        /* The producer never touches a pending page, so the file I/O can happen without the lock */
+        pthread_mutex_unlock(&writer->lock);
+        int8_t success = 1;
+        if (page->eraseBlock) {
+            success = state->fileInterface->erase(page->physicalPageNum, page->physicalPageNum + state->eraseSizeInPages, state->pageSize, page->file) == 1;
+#ifdef PRINT_ERRORS
+            if (!success)
+                printf("Background writer failed to erase pages starting at physical page %i\n", page->physicalPageNum);
+#endif
+        }
+        if (success) {
+            success = state->fileInterface->write(page->buffer, page->physicalPageNum, state->pageSize, page->file) != 0;
+#ifdef PRINT_ERRORS
+            if (!success)
+                printf("Background writer failed to write physical page %i\n", page->physicalPageNum);
+#endif
+        }
+        pthread_mutex_lock(&writer->lock);
+
+        if (!success)
+            writer->error = 1;
+        page->pending = 0;
+        pthread_cond_broadcast(&writer->changed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return NULL;
+}
+
+/**
+ * @brief	Allocates the staging pages and starts the thread that writes full data and index pages to storage.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBStartBackgroundWriter(embedDBState *state) {
+    embedDBBackgroundWriter *writer = calloc(1, sizeof(embedDBBackgroundWriter));
+    if (writer == NULL) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to allocate the background writer.\n");
+#endif
+        return -1;
+    }
+
+    writer->dataPage.buffer = malloc(state->pageSize);
+    writer->dataPage.file = state->dataFile;
+    writer->indexPage.buffer = EMBEDDB_USING_INDEX(state->parameters) ? malloc(state->pageSize) : NULL;
+    writer->indexPage.file = state->indexFile;
+    if (writer->dataPage.buffer == NULL || (EMBEDDB_USING_INDEX(state->parameters) && writer->indexPage.buffer == NULL)) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to allocate the background writer staging pages.\n");
+#endif
+        free(writer->dataPage.buffer);
+        free(writer->indexPage.buffer);
+        free(writer);
+        return -1;
+    }
+
+    pthread_mutex_init(&writer->lock, NULL);
+    pthread_cond_init(&writer->changed, NULL);
+    state->backgroundWriter = writer;
+
+    if (pthread_create(&writer->thread, NULL, backgroundWriterLoop, state) != 0) {
+#ifdef PRINT_ERRORS
+        printf("ERROR: Unable to start the background writer thread.\n");
+#endif
+        state->backgroundWriter = NULL;
+        pthread_cond_destroy(&writer->changed);
+        pthread_mutex_destroy(&writer->lock);
+        free(writer->dataPage.buffer);
+        free(writer->indexPage.buffer);
+        free(writer);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief	Writes out any queued pages, then stops the background writer thread and frees its memory. Does nothing if it is not running.
+ * @param	state	embedDB algorithm state structure
+ */
+void embedDBStopBackgroundWriter(embedDBState *state) {
+    embedDBBackgroundWriter *writer = (embedDBBackgroundWriter *)state->backgroundWriter;
+    if (writer == NULL)
+        return;
+
+    pthread_mutex_lock(&writer->lock);
+    writer->stop = 1;
+    pthread_cond_broadcast(&writer->changed);
+    pthread_mutex_unlock(&writer->lock);
+    pthread_join(writer->thread, NULL);
+
+    state->backgroundWriter = NULL;
+    pthread_cond_destroy(&writer->changed);
+    pthread_mutex_destroy(&writer->lock);
+    free(writer->dataPage.buffer);
+    free(writer->indexPage.buffer);
+    free(writer);
+}
+
+/**
+ * @brief	Blocks until the background writer has written every queued page to storage.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. -1 if a background erase or write has failed.
+ */
+int8_t embedDBWaitForBackgroundWriter(embedDBState *state) {
+    embedDBBackgroundWriter *writer = (embedDBBackgroundWriter *)state->backgroundWriter;
+    if (writer == NULL)
+        return 0;
+
+    pthread_mutex_lock(&writer->lock);
+    while (writer->dataPage.pending || writer->indexPage.pending)
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    int8_t error = writer->error;
+    pthread_mutex_unlock(&writer->lock);
+    return error ? -1 : 0;
+}
+
+/**
+ * @brief	Copies a full page into a staging page and hands it to the background writer. Only blocks if the previous page for the same file is still being written.
+ * @param	state			embedDB algorithm state structure
+ * @param	file			File to write the page to (state->dataFile or state->indexFile)
+ * @param	buffer			Page to write
+ * @param	physicalPageNum	Physical page number to write to
+ * @param	eraseBlock		1 if the erase block starting at physicalPageNum must be erased first
+ * @return	Return 0 if success. -1 if a background erase or write has failed.
+ */
+int8_t queueBackgroundPageWrite(embedDBState *state, void *file, void *buffer, id_t physicalPageNum, uint8_t eraseBlock) {
+    embedDBBackgroundWriter *writer = (embedDBBackgroundWriter *)state->backgroundWriter;
+    embedDBPendingPage *page = file == writer->dataPage.file ? &writer->dataPage : &writer->indexPage;
+
+    pthread_mutex_lock(&writer->lock);
+    while (page->pending)
+        pthread_cond_wait(&writer->changed, &writer->lock);
+    int8_t error = writer->error;
+    if (!error) {
+        memcpy(page->buffer, buffer, state->pageSize);
+        page->physicalPageNum = physicalPageNum;
+        page->eraseBlock = eraseBlock;
+        page->pending = 1;
+        pthread_cond_broadcast(&writer->changed);
+    }
+    pthread_mutex_unlock(&writer->lock);
+    return error ? -1 : 0;
+}
+
+/**
+ * @brief	Makes a file safe to read from the calling thread. If the requested page is still queued it is copied straight from the staging page,
+ *          otherwise this waits for any queued write to the same file to finish.
+ * @param	state			embedDB algorithm state structure
+ * @param	file			File about to be read
+ * @param	physicalPageNum	Physical page number about to be read
+ * @param	buffer			Where to copy the page if it is still queued
+ * @return	1 if the page was copied into buffer, 0 if it must be read from storage, -1 if a background erase or write has failed.
+ */
+int8_t syncBackgroundWriterForRead(embedDBState *state, void *file, id_t physicalPageNum, void *buffer) {
+    embedDBBackgroundWriter *writer = (embedDBBackgroundWriter *)state->backgroundWriter;
+    if (writer == NULL)
+        return 0;
+
+    embedDBPendingPage *page = file == writer->dataPage.file ? &writer->dataPage : &writer->indexPage;
+    int8_t result = 0;
+
+    pthread_mutex_lock(&writer->lock);
+    if (page->pending && page->physicalPageNum == physicalPageNum) {
+        /* The writer only reads the staging page, so it is safe to copy from while the write is in progress */
+        memcpy(buffer, page->buffer, state->pageSize);
+        result = 1;
+    } else {
+        while (page->pending)
+            pthread_cond_wait(&writer->changed, &writer->lock);
+    }
+    if (writer->error)
+        result = -1;
+    pthread_mutex_unlock(&writer->lock);
+    return result;
+}
+
+#else
+
+int8_t embedDBStartBackgroundWriter(embedDBState *state) {
+    (void)state;
+#ifdef PRINT_ERRORS
+    printf("ERROR: The background writer is not supported on this platform.\n");
+#endif
+    return -1;
+}
+
+void embedDBStopBackgroundWriter(embedDBState *state) {
+    (void)state;
+}
+
+int8_t embedDBWaitForBackgroundWriter(embedDBState *state) {
+    (void)state;
+    return 0;
+}
+
+int8_t queueBackgroundPageWrite(embedDBState *state, void *file, void *buffer, id_t physicalPageNum, uint8_t eraseBlock) {
+    (void)state;
+    (void)file;
+    (void)buffer;
+    (void)physicalPageNum;
+    (void)eraseBlock;
+    return -1;
+}
+
+int8_t syncBackgroundWriterForRead(embedDBState *state, void *file, id_t physicalPageNum, void *buffer) {
+    (void)state;
+    (void)file;
+    (void)physicalPageNum;
+    (void)buffer;
+    return 0;
+}
+
+#endif
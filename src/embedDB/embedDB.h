@@ -62,6 +62,17 @@ typedef uint16_t count_t;
 #define EMBEDDB_RECORD_LEVEL_CONSISTENCY 64
 #define EMBEDDB_USE_BINARY_SEARCH 128
 #define EMBEDDB_DISABLE_SPLINE_CLEAN 256
+#define EMBEDDB_USE_BACKGROUND_WRITER 512
+#define EMBEDDB_RLC_GROUP_COMMIT 1024
+#define EMBEDDB_USE_CHECKPOINT 2048
+#define EMBEDDB_USE_SPLINE_FILE 4096
+#define EMBEDDB_USE_BUFFER_POOL 8192
+#define EMBEDDB_USE_FENCE_KEYS 16384
+#define EMBEDDB_USE_ZONE_MAP 32768
+#define EMBEDDB_USE_UINT_KEYS 65536
+#define EMBEDDB_USE_COMPRESSION 131072
+#define EMBEDDB_USE_KEY_OFFSETS 262144
+#define EMBEDDB_USE_REORDER_BUFFER 524288
 
 #define EMBEDDB_USING_INDEX(x) ((x & EMBEDDB_USE_INDEX) > 0 ? 1 : 0)
 #define EMBEDDB_USING_MAX_MIN(x) ((x & EMBEDDB_USE_MAX_MIN) > 0 ? 1 : 0)
@@ -72,6 +83,29 @@ typedef uint16_t count_t;
 #define EMBEDDB_USING_BINARY_SEARCH(x) ((x & EMBEDDB_USE_BINARY_SEARCH) > 0 ? 1 : 0)
 #define EMBEDDB_DISABLED_SPLINE_CLEAN(x) ((x & EMBEDDB_DISABLE_SPLINE_CLEAN) > 0 ? 1 : 0)
 #define EMBEDDB_RESETING_DATA(x) ((x & EMBEDDB_RESET_DATA) > 0 ? 1 : 0)
+#define EMBEDDB_USING_BACKGROUND_WRITER(x) ((x & EMBEDDB_USE_BACKGROUND_WRITER) > 0 ? 1 : 0)
+#define EMBEDDB_USING_RLC_GROUP_COMMIT(x) ((x & EMBEDDB_RLC_GROUP_COMMIT) > 0 ? 1 : 0)
+#define EMBEDDB_USING_CHECKPOINT(x) ((x & EMBEDDB_USE_CHECKPOINT) > 0 ? 1 : 0)
+#define EMBEDDB_USING_SPLINE_FILE(x) ((x & EMBEDDB_USE_SPLINE_FILE) > 0 ? 1 : 0)
+#define EMBEDDB_USING_BUFFER_POOL(x) ((x & EMBEDDB_USE_BUFFER_POOL) > 0 ? 1 : 0)
+#define EMBEDDB_USING_FENCE_KEYS(x) ((x & EMBEDDB_USE_FENCE_KEYS) > 0 ? 1 : 0)
+#define EMBEDDB_USING_ZONE_MAP(x) ((x & EMBEDDB_USE_ZONE_MAP) > 0 ? 1 : 0)
+#define EMBEDDB_USING_UINT_KEYS(x) ((x & EMBEDDB_USE_UINT_KEYS) > 0 ? 1 : 0)
+#define EMBEDDB_USING_COMPRESSION(x) ((x & EMBEDDB_USE_COMPRESSION) > 0 ? 1 : 0)
+#define EMBEDDB_USING_KEY_OFFSETS(x) ((x & EMBEDDB_USE_KEY_OFFSETS) > 0 ? 1 : 0)
+#define EMBEDDB_USING_REORDER_BUFFER(x) ((x & EMBEDDB_USE_REORDER_BUFFER) > 0 ? 1 : 0)
+
+/* The background page writer needs POSIX threads, so it is only available when building for a desktop host */
+#if !defined(ARDUINO) && (defined(__linux__) || defined(__APPLE__)) && !defined(EMBEDDB_NO_THREADS)
+#define EMBEDDB_THREADS_SUPPORTED
+#endif
+
+/* Page searches with EMBEDDB_USE_UINT_KEYS compare, and pages with EMBEDDB_USE_KEY_OFFSETS decode, several keys per instruction when building for a host with AVX2 or SSE2. Define EMBEDDB_NO_SIMD to always use the scalar code */
+#if !defined(EMBEDDB_NO_SIMD) && defined(__AVX2__)
+#define EMBEDDB_SIMD_AVX2
+#elif !defined(EMBEDDB_NO_SIMD) && defined(__SSE2__)
+#define EMBEDDB_SIMD_SSE2
+#endif
 
 /* Offsets with header */
 #define EMBEDDB_COUNT_OFFSET 4
@@ -98,12 +132,26 @@ typedef uint16_t count_t;
 #define EMBEDDB_GET_MIN_DATA(x, y) ((void *)((int8_t *)x + EMBEDDB_MIN_OFFSET + y->keySize * 2))
 #define EMBEDDB_GET_MAX_DATA(x, y) ((void *)((int8_t *)x + EMBEDDB_MIN_OFFSET + y->keySize * 2 + y->dataSize))
 
+/* With EMBEDDB_USE_SUM, data pages hold the sum of their data after the min/max values */
+#define EMBEDDB_GET_SUM(x, y) ((void *)((int8_t *)x + EMBEDDB_MIN_OFFSET + (EMBEDDB_USING_MAX_MIN(y->parameters) ? y->keySize * 2 + y->dataSize * 2 : 0)))
+
+/* With EMBEDDB_USE_SUM, index pages hold the sum, record count, smallest and largest key and, with EMBEDDB_USE_MAX_MIN, the smallest and largest data of the data pages they index, before the bitmaps */
+#define EMBEDDB_IDX_SUM_SIZE(y) (sizeof(int64_t) + sizeof(uint32_t) + y->keySize * 2 + (EMBEDDB_USING_MAX_MIN(y->parameters) ? y->dataSize * 2 : 0))
+#define EMBEDDB_GET_IDX_HEADER_SIZE(y) (EMBEDDB_IDX_HEADER_SIZE + (EMBEDDB_USING_SUM(y->parameters) ? EMBEDDB_IDX_SUM_SIZE(y) : 0))
+#define EMBEDDB_GET_IDX_SUM(x) ((void *)((int8_t *)x + EMBEDDB_IDX_HEADER_SIZE))
+#define EMBEDDB_GET_IDX_SUM_COUNT(x) ((void *)((int8_t *)x + EMBEDDB_IDX_HEADER_SIZE + sizeof(int64_t)))
+#define EMBEDDB_GET_IDX_MIN_KEY(x) ((void *)((int8_t *)x + EMBEDDB_IDX_HEADER_SIZE + sizeof(int64_t) + sizeof(uint32_t)))
+#define EMBEDDB_GET_IDX_MAX_KEY(x, y) ((void *)((int8_t *)x + EMBEDDB_IDX_HEADER_SIZE + sizeof(int64_t) + sizeof(uint32_t) + y->keySize))
+#define EMBEDDB_GET_IDX_MIN_DATA(x, y) ((void *)((int8_t *)x + EMBEDDB_IDX_HEADER_SIZE + sizeof(int64_t) + sizeof(uint32_t) + y->keySize * 2))
+#define EMBEDDB_GET_IDX_MAX_DATA(x, y) ((void *)((int8_t *)x + EMBEDDB_IDX_HEADER_SIZE + sizeof(int64_t) + sizeof(uint32_t) + y->keySize * 2 + y->dataSize))
+
 #define EMBEDDB_DATA_WRITE_BUFFER 0
 #define EMBEDDB_DATA_READ_BUFFER 1
 #define EMBEDDB_INDEX_WRITE_BUFFER 2
 #define EMBEDDB_INDEX_READ_BUFFER 3
 #define EMBEDDB_VAR_WRITE_BUFFER(x) ((x & EMBEDDB_USE_INDEX) ? 4 : 2)
 #define EMBEDDB_VAR_READ_BUFFER(x) ((x & EMBEDDB_USE_INDEX) ? 5 : 3)
+#define EMBEDDB_COMPRESSION_BUFFER(x) ((x & EMBEDDB_USE_INDEX) ? 4 : 2)
 
 #define EMBEDDB_FILE_MODE_W_PLUS_B 0  // Open file as read/write, creates file if doesn't exist, overwrites if it does. aka "w+b"
 #define EMBEDDB_FILE_MODE_R_PLUS_B 1  // Open file as read/write, file must exist, keeps data if it does. aka "r+b"
@@ -205,13 +253,26 @@ typedef struct {
      * @return 1 for eof and 0 otherwise
      */
     int8_t (*eof)(void *file);
-    
+
+    /**
+     * @brief	Reads consecutive pages into the buffer with one request to storage. Optional: set to NULL and embedDB calls read once per page.
+     * 			It is the last member so that interfaces written before it still line up, but they must now set it to NULL, as embedDB calls it when it is not NULL
+     * @param	buffer		Pre-allocated space of numPages pages where data is read into
+     * @param	pageNum		First page number to read. Is treated as an offset from the beginning of the file
+     * @param	numPages	Number of pages to read. The pages never wrap around the end of the file
+     * @param	pageSize	Number of bytes in a page
+     * @param	file		The file to read from. This is the file data that was stored in embedDBState->dataFile etc
+     * @return	1 for success and 0 for failure
+     */
+    int8_t (*readPages)(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file);
 } embedDBFileInterface;
 
 typedef struct {
     void *dataFile;                                                       /* File for storing data records. */
     void *indexFile;                                                      /* File for storing index records. */
     void *varFile;                                                        /* File for storing variable length data. */
+    void *checkpointFile;                                                 /* File for storing the metadata checkpoint. Only used with EMBEDDB_USE_CHECKPOINT */
+    void *splineFile;                                                     /* File for storing spline points. Only used with EMBEDDB_USE_SPLINE_FILE */
     embedDBFileInterface *fileInterface;                                  /* Interface to the file storage */
     uint32_t numDataPages;                                                /* The number of pages will use for storing fixed records*/
     uint32_t numIndexPages;                                               /* The number of pages will use for storing the data index */
@@ -228,14 +289,31 @@ typedef struct {
     id_t nextVarPageId;                                                   /* Page number of next var page to be written */
     uint32_t nextRLCPhysicalPageLocation;                                 /* Physical page number for the location for the next record-level-consistency page */
     uint32_t rlcPhysicalStartingPage;                                     /* Physical page number for the starting page of the record-level consistnecy pages */
+    uint32_t rlcGroupCommitRecords;                                       /* With EMBEDDB_RLC_GROUP_COMMIT, number of inserted records that triggers a sync. 0 for no record limit */
+    uint32_t rlcGroupCommitWindow;                                        /* With EMBEDDB_RLC_GROUP_COMMIT, age in milliseconds of the oldest unsynced record at which an insert triggers a sync. 0 for no time limit. The window is only checked on the next insert, so records stay unsynced through an idle period until embedDBSync is called */
+    uint32_t rlcUncommittedRecords;                                       /* Number of records inserted since the last record-level consistency sync */
+    uint32_t rlcFirstUncommittedTime;                                     /* Time in milliseconds of the first insert since the last record-level consistency sync */
+    uint32_t checkpointInterval;                                          /* With EMBEDDB_USE_CHECKPOINT, number of data pages written between checkpoints. 0 to only checkpoint on embedDBFlush */
+    uint32_t checkpointSequence;                                          /* Sequence number of the last checkpoint written */
+    id_t lastCheckpointDataPageId;                                        /* Value of nextDataPageId when the last checkpoint was written */
+    uint32_t numSplinePages;                                              /* With EMBEDDB_USE_SPLINE_FILE, the number of pages used for storing spline points */
+    id_t nextSplinePageId;                                                /* Logical id of the spline file page that new spline points are added to */
+    count_t numSplinePagePoints;                                          /* Number of spline points on the current spline file page */
+    id_t lastSplineFilePointPage;                                         /* Data page of the last point added to the spline file. UINT32_MAX if there is none */
+    void *splinePageBuffer;                                               /* Current spline file page, kept in memory until it is full or embedDBFlush writes it. NULL unless using EMBEDDB_USE_SPLINE_FILE */
     id_t currentVarLoc;                                                   /* Current variable address offset to write at (bytes from beginning of file) */
     void *buffer;                                                         /* Pre-allocated memory buffer for use by algorithm */
     spline *spl;                                                          /* Spline model */
     uint32_t numSplinePoints;                                             /* Number of spline points to allocate */
     int32_t indexMaxError;                                                /* Max error for indexing structure (Spline or PGM) */
     int8_t bufferSizeInBlocks;                                            /* Size of buffer in blocks */
+    uint32_t bufferPoolSizeInPages;                                       /* With EMBEDDB_USE_BUFFER_POOL, the number of pages cached from the data, index and variable data files */
     count_t pageSize;                                                     /* Size of physical page on device */
-    int16_t parameters;                                                   /* Parameter flags for indexing and bitmaps */
+    count_t compressedPageSize;                                           /* With EMBEDDB_USE_COMPRESSION or EMBEDDB_USE_KEY_OFFSETS, size of the data pages in the data file. Data pages are encoded from pageSize bytes in memory to at most this many bytes */
+    int8_t keyOffsetSize;                                                 /* With EMBEDDB_USE_KEY_OFFSETS, size in bytes (2 or 4) of the key offsets stored in the data file */
+    count_t reorderBufferSize;                                            /* With EMBEDDB_USE_REORDER_BUFFER, number of the most recent records held back so they can be inserted out of order */
+    count_t compressedPageBytes;                                          /* Internal size of the records in the write buffer when compressed */
+    uint32_t parameters;                                                  /* Parameter flags for indexing and bitmaps */
     int8_t keySize;                                                       /* Size of key in bytes (fixed-size records) */
     int8_t dataSize;                                                      /* Size of data in bytes (fixed-size records). Do not include space for variable size records if you are using them. */
     int8_t recordSize;                                                    /* Size of record in bytes (fixed-size records) */
@@ -257,22 +335,45 @@ typedef struct {
     id_t numIdxWrites;                                                    /* Number of index page writes */
     id_t numIdxReads;                                                     /* Number of index page reads */
     id_t bufferHits;                                                      /* Number of pages returned from buffer rather than storage */
+    id_t bufferPoolHits;                                                  /* Number of pages copied from the buffer pool rather than read from storage */
+    id_t bufferPoolMisses;                                                /* Number of pages not found in the buffer pool */
     id_t bufferedPageId;                                                  /* Page id currently in read buffer */
     id_t bufferedIndexPageId;                                             /* Index page id currently in index read buffer */
     id_t bufferedVarPage;                                                 /* Variable page id currently in variable read buffer */
     uint8_t recordHasVarData;                                             /* Internal flag to signal that the record currently being written has var data */
+    void *backgroundWriter;                                               /* Internal state of the background page writer. NULL unless using EMBEDDB_USE_BACKGROUND_WRITER */
+    void *bufferPool;                                                     /* Internal state of the buffer pool. NULL unless using EMBEDDB_USE_BUFFER_POOL */
+    void *fenceKeys;                                                      /* Internal fence key directory of the smallest key on each data page. NULL unless using EMBEDDB_USE_FENCE_KEYS */
+    void *zoneMap;                                                        /* Internal zone map of the smallest and largest data value on each data page. NULL unless using EMBEDDB_USE_ZONE_MAP */
+    void *reorderBuffer;                                                  /* Internal buffer of the records not yet added to the write buffer. NULL unless using EMBEDDB_USE_REORDER_BUFFER */
 } embedDBState;
 
 typedef struct {
     uint32_t nextDataPage; /* Next data page that the iterator should read */
     uint16_t nextDataRec;  /* Next record on the data page tat the iterator should read */
+    uint32_t lastDataPage; /* Last data page the scan needs: the page that can hold maxKey, or for a reverse iterator the page that can hold minKey. UINT32_MAX if a forward scan may reach the write buffer */
     void *minKey;
     void *maxKey;
     void *minData;
     void *maxData;
     void *queryBitmap;
+    void *buffer;             /* Private data and index read buffers set with embedDBIteratorSetBuffer. NULL if the iterator uses the shared read buffers */
+    id_t bufferedPageId;      /* Data page id currently in the private data read buffer */
+    id_t bufferedIndexPageId; /* Index page id currently in the private index read buffer */
+    void *readaheadBuffer;    /* Readahead window set with embedDBIteratorSetReadahead. NULL if data pages are read one at a time */
+    uint32_t readaheadPages;  /* Number of pages the readahead window holds */
+    id_t readaheadFirstPage;  /* Logical id of the first data page in the readahead window */
+    uint32_t readaheadCount;  /* Number of data pages currently in the readahead window */
 } embedDBIterator;
 
+typedef struct {
+    void *page;         /* Buffer holding the data page. Only valid until the next call that reads a data page or inserts a record */
+    void *records;      /* First record on the page. Record i is at records + i * recordSize, with its data keySize bytes after its key */
+    count_t start;      /* First record in the key range of the iterator */
+    count_t end;        /* One past the last record in the key range of the iterator */
+    int8_t recordSize;  /* Number of bytes from the start of one record to the next */
+} embedDBPageBatch;
+
 typedef struct {
     uint32_t totalBytes; /* Total number of bytes in the stream */
     uint32_t bytesRead;  /* Number of bytes read so far */
@@ -308,7 +409,8 @@ embedDBState *defaultInitializedState();
 void embedDBPrintInit(embedDBState *state);
 
 /**
- * @brief	Puts a given key, data pair into structure.
+ * @brief	Puts a given key, data pair into structure. Keys must be larger than any key already stored.
+ * 			With EMBEDDB_USE_REORDER_BUFFER, keys only have to be larger than the keys already moved out of the reorder buffer.
  * @param	state	embedDB algorithm state structure
  * @param	key		Key for record
  * @param	data	Data for record
@@ -327,6 +429,17 @@ int8_t embedDBPut(embedDBState *state, void *key, void *data);
  */
 int8_t embedDBPutVar(embedDBState *state, void *key, void *data, void *variableData, uint32_t length);
 
+/**
+ * @brief	Puts an array of key, data pairs into structure. Keys must be in strictly ascending order and larger than any key already stored.
+ * 			Ordering is validated once for the batch and whole pages are filled at a time. With EMBEDDB_USE_REORDER_BUFFER, the records are put one at a time and do not need to be in order.
+ * @param	state	embedDB algorithm state structure
+ * @param	keys	Array of n keys, each state->keySize bytes
+ * @param	datas	Array of n data values, each state->dataSize bytes
+ * @param	n		Number of records to insert
+ * @return	Return 0 if success. Non-zero value if error. No records are inserted if the keys are not in ascending order.
+ */
+int8_t embedDBPutBatch(embedDBState *state, void *keys, void *datas, uint32_t n);
+
 /**
  * @brief	Given a key, returns data associated with key.
  * 			Note: Space for data must be already allocated.
@@ -338,6 +451,84 @@ int8_t embedDBPutVar(embedDBState *state, void *key, void *data, void *variableD
  */
 int8_t embedDBGet(embedDBState *state, void *key, void *data);
 
+/**
+ * @brief	Finds the data page that can hold a key and makes sure it is in memory.
+ * @param	state	embedDB algorithm state structure
+ * @param	key		Key to search for
+ * @return	The write buffer or the data read buffer holding the page. NULL if no page can hold the key or the page could not be read.
+ */
+void *embedDBGetPage(embedDBState *state, void *key);
+
+/**
+ * @brief	Finds the record with the largest key less than or equal to a key.
+ * 			Note: Space for foundKey and data must be already allocated.
+ * @param	state		embedDB algorithm state structure
+ * @param	key			Key to search for
+ * @param	foundKey	Return variable for the key of the record found
+ * @param	data		Return variable for the data of the record found
+ * @return	Return 0 if success. 1 if every record has a larger key. -1 if error.
+ */
+int8_t embedDBGetFloor(embedDBState *state, void *key, void *foundKey, void *data);
+
+/**
+ * @brief	Finds the record with the smallest key greater than or equal to a key.
+ * 			Note: Space for foundKey and data must be already allocated.
+ * @param	state		embedDB algorithm state structure
+ * @param	key			Key to search for
+ * @param	foundKey	Return variable for the key of the record found
+ * @param	data		Return variable for the data of the record found
+ * @return	Return 0 if success. 1 if every record has a smaller key. -1 if error.
+ */
+int8_t embedDBGetCeiling(embedDBState *state, void *key, void *foundKey, void *data);
+
+/**
+ * @brief	Given an array of keys, returns the data associated with each key.
+ *          The keys are looked up in sorted order, so each data page is read at most once no matter how many of the keys are on it.
+ * @param	state		embedDB algorithm state structure
+ * @param	keys		Array of n keys, each state->keySize bytes. The keys do not need to be sorted.
+ * @param	n			Number of keys
+ * @param	outData		Pre-allocated array of n data values, each state->dataSize bytes. The data for each key is copied to the same position as the key.
+ * @param	outStatus	Pre-allocated array of n results. Set to 0 for each key that was found and -1 for each key that was not, the same as embedDBGet.
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBGetMany(embedDBState *state, void *keys, uint32_t n, void *outData, int8_t *outStatus);
+
+/**
+ * @brief	Sums the data of every record with a key in a range. Requires EMBEDDB_USE_SUM.
+ *          Data pages, and with an index file whole index pages, that are entirely inside the range are added from their headers. Only the pages at the ends of the range are searched record by record.
+ * @param	state	embedDB algorithm state structure
+ * @param	minKey	Smallest key in the range. NULL for no lower bound.
+ * @param	maxKey	Largest key in the range. NULL for no upper bound.
+ * @param	sum		Return variable for the sum of the data, read as signed integers of state->dataSize bytes
+ * @param	count	Return variable for the number of records in the range
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBRangeSum(embedDBState *state, void *minKey, void *maxKey, int64_t *sum, uint32_t *count);
+
+/**
+ * @brief	Counts the records with a key in a range. Data pages entirely inside the range are counted from their headers,
+ *          and with EMBEDDB_USE_SUM and an index file, so are whole index pages.
+ * @param	state	embedDB algorithm state structure
+ * @param	minKey	Smallest key in the range. NULL for no lower bound.
+ * @param	maxKey	Largest key in the range. NULL for no upper bound.
+ * @param	count	Return variable for the number of records in the range
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBRangeCount(embedDBState *state, void *minKey, void *maxKey, uint32_t *count);
+
+/**
+ * @brief	Finds the smallest and largest data values of the records with a key in a range. Requires EMBEDDB_USE_MAX_MIN.
+ *          Data pages entirely inside the range use the data range in their headers, and with EMBEDDB_USE_SUM and an index file, so do whole index pages.
+ *          Only the pages at the ends of the range are searched record by record.
+ * @param	state	embedDB algorithm state structure
+ * @param	minKey	Smallest key in the range. NULL for no lower bound.
+ * @param	maxKey	Largest key in the range. NULL for no upper bound.
+ * @param	minData	Pre-allocated memory to copy the smallest data value into. NULL if not needed.
+ * @param	maxData	Pre-allocated memory to copy the largest data value into. NULL if not needed.
+ * @return	Return 0 if success, 1 if there are no records in the range (minData and maxData are not changed). -1 if error.
+ */
+int8_t embedDBRangeMinMax(embedDBState *state, void *minKey, void *maxKey, void *minData, void *maxData);
+
 /**
  * @brief	Given a key, returns data associated with key.
  * 			Data is copied from database into data buffer.
@@ -358,12 +549,51 @@ int8_t embedDBGetVar(embedDBState *state, void *key, void *data, embedDBVarDataS
  */
 void embedDBInitIterator(embedDBState *state, embedDBIterator *it);
 
+/**
+ * @brief	Initialize iterator on embedDB structure that returns records from the largest key to the smallest. Use embedDBPrev to read it.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ */
+void embedDBInitReverseIterator(embedDBState *state, embedDBIterator *it);
+
+/**
+ * @brief	Gives an iterator its own data and index read buffers, so other iterators and lookups do not evict its pages. Call after initializing the iterator.
+ * @param	it		embedDB iterator state structure
+ * @param	buffer	Buffer of two pages: the data page read buffer followed by the index page read buffer. NULL to use the shared read buffers again
+ */
+void embedDBIteratorSetBuffer(embedDBIterator *it, void *buffer);
+
+/**
+ * @brief	Gives a forward iterator a readahead window, so embedDBNext and embedDBNextPage read runs of consecutive data pages with one storage request. Call after initializing the iterator.
+ * @param	it			embedDB iterator state structure
+ * @param	buffer		Buffer of numPages pages for the readahead window. NULL to read data pages one at a time again
+ * @param	numPages	Number of pages in buffer
+ */
+void embedDBIteratorSetReadahead(embedDBIterator *it, void *buffer, uint32_t numPages);
+
 /**
  * @brief	Close iterator after use.
  * @param	it		embedDB iterator structure
  */
 void embedDBCloseIterator(embedDBIterator *it);
 
+/**
+ * @brief	Estimates how many data pages an iterator has left to scan, from the spline or fence key bound on the page of its max key.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @return	Number of data pages left, counting the write buffer as a page when the scan can reach it
+ */
+uint32_t embedDBIteratorEstimatePages(embedDBState *state, embedDBIterator *it);
+
+/**
+ * @brief	Returns the page holding the next records of a forward iterator. On a new page, it->nextDataRec is moved to the first record at or after minKey.
+ * 			The caller reads records from it->nextDataRec up to the page count, then moves to the next page by incrementing it->nextDataPage and setting it->nextDataRec to 0.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @return	Buffer holding the page, only valid until the next call that reads a data page or inserts a record. NULL if there are no more pages.
+ */
+void *embedDBIteratorPage(embedDBState *state, embedDBIterator *it);
+
 /**
  * @brief	Return next key, data pair for iterator.
  * @param	state	embedDB algorithm state structure
@@ -374,6 +604,26 @@ void embedDBCloseIterator(embedDBIterator *it);
  */
 int8_t embedDBNext(embedDBState *state, embedDBIterator *it, void *key, void *data);
 
+/**
+ * @brief	Returns the records on the next data page of an iterator that are within its key range, without copying them.
+ * 			Data filters are only used to skip whole pages, so the records in the batch must still be checked against minData and maxData.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	batch	Return variable for the page and the range of records on it
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBNextPage(embedDBState *state, embedDBIterator *it, embedDBPageBatch *batch);
+
+/**
+ * @brief	Return previous key, data pair for an iterator initialized with embedDBInitReverseIterator.
+ * @param	state	embedDB algorithm state structure
+ * @param	it		embedDB iterator state structure
+ * @param	key		Return variable for key (Pre-allocated)
+ * @param	data	Return variable for data (Pre-allocated)
+ * @return	1 if successful, 0 if no more records
+ */
+int8_t embedDBPrev(embedDBState *state, embedDBIterator *it, void *key, void *data);
+
 /**
  * @brief	Return next key, data, variable data set for iterator
  * @param	state	embedDB algorithm state structure
@@ -402,6 +652,14 @@ uint32_t embedDBVarDataStreamRead(embedDBState *state, embedDBVarDataStream *str
  */
 int8_t embedDBFlush(embedDBState *state);
 
+/**
+ * @brief	Makes every record inserted so far durable when using record-level consistency, by writing the write buffer
+ *          (and the variable data buffer, if used) to storage. Used to commit a group of records with EMBEDDB_RLC_GROUP_COMMIT.
+ * @param	state	embedDB algorithm state structure
+ * @return	Return 0 if success. Non-zero value if error.
+ */
+int8_t embedDBSync(embedDBState *state);
+
 /**
  * @brief	Flushes output buffer.
  * @param	state	algorithm state structure
@@ -0,0 +1,452 @@
+/******************************************************************************/
+/**
+ * @file        embedDB.hpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Typed C++17 interface to EmbedDB.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#ifndef embedDB_HPP_
+#define embedDB_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include "embedDB.h"
+
+namespace embeddb {
+
+/**
+ * @brief	Orders values with operator<. Pass another order with the same members to EmbedDB for data types without operator<.
+ */
+template <typename T>
+struct NaturalOrder {
+    static bool less(const T &a, const T &b) { return a < b; }
+
+    /* Comparator for the C API */
+    static int8_t compare(void *a, void *b) {
+        T x, y;
+        memcpy(&x, a, sizeof(T));
+        memcpy(&y, b, sizeof(T));
+        return less(x, y) ? -1 : (less(y, x) ? 1 : 0);
+    }
+};
+
+/**
+ * @brief	Settings of an EmbedDB. Variable data, checkpoints and the spline file need files the typed interface does not manage, so they are not supported.
+ */
+struct Options {
+    uint32_t parameters = 0;          /* EMBEDDB_USE_ and EMBEDDB_ flags */
+    count_t pageSize = 512;           /* Size of physical page on device */
+    count_t compressedPageSize = 0;   /* Size of the data pages in the data file. Only used with EMBEDDB_USE_COMPRESSION or EMBEDDB_USE_KEY_OFFSETS */
+    int8_t keyOffsetSize = 2;         /* Size of the key offsets in the data file. Only used with EMBEDDB_USE_KEY_OFFSETS */
+    count_t reorderBufferSize = 0;    /* Number of recent records that can be inserted out of order. Only used with EMBEDDB_USE_REORDER_BUFFER */
+    uint32_t numDataPages = 1000;     /* Number of pages for data */
+    uint32_t numIndexPages = 0;       /* Number of pages for the index. Only used with EMBEDDB_USE_INDEX */
+    count_t eraseSizeInPages = 4;     /* Erase size in pages */
+    uint32_t numSplinePoints = 300;   /* Number of spline points to allocate */
+    size_t indexMaxError = 1;         /* Max error of the spline */
+    uint32_t bufferPoolSizeInPages = 0; /* Only used with EMBEDDB_USE_BUFFER_POOL */
+    int8_t bitmapSize = 0;            /* Size of bitmap in bytes. Only used with EMBEDDB_USE_INDEX or EMBEDDB_USE_BMAP */
+    void (*updateBitmap)(void *data, void *bm) = nullptr;
+    int8_t (*inBitmap)(void *data, void *bm) = nullptr;
+    void (*buildBitmapFromRange)(void *minData, void *maxData, void *bm) = nullptr;
+};
+
+/**
+ * @brief	Storage of an EmbedDB. The EmbedDB owns the file interface, which is freed with free(), and the files, which are freed with freeFile.
+ */
+struct Storage {
+    embedDBFileInterface *fileInterface = nullptr;
+    void *dataFile = nullptr;
+    void *indexFile = nullptr;              /* Only used with EMBEDDB_USE_INDEX */
+    void (*freeFile)(void *file) = nullptr; /* Frees a file after EmbedDB closes it, such as tearDownFile. nullptr to keep the files */
+};
+
+/**
+ * @brief	An EmbedDB with fixed key and record types. Keys are unsigned integers.
+ * 			Records are compared with DataOrder for the page data range, the zone map and data filters.
+ * 			Construction does not throw. Check ok() or status() before using the database.
+ */
+template <typename Key, typename Record, typename DataOrder = NaturalOrder<Record>>
+class EmbedDB {
+    static_assert(std::is_integral<Key>::value && std::is_unsigned<Key>::value && sizeof(Key) <= 8, "EmbedDB keys must be unsigned integers of at most 8 bytes");
+    static_assert(std::is_trivially_copyable<Record>::value, "EmbedDB records are copied as bytes");
+    static_assert(sizeof(Key) + sizeof(Record) <= 127, "EmbedDB records must be at most 127 bytes");
+
+   public:
+    struct Entry {
+        Key key;
+        Record data;
+    };
+
+    static constexpr int8_t keySize = sizeof(Key);
+    static constexpr int8_t dataSize = sizeof(Record);
+    static constexpr int8_t recordSize = keySize + dataSize;
+
+    /**
+     * @brief	Size of the data page header, as calculated by embedDBInit.
+     */
+    static constexpr int8_t headerSize(uint32_t parameters, int8_t bitmapSize = 0) {
+        int size = 6;
+        if (EMBEDDB_USING_INDEX(parameters))
+            size += bitmapSize;
+        if (EMBEDDB_USING_MAX_MIN(parameters)) {
+            int minMaxEnd = EMBEDDB_MIN_OFFSET + keySize * 2 + dataSize * 2;
+            size = size + keySize * 2 + dataSize * 2 > minMaxEnd ? size + keySize * 2 + dataSize * 2 : minMaxEnd;
+        }
+        if (EMBEDDB_USING_SUM(parameters)) {
+            int sumEnd = EMBEDDB_MIN_OFFSET + (EMBEDDB_USING_MAX_MIN(parameters) ? keySize * 2 + dataSize * 2 : 0) + (int)sizeof(int64_t);
+            size = size > sumEnd ? size : sumEnd;
+        }
+        return (int8_t)size;
+    }
+
+    /**
+     * @brief	Number of records on a data page, as calculated by embedDBInit.
+     * 			With EMBEDDB_USE_KEY_OFFSETS, a page holds only as many records as fit in compressedPageSize with keys stored in keyOffsetSize bytes.
+     * 			With EMBEDDB_USE_COMPRESSION, this is the most records a page can hold. A page is written once its compressed records fill compressedPageSize,
+     * 			so pages often hold fewer.
+     */
+    static constexpr count_t recordsPerPage(count_t pageSize, uint32_t parameters, int8_t bitmapSize = 0, count_t compressedPageSize = 0, int8_t keyOffsetSize = 2) {
+        count_t records = (count_t)((pageSize - headerSize(parameters, bitmapSize)) / recordSize);
+        if (EMBEDDB_USING_KEY_OFFSETS(parameters)) {
+            count_t storedRecords = (count_t)((compressedPageSize - headerSize(parameters, bitmapSize)) / (keyOffsetSize + dataSize));
+            records = storedRecords < records ? storedRecords : records;
+        }
+        return records;
+    }
+
+    /**
+     * @brief	Number of pages of memory the database needs.
+     */
+    static constexpr int8_t bufferSizeInBlocks(uint32_t parameters) {
+        return (EMBEDDB_USING_INDEX(parameters) ? 4 : 2) + ((EMBEDDB_USING_COMPRESSION(parameters) || EMBEDDB_USING_KEY_OFFSETS(parameters)) ? 1 : 0);
+    }
+
+    EmbedDB(const Options &options, const Storage &storage) : storage_(storage) {
+        state_ = (embedDBState *)calloc(1, sizeof(embedDBState));
+        if (state_ == nullptr) {
+            status_ = -1;
+            return;
+        }
+        state_->fileInterface = storage.fileInterface;
+        state_->dataFile = storage.dataFile;
+        state_->indexFile = storage.indexFile;
+        state_->keySize = keySize;
+        state_->dataSize = dataSize;
+        state_->compareKey = compareKey;
+        state_->compareData = DataOrder::compare;
+        state_->pageSize = options.pageSize;
+        state_->compressedPageSize = options.compressedPageSize;
+        state_->keyOffsetSize = options.keyOffsetSize;
+        state_->reorderBufferSize = options.reorderBufferSize;
+        state_->numDataPages = options.numDataPages;
+        state_->numIndexPages = options.numIndexPages;
+        state_->eraseSizeInPages = options.eraseSizeInPages;
+        state_->numSplinePoints = options.numSplinePoints;
+        state_->bufferPoolSizeInPages = options.bufferPoolSizeInPages;
+        state_->bitmapSize = options.bitmapSize;
+        state_->updateBitmap = options.updateBitmap;
+        state_->inBitmap = options.inBitmap;
+        state_->buildBitmapFromRange = options.buildBitmapFromRange;
+        state_->parameters = options.parameters;
+        state_->bufferSizeInBlocks = bufferSizeInBlocks(options.parameters);
+        if (options.parameters & (EMBEDDB_USE_VDATA | EMBEDDB_USE_CHECKPOINT | EMBEDDB_USE_SPLINE_FILE)) {
+#ifdef PRINT_ERRORS
+            printf("ERROR: The typed EmbedDB does not support variable data, checkpoints or the spline file.\n");
+#endif
+            status_ = -1;
+            return;
+        }
+        state_->buffer = malloc((size_t)state_->bufferSizeInBlocks * state_->pageSize);
+        if (state_->buffer == nullptr) {
+            status_ = -1;
+            return;
+        }
+        status_ = embedDBInit(state_, options.indexMaxError);
+        opened_ = status_ == 0;
+    }
+
+    ~EmbedDB() { release(); }
+
+    EmbedDB(const EmbedDB &) = delete;
+    EmbedDB &operator=(const EmbedDB &) = delete;
+
+    EmbedDB(EmbedDB &&other) noexcept
+        : state_(std::exchange(other.state_, nullptr)), storage_(std::exchange(other.storage_, Storage())), status_(other.status_), opened_(std::exchange(other.opened_, false)) {}
+
+    EmbedDB &operator=(EmbedDB &&other) noexcept {
+        if (this != &other) {
+            release();
+            state_ = std::exchange(other.state_, nullptr);
+            storage_ = std::exchange(other.storage_, Storage());
+            status_ = other.status_;
+            opened_ = std::exchange(other.opened_, false);
+        }
+        return *this;
+    }
+
+    /** @brief	True if the database was initialized. */
+    bool ok() const { return opened_; }
+
+    /** @brief	Result of embedDBInit, or -1 if the state or its buffer could not be allocated or the options are not supported. */
+    int8_t status() const { return status_; }
+
+    /** @brief	State for the C API. It stays owned by this object. */
+    embedDBState *state() const { return state_; }
+
+    /**
+     * @brief	Same as embedDBPut. Records are copied onto the write buffer directly when no other option needs per record work.
+     * @return	0 if success. Non-zero value if error.
+     */
+    int8_t put(Key key, const Record &data) {
+        count_t count = EMBEDDB_GET_COUNT(state_->buffer);
+        if (count == 0 || count >= state_->maxRecordsPerPage ||
+            (state_->parameters & (EMBEDDB_USE_SUM | EMBEDDB_USE_BMAP | EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_USE_COMPRESSION | EMBEDDB_USE_KEY_OFFSETS | EMBEDDB_USE_REORDER_BUFFER))) {
+            return embedDBPut(state_, &key, (void *)&data);
+        }
+        int8_t *record = (int8_t *)state_->buffer + state_->headerSize + recordSize * count;
+        if (!(key > keyAt(record - recordSize))) {
+#ifdef PRINT_ERRORS
+            printf("Keys must be strictly ascending order. Insert Failed.\n");
+#endif
+            return 1;
+        }
+        memcpy(record, &key, keySize);
+        memcpy(record + keySize, &data, dataSize);
+        EMBEDDB_INC_COUNT(state_->buffer);
+        if (EMBEDDB_USING_MAX_MIN(state_->parameters)) {
+            memcpy(EMBEDDB_GET_MAX_KEY(state_->buffer, state_), &key, keySize);
+            if (DataOrder::less(data, dataAt(EMBEDDB_GET_MIN_DATA(state_->buffer, state_))))
+                memcpy(EMBEDDB_GET_MIN_DATA(state_->buffer, state_), &data, dataSize);
+            if (DataOrder::less(dataAt(EMBEDDB_GET_MAX_DATA(state_->buffer, state_)), data))
+                memcpy(EMBEDDB_GET_MAX_DATA(state_->buffer, state_), &data, dataSize);
+        }
+        return 0;
+    }
+
+    /**
+     * @brief	Same as embedDBGet.
+     * @return	0 if the key was found. -1 if not.
+     */
+    int8_t get(Key key, Record &data) {
+        /* Records in the reorder buffer are found by embedDBGet */
+        if (state_->reorderBuffer != nullptr)
+            return embedDBGet(state_, &key, &data);
+        int8_t *page = (int8_t *)embedDBGetPage(state_, &key);
+        if (page == nullptr)
+            return -1;
+        int8_t *records = page + state_->headerSize;
+        int32_t low = 0, high = (int32_t)EMBEDDB_GET_COUNT(page) - 1;
+        while (low <= high) {
+            int32_t mid = low + (high - low) / 2;
+            Key midKey = keyAt(records + recordSize * mid);
+            if (midKey < key) {
+                low = mid + 1;
+            } else if (key < midKey) {
+                high = mid - 1;
+            } else {
+                memcpy(&data, records + recordSize * mid + keySize, dataSize);
+                return 0;
+            }
+        }
+        return -1;
+    }
+
+    /** @brief	Same as embedDBFlush. */
+    int8_t flush() { return embedDBFlush(state_); }
+
+    /**
+     * @brief	Records in key order for a range-based for loop. The range must not outlive the database.
+     * 			Records inserted while iterating are returned if they are within the key range.
+     */
+    class Range {
+       public:
+        struct End {};
+
+        class Iterator {
+           public:
+            const Entry &operator*() const { return entry_; }
+            const Entry *operator->() const { return &entry_; }
+            Iterator &operator++() {
+                done_ = !range_->next(entry_);
+                return *this;
+            }
+            bool operator!=(End) const { return !done_; }
+            bool operator==(End) const { return done_; }
+
+           private:
+            friend class Range;
+            explicit Iterator(Range *range) : range_(range) { ++*this; }
+            Range *range_;
+            Entry entry_{};
+            bool done_ = false;
+        };
+
+        Range(embedDBState *state, const Key *minKey, const Key *maxKey, const Record *minData, const Record *maxData) : state_(state) {
+            it_.minKey = minKey != nullptr ? copyBound(&minKey_, minKey) : nullptr;
+            it_.maxKey = maxKey != nullptr ? copyBound(&maxKey_, maxKey) : nullptr;
+            it_.minData = minData != nullptr ? copyBound(&minData_, minData) : nullptr;
+            it_.maxData = maxData != nullptr ? copyBound(&maxData_, maxData) : nullptr;
+            embedDBInitIterator(state_, &it_);
+        }
+
+        ~Range() { embedDBCloseIterator(&it_); }
+
+        /* The iterator points at the bounds in the range, so ranges are returned from EmbedDB::range without being copied or moved */
+        Range(const Range &) = delete;
+        Range &operator=(const Range &) = delete;
+
+        /** @brief	Iterator to the first record. A range can only be iterated once. */
+        Iterator begin() { return Iterator(this); }
+        End end() { return End(); }
+
+        /** @brief	Iterator state for the C API, such as embedDBIteratorSetBuffer. Set it up before calling begin(). */
+        embedDBIterator *iterator() { return &it_; }
+
+        /**
+         * @brief	Same as embedDBNext.
+         * @return	1 if a record was returned. 0 if there are no more records.
+         */
+        int8_t next(Entry &entry) {
+            while (1) {
+                /* The page is positioned at the first record at or after minKey, so only the max key has to be checked */
+                int8_t *page = (int8_t *)embedDBIteratorPage(state_, &it_);
+                if (page == nullptr)
+                    return state_->reorderBuffer != nullptr ? nextBuffered(entry) : 0;
+                count_t count = EMBEDDB_GET_COUNT(page);
+                int8_t *record = page + state_->headerSize + recordSize * it_.nextDataRec;
+                for (; it_.nextDataRec < count; record += recordSize) {
+                    it_.nextDataRec++;
+                    Key key = keyAt(record);
+                    if (it_.maxKey != nullptr && maxKey_ < key)
+                        return 0;
+                    Record data = dataAt(record + keySize);
+                    if ((it_.minData != nullptr && DataOrder::less(data, minData_)) || (it_.maxData != nullptr && DataOrder::less(maxData_, data)))
+                        continue;
+                    entry.key = key;
+                    entry.data = data;
+                    return 1;
+                }
+                it_.nextDataPage++;
+                it_.nextDataRec = 0;
+            }
+        }
+
+       private:
+        /* Records in the reorder buffer are returned by embedDBNext */
+        int8_t nextBuffered(Entry &entry) {
+            Key key;
+            Record data;
+            if (embedDBNext(state_, &it_, &key, &data) != 1)
+                return 0;
+            entry.key = key;
+            entry.data = data;
+            return 1;
+        }
+
+        template <typename T>
+        static void *copyBound(T *bound, const T *value) {
+            *bound = *value;
+            return bound;
+        }
+
+        embedDBState *state_;
+        embedDBIterator it_{};
+        Key minKey_{}, maxKey_{};
+        Record minData_{}, maxData_{};
+    };
+
+    /**
+     * @brief	Records with a key and data in a range. nullptr for no bound.
+     */
+    Range range(const Key *minKey, const Key *maxKey, const Record *minData = nullptr, const Record *maxData = nullptr) {
+        return Range(state_, minKey, maxKey, minData, maxData);
+    }
+
+    /** @brief	Records with a key from minKey to maxKey. */
+    Range range(Key minKey, Key maxKey) { return Range(state_, &minKey, &maxKey, nullptr, nullptr); }
+
+    /** @brief	All records. */
+    Range all() { return Range(state_, nullptr, nullptr, nullptr, nullptr); }
+
+   private:
+    static Key keyAt(const void *ptr) {
+        Key key;
+        memcpy(&key, ptr, keySize);
+        return key;
+    }
+
+    static Record dataAt(const void *ptr) {
+        Record data;
+        memcpy(&data, ptr, dataSize);
+        return data;
+    }
+
+    static int8_t compareKey(void *a, void *b) {
+        Key x = keyAt(a), y = keyAt(b);
+        return x < y ? -1 : (y < x ? 1 : 0);
+    }
+
+    /* Flushes the write and reorder buffers before closing, so records that were put are not lost when the database is destroyed or assigned to */
+    void release() {
+        if (state_ == nullptr)
+            return;
+        if (opened_) {
+            embedDBFlush(state_);
+            embedDBClose(state_);
+        }
+        free(state_->buffer);
+        if (storage_.freeFile != nullptr) {
+            if (storage_.dataFile != nullptr)
+                storage_.freeFile(storage_.dataFile);
+            if (storage_.indexFile != nullptr)
+                storage_.freeFile(storage_.indexFile);
+        }
+        free(storage_.fileInterface);
+        free(state_);
+        state_ = nullptr;
+        opened_ = false;
+    }
+
+    embedDBState *state_ = nullptr;
+    Storage storage_;
+    int8_t status_ = -1;
+    bool opened_ = false;
+};
+
+}  // namespace embeddb
+
+#endif
@@ -0,0 +1,184 @@
+/******************************************************************************/
+/**
+ * @file        embedDBTable.h
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Tables with key and data types fixed at compile time.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/******************************************************************************/
+
+#ifndef embedDBTable_H_
+#define embedDBTable_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "embedDB.h"
+
+/**
+ * EMBEDDB_DEFINE_TABLE(name, KeyType, DataType) defines functions for a table whose keys and data are
+ * fixed size integer or floating point types. Keys and data are ordered by the natural order of their type.
+ *
+ * 	name##CompareKey(a, b), name##CompareData(a, b)	Comparators for the key and data types
+ * 	name##Configure(state)							Sets keySize, dataSize, compareKey and compareData. Call before embedDBInit.
+ * 	name##Put(state, key, data)						Same as embedDBPut
+ * 	name##Get(state, key, &data)					Same as embedDBGet
+ * 	name##Next(state, it, &key, &data)				Same as embedDBNext
+ *
+ * The typed functions copy and compare keys and data with their types instead of through the sizes and
+ * comparators in the state, so the compiler can inline them. Put falls back to embedDBPut when a page is
+ * started or written, and when the state uses variable data, sums, bitmaps or record level consistency.
+ * With a reorder buffer, Get and Next use embedDBGet and embedDBNext for the records still in it.
+ * The state must be set up with name##Configure. The generic functions can still be used on the same state.
+ */
+#define EMBEDDB_DEFINE_TABLE(name, KeyType, DataType)                                                                           \
+    static inline int8_t name##CompareKey(void *a, void *b) {                                                                  \
+        KeyType x, y;                                                                                                          \
+        memcpy(&x, a, sizeof(KeyType));                                                                                        \
+        memcpy(&y, b, sizeof(KeyType));                                                                                        \
+        return (int8_t)((x > y) - (x < y));                                                                                    \
+    }                                                                                                                          \
+                                                                                                                               \
+    static inline int8_t name##CompareData(void *a, void *b) {                                                                 \
+        DataType x, y;                                                                                                         \
+        memcpy(&x, a, sizeof(DataType));                                                                                       \
+        memcpy(&y, b, sizeof(DataType));                                                                                       \
+        return (int8_t)((x > y) - (x < y));                                                                                    \
+    }                                                                                                                          \
+                                                                                                                               \
+    static inline void name##Configure(embedDBState *state) {                                                                  \
+        state->keySize = sizeof(KeyType);                                                                                      \
+        state->dataSize = sizeof(DataType);                                                                                    \
+        state->compareKey = name##CompareKey;                                                                                  \
+        state->compareData = name##CompareData;                                                                                \
+    }                                                                                                                          \
+                                                                                                                               \
+    static inline int8_t name##Put(embedDBState *state, KeyType key, DataType data) {                                          \
+        count_t count = EMBEDDB_GET_COUNT(state->buffer);                                                                      \
+        /* Starting or writing a page and the per record work of the other options are left to embedDBPut */                   \
+        if (count == 0 || count >= state->maxRecordsPerPage ||                                                                 \
+            (state->parameters & (EMBEDDB_USE_VDATA | EMBEDDB_USE_SUM | EMBEDDB_USE_BMAP | EMBEDDB_RECORD_LEVEL_CONSISTENCY |  \
+                                  EMBEDDB_USE_COMPRESSION | EMBEDDB_USE_KEY_OFFSETS | EMBEDDB_USE_REORDER_BUFFER))) {          \
+            return embedDBPut(state, &key, &data);                                                                             \
+        }                                                                                                                      \
+        int8_t *record = (int8_t *)state->buffer + state->headerSize + state->recordSize * count;                              \
+        KeyType previousKey;                                                                                                   \
+        memcpy(&previousKey, record - state->recordSize, sizeof(KeyType));                                                     \
+        if (!(key > previousKey)) {                                                                                            \
+            EMBEDDB_TABLE_PRINT_ERROR("Keys must be strictly ascending order. Insert Failed.\n");                             \
+            return 1;                                                                                                          \
+        }                                                                                                                      \
+        memcpy(record, &key, sizeof(KeyType));                                                                                 \
+        memcpy(record + sizeof(KeyType), &data, sizeof(DataType));                                                             \
+        EMBEDDB_INC_COUNT(state->buffer);                                                                                      \
+        if (EMBEDDB_USING_MAX_MIN(state->parameters)) {                                                                        \
+            DataType minData, maxData;                                                                                         \
+            memcpy(EMBEDDB_GET_MAX_KEY(state->buffer, state), &key, sizeof(KeyType));                                         \
+            memcpy(&minData, EMBEDDB_GET_MIN_DATA(state->buffer, state), sizeof(DataType));                                    \
+            memcpy(&maxData, EMBEDDB_GET_MAX_DATA(state->buffer, state), sizeof(DataType));                                    \
+            if (data < minData)                                                                                                \
+                memcpy(EMBEDDB_GET_MIN_DATA(state->buffer, state), &data, sizeof(DataType));                                   \
+            if (data > maxData)                                                                                                \
+                memcpy(EMBEDDB_GET_MAX_DATA(state->buffer, state), &data, sizeof(DataType));                                   \
+        }                                                                                                                      \
+        return 0;                                                                                                              \
+    }                                                                                                                          \
+                                                                                                                               \
+    static inline int8_t name##Get(embedDBState *state, KeyType key, DataType *data) {                                         \
+        /* Records in the reorder buffer are found by embedDBGet */                                                            \
+        if (state->reorderBuffer != NULL) {                                                                                    \
+            return embedDBGet(state, &key, data);                                                                              \
+        }                                                                                                                      \
+        int8_t *page = (int8_t *)embedDBGetPage(state, &key);                                                                  \
+        if (page == NULL) {                                                                                                    \
+            return -1;                                                                                                         \
+        }                                                                                                                      \
+        int8_t *records = page + state->headerSize;                                                                            \
+        int32_t low = 0, high = (int32_t)EMBEDDB_GET_COUNT(page) - 1;                                                          \
+        while (low <= high) {                                                                                                  \
+            int32_t mid = low + (high - low) / 2;                                                                              \
+            KeyType midKey;                                                                                                    \
+            memcpy(&midKey, records + state->recordSize * mid, sizeof(KeyType));                                               \
+            if (midKey < key) {                                                                                                \
+                low = mid + 1;                                                                                                 \
+            } else if (midKey > key) {                                                                                         \
+                high = mid - 1;                                                                                                \
+            } else {                                                                                                           \
+                memcpy(data, records + state->recordSize * mid + sizeof(KeyType), sizeof(DataType));                           \
+                return 0;                                                                                                      \
+            }                                                                                                                  \
+        }                                                                                                                      \
+        return -1;                                                                                                             \
+    }                                                                                                                          \
+                                                                                                                               \
+    static inline int8_t name##Next(embedDBState *state, embedDBIterator *it, KeyType *key, DataType *data) {                  \
+        KeyType maxKey = 0;                                                                                                    \
+        DataType minData = 0, maxData = 0;                                                                                     \
+        if (it->maxKey != NULL)                                                                                                \
+            memcpy(&maxKey, it->maxKey, sizeof(KeyType));                                                                      \
+        if (it->minData != NULL)                                                                                               \
+            memcpy(&minData, it->minData, sizeof(DataType));                                                                   \
+        if (it->maxData != NULL)                                                                                               \
+            memcpy(&maxData, it->maxData, sizeof(DataType));                                                                   \
+        while (1) {                                                                                                            \
+            /* The page is positioned at the first record at or after minKey, so only the max key has to be checked */        \
+            int8_t *page = (int8_t *)embedDBIteratorPage(state, it);                                                           \
+            if (page == NULL) {                                                                                                \
+                /* Records in the reorder buffer are returned by embedDBNext */                                                \
+                return state->reorderBuffer != NULL ? embedDBNext(state, it, key, data) : 0;                                   \
+            }                                                                                                                  \
+            count_t count = EMBEDDB_GET_COUNT(page);                                                                           \
+            int8_t *record = page + state->headerSize + state->recordSize * it->nextDataRec;                                   \
+            for (; it->nextDataRec < count; record += state->recordSize) {                                                     \
+                KeyType recordKey;                                                                                             \
+                DataType recordData;                                                                                           \
+                memcpy(&recordKey, record, sizeof(KeyType));                                                                   \
+                memcpy(&recordData, record + sizeof(KeyType), sizeof(DataType));                                               \
+                it->nextDataRec++;                                                                                             \
+                if (it->maxKey != NULL && recordKey > maxKey)                                                                  \
+                    return 0;                                                                                                  \
+                if ((it->minData != NULL && recordData < minData) || (it->maxData != NULL && recordData > maxData))            \
+                    continue;                                                                                                  \
+                *key = recordKey;                                                                                              \
+                *data = recordData;                                                                                            \
+                return 1;                                                                                                      \
+            }                                                                                                                  \
+            it->nextDataPage++;                                                                                                \
+            it->nextDataRec = 0;                                                                                               \
+        }                                                                                                                      \
+    }
+
+#ifdef PRINT_ERRORS
+#define EMBEDDB_TABLE_PRINT_ERROR(message) printf(message)
+#else
+#define EMBEDDB_TABLE_PRINT_ERROR(message)
+#endif
+
+#endif
@@ -0,0 +1,262 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_background_writer.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test writing full pages to storage with the background page writer.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#define COMPARE_DATA_PATH "dataFile2.bin"
+#define COMPARE_INDEX_PATH "indexFile2.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#define COMPARE_DATA_PATH "build/artifacts/dataFile2.bin"
+#define COMPARE_INDEX_PATH "build/artifacts/indexFile2.bin"
+#endif
+
+#include "unity.h"
+
+#include "unity.h"
+
+#define NUM_RECORDS 40000
+
+embedDBState *state;
+
+embedDBState *setupEmbedDB(char *dataPath, char *indexPath, int16_t parameters) {
+    embedDBState *newState = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(newState, "Unable to allocate embedDBState.");
+    newState->keySize = 4;
+    newState->dataSize = 4;
+    newState->pageSize = 512;
+    newState->bufferSizeInBlocks = 4;
+    newState->numSplinePoints = 32;
+    newState->bitmapSize = 8;
+    newState->buffer = malloc((size_t)newState->bufferSizeInBlocks * newState->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(newState->buffer, "Failed to allocate buffer for EmbedDB.");
+    newState->numDataPages = 64;
+    newState->numIndexPages = 8;
+    newState->eraseSizeInPages = 4;
+    newState->fileInterface = getFileInterface();
+    newState->dataFile = setupFile(dataPath);
+    newState->indexFile = setupFile(indexPath);
+    newState->parameters = EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | parameters;
+    newState->compareKey = int32Comparator;
+    newState->compareData = int32Comparator;
+    newState->inBitmap = inBitmapInt64;
+    newState->updateBitmap = updateBitmapInt64;
+    newState->buildBitmapFromRange = buildBitmapInt64FromRange;
+    int8_t result = embedDBInit(newState, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+    return newState;
+}
+
+void tearDownEmbedDB(embedDBState *oldState) {
+    free(oldState->buffer);
+    embedDBClose(oldState);
+    tearDownFile(oldState->dataFile);
+    tearDownFile(oldState->indexFile);
+    free(oldState->fileInterface);
+    free(oldState);
+}
+
+void setUp(void) {
+    char dataPath[] = DATA_PATH, indexPath[] = INDEX_PATH;
+    state = setupEmbedDB(dataPath, indexPath, EMBEDDB_RESET_DATA | EMBEDDB_USE_BACKGROUND_WRITER);
+}
+
+void tearDown(void) {
+    tearDownEmbedDB(state);
+}
+
+int32_t dataForKey(uint32_t key) {
+    return (int32_t)(300 + (key * 7) % 700);
+}
+
+void insertRecords(embedDBState *insertState, uint32_t startingKey, uint32_t numRecords) {
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = startingKey + i;
+        int32_t data = dataForKey(key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(insertState, &key, &data), "embedDBPut failed to insert a record.");
+    }
+}
+
+void backgroundWriter_should_write_same_pages_as_synchronous_writes() {
+    char dataPath[] = COMPARE_DATA_PATH, indexPath[] = COMPARE_INDEX_PATH;
+    embedDBState *compareState = setupEmbedDB(dataPath, indexPath, EMBEDDB_RESET_DATA);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->backgroundWriter, "embedDBInit did not start the background writer.");
+    TEST_ASSERT_NULL_MESSAGE(compareState->backgroundWriter, "embedDBInit started a background writer when it was not requested.");
+
+    /* Enough records to wrap both the data and index files so that the writer also has to erase blocks */
+    insertRecords(state, 100, NUM_RECORDS);
+    insertRecords(compareState, 100, NUM_RECORDS);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed with the background writer.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(compareState), "embedDBFlush failed without the background writer.");
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(compareState->nextDataPageId, state->nextDataPageId, "The background writer changed the number of data pages written.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(compareState->minDataPageId, state->minDataPageId, "The background writer changed the minimum data page.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(compareState->nextIdxPageId, state->nextIdxPageId, "The background writer changed the number of index pages written.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(compareState->numWrites, state->numWrites, "The background writer changed the number of page writes recorded.");
+
+    for (uint32_t i = 0; i < state->numDataPages; i++) {
+        readPage(state, i);
+        readPage(compareState, i);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE((int8_t *)compareState->buffer + compareState->pageSize * EMBEDDB_DATA_READ_BUFFER,
+                                         (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER,
+                                         state->pageSize, "Data page written by the background writer did not match the synchronous write.");
+    }
+    for (uint32_t i = 0; i < state->numIndexPages; i++) {
+        readIndexPage(state, i);
+        readIndexPage(compareState, i);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE((int8_t *)compareState->buffer + compareState->pageSize * EMBEDDB_INDEX_READ_BUFFER,
+                                         (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER,
+                                         state->pageSize, "Index page written by the background writer did not match the synchronous write.");
+    }
+
+    tearDownEmbedDB(compareState);
+}
+
+void embedDBGet_should_find_records_on_pages_still_being_written() {
+    /* Query the record at the start of the page that was just handed to the writer, every time a page fills up */
+    uint32_t startingKey = 5000;
+    int32_t actualData = 0;
+    for (uint32_t i = 0; i < 3000; i++) {
+        uint32_t key = startingKey + i;
+        int32_t data = dataForKey(key);
+        id_t pagesWritten = state->nextDataPageId;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut failed to insert a record.");
+        if (state->nextDataPageId != pagesWritten) {
+            uint32_t searchKey = startingKey + pagesWritten * state->maxRecordsPerPage;
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &searchKey, &actualData), "embedDBGet could not find a record on a page queued for writing.");
+            TEST_ASSERT_EQUAL_INT32_MESSAGE(dataForKey(searchKey), actualData, "embedDBGet returned the wrong data for a record on a page queued for writing.");
+        }
+    }
+}
+
+void embedDBIterator_should_return_all_records_written_in_background() {
+    uint32_t startingKey = 20;
+    uint32_t numRecords = 3000;
+    insertRecords(state, startingKey, numRecords);
+
+    embedDBIterator it;
+    uint32_t minKey = startingKey, maxKey = startingKey + numRecords;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+
+    uint32_t key = 0, expectedKey = startingKey;
+    int32_t data = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKey, key, "embedDBNext returned the wrong key with the background writer.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataForKey(key), data, "embedDBNext returned the wrong data with the background writer.");
+        expectedKey++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(startingKey + numRecords, expectedKey, "embedDBNext did not return every record written by the background writer.");
+}
+
+void embedDB_should_recover_pages_written_in_background() {
+    uint32_t startingKey = 1;
+    uint32_t numRecords = 2000;
+    insertRecords(state, startingKey, numRecords);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed with the background writer.");
+    id_t pagesWritten = state->nextDataPageId;
+    tearDownEmbedDB(state);
+
+    char dataPath[] = DATA_PATH, indexPath[] = INDEX_PATH;
+    state = setupEmbedDB(dataPath, indexPath, EMBEDDB_USE_BACKGROUND_WRITER);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(pagesWritten, state->nextDataPageId, "EmbedDB did not recover every page written by the background writer.");
+
+    int32_t actualData = 0;
+    for (uint32_t key = startingKey; key < startingKey + numRecords; key++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &actualData), "embedDBGet could not find a record after recovery.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataForKey(key), actualData, "embedDBGet returned the wrong data after recovery.");
+    }
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+#if defined(EMBEDDB_THREADS_SUPPORTED)
+    RUN_TEST(backgroundWriter_should_write_same_pages_as_synchronous_writes);
+    RUN_TEST(embedDBGet_should_find_records_on_pages_still_being_written);
+    RUN_TEST(embedDBIterator_should_return_all_records_written_in_background);
+    RUN_TEST(embedDB_should_recover_pages_written_in_background);
+#endif
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
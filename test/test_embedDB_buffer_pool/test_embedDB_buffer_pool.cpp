@@ -0,0 +1,338 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_buffer_pool.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the EmbedDB buffer pool.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#define VAR_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#define VAR_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+/* Records per data page with the configuration below */
+#define RECORDS_PER_PAGE 42
+
+/* Bytes of variable data stored with each record. Three records fill more than one variable data page. */
+#define VAR_DATA_SIZE 200
+
+embedDBState *state = NULL;
+
+void setupEmbedDB(int16_t parameters, uint32_t bufferPoolSizeInPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 6;
+    state->numSplinePoints = 32;
+    state->bitmapSize = 1;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 64;
+    state->numIndexPages = 8;
+    state->numVarPages = 16;
+    state->eraseSizeInPages = 4;
+    state->bufferPoolSizeInPages = bufferPoolSizeInPages;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = setupFile(INDEX_PATH);
+    state->varFile = setupFile(VAR_PATH);
+    state->parameters = EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_VDATA | EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(RECORDS_PER_PAGE, state->maxRecordsPerPage, "The number of records per page does not match the test.");
+}
+
+void tearDownEmbedDB() {
+    if (state == NULL) {
+        return;
+    }
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    tearDownFile(state->varFile);
+    free(state->fileInterface);
+    free(state);
+    state = NULL;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Fills the variable data of a record with bytes that depend on its key */
+void fillVarData(int32_t key, uint8_t *varData) {
+    for (uint32_t i = 0; i < VAR_DATA_SIZE; i++) {
+        varData[i] = (uint8_t)(key * 7 + i);
+    }
+}
+
+void insertRecords(int32_t startingKey, int32_t numRecords) {
+    uint8_t varData[VAR_DATA_SIZE];
+    for (int32_t key = startingKey; key < startingKey + numRecords; key++) {
+        int32_t data = key * 3;
+        fillVarData(key, varData);
+        int8_t result = embedDBPutVar(state, &key, &data, varData, VAR_DATA_SIZE);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPutVar did not correctly insert data.");
+    }
+}
+
+void assertGet(int32_t key) {
+    int32_t data = 0;
+    char message[100];
+    snprintf(message, 100, "embedDBGet could not find key %li.", (long)key);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(key * 3, data, "embedDBGet returned the wrong data.");
+}
+
+void assertGetVar(int32_t key) {
+    int32_t data = 0;
+    uint8_t expected[VAR_DATA_SIZE];
+    uint8_t varData[VAR_DATA_SIZE];
+    embedDBVarDataStream *stream = NULL;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &data, &stream), "embedDBGetVar could not find the record.");
+    TEST_ASSERT_NOT_NULL_MESSAGE(stream, "embedDBGetVar did not return the variable data.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(VAR_DATA_SIZE, embedDBVarDataStreamRead(state, stream, varData, VAR_DATA_SIZE), "The variable data stream did not read the correct number of bytes.");
+    free(stream);
+    fillVarData(key, expected);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(key * 3, data, "embedDBGetVar returned the wrong data.");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, varData, VAR_DATA_SIZE, "embedDBGetVar returned the wrong variable data.");
+}
+
+void bufferPool_should_stop_alternating_gets_from_reading_storage() {
+    setupEmbedDB(EMBEDDB_USE_BUFFER_POOL, 16);
+    insertRecords(0, 10 * RECORDS_PER_PAGE);
+    embedDBFlush(state);
+
+    /* Keys on data pages 2 and 7, so every get misses the single page read buffer */
+    int32_t firstKey = 2 * RECORDS_PER_PAGE + 5, secondKey = 7 * RECORDS_PER_PAGE + 5;
+    assertGet(firstKey);
+    assertGet(secondKey);
+    embedDBResetStats(state);
+    for (int32_t i = 0; i < 20; i++) {
+        assertGet(firstKey);
+        assertGet(secondKey);
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numReads, "Gets alternating between two pages read from storage.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(40, state->bufferPoolHits, "Every get should have been a buffer pool hit.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->bufferPoolMisses, "No get should have missed the buffer pool.");
+}
+
+void bufferPool_should_replace_pages_that_have_not_been_used_recently() {
+    setupEmbedDB(EMBEDDB_USE_BUFFER_POOL, 4);
+    insertRecords(0, 10 * RECORDS_PER_PAGE);
+    embedDBFlush(state);
+
+    /* Fill the pool with data pages 0 to 3, then use page 0 again */
+    for (int32_t page = 0; page < 4; page++) {
+        assertGet(page * RECORDS_PER_PAGE);
+    }
+    assertGet(RECORDS_PER_PAGE);
+    assertGet(0);
+
+    /* Page 4 replaces a page that has not been used since the clock hand last passed it, so page 0 survives a pass of the hand */
+    embedDBResetStats(state);
+    assertGet(4 * RECORDS_PER_PAGE);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->bufferPoolMisses, "Page 4 should not have been in the buffer pool.");
+    assertGet(0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->bufferPoolHits, "Page 0 was replaced although it was used after the other pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->numReads, "Only page 4 should have been read from storage.");
+}
+
+void bufferPool_should_not_return_pages_that_were_overwritten() {
+    setupEmbedDB(EMBEDDB_USE_BUFFER_POOL, 128);
+    int32_t numRecords = 0;
+
+    /* Query everything after each batch, so the pool holds every physical page when the files wrap around and overwrite them */
+    for (int32_t batch = 0; batch < 6; batch++) {
+        insertRecords(numRecords, 20 * RECORDS_PER_PAGE);
+        numRecords += 20 * RECORDS_PER_PAGE;
+        embedDBFlush(state);
+
+        int32_t minKey = state->minDataPageId * RECORDS_PER_PAGE;
+        for (int32_t key = minKey; key < numRecords; key += 7) {
+            assertGet(key);
+        }
+        int32_t erasedKey = minKey - 1;
+        int32_t data = 0;
+        if (erasedKey >= 0) {
+            TEST_ASSERT_TRUE_MESSAGE(embedDBGet(state, &erasedKey, &data) != 0, "embedDBGet found a key from an overwritten page.");
+        }
+        for (int32_t key = numRecords - 20; key < numRecords; key++) {
+            assertGetVar(key);
+        }
+    }
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->minDataPageId, "The data file did not wrap.");
+}
+
+void bufferPool_should_cache_variable_data_pages() {
+    setupEmbedDB(EMBEDDB_USE_BUFFER_POOL, 16);
+    insertRecords(0, 10);
+    embedDBFlush(state);
+
+    /* Alternate between records whose variable data is on different pages */
+    assertGetVar(1);
+    assertGetVar(8);
+    embedDBResetStats(state);
+    for (int32_t i = 0; i < 10; i++) {
+        assertGetVar(1);
+        assertGetVar(8);
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numReads, "Reading variable data from two pages read from storage.");
+}
+
+void bufferPool_should_cache_pages_read_by_iterators() {
+    setupEmbedDB(EMBEDDB_USE_BUFFER_POOL, 32);
+    insertRecords(0, 20 * RECORDS_PER_PAGE);
+    embedDBFlush(state);
+
+    for (int32_t pass = 0; pass < 2; pass++) {
+        embedDBResetStats(state);
+        embedDBIterator it;
+        int32_t minKey = 3 * RECORDS_PER_PAGE, maxKey = 12 * RECORDS_PER_PAGE;
+        it.minKey = &minKey;
+        it.maxKey = &maxKey;
+        it.minData = NULL;
+        it.maxData = NULL;
+        embedDBInitIterator(state, &it);
+
+        int32_t key = 0, data = 0, expectedKey = minKey;
+        while (embedDBNext(state, &it, &key, &data)) {
+            TEST_ASSERT_EQUAL_INT32_MESSAGE(expectedKey, key, "embedDBNext returned the wrong key.");
+            TEST_ASSERT_EQUAL_INT32_MESSAGE(key * 3, data, "embedDBNext returned the wrong data.");
+            expectedKey++;
+        }
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(maxKey + 1, expectedKey, "embedDBNext did not return every record in the range.");
+        embedDBCloseIterator(&it);
+
+        if (pass == 1) {
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numReads, "Iterating over the same range again read data pages from storage.");
+        }
+    }
+}
+
+void bufferPool_should_be_freed_when_init_fails() {
+    embedDBState *failedState = (embedDBState *)calloc(1, sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(failedState, "Unable to allocate embedDBState.");
+    failedState->keySize = 4;
+    failedState->dataSize = 4;
+    failedState->pageSize = 512;
+    failedState->bufferSizeInBlocks = 2;
+    failedState->buffer = malloc((size_t)failedState->bufferSizeInBlocks * failedState->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(failedState->buffer, "Failed to allocate buffer for EmbedDB.");
+    failedState->numDataPages = 64;
+    failedState->eraseSizeInPages = 4;
+    failedState->bufferPoolSizeInPages = 8;
+    failedState->fileInterface = getFileInterface();
+    /* Without a data file, embedDBInit fails after the buffer pool is allocated */
+    failedState->dataFile = NULL;
+    failedState->parameters = EMBEDDB_USE_BUFFER_POOL | EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_RESET_DATA;
+    failedState->compareKey = int32Comparator;
+    failedState->compareData = int32Comparator;
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(failedState, 1), "EmbedDB initialized without a data file.");
+    TEST_ASSERT_NULL_MESSAGE(failedState->bufferPool, "The buffer pool was not freed when embedDBInit failed.");
+
+    free(failedState->buffer);
+    free(failedState->fileInterface);
+    free(failedState);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(bufferPool_should_stop_alternating_gets_from_reading_storage);
+    RUN_TEST(bufferPool_should_replace_pages_that_have_not_been_used_recently);
+    RUN_TEST(bufferPool_should_not_return_pages_that_were_overwritten);
+    RUN_TEST(bufferPool_should_cache_variable_data_pages);
+    RUN_TEST(bufferPool_should_cache_pages_read_by_iterators);
+    RUN_TEST(bufferPool_should_be_freed_when_init_fails);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
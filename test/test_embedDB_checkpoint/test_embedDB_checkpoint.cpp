@@ -0,0 +1,419 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_checkpoint.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB recovery from a metadata checkpoint.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#define VAR_PATH "varFile.bin"
+#define CHECKPOINT_PATH "checkpointFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#define VAR_PATH "build/artifacts/varFile.bin"
+#define CHECKPOINT_PATH "build/artifacts/checkpointFile.bin"
+/* On the desktop platform, there is a file interface which simulates "erasing" by writing out all 1's to the location in the file ot be erased */
+#define MOCK_ERASE_INTERFACE
+#endif
+
+#include "unity.h"
+
+/* Records per data page with the configuration below */
+#define RECORDS_PER_PAGE 60
+
+/* Pages in each checkpoint slot with the configuration below */
+#define CHECKPOINT_SLOT_PAGES 4
+
+embedDBState *state;
+
+/* Counts the reads made from the data file, so the tests can check how much of it recovery scans */
+int8_t (*storageRead)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+void *countedFile = NULL;
+uint32_t dataFileReads = 0;
+
+/* Size of the data file pages when using EMBEDDB_USE_COMPRESSION or EMBEDDB_USE_KEY_OFFSETS */
+count_t compressedPageSize = 256;
+
+int8_t countingRead(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    if (file == countedFile)
+        dataFileReads++;
+    return storageRead(buffer, pageNum, pageSize, file);
+}
+
+void setupEmbedDB(uint32_t parameters, uint32_t checkpointInterval) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 6;
+    state->numSplinePoints = 32;
+    state->bitmapSize = 8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 64;
+    state->numIndexPages = 8;
+    state->numVarPages = 16;
+    state->eraseSizeInPages = 4;
+    state->checkpointInterval = checkpointInterval;
+    state->compressedPageSize = compressedPageSize;
+    state->keyOffsetSize = 2;
+#ifdef MOCK_ERASE_INTERFACE
+    state->fileInterface = getMockEraseFileInterface();
+#else
+    state->fileInterface = getFileInterface();
+#endif
+    storageRead = state->fileInterface->read;
+    state->fileInterface->read = countingRead;
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = setupFile(INDEX_PATH);
+    if (EMBEDDB_USING_VDATA(parameters)) {
+        state->varFile = setupFile(VAR_PATH);
+    }
+    state->checkpointFile = setupFile(CHECKPOINT_PATH);
+    state->parameters = EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_USE_CHECKPOINT | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt64;
+    state->updateBitmap = updateBitmapInt64;
+    state->buildBitmapFromRange = buildBitmapInt64FromRange;
+    countedFile = state->dataFile;
+    dataFileReads = 0;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    if (EMBEDDB_USING_VDATA(state->parameters)) {
+        tearDownFile(state->varFile);
+    }
+    tearDownFile(state->checkpointFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+void insertRecords(int32_t startingKey, int32_t numRecords) {
+    for (int32_t key = startingKey; key < startingKey + numRecords; key++) {
+        int32_t data = key * 3;
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+void queryRecords(int32_t startingKey, int32_t numRecords) {
+    int32_t data = 0;
+    char message[100];
+    for (int32_t key = startingKey; key < startingKey + numRecords; key++) {
+        snprintf(message, 100, "embedDBGet could not find key %li after recovering from a checkpoint.", (long)key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(key * 3, data, "embedDBGet returned the wrong data after recovering from a checkpoint.");
+    }
+}
+
+/* Overwrites the first page of a checkpoint slot, as if writing that checkpoint had been interrupted */
+void corruptCheckpointSlot(uint32_t slot) {
+    embedDBFileInterface *fileInterface = getFileInterface();
+    char checkpointPath[] = CHECKPOINT_PATH;
+    void *checkpointFile = setupFile(checkpointPath);
+    TEST_ASSERT_TRUE_MESSAGE(fileInterface->open(checkpointFile, EMBEDDB_FILE_MODE_R_PLUS_B), "Unable to open checkpoint file.");
+    int8_t page[512];
+    memset(page, 0x5A, 512);
+    TEST_ASSERT_TRUE_MESSAGE(fileInterface->write(page, slot * CHECKPOINT_SLOT_PAGES, 512, checkpointFile), "Unable to overwrite checkpoint slot.");
+    fileInterface->close(checkpointFile);
+    tearDownFile(checkpointFile);
+    free(fileInterface);
+}
+
+typedef struct {
+    id_t nextDataPageId;
+    uint32_t minDataPageId;
+    uint32_t numAvailDataPages;
+    int32_t maxError;
+    id_t nextIdxPageId;
+    uint32_t minIndexPageId;
+    uint32_t numAvailIndexPages;
+    size_t splineCount;
+    uint32_t splineNumAddCalls;
+} savedState;
+
+savedState saveState() {
+    savedState saved;
+    saved.nextDataPageId = state->nextDataPageId;
+    saved.minDataPageId = state->minDataPageId;
+    saved.numAvailDataPages = state->numAvailDataPages;
+    saved.maxError = state->maxError;
+    saved.nextIdxPageId = state->nextIdxPageId;
+    saved.minIndexPageId = state->minIndexPageId;
+    saved.numAvailIndexPages = state->numAvailIndexPages;
+    saved.splineCount = state->spl->count;
+    saved.splineNumAddCalls = state->spl->numAddCalls;
+    return saved;
+}
+
+void assertStateRecovered(savedState saved) {
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(saved.nextDataPageId, state->nextDataPageId, "nextDataPageId was not recovered.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(saved.minDataPageId, state->minDataPageId, "minDataPageId was not recovered.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(saved.numAvailDataPages, state->numAvailDataPages, "numAvailDataPages was not recovered.");
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(saved.maxError, state->maxError, "maxError was not recovered.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(saved.nextIdxPageId, state->nextIdxPageId, "nextIdxPageId was not recovered.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(saved.minIndexPageId, state->minIndexPageId, "minIndexPageId was not recovered.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(saved.numAvailIndexPages, state->numAvailIndexPages, "numAvailIndexPages was not recovered.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(saved.splineCount, state->spl->count, "The spline was not recovered with the same number of points.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(saved.splineNumAddCalls, state->spl->numAddCalls, "The spline was not recovered with the same number of pages.");
+}
+
+void embedDBFlush_should_write_checkpoint_that_recovers_without_scanning() {
+    setupEmbedDB(EMBEDDB_RESET_DATA, 0);
+    insertRecords(0, 2500);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush did not write the checkpoint.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->checkpointSequence, "embedDBFlush did not write a checkpoint.");
+    savedState saved = saveState();
+    tearDownEmbedDB();
+
+    setupEmbedDB(0, 0);
+    /* One read to check the last checkpointed page and one to find there are no pages after it */
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(2, dataFileReads, "Recovery scanned the data file despite an up to date checkpoint.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->checkpointSequence, "The checkpoint was not loaded.");
+    assertStateRecovered(saved);
+    queryRecords(0, 2500);
+}
+
+void embedDB_should_replay_pages_written_after_checkpoint() {
+    setupEmbedDB(EMBEDDB_RESET_DATA, 0);
+    insertRecords(0, 2500);
+    embedDBFlush(state);
+    insertRecords(2500, 20 * RECORDS_PER_PAGE);
+    savedState saved = saveState();
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(61, saved.nextDataPageId, "EmbedDB did not write the expected number of pages.");
+    tearDownEmbedDB();
+
+    setupEmbedDB(0, 0);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(19 + 3, dataFileReads, "Recovery read more than the pages written after the checkpoint.");
+    assertStateRecovered(saved);
+    queryRecords(0, 2500 + 19 * RECORDS_PER_PAGE);
+}
+
+void embedDB_should_write_checkpoint_every_checkpointInterval_pages() {
+    setupEmbedDB(EMBEDDB_RESET_DATA, 8);
+    insertRecords(0, 20 * RECORDS_PER_PAGE + 1);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(20, state->nextDataPageId, "EmbedDB did not write the expected number of pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, state->checkpointSequence, "EmbedDB did not write a checkpoint every 8 pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(16, state->lastCheckpointDataPageId, "The last checkpoint was not written after page 16.");
+}
+
+void embedDB_should_recover_wrapped_data_from_checkpoint() {
+    setupEmbedDB(EMBEDDB_RESET_DATA, 8);
+    insertRecords(0, 200 * RECORDS_PER_PAGE + 30);
+    savedState saved = saveState();
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(200, saved.nextDataPageId, "EmbedDB did not write the expected number of pages.");
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, saved.minDataPageId, "The data file did not wrap.");
+    tearDownEmbedDB();
+
+    setupEmbedDB(0, 8);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(25, state->checkpointSequence, "The most recent checkpoint was not loaded.");
+    /* Check the last checkpointed page, find the page after it is from before the wrap, and reload the last page */
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(3, dataFileReads, "Recovery scanned the data file despite an up to date checkpoint.");
+    assertStateRecovered(saved);
+    queryRecords(saved.minDataPageId * RECORDS_PER_PAGE, (200 - saved.minDataPageId) * RECORDS_PER_PAGE);
+}
+
+void embedDB_should_use_previous_checkpoint_when_latest_is_corrupt() {
+    setupEmbedDB(EMBEDDB_RESET_DATA, 8);
+    insertRecords(0, 200 * RECORDS_PER_PAGE + 30);
+    savedState saved = saveState();
+    tearDownEmbedDB();
+
+    /* Checkpoint 25 is in slot 1 */
+    corruptCheckpointSlot(1);
+
+    setupEmbedDB(0, 8);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(24, state->checkpointSequence, "The previous checkpoint was not loaded.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(8 + 3, dataFileReads, "Recovery read more than the pages written after the previous checkpoint.");
+    assertStateRecovered(saved);
+    queryRecords(saved.minDataPageId * RECORDS_PER_PAGE, (200 - saved.minDataPageId) * RECORDS_PER_PAGE);
+}
+
+void embedDB_should_scan_data_file_when_no_checkpoint_is_valid() {
+    setupEmbedDB(EMBEDDB_RESET_DATA, 8);
+    insertRecords(0, 200 * RECORDS_PER_PAGE + 30);
+    savedState saved = saveState();
+    tearDownEmbedDB();
+
+    corruptCheckpointSlot(0);
+    corruptCheckpointSlot(1);
+
+    setupEmbedDB(0, 8);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->checkpointSequence, "A corrupt checkpoint was loaded.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(saved.nextDataPageId, state->nextDataPageId, "nextDataPageId was not recovered by scanning the data file.");
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(saved.minDataPageId, state->minDataPageId, "Scanning the data file recovered pages that were erased.");
+    queryRecords(state->minDataPageId * RECORDS_PER_PAGE, (200 - state->minDataPageId) * RECORDS_PER_PAGE);
+}
+
+void embedDB_should_recover_variable_data_from_checkpoint() {
+    setupEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_VDATA, 0);
+    char variableData[13] = "Hello World!";
+    for (int32_t key = 0; key < 1500; key++) {
+        int32_t data = key * 3;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutVar(state, &key, &data, variableData, 13), "embedDBPutVar did not correctly insert data.");
+        if (key == 999) {
+            embedDBFlush(state);
+        }
+    }
+    id_t nextVarPageId = state->nextVarPageId;
+    uint32_t numAvailVarPages = state->numAvailVarPages;
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(16, nextVarPageId, "The variable data file did not wrap.");
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_VDATA, 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextVarPageId, state->nextVarPageId, "nextVarPageId was not recovered.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numAvailVarPages, state->numAvailVarPages, "numAvailVarPages was not recovered.");
+
+    int32_t key = 1400;
+    TEST_ASSERT_TRUE_MESSAGE(state->compareKey(&state->minVarRecordId, &key) <= 0, "minVarRecordId does not include records whose variable data is still stored.");
+    int32_t data = 0;
+    char variableDataBuffer[13];
+    embedDBVarDataStream *stream = NULL;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetVar(state, &key, &data, &stream), "embedDBGetVar could not find a record after recovering from a checkpoint.");
+    TEST_ASSERT_NOT_NULL_MESSAGE(stream, "embedDBGetVar did not return the variable data after recovering from a checkpoint.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(13, embedDBVarDataStreamRead(state, stream, variableDataBuffer, 13), "The variable data stream did not read the correct number of bytes.");
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(key * 3, data, "embedDBGetVar returned the wrong data after recovering from a checkpoint.");
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE(variableData, variableDataBuffer, 13, "embedDBGetVar returned the wrong variable data after recovering from a checkpoint.");
+    free(stream);
+}
+
+void embedDB_should_ignore_checkpoint_written_with_different_compression() {
+    compressedPageSize = 256;
+    setupEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_COMPRESSION, 0);
+    insertRecords(0, 2500);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush did not write the checkpoint.");
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_COMPRESSION, 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->checkpointSequence, "The checkpoint was not loaded with the same compression setting.");
+    tearDownEmbedDB();
+
+    compressedPageSize = 384;
+    setupEmbedDB(EMBEDDB_USE_COMPRESSION, 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->checkpointSequence, "A checkpoint written with a different compressed page size was loaded.");
+    tearDownEmbedDB();
+
+    compressedPageSize = 256;
+    setupEmbedDB(0, 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->checkpointSequence, "A checkpoint written with compression was loaded without compression.");
+}
+
+void embedDB_should_ignore_checkpoint_written_with_different_key_offset_setting() {
+    /* Full size data file pages, so only the key offset setting differs when reopening without it */
+    compressedPageSize = 512;
+    setupEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_KEY_OFFSETS, 0);
+    insertRecords(0, 2500);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush did not write the checkpoint.");
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_KEY_OFFSETS, 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->checkpointSequence, "The checkpoint was not loaded with the same key offset setting.");
+    tearDownEmbedDB();
+
+    setupEmbedDB(0, 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->checkpointSequence, "A checkpoint written with key offsets was loaded without them.");
+    compressedPageSize = 256;
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBFlush_should_write_checkpoint_that_recovers_without_scanning);
+    RUN_TEST(embedDB_should_replay_pages_written_after_checkpoint);
+    RUN_TEST(embedDB_should_write_checkpoint_every_checkpointInterval_pages);
+    RUN_TEST(embedDB_should_recover_wrapped_data_from_checkpoint);
+    RUN_TEST(embedDB_should_use_previous_checkpoint_when_latest_is_corrupt);
+    RUN_TEST(embedDB_should_scan_data_file_when_no_checkpoint_is_valid);
+    RUN_TEST(embedDB_should_recover_variable_data_from_checkpoint);
+    RUN_TEST(embedDB_should_ignore_checkpoint_written_with_different_compression);
+    RUN_TEST(embedDB_should_ignore_checkpoint_written_with_different_key_offset_setting);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
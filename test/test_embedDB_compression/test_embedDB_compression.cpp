@@ -0,0 +1,473 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_compression.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB compressed data pages.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+/* Records the page size of the writes to the data file */
+int8_t (*storageWrite)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+uint32_t dataFileWriteSize = 0;
+
+/* Settings rejected by embedDBInit leave the files unopened, so the state is freed without closing it */
+int8_t embedDBOpened = 0;
+
+int8_t recordingWrite(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    if (file == state->dataFile) {
+        dataFileWriteSize = pageSize;
+    }
+    return storageWrite(buffer, pageNum, pageSize, file);
+}
+
+typedef struct {
+    int32_t temperature;
+    uint8_t samples[16];
+} wideReading;
+
+void configureState(uint32_t parameters, count_t compressedPageSize, uint32_t numDataPages) {
+    state = (embedDBState *)calloc(1, sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->pageSize = 512;
+    state->compressedPageSize = compressedPageSize;
+    state->bufferSizeInBlocks = EMBEDDB_COMPRESSION_BUFFER(parameters) + 1;
+    state->numSplinePoints = 64;
+    state->bitmapSize = 1;
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    storageWrite = state->fileInterface->write;
+    state->fileInterface->write = recordingWrite;
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = EMBEDDB_USING_INDEX(parameters) ? setupFile(INDEX_PATH) : NULL;
+    state->parameters = EMBEDDB_USE_COMPRESSION | parameters;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->inBitmap = inBitmapInt8;
+}
+
+int8_t openEmbedDB(uint32_t parameters, count_t compressedPageSize, uint32_t numDataPages) {
+    configureState(parameters, compressedPageSize, numDataPages);
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    int8_t result = embedDBInit(state, 1);
+    embedDBOpened = result == 0;
+    return result;
+}
+
+void tearDownEmbedDB() {
+    if (state == NULL) {
+        return;
+    }
+    free(state->buffer);
+    if (embedDBOpened) {
+        embedDBClose(state);
+    }
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+    state = NULL;
+}
+
+void setUp(void) {
+    dataFileWriteSize = 0;
+}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Sensor readings taken about every 10 seconds that change slowly */
+uint32_t readingKey(uint32_t record) {
+    return 1000000 + record * 10 + record % 3;
+}
+
+int32_t readingData(uint32_t record) {
+    return 200 + (int32_t)((record / 50) % 20);
+}
+
+void insertReadings(uint32_t numRecords) {
+    for (uint32_t record = 0; record < numRecords; record++) {
+        uint32_t key = readingKey(record);
+        int32_t data = readingData(record);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert a record.");
+    }
+}
+
+void assertReadingsFound(uint32_t firstRecord, uint32_t numRecords) {
+    for (uint32_t record = firstRecord; record < numRecords; record++) {
+        uint32_t key = readingKey(record);
+        int32_t data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record on a compressed page.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(readingData(record), data, "embedDBGet returned the wrong data from a compressed page.");
+    }
+}
+
+void compression_should_store_more_records_in_each_data_file_page() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 128, 1000));
+    uint32_t numRecords = 5000;
+    insertReadings(numRecords);
+    TEST_ASSERT_EQUAL_INT8(0, embedDBFlush(state));
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(128, dataFileWriteSize, "Data pages were not written with the compressed page size.");
+    uint32_t uncompressedRecordsPerPage = (128 - state->headerSize) / state->recordSize;
+    uint32_t uncompressedPages = (numRecords + uncompressedRecordsPerPage - 1) / uncompressedRecordsPerPage;
+    TEST_ASSERT_TRUE_MESSAGE(state->nextDataPageId * 3 < uncompressedPages, "Compressed pages did not hold at least three times as many records.");
+    assertReadingsFound(0, numRecords);
+
+    uint32_t key = readingKey(100) + 1;
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was not inserted.");
+}
+
+void compression_should_return_records_in_order_from_iterators() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP, 128, 1000));
+    uint32_t numRecords = 3000;
+    insertReadings(numRecords);
+
+    uint32_t minKey = readingKey(500), maxKey = readingKey(2500);
+    int32_t minData = 205;
+    embedDBIterator it;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = &minData;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key = 0, numFound = 0, record = 500;
+    int32_t data = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        while (readingData(record) < minData) {
+            record++;
+        }
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(readingKey(record), key, "embedDBNext returned the wrong key from a compressed page.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(readingData(record), data, "embedDBNext returned the wrong data from a compressed page.");
+        record++;
+        numFound++;
+    }
+    embedDBCloseIterator(&it);
+    uint32_t numExpected = 0;
+    for (uint32_t i = 500; i <= 2500; i++) {
+        numExpected += readingData(i) >= minData ? 1 : 0;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numExpected, numFound, "embedDBNext did not return every record in the range.");
+
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    embedDBInitReverseIterator(state, &it);
+    record = numRecords;
+    while (embedDBPrev(state, &it, &key, &data)) {
+        record--;
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(readingKey(record), key, "embedDBPrev returned the wrong key from a compressed page.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(readingData(record), data, "embedDBPrev returned the wrong data from a compressed page.");
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, record, "embedDBPrev did not return every record.");
+}
+
+void compression_should_read_pages_into_readahead_windows_and_iterator_buffers() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 128, 1000));
+    uint32_t numRecords = 4000;
+    insertReadings(numRecords);
+
+    void *window = malloc(4 * state->pageSize);
+    void *pageBuffer = malloc(state->pageSize);
+    TEST_ASSERT_TRUE_MESSAGE(window != NULL && pageBuffer != NULL, "Failed to allocate iterator buffers.");
+    for (int useWindow = 0; useWindow < 2; useWindow++) {
+        embedDBIterator it;
+        it.minKey = NULL;
+        it.maxKey = NULL;
+        it.minData = NULL;
+        it.maxData = NULL;
+        embedDBInitIterator(state, &it);
+        if (useWindow) {
+            embedDBIteratorSetReadahead(&it, window, 4);
+        } else {
+            embedDBIteratorSetBuffer(&it, pageBuffer);
+        }
+        uint32_t key = 0, record = 0;
+        int32_t data = 0;
+        while (embedDBNext(state, &it, &key, &data)) {
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(readingKey(record), key, "Iterator buffer returned the wrong key from a compressed page.");
+            TEST_ASSERT_EQUAL_INT32_MESSAGE(readingData(record), data, "Iterator buffer returned the wrong data from a compressed page.");
+            record++;
+        }
+        embedDBCloseIterator(&it);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords, record, "Iterator did not return every record.");
+    }
+    free(window);
+    free(pageBuffer);
+}
+
+void compression_should_recover_records_after_reopening() {
+    uint32_t parameters = EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP;
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | parameters, 128, 1000));
+    uint32_t numRecords = 2500;
+    insertReadings(numRecords);
+    TEST_ASSERT_EQUAL_INT8(0, embedDBFlush(state));
+    id_t nextDataPageId = state->nextDataPageId;
+    tearDownEmbedDB();
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, openEmbedDB(parameters, 128, 1000), "EmbedDB did not reopen a compressed data file.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextDataPageId, state->nextDataPageId, "Recovery did not find every compressed page.");
+    assertReadingsFound(0, numRecords);
+
+    /* Records continue after the recovered pages */
+    for (uint32_t record = numRecords; record < numRecords + 1000; record++) {
+        uint32_t key = readingKey(record);
+        int32_t data = readingData(record);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert a record after recovery.");
+    }
+    uint32_t key = readingKey(numRecords - 1);
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &key, &data), "embedDBPut accepted a key that was not larger than the recovered keys.");
+    assertReadingsFound(0, numRecords + 1000);
+}
+
+void compression_should_keep_the_newest_records_when_the_data_file_wraps() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 128, 16));
+    uint32_t numRecords = 6000;
+    insertReadings(numRecords);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key = 0, firstKey = 0, numFound = 0;
+    int32_t data = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        if (numFound == 0) {
+            firstKey = key;
+        }
+        numFound++;
+    }
+    embedDBCloseIterator(&it);
+
+    uint32_t firstRecord = numRecords - numFound;
+    TEST_ASSERT_TRUE_MESSAGE(firstRecord > 0, "The data file did not wrap around.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(readingKey(firstRecord), firstKey, "The iterator did not start at the oldest record kept.");
+    assertReadingsFound(firstRecord, numRecords);
+    key = readingKey(0);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a record on an erased page.");
+}
+
+void compression_should_store_partial_pages_from_flush_and_put_batch() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 96, 1000));
+    uint32_t keys[700];
+    int32_t datas[700];
+    uint32_t record = 0;
+    for (int batch = 0; batch < 5; batch++) {
+        uint32_t batchSize = 100 + batch * 7;
+        for (uint32_t i = 0; i < batchSize; i++) {
+            keys[i] = readingKey(record + i);
+            datas[i] = readingData(record + i);
+        }
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys, datas, batchSize), "embedDBPutBatch did not insert a batch.");
+        record += batchSize;
+        TEST_ASSERT_EQUAL_INT8(0, embedDBFlush(state));
+    }
+    keys[0] = readingKey(record - 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPutBatch(state, keys, datas, 1), "embedDBPutBatch accepted a key that was not larger than the keys of a flushed page.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, keys, datas), "embedDBPut accepted a key that was not larger than the keys of a flushed page.");
+    keys[0] = readingKey(record);
+    datas[0] = readingData(record);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, keys, datas), "embedDBPut did not insert a record after a flushed page.");
+    record++;
+    assertReadingsFound(0, record);
+}
+
+void compression_should_round_trip_wide_records_and_large_key_gaps() {
+    configureState(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 256, 1000);
+    state->keySize = 8;
+    state->dataSize = sizeof(wideReading);
+    state->compareKey = int64Comparator;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    TEST_ASSERT_EQUAL_INT8(0, embedDBInit(state, 1));
+    embedDBOpened = 1;
+
+    uint32_t numRecords = 3000;
+    uint64_t key = 5;
+    uint32_t seed = 12345;
+    for (uint32_t record = 0; record < numRecords; record++) {
+        seed = seed * 1103515245u + 12345u;
+        key += record % 97 == 0 ? ((uint64_t)1 << 40) + seed : 1 + seed % 3;
+        wideReading data;
+        data.temperature = (int32_t)(seed % 1000) - 500;
+        for (int i = 0; i < 16; i++) {
+            data.samples[i] = i < 4 ? (uint8_t)(record >> (i * 3)) : (uint8_t)i;
+        }
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert a wide record.");
+    }
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint64_t expectedKey = 5, foundKey = 0;
+    seed = 12345;
+    wideReading found, expected;
+    uint32_t record = 0;
+    while (embedDBNext(state, &it, &foundKey, &found)) {
+        seed = seed * 1103515245u + 12345u;
+        expectedKey += record % 97 == 0 ? ((uint64_t)1 << 40) + seed : 1 + seed % 3;
+        expected.temperature = (int32_t)(seed % 1000) - 500;
+        for (int i = 0; i < 16; i++) {
+            expected.samples[i] = i < 4 ? (uint8_t)(record >> (i * 3)) : (uint8_t)i;
+        }
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(expectedKey, foundKey, "embedDBNext returned the wrong 8 byte key from a compressed page.");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expected, &found, sizeof(wideReading), "embedDBNext returned the wrong wide data from a compressed page.");
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &foundKey, &found), "embedDBGet did not find a wide record.");
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expected, &found, sizeof(wideReading), "embedDBGet returned the wrong wide data from a compressed page.");
+        record++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords, record, "embedDBNext did not return every wide record.");
+}
+
+void compression_should_reject_unsupported_settings() {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_RESET_DATA, 513, 1000), "embedDBInit accepted a compressed page size larger than the page size.");
+    tearDownEmbedDB();
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 24, 1000), "embedDBInit accepted a compressed page size without room for a record.");
+    tearDownEmbedDB();
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_RECORD_LEVEL_CONSISTENCY, 128, 1000), "embedDBInit accepted record-level consistency with compression.");
+    tearDownEmbedDB();
+
+    configureState(EMBEDDB_RESET_DATA | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP, 128, 1000);
+    state->bufferSizeInBlocks = 4;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    embedDBOpened = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "embedDBInit accepted a buffer without a page for compression.");
+}
+
+void compression_should_leave_nothing_allocated_when_init_fails() {
+    configureState(EMBEDDB_USE_BUFFER_POOL | EMBEDDB_USE_REORDER_BUFFER | EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_RESET_DATA, 128, 1000);
+    state->bufferPoolSizeInPages = 8;
+    state->reorderBufferSize = 16;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+
+    /* Without a data file, embedDBInit fails after compression, the reorder buffer and the buffer pool are set up */
+    void *dataFile = state->dataFile;
+    state->dataFile = NULL;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "EmbedDB initialized without a data file.");
+    TEST_ASSERT_NULL_MESSAGE(state->reorderBuffer, "The reorder buffer was not freed when embedDBInit failed.");
+    TEST_ASSERT_NULL_MESSAGE(state->bufferPool, "The buffer pool was not freed when embedDBInit failed.");
+
+    /* The same state and buffer can be initialized again */
+    state->dataFile = dataFile;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize after a failed init.");
+    embedDBOpened = 1;
+    insertReadings(500);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush failed after a failed init.");
+    assertReadingsFound(0, 500);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(compression_should_store_more_records_in_each_data_file_page);
+    RUN_TEST(compression_should_return_records_in_order_from_iterators);
+    RUN_TEST(compression_should_read_pages_into_readahead_windows_and_iterator_buffers);
+    RUN_TEST(compression_should_recover_records_after_reopening);
+    RUN_TEST(compression_should_keep_the_newest_records_when_the_data_file_wraps);
+    RUN_TEST(compression_should_store_partial_pages_from_flush_and_put_batch);
+    RUN_TEST(compression_should_round_trip_wide_records_and_large_key_gaps);
+    RUN_TEST(compression_should_reject_unsupported_settings);
+    RUN_TEST(compression_should_leave_nothing_allocated_when_init_fails);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
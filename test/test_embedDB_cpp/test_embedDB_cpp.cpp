@@ -0,0 +1,390 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_cpp.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the typed C++ interface to EmbedDB.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define OTHER_DATA_PATH "dataFile2.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define OTHER_DATA_PATH "build/artifacts/dataFile2.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+/* The typed interface needs C++17, which some board toolchains do not default to */
+#if __cplusplus >= 201703L
+
+#ifdef DIST
+#include "embedDB.hpp"
+#else
+#include "embedDB/embedDB.hpp"
+#endif
+
+typedef embeddb::EmbedDB<uint32_t, int32_t> SensorDB;
+
+/* A record without operator<, ordered by temperature */
+struct Reading {
+    int16_t temperature;
+    uint16_t humidity;
+};
+
+struct TemperatureOrder {
+    static bool less(const Reading &a, const Reading &b) { return a.temperature < b.temperature; }
+    static int8_t compare(void *a, void *b) {
+        Reading x, y;
+        memcpy(&x, a, sizeof(Reading));
+        memcpy(&y, b, sizeof(Reading));
+        return less(x, y) ? -1 : (less(y, x) ? 1 : 0);
+    }
+};
+
+typedef embeddb::EmbedDB<uint64_t, Reading, TemperatureOrder> ReadingDB;
+
+embeddb::Storage makeStorage(bool useIndex, const char *dataFilePath = DATA_PATH) {
+    embeddb::Storage storage;
+    char dataPath[64], indexPath[] = INDEX_PATH;
+    strncpy(dataPath, dataFilePath, sizeof(dataPath) - 1);
+    dataPath[sizeof(dataPath) - 1] = '\0';
+    storage.fileInterface = getFileInterface();
+    storage.dataFile = setupFile(dataPath);
+    storage.indexFile = useIndex ? setupFile(indexPath) : nullptr;
+    storage.freeFile = tearDownFile;
+    return storage;
+}
+
+embeddb::Options makeOptions(uint32_t parameters) {
+    embeddb::Options options;
+    options.parameters = EMBEDDB_RESET_DATA | parameters;
+    options.numDataPages = 1000;
+    options.numSplinePoints = 64;
+    options.compressedPageSize = 128;
+    if (EMBEDDB_USING_INDEX(parameters)) {
+        options.numIndexPages = 16;
+        options.bitmapSize = 1;
+        options.updateBitmap = updateBitmapInt8;
+        options.inBitmap = inBitmapInt8;
+        options.buildBitmapFromRange = buildBitmapInt8FromRange;
+    }
+    return options;
+}
+
+int32_t sensorData(uint32_t record) {
+    return (int32_t)((record * 7919u) % 1000u) - 500;
+}
+
+void cpp_sizes_should_match_state_after_init() {
+    static_assert(SensorDB::recordSize == 8, "Record size of uint32_t keys and int32_t data");
+    static_assert(SensorDB::recordsPerPage(512, 0) == 63, "Records per page without a data range");
+    static_assert(SensorDB::recordsPerPage(512, EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_KEY_OFFSETS, 0, 128, 2) == 16, "Records per page with 2 byte key offsets in 128 byte data file pages");
+    static_assert(ReadingDB::recordSize == 12, "Record size of uint64_t keys and Reading data");
+
+    uint32_t parameterSets[] = {0,
+                                EMBEDDB_USE_MAX_MIN,
+                                EMBEDDB_USE_SUM,
+                                EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_SUM,
+                                EMBEDDB_USE_INDEX,
+                                EMBEDDB_USE_INDEX | EMBEDDB_USE_MAX_MIN,
+                                EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_COMPRESSION,
+                                EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_KEY_OFFSETS,
+                                EMBEDDB_USE_INDEX | EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_KEY_OFFSETS};
+    for (uint32_t parameters : parameterSets) {
+        embeddb::Options options = makeOptions(parameters);
+        SensorDB db(options, makeStorage(EMBEDDB_USING_INDEX(parameters)));
+        TEST_ASSERT_TRUE_MESSAGE(db.ok(), "SensorDB did not initialize.");
+        TEST_ASSERT_EQUAL_INT8(SensorDB::recordSize, db.state()->recordSize);
+        TEST_ASSERT_EQUAL_INT8(SensorDB::headerSize(options.parameters, options.bitmapSize), db.state()->headerSize);
+        TEST_ASSERT_EQUAL_UINT32(SensorDB::recordsPerPage(options.pageSize, options.parameters, options.bitmapSize, options.compressedPageSize, options.keyOffsetSize), db.state()->maxRecordsPerPage);
+    }
+}
+
+void cpp_put_should_store_records_read_by_get() {
+    uint32_t parameterSets[] = {EMBEDDB_USE_MAX_MIN, EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_COMPRESSION};
+    for (uint32_t parameters : parameterSets) {
+        SensorDB db(makeOptions(parameters), makeStorage(false));
+        TEST_ASSERT_TRUE_MESSAGE(db.ok(), "SensorDB did not initialize.");
+        uint32_t numRecords = 5000;
+        for (uint32_t record = 0; record < numRecords; record++) {
+            TEST_ASSERT_EQUAL_INT8(0, db.put(record * 3, sensorData(record)));
+        }
+        for (uint32_t record = 0; record < numRecords; record++) {
+            uint32_t key = record * 3;
+            int32_t data = 0;
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, db.get(key, data), "get did not find a record.");
+            TEST_ASSERT_EQUAL_INT32(sensorData(record), data);
+            data = 0;
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(db.state(), &key, &data), "embedDBGet did not find a record inserted with put.");
+            TEST_ASSERT_EQUAL_INT32(sensorData(record), data);
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, db.get(key + 1, data), "get found a key that was not inserted.");
+        }
+    }
+}
+
+void cpp_put_should_reject_keys_out_of_order() {
+    SensorDB db(makeOptions(0), makeStorage(false));
+    TEST_ASSERT_EQUAL_INT8(0, db.put(10, 1));
+    TEST_ASSERT_EQUAL_INT8(0, db.put(20, 2));
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, db.put(20, 3), "put accepted a duplicate key.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, db.put(5, 3), "put accepted a smaller key.");
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8(0, db.get(20, data));
+    TEST_ASSERT_EQUAL_INT32(2, data);
+}
+
+void checkRangeMatchesNext(SensorDB &db, const uint32_t *minKey, const uint32_t *maxKey, const int32_t *minData, const int32_t *maxData) {
+    embedDBIterator it;
+    it.minKey = (void *)minKey;
+    it.maxKey = (void *)maxKey;
+    it.minData = (void *)minData;
+    it.maxData = (void *)maxData;
+    embedDBInitIterator(db.state(), &it);
+
+    uint32_t key = 0, numRecords = 0;
+    int32_t data = 0;
+    for (const SensorDB::Entry &entry : db.range(minKey, maxKey, minData, maxData)) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBNext(db.state(), &it, &key, &data), "The range returned more records than embedDBNext.");
+        TEST_ASSERT_EQUAL_UINT32(key, entry.key);
+        TEST_ASSERT_EQUAL_INT32(data, entry.data);
+        numRecords++;
+    }
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBNext(db.state(), &it, &key, &data), "The range returned fewer records than embedDBNext.");
+    TEST_ASSERT_TRUE_MESSAGE(numRecords > 0, "The query should match some records.");
+    embedDBCloseIterator(&it);
+}
+
+void cpp_range_should_return_the_same_records_as_next() {
+    SensorDB db(makeOptions(EMBEDDB_USE_INDEX | EMBEDDB_USE_MAX_MIN), makeStorage(true));
+    TEST_ASSERT_TRUE_MESSAGE(db.ok(), "SensorDB did not initialize.");
+    uint32_t numRecords = 8000;
+    for (uint32_t record = 0; record < numRecords; record++) {
+        TEST_ASSERT_EQUAL_INT8(0, db.put(record * 3, sensorData(record)));
+    }
+
+    uint32_t minKey = 1001, maxKey = 17000, maxKeyInWriteBuffer = numRecords * 3 - 10;
+    int32_t minData = -100, maxData = 250;
+    checkRangeMatchesNext(db, nullptr, nullptr, nullptr, nullptr);
+    checkRangeMatchesNext(db, &minKey, nullptr, nullptr, nullptr);
+    checkRangeMatchesNext(db, nullptr, &maxKey, nullptr, nullptr);
+    checkRangeMatchesNext(db, &minKey, &maxKeyInWriteBuffer, nullptr, nullptr);
+    checkRangeMatchesNext(db, nullptr, nullptr, &minData, &maxData);
+    checkRangeMatchesNext(db, &minKey, &maxKey, &minData, nullptr);
+
+    uint32_t numFound = 0, expectedKey = 1002;
+    for (const SensorDB::Entry &entry : db.range(1001, 2000)) {
+        TEST_ASSERT_EQUAL_UINT32(expectedKey, entry.key);
+        expectedKey += 3;
+        numFound++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(333, numFound);
+}
+
+void cpp_should_put_get_and_iterate_records_in_the_reorder_buffer() {
+    embeddb::Options options = makeOptions(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_REORDER_BUFFER);
+    options.reorderBufferSize = 8;
+    SensorDB db(options, makeStorage(false));
+    TEST_ASSERT_TRUE_MESSAGE(db.ok(), "SensorDB did not initialize with a reorder buffer.");
+    uint32_t numRecords = 1000;
+    for (uint32_t arrival = 0; arrival < numRecords; arrival++) {
+        /* Pairs of records arrive swapped */
+        uint32_t record = arrival ^ 1;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, db.put(record * 3, sensorData(record)), "put did not insert a late record.");
+    }
+
+    for (uint32_t record = 0; record < numRecords; record++) {
+        int32_t data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, db.get(record * 3, data), "get did not find a record inserted out of order.");
+        TEST_ASSERT_EQUAL_INT32(sensorData(record), data);
+    }
+
+    uint32_t numFound = 0, expectedKey = 0;
+    for (const SensorDB::Entry &entry : db.all()) {
+        TEST_ASSERT_EQUAL_UINT32(expectedKey, entry.key);
+        expectedKey += 3;
+        numFound++;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords, numFound, "The range did not return the records in the reorder buffer.");
+}
+
+void cpp_should_order_records_with_a_custom_data_order() {
+    ReadingDB db(makeOptions(EMBEDDB_USE_MAX_MIN), makeStorage(false));
+    TEST_ASSERT_TRUE_MESSAGE(db.ok(), "ReadingDB did not initialize.");
+    uint64_t base = 1700000000000ull;
+    uint32_t numRecords = 3000;
+    for (uint32_t record = 0; record < numRecords; record++) {
+        Reading reading = {(int16_t)((int32_t)(record % 200) - 100), (uint16_t)record};
+        TEST_ASSERT_EQUAL_INT8(0, db.put(base + record * 1000, reading));
+    }
+
+    /* The page header data range is ordered by temperature */
+    Reading minData, maxData;
+    memcpy(&minData, EMBEDDB_GET_MIN_DATA(db.state()->buffer, db.state()), sizeof(Reading));
+    memcpy(&maxData, EMBEDDB_GET_MAX_DATA(db.state()->buffer, db.state()), sizeof(Reading));
+    TEST_ASSERT_TRUE_MESSAGE(minData.temperature < maxData.temperature, "Page data range was not updated.");
+
+    Reading warm = {90, 0};
+    uint32_t numFound = 0;
+    for (const ReadingDB::Entry &entry : db.range(nullptr, nullptr, &warm, nullptr)) {
+        TEST_ASSERT_TRUE_MESSAGE(entry.data.temperature >= 90, "Range returned a record below the data filter.");
+        TEST_ASSERT_TRUE_MESSAGE(entry.key == base + (uint64_t)entry.data.humidity * 1000, "Range returned a record with the wrong key.");
+        numFound++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(numRecords / 200 * 10, numFound);
+
+    Reading reading;
+    TEST_ASSERT_EQUAL_INT8(0, db.get(base + 1234000, reading));
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(1234, reading.humidity, "get returned the wrong record.");
+}
+
+void cpp_move_should_transfer_ownership() {
+    SensorDB first(makeOptions(0), makeStorage(false));
+    TEST_ASSERT_TRUE_MESSAGE(first.ok(), "SensorDB did not initialize.");
+    for (uint32_t key = 0; key < 1000; key++) {
+        TEST_ASSERT_EQUAL_INT8(0, first.put(key, (int32_t)key));
+    }
+
+    SensorDB second(std::move(first));
+    TEST_ASSERT_FALSE_MESSAGE(first.ok(), "A moved from database should not be open.");
+    TEST_ASSERT_TRUE_MESSAGE(first.state() == nullptr, "A moved from database should not have a state.");
+    TEST_ASSERT_TRUE_MESSAGE(second.ok(), "A moved to database should be open.");
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8(0, second.get(999, data));
+    TEST_ASSERT_EQUAL_INT32(999, data);
+
+    /* Moving into an open database closes the database it had */
+    SensorDB third(makeOptions(0), makeStorage(false, OTHER_DATA_PATH));
+    third = std::move(second);
+    TEST_ASSERT_TRUE_MESSAGE(second.state() == nullptr, "A moved from database should not have a state.");
+    TEST_ASSERT_EQUAL_INT8(0, third.get(500, data));
+    TEST_ASSERT_EQUAL_INT32(500, data);
+}
+
+void cpp_destructor_should_flush_records() {
+    uint32_t parameterSets[] = {EMBEDDB_USE_MAX_MIN, EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_REORDER_BUFFER};
+    for (uint32_t parameters : parameterSets) {
+        embeddb::Options options = makeOptions(parameters);
+        options.reorderBufferSize = 16;
+        {
+            SensorDB db(options, makeStorage(false));
+            TEST_ASSERT_TRUE_MESSAGE(db.ok(), "SensorDB did not initialize.");
+            /* Not a multiple of the records per page, so the last records are still in memory */
+            for (uint32_t record = 0; record < 1000; record++) {
+                TEST_ASSERT_EQUAL_INT8(0, db.put(record, sensorData(record)));
+            }
+        }
+
+        options.parameters &= ~EMBEDDB_RESET_DATA;
+        SensorDB db(options, makeStorage(false));
+        TEST_ASSERT_TRUE_MESSAGE(db.ok(), "SensorDB did not recover.");
+        for (uint32_t record = 0; record < 1000; record++) {
+            int32_t data = 0;
+            TEST_ASSERT_EQUAL_INT8_MESSAGE(0, db.get(record, data), "A record put before the database was destroyed was lost.");
+            TEST_ASSERT_EQUAL_INT32(sensorData(record), data);
+        }
+    }
+}
+
+void cpp_should_report_unsupported_options() {
+    SensorDB db(makeOptions(EMBEDDB_USE_VDATA), makeStorage(false));
+    TEST_ASSERT_FALSE_MESSAGE(db.ok(), "Variable data is not supported.");
+    TEST_ASSERT_EQUAL_INT8(-1, db.status());
+}
+
+#endif
+
+int runUnityTests() {
+    UNITY_BEGIN();
+#if __cplusplus >= 201703L
+    RUN_TEST(cpp_sizes_should_match_state_after_init);
+    RUN_TEST(cpp_put_should_store_records_read_by_get);
+    RUN_TEST(cpp_put_should_reject_keys_out_of_order);
+    RUN_TEST(cpp_range_should_return_the_same_records_as_next);
+    RUN_TEST(cpp_should_put_get_and_iterate_records_in_the_reorder_buffer);
+    RUN_TEST(cpp_should_order_records_with_a_custom_data_order);
+    RUN_TEST(cpp_move_should_transfer_ownership);
+    RUN_TEST(cpp_destructor_should_flush_records);
+    RUN_TEST(cpp_should_report_unsupported_options);
+#endif
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
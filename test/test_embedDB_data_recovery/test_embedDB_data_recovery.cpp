@@ -127,6 +127,47 @@ void initalizeEmbedDBFromFile(void) {
     TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
 }
 
+/* Counts the reads made from storage, so tests can check how many pages recovery reads */
+int8_t (*storageRead)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+uint32_t numStorageReads = 0;
+
+int8_t countingRead(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    numStorageReads++;
+    return storageRead(buffer, pageNum, pageSize, file);
+}
+
+/* Recovers without a spline, as rebuilding the spline reads every page */
+void initalizeEmbedDBFromFileCountingReads(void) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate EmbedDB state.");
+    state->keySize = 4;
+    state->dataSize = 8;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+
+/* configure EmbedDB storage */
+#ifdef MOCK_ERASE_INTERFACE
+    state->fileInterface = getMockEraseFileInterface();
+#else
+    state->fileInterface = getFileInterface();
+#endif
+    storageRead = state->fileInterface->read;
+    state->fileInterface->read = countingRead;
+    numStorageReads = 0;
+    state->dataFile = setupFile(DATA_FILE_PATH);
+
+    state->numDataPages = 92;
+    state->eraseSizeInPages = 4;
+    state->parameters = EMBEDDB_USE_BINARY_SEARCH;
+    state->compareKey = int32Comparator;
+    state->compareData = int64Comparator;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
 void setUp() {
     setupEmbedDB();
 }
@@ -338,6 +379,17 @@ void embedDB_recovery_algorithm_functions_correctly_when_have_wrapped_but_at_the
     TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expectedData, &actualData, sizeof(int64_t), "embedDBGet did not return the correct data for a key inserted after recovery.");
 }
 
+void embedDB_recovery_algorithm_finds_write_head_without_reading_every_page() {
+    insertRecordsLinearly(0, 0, 7560);
+    embedDBFlush(state);
+    tearDown();
+    initalizeEmbedDBFromFileCountingReads();
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(180, state->nextDataPageId, "EmbedDB nextDataPageId is not correctly identified after reload from data file.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(92, state->minDataPageId, "EmbedDB minDataPageId was not correctly identified.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->numAvailDataPages, "EmbedDB numAvailDataPages is not correctly initialized.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(16, numStorageReads, "Recovery read more pages than a binary search over the data file needs.");
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
     RUN_TEST(embedDB_parameters_initializes_from_data_file_with_twenty_seven_pages_correctly);
@@ -351,6 +403,7 @@ int runUnityTests() {
     RUN_TEST(embedDB_parameters_initializes_correctly_from_data_file_with_no_data);
     RUN_TEST(embedDB_recovery_algorithm_wraps_when_skipping_to_next_block);
     RUN_TEST(embedDB_recovery_algorithm_functions_correctly_when_have_wrapped_but_at_the_end_of_storage);
+    RUN_TEST(embedDB_recovery_algorithm_finds_write_head_without_reading_every_page);
     return UNITY_END();
 }
 
@@ -0,0 +1,283 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_fence_keys.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the EmbedDB fence key directory.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+/* Added to the keys of the second half of the records in the large gap test. Too large to store as a difference from another key. */
+#define LARGE_KEY_GAP 0x10000000000ULL
+
+void setupState(uint32_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 8;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 64;
+    state->bitmapSize = 0;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 100;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->parameters = EMBEDDB_USE_FENCE_KEYS | parameters;
+    state->compareKey = int64Comparator;
+    state->compareData = int32Comparator;
+}
+
+void setupEmbedDB(uint32_t parameters) {
+    setupState(parameters);
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Keys with gaps that grow every 100 records, so the spline has to guess the page of a key */
+uint64_t keyOf(uint32_t record) {
+    uint64_t step = record / 100;
+    return (uint64_t)record * 3 + step * step * 40;
+}
+
+void insertRecords(uint32_t startingRecord, uint32_t numRecords, uint64_t keyOffset) {
+    for (uint32_t record = startingRecord; record < startingRecord + numRecords; record++) {
+        uint64_t key = keyOf(record) + keyOffset;
+        int32_t data = (int32_t)record;
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+void assertGet(uint32_t record, uint64_t keyOffset) {
+    uint64_t key = keyOf(record) + keyOffset;
+    int32_t data = 0;
+    char message[100];
+    snprintf(message, 100, "embedDBGet could not find record %lu.", (unsigned long)record);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+    TEST_ASSERT_EQUAL_INT32_MESSAGE((int32_t)record, data, "embedDBGet returned the wrong data.");
+}
+
+/* Gets a record on a different page than the last one, and checks that only its page was read */
+void assertGetReadsOnePage(uint32_t record, uint64_t keyOffset) {
+    embedDBResetStats(state);
+    assertGet(record, keyOffset);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->numReads, "embedDBGet read more than the page that holds the record.");
+}
+
+void fenceKeys_should_read_one_page_for_each_get() {
+    setupEmbedDB(EMBEDDB_RESET_DATA);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(0, 80 * recordsPerPage, 0);
+    embedDBFlush(state);
+
+    for (uint32_t record = 3; record < 80 * recordsPerPage; record += recordsPerPage + 7) {
+        assertGetReadsOnePage(record, 0);
+    }
+}
+
+void fenceKeys_should_read_one_page_for_missing_keys() {
+    setupEmbedDB(EMBEDDB_RESET_DATA);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(0, 40 * recordsPerPage, 0);
+    embedDBFlush(state);
+
+    /* Keys between the records of a page are not stored. keyOf(10) + 1 is not a key of any record. */
+    for (uint32_t page = 0; page < 40; page += 3) {
+        uint64_t key = keyOf(page * recordsPerPage + 10) + 1;
+        int32_t data = 0;
+        embedDBResetStats(state);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was not inserted.");
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(1, state->numReads, "embedDBGet read more than one page for a missing key.");
+    }
+}
+
+void fenceKeys_should_not_find_keys_on_erased_pages() {
+    setupEmbedDB(EMBEDDB_RESET_DATA);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(0, 350 * recordsPerPage, 0);
+    embedDBFlush(state);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->minDataPageId, "The data file did not wrap.");
+
+    /* Records before the oldest page have been erased, and looking for them reads nothing */
+    uint32_t firstRecord = state->minDataPageId * recordsPerPage;
+    uint64_t key = keyOf(firstRecord - 1);
+    int32_t data = 0;
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a record on an erased page.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numReads, "embedDBGet read a page for a key older than every page.");
+
+    for (uint32_t record = firstRecord; record < 350 * recordsPerPage; record += recordsPerPage + 11) {
+        assertGetReadsOnePage(record, 0);
+    }
+}
+
+void fenceKeys_should_find_keys_with_large_gaps() {
+    setupEmbedDB(EMBEDDB_RESET_DATA);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(0, 30 * recordsPerPage + 5, 0);
+    insertRecords(30 * recordsPerPage + 5, 30 * recordsPerPage, LARGE_KEY_GAP);
+    embedDBFlush(state);
+
+    for (uint32_t record = 0; record < 30 * recordsPerPage + 5; record += 37) {
+        assertGet(record, 0);
+    }
+    /* The directory restarts at the first page after the gap. The page with the gap is found with the spline. */
+    assertGet(30 * recordsPerPage + 5, LARGE_KEY_GAP);
+    for (uint32_t record = 31 * recordsPerPage; record < 60 * recordsPerPage + 5; record += recordsPerPage + 3) {
+        assertGetReadsOnePage(record, LARGE_KEY_GAP);
+    }
+}
+
+void fenceKeys_should_cover_pages_written_after_recovery() {
+    setupEmbedDB(EMBEDDB_RESET_DATA);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(0, 20 * recordsPerPage, 0);
+    embedDBFlush(state);
+    tearDownEmbedDB();
+
+    setupEmbedDB(0);
+    insertRecords(20 * recordsPerPage, 20 * recordsPerPage, 0);
+    embedDBFlush(state);
+
+    /* Recovered pages are found with the spline, newer pages with the fence keys */
+    for (uint32_t record = 0; record < 20 * recordsPerPage; record += 29) {
+        assertGet(record, 0);
+    }
+    for (uint32_t record = 20 * recordsPerPage + 1; record < 40 * recordsPerPage; record += recordsPerPage + 5) {
+        assertGetReadsOnePage(record, 0);
+    }
+}
+
+void fenceKeys_should_work_with_binary_search() {
+    setupEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_DISABLE_SPLINE_CLEAN);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(0, 150 * recordsPerPage, 0);
+    embedDBFlush(state);
+
+    for (uint32_t record = state->minDataPageId * recordsPerPage; record < 150 * recordsPerPage; record += recordsPerPage + 13) {
+        assertGetReadsOnePage(record, 0);
+    }
+}
+
+void fenceKeys_should_be_freed_when_init_fails() {
+    /* Too few buffers for an index, so embedDBInit fails after the fence key directory is allocated */
+    setupState(EMBEDDB_RESET_DATA | EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_USE_INDEX);
+    state->indexFile = NULL;
+    state->numIndexPages = 8;
+    state->bufferSizeInBlocks = 2;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "EmbedDB initialized an index with two page buffers.");
+    TEST_ASSERT_NULL_MESSAGE(state->fenceKeys, "The fence key directory was not freed when embedDBInit failed.");
+
+    state->bufferSizeInBlocks = 4;
+    state->parameters &= ~EMBEDDB_USE_INDEX;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(fenceKeys_should_read_one_page_for_each_get);
+    RUN_TEST(fenceKeys_should_read_one_page_for_missing_keys);
+    RUN_TEST(fenceKeys_should_not_find_keys_on_erased_pages);
+    RUN_TEST(fenceKeys_should_find_keys_with_large_gaps);
+    RUN_TEST(fenceKeys_should_cover_pages_written_after_recovery);
+    RUN_TEST(fenceKeys_should_work_with_binary_search);
+    RUN_TEST(fenceKeys_should_be_freed_when_init_fails);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,284 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_floor_ceiling.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test finding the floor and ceiling of keys.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setupEmbedDB(uint32_t parameters, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 256;
+    state->bitmapSize = EMBEDDB_USING_BMAP(parameters) ? 1 : 0;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = EMBEDDB_USING_INDEX(parameters) ? setupFile(INDEX_PATH) : NULL;
+    state->parameters = EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Keys with gaps that grow every 100 records, so the spline has to interpolate between its points */
+uint32_t keyOf(uint32_t record) {
+    uint32_t step = record / 100;
+    return 10 + record * 3 + step * step * 40;
+}
+
+/* Number of records inserted by insertRecords */
+uint32_t numInserted = 0;
+
+void insertRecords(uint32_t numRecords) {
+    numInserted = numRecords;
+    for (uint32_t record = 0; record < numRecords; record++) {
+        uint32_t key = keyOf(record);
+        int32_t data = (int32_t)record;
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+/* Checks the floor and ceiling of a key are the expected records. -1 if there should not be one. */
+void assertFloorCeiling(uint32_t key, int64_t floorRecord, int64_t ceilingRecord) {
+    uint32_t foundKey = 0;
+    int32_t data = 0;
+    char message[100];
+
+    int8_t result = embedDBGetFloor(state, &key, &foundKey, &data);
+    snprintf(message, 100, "embedDBGetFloor returned the wrong result for key %lu.", (unsigned long)key);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(floorRecord < 0 ? 1 : 0, result, message);
+    if (floorRecord >= 0) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(keyOf((uint32_t)floorRecord), foundKey, message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE((int32_t)floorRecord, data, message);
+    }
+
+    result = embedDBGetCeiling(state, &key, &foundKey, &data);
+    snprintf(message, 100, "embedDBGetCeiling returned the wrong result for key %lu.", (unsigned long)key);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(ceilingRecord < 0 ? 1 : 0, result, message);
+    if (ceilingRecord >= 0) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(keyOf((uint32_t)ceilingRecord), foundKey, message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE((int32_t)ceilingRecord, data, message);
+    }
+}
+
+/* Checks keys equal to, and between, records from firstRecord to lastRecord. Includes the last record on each page and the first record on the next. */
+void assertRecords(uint32_t firstRecord, uint32_t lastRecord) {
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    for (uint32_t record = firstRecord; record <= lastRecord; record++) {
+        if (record % 23 != 0 && record % recordsPerPage > 1 && record % recordsPerPage < recordsPerPage - 1 && record != lastRecord)
+            continue;
+        assertFloorCeiling(keyOf(record), record, record);
+        assertFloorCeiling(keyOf(record) + 1, record, record == numInserted - 1 ? -1 : (int64_t)record + 1);
+    }
+}
+
+void floorCeiling_should_find_records_on_pages_and_write_buffer() {
+    setupEmbedDB(0, 200);
+    uint32_t numRecords = 60 * state->maxRecordsPerPage + 20;
+    insertRecords(numRecords);
+
+    assertRecords(0, numRecords - 1);
+    assertFloorCeiling(0, -1, 0);
+    assertFloorCeiling(keyOf(0) - 1, -1, 0);
+    assertFloorCeiling(UINT32_MAX / 2, numRecords - 1, -1);
+}
+
+void floorCeiling_should_find_records_without_write_buffer() {
+    setupEmbedDB(0, 200);
+    uint32_t numRecords = 30 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+    embedDBFlush(state);
+
+    assertRecords(numRecords - 2 * state->maxRecordsPerPage, numRecords - 1);
+    assertFloorCeiling(keyOf(numRecords - 1) + 100, numRecords - 1, -1);
+}
+
+void floorCeiling_should_find_records_only_in_write_buffer() {
+    setupEmbedDB(0, 200);
+    numInserted = 0;
+    assertFloorCeiling(keyOf(5), -1, -1);
+
+    insertRecords(20);
+    assertRecords(0, 19);
+    assertFloorCeiling(1, -1, 0);
+}
+
+void floorCeiling_should_find_records_with_binary_search() {
+    setupEmbedDB(EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_DISABLE_SPLINE_CLEAN, 200);
+    uint32_t numRecords = 45 * state->maxRecordsPerPage + 3;
+    insertRecords(numRecords);
+
+    assertRecords(0, numRecords - 1);
+    assertFloorCeiling(1, -1, 0);
+}
+
+void floorCeiling_should_read_one_page_with_fence_keys() {
+    setupEmbedDB(EMBEDDB_USE_FENCE_KEYS, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numRecords = 45 * recordsPerPage + 3;
+    insertRecords(numRecords);
+
+    assertRecords(0, numRecords - 1);
+    /* Each lookup is on a different page than the last one, so it is not already in the read buffer */
+    for (uint32_t record = 5; record < 44 * recordsPerPage; record += recordsPerPage + 7) {
+        uint32_t key = keyOf(record) + 1, foundKey = 0;
+        int32_t data = 0;
+        embedDBResetStats(state);
+        TEST_ASSERT_EQUAL_INT8(0, embedDBGetFloor(state, &key, &foundKey, &data));
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->numReads, "embedDBGetFloor read more than the page of the floor.");
+    }
+}
+
+void floorCeiling_should_read_few_pages_with_spline() {
+    setupEmbedDB(0, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(100 * recordsPerPage + 3);
+
+    for (uint32_t record = 5; record < 99 * recordsPerPage; record += recordsPerPage + 7) {
+        uint32_t key = keyOf(record) + 1, foundKey = 0;
+        int32_t data = 0;
+        embedDBResetStats(state);
+        TEST_ASSERT_EQUAL_INT8(0, embedDBGetCeiling(state, &key, &foundKey, &data));
+        TEST_ASSERT_EQUAL_UINT32(keyOf(record + 1), foundKey);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(4, state->numReads, "embedDBGetCeiling read more pages than the spline error.");
+    }
+}
+
+void floorCeiling_should_not_find_erased_records() {
+    setupEmbedDB(0, 100);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numRecords = 230 * recordsPerPage + 3;
+    insertRecords(numRecords);
+
+    uint32_t oldestRecord = state->minDataPageId * recordsPerPage;
+    assertFloorCeiling(keyOf(oldestRecord) - 1, -1, oldestRecord);
+    assertFloorCeiling(keyOf(10), -1, oldestRecord);
+    assertRecords(oldestRecord, oldestRecord + 2 * recordsPerPage);
+    assertRecords(numRecords - recordsPerPage, numRecords - 1);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(floorCeiling_should_find_records_on_pages_and_write_buffer);
+    RUN_TEST(floorCeiling_should_find_records_without_write_buffer);
+    RUN_TEST(floorCeiling_should_find_records_only_in_write_buffer);
+    RUN_TEST(floorCeiling_should_find_records_with_binary_search);
+    RUN_TEST(floorCeiling_should_read_one_page_with_fence_keys);
+    RUN_TEST(floorCeiling_should_read_few_pages_with_spline);
+    RUN_TEST(floorCeiling_should_not_find_erased_records);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
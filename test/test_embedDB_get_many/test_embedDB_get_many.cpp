@@ -0,0 +1,284 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_get_many.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test embedDBGetMany.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setupEmbedDB(int16_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 32;
+    state->bitmapSize = 8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 64;
+    state->numIndexPages = 8;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = setupFile(INDEX_PATH);
+    state->parameters = EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt64;
+    state->updateBitmap = updateBitmapInt64;
+    state->buildBitmapFromRange = buildBitmapInt64FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Inserts the even keys from 0 up to (but not including) 2 * numRecords */
+void insertRecords(uint32_t numRecords) {
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = i * 2;
+        int32_t data = (int32_t)(key * 5 + 1);
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+/* Keys in an order that jumps between pages, and that repeats some keys */
+void fillShuffledKeys(uint32_t *keys, uint32_t numKeys, uint32_t maxKey) {
+    for (uint32_t i = 0; i < numKeys; i++) {
+        keys[i] = (uint32_t)(((uint64_t)i * 7919 + 13) % maxKey);
+    }
+}
+
+void assertSameAsEmbedDBGet(uint32_t *keys, uint32_t numKeys) {
+    int32_t *data = (int32_t *)malloc(numKeys * sizeof(int32_t));
+    int8_t *status = (int8_t *)malloc(numKeys);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetMany(state, keys, numKeys, data, status), "embedDBGetMany returned an error.");
+
+    char message[100];
+    for (uint32_t i = 0; i < numKeys; i++) {
+        int32_t expectedData = 0;
+        int8_t expectedStatus = embedDBGet(state, &keys[i], &expectedData);
+        snprintf(message, 100, "embedDBGetMany did not return the same result as embedDBGet for key %lu.", (unsigned long)keys[i]);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(expectedStatus, status[i], message);
+        if (expectedStatus == 0) {
+            TEST_ASSERT_EQUAL_INT32_MESSAGE(expectedData, data[i], message);
+        }
+    }
+    free(data);
+    free(status);
+}
+
+void embedDBGetMany_should_return_same_results_as_embedDBGet() {
+    setupEmbedDB(0);
+    uint32_t numRecords = 20 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+
+    /* Odd keys were not inserted, and keys past the end are also looked up */
+    uint32_t numKeys = 400;
+    uint32_t *keys = (uint32_t *)malloc(numKeys * sizeof(uint32_t));
+    fillShuffledKeys(keys, numKeys, 2 * numRecords + 50);
+    assertSameAsEmbedDBGet(keys, numKeys);
+    free(keys);
+}
+
+void embedDBGetMany_should_find_keys_in_write_buffer() {
+    setupEmbedDB(0);
+    uint32_t numRecords = 3 * state->maxRecordsPerPage + 10;
+    insertRecords(numRecords);
+
+    uint32_t keys[] = {2 * (numRecords - 1), 0, 2 * (numRecords - 5), 2 * (numRecords + 3), 2 * state->maxRecordsPerPage, 2 * (numRecords - 1)};
+    int32_t data[6];
+    int8_t status[6];
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetMany(state, keys, 6, data, status), "embedDBGetMany returned an error.");
+    int8_t expectedStatus[] = {0, 0, 0, -1, 0, 0};
+    TEST_ASSERT_EQUAL_INT8_ARRAY_MESSAGE(expectedStatus, status, 6, "embedDBGetMany did not find the right keys.");
+    for (uint32_t i = 0; i < 6; i++) {
+        if (status[i] == 0) {
+            TEST_ASSERT_EQUAL_INT32_MESSAGE((int32_t)(keys[i] * 5 + 1), data[i], "embedDBGetMany returned the wrong data.");
+        }
+    }
+}
+
+void embedDBGetMany_should_read_each_page_once() {
+    setupEmbedDB(EMBEDDB_USE_FENCE_KEYS);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(30 * recordsPerPage);
+    embedDBFlush(state);
+
+    /* 200 keys spread over data pages 4, 11, 12 and 25 in no particular order */
+    uint32_t pages[] = {25, 4, 12, 11};
+    uint32_t numKeys = 200;
+    uint32_t *keys = (uint32_t *)malloc(numKeys * sizeof(uint32_t));
+    for (uint32_t i = 0; i < numKeys; i++) {
+        keys[i] = 2 * (pages[i % 4] * recordsPerPage + (i * 17) % recordsPerPage);
+    }
+    int32_t *data = (int32_t *)malloc(numKeys * sizeof(int32_t));
+    int8_t *status = (int8_t *)malloc(numKeys);
+
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetMany(state, keys, numKeys, data, status), "embedDBGetMany returned an error.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->numReads, "embedDBGetMany did not read each page exactly once.");
+    for (uint32_t i = 0; i < numKeys; i++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, status[i], "embedDBGetMany did not find a key.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE((int32_t)(keys[i] * 5 + 1), data[i], "embedDBGetMany returned the wrong data.");
+    }
+    free(keys);
+    free(data);
+    free(status);
+}
+
+void embedDBGetMany_should_read_fewer_pages_than_embedDBGet() {
+    setupEmbedDB(0);
+    uint32_t numRecords = 30 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+    embedDBFlush(state);
+
+    uint32_t numKeys = 300;
+    uint32_t *keys = (uint32_t *)malloc(numKeys * sizeof(uint32_t));
+    fillShuffledKeys(keys, numKeys, 2 * numRecords);
+    int32_t *data = (int32_t *)malloc(numKeys * sizeof(int32_t));
+    int8_t *status = (int8_t *)malloc(numKeys);
+
+    embedDBResetStats(state);
+    for (uint32_t i = 0; i < numKeys; i++) {
+        embedDBGet(state, &keys[i], &data[i]);
+    }
+    uint32_t singleReads = state->numReads;
+
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetMany(state, keys, numKeys, data, status), "embedDBGetMany returned an error.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(2 * 30, state->numReads, "embedDBGetMany read a page more than twice on average.");
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(singleReads, state->numReads, "embedDBGetMany did not read fewer pages than embedDBGet.");
+    free(keys);
+    free(data);
+    free(status);
+}
+
+void embedDBGetMany_should_not_find_erased_keys() {
+    setupEmbedDB(EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_DISABLE_SPLINE_CLEAN);
+    uint32_t numRecords = 100 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->minDataPageId, "The data file did not wrap.");
+
+    uint32_t numKeys = 500;
+    uint32_t *keys = (uint32_t *)malloc(numKeys * sizeof(uint32_t));
+    fillShuffledKeys(keys, numKeys, 2 * numRecords);
+    assertSameAsEmbedDBGet(keys, numKeys);
+    free(keys);
+}
+
+void embedDBGetMany_should_accept_no_keys() {
+    setupEmbedDB(0);
+    insertRecords(100);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetMany(state, NULL, 0, NULL, NULL), "embedDBGetMany returned an error for no keys.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBGetMany_should_return_same_results_as_embedDBGet);
+    RUN_TEST(embedDBGetMany_should_find_keys_in_write_buffer);
+    RUN_TEST(embedDBGetMany_should_read_each_page_once);
+    RUN_TEST(embedDBGetMany_should_read_fewer_pages_than_embedDBGet);
+    RUN_TEST(embedDBGetMany_should_not_find_erased_keys);
+    RUN_TEST(embedDBGetMany_should_accept_no_keys);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,311 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_iterator_bounds.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the page bound and page estimate of key range iterators.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setupEmbedDB(uint32_t parameters, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 256;
+    state->bitmapSize = EMBEDDB_USING_BMAP(parameters) ? 1 : 0;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = EMBEDDB_USING_INDEX(parameters) ? setupFile(INDEX_PATH) : NULL;
+    state->parameters = EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Keys with gaps that grow every 100 records, so the spline has to interpolate between its points */
+uint32_t keyOf(uint32_t record) {
+    uint32_t step = record / 100;
+    return record * 3 + step * step * 40;
+}
+
+void insertRecords(uint32_t numRecords, int32_t (*dataOf)(uint32_t record)) {
+    for (uint32_t record = 0; record < numRecords; record++) {
+        uint32_t key = keyOf(record);
+        int32_t data = dataOf(record);
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+int32_t recordData(uint32_t record) {
+    return (int32_t)record;
+}
+
+void initKeyIterator(embedDBIterator *it, uint32_t *minKey, uint32_t *maxKey) {
+    it->minKey = minKey;
+    it->maxKey = maxKey;
+    it->minData = NULL;
+    it->maxData = NULL;
+    embedDBInitIterator(state, it);
+}
+
+/* Iterates from the record firstRecord to lastRecord by key and checks every record is returned */
+void assertKeyRange(uint32_t firstRecord, uint32_t lastRecord) {
+    uint32_t minKey = keyOf(firstRecord), maxKey = keyOf(lastRecord);
+    embedDBIterator it;
+    initKeyIterator(&it, &minKey, &maxKey);
+
+    uint32_t key = 0, record = firstRecord;
+    int32_t data = 0;
+    char message[100];
+    while (embedDBNext(state, &it, &key, &data)) {
+        snprintf(message, 100, "Iterator from record %lu to %lu returned the wrong key.", (unsigned long)firstRecord, (unsigned long)lastRecord);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(keyOf(record), key, message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE((int32_t)record, data, "Iterator returned the wrong data.");
+        record++;
+    }
+    embedDBCloseIterator(&it);
+    snprintf(message, 100, "Iterator from record %lu to %lu stopped early.", (unsigned long)firstRecord, (unsigned long)lastRecord);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(lastRecord + 1, record, message);
+}
+
+void iteratorBounds_should_return_every_record_in_range() {
+    setupEmbedDB(0, 200);
+    uint32_t numRecords = 150 * state->maxRecordsPerPage + 25;
+    insertRecords(numRecords, recordData);
+
+    for (uint32_t firstRecord = 0; firstRecord < numRecords; firstRecord += 997) {
+        assertKeyRange(firstRecord, firstRecord);
+        assertKeyRange(firstRecord, firstRecord + 13 < numRecords ? firstRecord + 13 : numRecords - 1);
+        assertKeyRange(firstRecord, firstRecord + 1500 < numRecords ? firstRecord + 1500 : numRecords - 1);
+    }
+    assertKeyRange(numRecords - 100, numRecords - 1);
+}
+
+void iteratorBounds_should_estimate_pages_holding_range() {
+    setupEmbedDB(0, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(150 * recordsPerPage, recordData);
+
+    char message[100];
+    for (uint32_t firstRecord = 31; firstRecord < 120 * recordsPerPage; firstRecord += 1013) {
+        uint32_t lastRecord = firstRecord + 8 * recordsPerPage;
+        uint32_t minKey = keyOf(firstRecord), maxKey = keyOf(lastRecord);
+        embedDBIterator it;
+        initKeyIterator(&it, &minKey, &maxKey);
+
+        /* The estimate must cover every page in the range, and is at most the spline error past the last one */
+        uint32_t lastPage = lastRecord / recordsPerPage;
+        snprintf(message, 100, "Iterator bound for record %lu is before its page.", (unsigned long)lastRecord);
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(lastPage, it.lastDataPage, message);
+        snprintf(message, 100, "Iterator bound for record %lu is far past its page.", (unsigned long)lastRecord);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(lastPage + 2, it.lastDataPage, message);
+        TEST_ASSERT_EQUAL_UINT32(it.lastDataPage - it.nextDataPage + 1, embedDBIteratorEstimatePages(state, &it));
+
+        /* Scanning the range never reads more pages than the estimate */
+        uint32_t estimate = embedDBIteratorEstimatePages(state, &it);
+        embedDBResetStats(state);
+        uint32_t key = 0;
+        int32_t data = 0;
+        while (embedDBNext(state, &it, &key, &data)) {
+        }
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(estimate, state->numReads, "Iterator read more pages than it estimated.");
+        embedDBCloseIterator(&it);
+    }
+}
+
+void iteratorBounds_should_reach_write_buffer_without_bound() {
+    setupEmbedDB(0, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numRecords = 40 * recordsPerPage + 10;
+    insertRecords(numRecords, recordData);
+
+    /* A max key on the last page written or in the write buffer does not bound the scan */
+    uint32_t minKey = keyOf(38 * recordsPerPage), maxKey = keyOf(numRecords - 1);
+    embedDBIterator it;
+    initKeyIterator(&it, &minKey, &maxKey);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, it.lastDataPage);
+    TEST_ASSERT_EQUAL_UINT32(state->nextDataPageId - it.nextDataPage + 1, embedDBIteratorEstimatePages(state, &it));
+    embedDBCloseIterator(&it);
+    assertKeyRange(38 * recordsPerPage, numRecords - 1);
+
+    maxKey = keyOf(40 * recordsPerPage - 1);
+    initKeyIterator(&it, &minKey, &maxKey);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, it.lastDataPage);
+    embedDBCloseIterator(&it);
+
+    /* Without a max key, the whole file and the write buffer are left to scan */
+    initKeyIterator(&it, NULL, NULL);
+    TEST_ASSERT_EQUAL_UINT32(UINT32_MAX, it.lastDataPage);
+    TEST_ASSERT_EQUAL_UINT32(state->nextDataPageId - state->minDataPageId + 1, embedDBIteratorEstimatePages(state, &it));
+    embedDBCloseIterator(&it);
+}
+
+void iteratorBounds_should_use_exact_page_from_fence_keys() {
+    setupEmbedDB(EMBEDDB_USE_FENCE_KEYS, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(100 * recordsPerPage, recordData);
+
+    for (uint32_t lastRecord = 17; lastRecord < 95 * recordsPerPage; lastRecord += 541) {
+        uint32_t minKey = keyOf(0), maxKey = keyOf(lastRecord);
+        embedDBIterator it;
+        initKeyIterator(&it, &minKey, &maxKey);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(lastRecord / recordsPerPage, it.lastDataPage, "Fence keys did not give the page of the max key.");
+        TEST_ASSERT_EQUAL_UINT32(lastRecord / recordsPerPage + 1, embedDBIteratorEstimatePages(state, &it));
+        embedDBCloseIterator(&it);
+    }
+    assertKeyRange(500, 90 * recordsPerPage);
+}
+
+/* Data in the top bitmap bucket on the first 10 pages, and in the bottom bucket after that */
+int32_t earlyPeakData(uint32_t record) {
+    return record < 10 * state->maxRecordsPerPage ? 150 : 5;
+}
+
+void iteratorBounds_should_not_read_index_pages_past_bound() {
+    setupEmbedDB(EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP, 1600);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numPages = 3 * state->maxIdxRecordsPerPage;
+    insertRecords(numPages * recordsPerPage, earlyPeakData);
+
+    /* Pages past the max key are excluded by their bitmaps, so without the bound the scan would check the index for all of them */
+    uint32_t maxKey = keyOf(30 * recordsPerPage), minData = 100;
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = &maxKey;
+    it.minData = &minData;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+
+    embedDBResetStats(state);
+    uint32_t key = 0, numRecords = 0;
+    int32_t data = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        numRecords++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(10 * recordsPerPage, numRecords, "Iterator returned the wrong number of records.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(1, state->numIdxReads, "Iterator read index pages past the page of the max key.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(10, state->numReads, "Iterator read data pages without data in range.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(iteratorBounds_should_return_every_record_in_range);
+    RUN_TEST(iteratorBounds_should_estimate_pages_holding_range);
+    RUN_TEST(iteratorBounds_should_reach_write_buffer_without_bound);
+    RUN_TEST(iteratorBounds_should_use_exact_page_from_fence_keys);
+    RUN_TEST(iteratorBounds_should_not_read_index_pages_past_bound);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,364 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_iterator_buffers.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test iterators that read pages into their own buffers.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setupEmbedDB(uint32_t parameters, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 256;
+    state->bitmapSize = EMBEDDB_USING_BMAP(parameters) ? 1 : 0;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = EMBEDDB_USING_INDEX(parameters) ? setupFile(INDEX_PATH) : NULL;
+    state->parameters = EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+void insertRecords(uint32_t numRecords) {
+    for (uint32_t key = 0; key < numRecords; key++) {
+        int32_t data = (int32_t)(key / 200 % 100);
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+    embedDBFlush(state);
+}
+
+/* Reads an iterator to the end on its own and returns the number of data pages read from storage */
+uint32_t readsForScan(embedDBIterator *it, void *buffer) {
+    embedDBInitIterator(state, it);
+    embedDBIteratorSetBuffer(it, buffer);
+    uint32_t key = 0;
+    int32_t data = 0;
+    id_t readsBefore = state->numReads;
+    while (embedDBNext(state, it, &key, &data)) {
+    }
+    embedDBCloseIterator(it);
+    return state->numReads - readsBefore;
+}
+
+/* Reads two iterators one record at a time in turns, checking each returns its keys in order, and returns the number of data pages read */
+uint32_t readsForInterleavedScans(embedDBIterator *first, embedDBIterator *second, void *firstBuffer, void *secondBuffer) {
+    embedDBInitIterator(state, first);
+    embedDBIteratorSetBuffer(first, firstBuffer);
+    embedDBInitIterator(state, second);
+    embedDBIteratorSetBuffer(second, secondBuffer);
+    uint32_t firstKey = 0, secondKey = 0, firstExpected = *(uint32_t *)first->minKey, secondExpected = *(uint32_t *)second->minKey;
+    int32_t data = 0;
+    int8_t firstMore = 1, secondMore = 1;
+    id_t readsBefore = state->numReads;
+    while (firstMore || secondMore) {
+        if (firstMore && (firstMore = embedDBNext(state, first, &firstKey, &data))) {
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(firstExpected++, firstKey, "First iterator returned the wrong key.");
+        }
+        if (secondMore && (secondMore = embedDBNext(state, second, &secondKey, &data))) {
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(secondExpected++, secondKey, "Second iterator returned the wrong key.");
+        }
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(*(uint32_t *)first->maxKey + 1, firstExpected, "First iterator did not return every key.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(*(uint32_t *)second->maxKey + 1, secondExpected, "Second iterator did not return every key.");
+    embedDBCloseIterator(first);
+    embedDBCloseIterator(second);
+    return state->numReads - readsBefore;
+}
+
+void embedDBIteratorSetBuffer_interleaved_scans_read_as_many_pages_as_separate_scans(void) {
+    setupEmbedDB(0, 100);
+    insertRecords(3000);
+
+    uint32_t firstMin = 0, firstMax = 1999, secondMin = 1000, secondMax = 2999;
+    embedDBIterator first, second;
+    first.minKey = &firstMin;
+    first.maxKey = &firstMax;
+    first.minData = NULL;
+    first.maxData = NULL;
+    second.minKey = &secondMin;
+    second.maxKey = &secondMax;
+    second.minData = NULL;
+    second.maxData = NULL;
+
+    void *firstBuffer = malloc(2 * state->pageSize);
+    void *secondBuffer = malloc(2 * state->pageSize);
+    uint32_t separateReads = readsForScan(&first, firstBuffer) + readsForScan(&second, secondBuffer);
+    uint32_t interleavedReads = readsForInterleavedScans(&first, &second, firstBuffer, secondBuffer);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(separateReads, interleavedReads, "Interleaved scans with their own buffers read more pages than the scans did separately.");
+
+    uint32_t sharedReads = readsForInterleavedScans(&first, &second, NULL, NULL);
+    TEST_ASSERT_TRUE_MESSAGE(sharedReads > interleavedReads, "Interleaved scans with the shared buffer should read pages again.");
+    free(firstBuffer);
+    free(secondBuffer);
+}
+
+void embedDBIteratorSetBuffer_scan_keeps_its_page_between_lookups(void) {
+    setupEmbedDB(0, 100);
+    insertRecords(3000);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    void *buffer = malloc(2 * state->pageSize);
+    uint32_t scanReads = readsForScan(&it, buffer);
+
+    /* Look up a key on the same page every time, so the lookups read one page and the scan reads its own pages once */
+    embedDBInitIterator(state, &it);
+    embedDBIteratorSetBuffer(&it, buffer);
+    uint32_t key = 0, expectedKey = 0, lookupKey = 2900;
+    int32_t data = 0, lookupData = 0;
+    id_t readsBefore = state->numReads;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKey++, key, "Iterator returned the wrong key.");
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &lookupKey, &lookupData), "embedDBGet did not find the key.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(14, lookupData, "embedDBGet returned the wrong data.");
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3000, expectedKey, "Iterator did not return every key.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(scanReads + 1, state->numReads - readsBefore, "Lookups made the scan read its pages again.");
+    free(buffer);
+}
+
+void embedDBIteratorSetBuffer_interleaved_bitmap_scans_read_index_pages_once(void) {
+    setupEmbedDB(EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP, 800);
+    insertRecords(40000);
+
+    int32_t firstMinData = 20, firstMaxData = 40, secondMinData = 60, secondMaxData = 90;
+    embedDBIterator first, second;
+    first.minKey = NULL;
+    first.maxKey = NULL;
+    first.minData = &firstMinData;
+    first.maxData = &firstMaxData;
+    second.minKey = NULL;
+    second.maxKey = NULL;
+    second.minData = &secondMinData;
+    second.maxData = &secondMaxData;
+
+    void *firstBuffer = malloc(2 * state->pageSize);
+    void *secondBuffer = malloc(2 * state->pageSize);
+    id_t idxReadsBefore = state->numIdxReads;
+    uint32_t separateReads = readsForScan(&first, firstBuffer) + readsForScan(&second, secondBuffer);
+    id_t separateIdxReads = state->numIdxReads - idxReadsBefore;
+    TEST_ASSERT_TRUE_MESSAGE(separateIdxReads > 2, "Scans should read more than one index page each.");
+
+    embedDBInitIterator(state, &first);
+    embedDBIteratorSetBuffer(&first, firstBuffer);
+    embedDBInitIterator(state, &second);
+    embedDBIteratorSetBuffer(&second, secondBuffer);
+    uint32_t key = 0;
+    int32_t data = 0;
+    uint32_t numFirst = 0, numSecond = 0;
+    int8_t firstMore = 1, secondMore = 1;
+    id_t readsBefore = state->numReads;
+    idxReadsBefore = state->numIdxReads;
+    while (firstMore || secondMore) {
+        if (firstMore && (firstMore = embedDBNext(state, &first, &key, &data))) {
+            TEST_ASSERT_TRUE_MESSAGE(data >= firstMinData && data <= firstMaxData, "First iterator returned data outside its range.");
+            numFirst++;
+        }
+        if (secondMore && (secondMore = embedDBNext(state, &second, &key, &data))) {
+            TEST_ASSERT_TRUE_MESSAGE(data >= secondMinData && data <= secondMaxData, "Second iterator returned data outside its range.");
+            numSecond++;
+        }
+    }
+    embedDBCloseIterator(&first);
+    embedDBCloseIterator(&second);
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2 * 21 * 200, numFirst, "First iterator returned the wrong number of records.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2 * 31 * 200, numSecond, "Second iterator returned the wrong number of records.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(separateReads, state->numReads - readsBefore, "Interleaved scans read more data pages than the scans did separately.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(separateIdxReads, state->numIdxReads - idxReadsBefore, "Interleaved scans read more index pages than the scans did separately.");
+    free(firstBuffer);
+    free(secondBuffer);
+}
+
+void embedDBIteratorSetBuffer_forward_and_reverse_scans_interleave(void) {
+    setupEmbedDB(0, 100);
+    insertRecords(3000);
+
+    embedDBIterator forward, reverse;
+    forward.minKey = NULL;
+    forward.maxKey = NULL;
+    forward.minData = NULL;
+    forward.maxData = NULL;
+    reverse.minKey = NULL;
+    reverse.maxKey = NULL;
+    reverse.minData = NULL;
+    reverse.maxData = NULL;
+    void *forwardBuffer = malloc(2 * state->pageSize);
+    void *reverseBuffer = malloc(2 * state->pageSize);
+    uint32_t forwardReads = readsForScan(&forward, forwardBuffer);
+
+    embedDBInitIterator(state, &forward);
+    embedDBIteratorSetBuffer(&forward, forwardBuffer);
+    embedDBInitReverseIterator(state, &reverse);
+    embedDBIteratorSetBuffer(&reverse, reverseBuffer);
+    uint32_t forwardKey = 0, reverseKey = 0;
+    int32_t data = 0;
+    id_t readsBefore = state->numReads;
+    for (uint32_t i = 0; i < 3000; i++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBNext(state, &forward, &forwardKey, &data), "Forward iterator ended early.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(i, forwardKey, "Forward iterator returned the wrong key.");
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPrev(state, &reverse, &reverseKey, &data), "Reverse iterator ended early.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(2999 - i, reverseKey, "Reverse iterator returned the wrong key.");
+    }
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBNext(state, &forward, &forwardKey, &data), "Forward iterator returned too many records.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPrev(state, &reverse, &reverseKey, &data), "Reverse iterator returned too many records.");
+    embedDBCloseIterator(&forward);
+    embedDBCloseIterator(&reverse);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2 * forwardReads, state->numReads - readsBefore, "Interleaved forward and reverse scans read pages again.");
+    free(forwardBuffer);
+    free(reverseBuffer);
+}
+
+void embedDBIteratorSetBuffer_null_buffer_uses_shared_read_buffer(void) {
+    setupEmbedDB(0, 100);
+    insertRecords(3000);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    void *buffer = malloc(2 * state->pageSize);
+    embedDBInitIterator(state, &it);
+    embedDBIteratorSetBuffer(&it, buffer);
+    embedDBIteratorSetBuffer(&it, NULL);
+
+    uint32_t key = 0, expectedKey = 0;
+    int32_t data = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKey++, key, "Iterator returned the wrong key.");
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3000, expectedKey, "Iterator did not return every key.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(state->nextDataPageId - 1, state->bufferedPageId, "Iterator without its own buffer should read into the shared read buffer.");
+    free(buffer);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBIteratorSetBuffer_interleaved_scans_read_as_many_pages_as_separate_scans);
+    RUN_TEST(embedDBIteratorSetBuffer_scan_keeps_its_page_between_lookups);
+    RUN_TEST(embedDBIteratorSetBuffer_interleaved_bitmap_scans_read_index_pages_once);
+    RUN_TEST(embedDBIteratorSetBuffer_forward_and_reverse_scans_interleave);
+    RUN_TEST(embedDBIteratorSetBuffer_null_buffer_uses_shared_read_buffer);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,428 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_key_offsets.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB data pages with keys stored as offsets from the smallest key on the page.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+/* Records the page size of the writes to the data file */
+int8_t (*storageWrite)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+uint32_t dataFileWriteSize = 0;
+
+int8_t recordingWrite(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    if (file == state->dataFile) {
+        dataFileWriteSize = pageSize;
+    }
+    return storageWrite(buffer, pageNum, pageSize, file);
+}
+
+/* Settings rejected by embedDBInit leave the files unopened, so the state is freed without closing it */
+int8_t embedDBOpened = 0;
+
+int8_t uint64Comparator(void *a, void *b) {
+    uint64_t i1, i2;
+    memcpy(&i1, a, sizeof(uint64_t));
+    memcpy(&i2, b, sizeof(uint64_t));
+    return i1 < i2 ? -1 : (i1 > i2 ? 1 : 0);
+}
+
+int8_t openEmbedDB(uint32_t parameters, int8_t keySize, int8_t keyOffsetSize, count_t compressedPageSize, uint32_t numDataPages) {
+    state = (embedDBState *)calloc(1, sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = keySize;
+    state->dataSize = 4;
+    state->compareKey = keySize == 8 ? uint64Comparator : int32Comparator;
+    state->compareData = int32Comparator;
+    state->pageSize = 512;
+    state->compressedPageSize = compressedPageSize;
+    state->keyOffsetSize = keyOffsetSize;
+    state->bufferSizeInBlocks = EMBEDDB_COMPRESSION_BUFFER(parameters) + 1;
+    state->numSplinePoints = 64;
+    state->bitmapSize = 1;
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    storageWrite = state->fileInterface->write;
+    state->fileInterface->write = recordingWrite;
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = EMBEDDB_USING_INDEX(parameters) ? setupFile(INDEX_PATH) : NULL;
+    state->parameters = EMBEDDB_USE_KEY_OFFSETS | parameters;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->inBitmap = inBitmapInt8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    int8_t result = embedDBInit(state, 1);
+    embedDBOpened = result == 0;
+    return result;
+}
+
+void tearDownEmbedDB() {
+    if (state == NULL) {
+        return;
+    }
+    free(state->buffer);
+    if (embedDBOpened) {
+        embedDBClose(state);
+    }
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+    state = NULL;
+}
+
+void setUp(void) {
+    dataFileWriteSize = 0;
+}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Millisecond timestamps about a second apart, with a gap of a few minutes every 300 records */
+uint64_t timestampKey(uint32_t record) {
+    return 1700000000000ull + (uint64_t)record * 1000 + (record * 37) % 50 + (uint64_t)(record / 300) * 240000;
+}
+
+int32_t timestampData(uint32_t record) {
+    return (int32_t)((record * 7919u) % 1000u) - 500;
+}
+
+void insertTimestamps(uint32_t firstRecord, uint32_t numRecords) {
+    for (uint32_t record = firstRecord; record < firstRecord + numRecords; record++) {
+        uint64_t key = timestampKey(record);
+        int32_t data = timestampData(record);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert a record.");
+    }
+}
+
+void assertTimestampsFound(uint32_t firstRecord, uint32_t numRecords) {
+    for (uint32_t record = firstRecord; record < numRecords; record++) {
+        uint64_t key = timestampKey(record);
+        int32_t data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record on a page with key offsets.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(timestampData(record), data, "embedDBGet returned the wrong data from a page with key offsets.");
+    }
+}
+
+/* Checks that no page holds keys further apart than a key offset can store, and returns the number of records */
+uint32_t checkPageKeyRanges(uint64_t maxOffset) {
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    embedDBPageBatch batch;
+    uint32_t numRecords = 0;
+    while (embedDBNextPage(state, &it, &batch)) {
+        uint64_t firstKey = 0, lastKey = 0;
+        memcpy(&firstKey, (int8_t *)batch.records, state->keySize);
+        memcpy(&lastKey, (int8_t *)batch.records + (EMBEDDB_GET_COUNT(batch.page) - 1) * batch.recordSize, state->keySize);
+        TEST_ASSERT_TRUE_MESSAGE(lastKey - firstKey <= maxOffset, "A page holds keys further apart than a key offset can store.");
+        TEST_ASSERT_TRUE_MESSAGE(EMBEDDB_GET_COUNT(batch.page) <= state->maxRecordsPerPage, "A page holds more records than fit in the data file.");
+        numRecords += batch.end - batch.start;
+    }
+    embedDBCloseIterator(&it);
+    return numRecords;
+}
+
+void key_offsets_should_store_more_records_in_each_data_file_page() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 8, 2, 256, 1000));
+    uint32_t uncompressedRecordsPerPage = (256 - state->headerSize) / state->recordSize;
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE((256 - state->headerSize) / 6, state->maxRecordsPerPage, "Pages do not hold as many records as fit in the data file with key offsets.");
+    TEST_ASSERT_TRUE_MESSAGE(state->maxRecordsPerPage > uncompressedRecordsPerPage * 3 / 2, "Key offsets did not widen the pages.");
+
+    uint32_t numRecords = 5000;
+    insertTimestamps(0, numRecords);
+    TEST_ASSERT_EQUAL_INT8(0, embedDBFlush(state));
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(256, dataFileWriteSize, "Data pages were not written with the compressed page size.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords, checkPageKeyRanges(UINT16_MAX), "The pages did not hold every record.");
+    assertTimestampsFound(0, numRecords);
+
+    uint64_t key = timestampKey(100) + 1;
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was not inserted.");
+}
+
+void key_offsets_should_return_records_in_order_from_iterators() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP | EMBEDDB_USE_UINT_KEYS, 8, 2, 256, 1000));
+    uint32_t numRecords = 3000;
+    insertTimestamps(0, numRecords);
+
+    uint64_t minKey = timestampKey(777), maxKey = timestampKey(2222);
+    embedDBIterator it;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint64_t key = 0;
+    int32_t data = 0;
+    uint32_t record = 777;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(timestampKey(record), key, "embedDBNext returned the wrong key from a page with key offsets.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(timestampData(record), data, "embedDBNext returned the wrong data from a page with key offsets.");
+        record++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2223, record, "embedDBNext did not return every record in the range.");
+
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    embedDBInitReverseIterator(state, &it);
+    record = numRecords;
+    while (embedDBPrev(state, &it, &key, &data)) {
+        record--;
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(timestampKey(record), key, "embedDBPrev returned the wrong key from a page with key offsets.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(timestampData(record), data, "embedDBPrev returned the wrong data from a page with key offsets.");
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, record, "embedDBPrev did not return every record.");
+}
+
+void key_offsets_should_start_a_page_when_a_key_is_too_far_from_the_first_key() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 8, 2, 256, 1000));
+    /* Keys 20000 apart, so the fifth key on a page would be more than 65535 from the first */
+    uint64_t key = 5000000000ull;
+    int32_t data = 1;
+    for (uint32_t record = 0; record < 40; record++) {
+        TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &key, &data));
+        key += 20000;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(9, state->nextDataPageId, "Pages were not started when keys no longer fit in a key offset.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(40, checkPageKeyRanges(UINT16_MAX), "The pages did not hold every record.");
+
+    /* A key exactly 65535 from the first key on the page still fits */
+    TEST_ASSERT_EQUAL_INT8(0, embedDBFlush(state));
+    uint64_t firstKey = key;
+    TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &firstKey, &data));
+    uint64_t lastKey = firstKey + UINT16_MAX;
+    TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &lastKey, &data));
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(2, EMBEDDB_GET_COUNT(state->buffer), "A key at the largest offset did not fit on the page.");
+    uint64_t nextKey = firstKey + UINT16_MAX + 1;
+    TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &nextKey, &data));
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(1, EMBEDDB_GET_COUNT(state->buffer), "A key past the largest offset did not start a page.");
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGet(state, &lastKey, &data));
+    TEST_ASSERT_EQUAL_INT8(0, embedDBGet(state, &firstKey, &data));
+}
+
+void key_offsets_should_split_batches_at_keys_too_far_from_the_first_key() {
+    uint32_t numRecords = 4000;
+    uint64_t *keys = (uint64_t *)malloc(numRecords * sizeof(uint64_t));
+    int32_t *datas = (int32_t *)malloc(numRecords * sizeof(int32_t));
+    TEST_ASSERT_TRUE_MESSAGE(keys != NULL && datas != NULL, "Failed to allocate the batch.");
+    for (uint32_t record = 0; record < numRecords; record++) {
+        keys[record] = timestampKey(record);
+        datas[record] = timestampData(record);
+    }
+
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 8, 2, 256, 1000));
+    insertTimestamps(0, numRecords);
+    id_t pagesWithPut = state->nextDataPageId;
+    tearDownEmbedDB();
+
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 8, 2, 256, 1000));
+    for (uint32_t inserted = 0; inserted < numRecords; inserted += 250) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys + inserted, datas + inserted, 250), "embedDBPutBatch did not insert a batch.");
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(pagesWithPut, state->nextDataPageId, "embedDBPutBatch did not fill pages the same way as embedDBPut.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords, checkPageKeyRanges(UINT16_MAX), "The pages did not hold every record.");
+    assertTimestampsFound(0, numRecords);
+    free(keys);
+    free(datas);
+}
+
+void key_offsets_should_store_32_bit_offsets() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 8, 4, 256, 1000));
+    TEST_ASSERT_EQUAL_UINT32((256 - state->headerSize) / 8, state->maxRecordsPerPage);
+    /* Keys a day of milliseconds apart only fit in 32 bit offsets */
+    uint64_t key = 1700000000000ull;
+    for (uint32_t record = 0; record < 2000; record++) {
+        int32_t data = (int32_t)record;
+        TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &key, &data));
+        key += 86400000ull + record % 7;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2000, checkPageKeyRanges(UINT32_MAX), "The pages did not hold every record.");
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint64_t expectedKey = 1700000000000ull, foundKey = 0;
+    int32_t data = 0;
+    uint32_t record = 0;
+    while (embedDBNext(state, &it, &foundKey, &data)) {
+        TEST_ASSERT_EQUAL_UINT64_MESSAGE(expectedKey, foundKey, "embedDBNext returned the wrong key from a page with 32 bit key offsets.");
+        TEST_ASSERT_EQUAL_INT32((int32_t)record, data);
+        TEST_ASSERT_EQUAL_INT8(0, embedDBGet(state, &foundKey, &data));
+        TEST_ASSERT_EQUAL_INT32((int32_t)record, data);
+        expectedKey += 86400000ull + record % 7;
+        record++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32(2000, record);
+}
+
+void key_offsets_should_restore_4_byte_keys() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 4, 2, 128, 1000));
+    TEST_ASSERT_EQUAL_UINT32((128 - state->headerSize) / 6, state->maxRecordsPerPage);
+    int32_t numRecords = 3000;
+    for (int32_t record = 0; record < numRecords; record++) {
+        int32_t key = 4500 + record * 3, data = record;
+        TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &key, &data));
+    }
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    int32_t key = 0, data = 0, record = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(4500 + record * 3, key, "embedDBNext returned the wrong 4 byte key from a page with key offsets.");
+        TEST_ASSERT_EQUAL_INT32(record, data);
+        record++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_INT32(numRecords, record);
+    for (record = 0; record < numRecords; record += 7) {
+        key = 4500 + record * 3;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a 4 byte key.");
+        TEST_ASSERT_EQUAL_INT32(record, data);
+    }
+}
+
+void key_offsets_should_recover_records_after_reopening_and_wrapping() {
+    TEST_ASSERT_EQUAL_INT8(0, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 8, 2, 256, 32));
+    uint32_t numRecords = 2500;
+    insertTimestamps(0, numRecords);
+    TEST_ASSERT_EQUAL_INT8(0, embedDBFlush(state));
+    id_t nextDataPageId = state->nextDataPageId;
+    tearDownEmbedDB();
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, openEmbedDB(EMBEDDB_USE_MAX_MIN, 8, 2, 256, 32), "EmbedDB did not reopen a data file with key offsets.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(nextDataPageId, state->nextDataPageId, "Recovery did not find every page.");
+    insertTimestamps(numRecords, 500);
+    uint32_t numKept = checkPageKeyRanges(UINT16_MAX);
+    TEST_ASSERT_TRUE_MESSAGE(numKept < numRecords, "The data file did not wrap around.");
+    assertTimestampsFound(numRecords + 500 - numKept, numRecords + 500);
+    uint64_t key = timestampKey(0);
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a record on an erased page.");
+}
+
+void key_offsets_should_reject_unsupported_settings() {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_RESET_DATA, 8, 2, 256, 1000), "embedDBInit accepted key offsets without the smallest key in the page header.");
+    tearDownEmbedDB();
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 8, 3, 256, 1000), "embedDBInit accepted a key offset size of 3 bytes.");
+    tearDownEmbedDB();
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 4, 4, 256, 1000), "embedDBInit accepted key offsets as large as the keys.");
+    tearDownEmbedDB();
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_COMPRESSION, 8, 2, 256, 1000), "embedDBInit accepted key offsets with compression.");
+    tearDownEmbedDB();
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_MAX_MIN, 8, 2, 1024, 1000), "embedDBInit accepted a compressed page size larger than the page size.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(key_offsets_should_store_more_records_in_each_data_file_page);
+    RUN_TEST(key_offsets_should_return_records_in_order_from_iterators);
+    RUN_TEST(key_offsets_should_start_a_page_when_a_key_is_too_far_from_the_first_key);
+    RUN_TEST(key_offsets_should_split_batches_at_keys_too_far_from_the_first_key);
+    RUN_TEST(key_offsets_should_store_32_bit_offsets);
+    RUN_TEST(key_offsets_should_restore_4_byte_keys);
+    RUN_TEST(key_offsets_should_recover_records_after_reopening_and_wrapping);
+    RUN_TEST(key_offsets_should_reject_unsupported_settings);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,301 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_next_page.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test reading iterator results a page at a time without copying records.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setupEmbedDB(uint32_t parameters, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 256;
+    state->bitmapSize = EMBEDDB_USING_BMAP(parameters) ? 1 : 0;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = EMBEDDB_USING_INDEX(parameters) ? setupFile(INDEX_PATH) : NULL;
+    state->parameters = EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Keys with gaps that grow every 100 records, so the spline has to interpolate between its points */
+uint32_t keyOf(uint32_t record) {
+    uint32_t step = record / 100;
+    return record * 3 + step * step * 40;
+}
+
+/* Data values from 0 to 99 that change slowly, so some pages have no data in a small range */
+int32_t dataOf(uint32_t record) {
+    return (int32_t)(record / 150 % 100);
+}
+
+void insertRecords(uint32_t numRecords) {
+    for (uint32_t record = 0; record < numRecords; record++) {
+        uint32_t key = keyOf(record);
+        int32_t data = dataOf(record);
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+void initIterator(embedDBIterator *it, uint32_t *minKey, uint32_t *maxKey, int32_t *minData, int32_t *maxData) {
+    it->minKey = minKey;
+    it->maxKey = maxKey;
+    it->minData = minData;
+    it->maxData = maxData;
+    embedDBInitIterator(state, it);
+}
+
+/*
+ * Reads the iterator a page at a time and checks that the batches hold the records from firstRecord to lastRecord in order.
+ * Records outside the data range are skipped, as the batches are only filtered by key. Returns the number of records in range.
+ */
+uint32_t assertPages(embedDBIterator *it, uint32_t firstRecord, uint32_t lastRecord, int32_t minData, int32_t maxData) {
+    embedDBPageBatch batch;
+    uint32_t record = firstRecord, numRecords = 0;
+    char message[100];
+    while (embedDBNextPage(state, it, &batch)) {
+        TEST_ASSERT_EQUAL_INT8(state->recordSize, batch.recordSize);
+        TEST_ASSERT_TRUE_MESSAGE(batch.start < batch.end, "embedDBNextPage returned an empty batch.");
+        TEST_ASSERT_TRUE_MESSAGE(batch.end <= EMBEDDB_GET_COUNT(batch.page), "embedDBNextPage returned records past the end of the page.");
+        for (count_t i = batch.start; i < batch.end; i++) {
+            int8_t *recordPtr = (int8_t *)batch.records + i * batch.recordSize;
+            uint32_t key = 0;
+            int32_t data = 0;
+            memcpy(&key, recordPtr, sizeof(uint32_t));
+            memcpy(&data, recordPtr + state->keySize, sizeof(int32_t));
+
+            /* Pages with no data in range are skipped, so move to the record with this key */
+            while (record <= lastRecord && keyOf(record) < key && (dataOf(record) < minData || dataOf(record) > maxData)) {
+                record++;
+            }
+            snprintf(message, 100, "embedDBNextPage returned key %lu instead of record %lu.", (unsigned long)key, (unsigned long)record);
+            TEST_ASSERT_TRUE_MESSAGE(record <= lastRecord, message);
+            TEST_ASSERT_EQUAL_UINT32_MESSAGE(keyOf(record), key, message);
+            TEST_ASSERT_EQUAL_INT32_MESSAGE(dataOf(record), data, "embedDBNextPage returned the wrong data.");
+            if (data >= minData && data <= maxData)
+                numRecords++;
+            record++;
+        }
+    }
+    while (record <= lastRecord && (dataOf(record) < minData || dataOf(record) > maxData)) {
+        record++;
+    }
+    snprintf(message, 100, "embedDBNextPage stopped before record %lu.", (unsigned long)record);
+    TEST_ASSERT_TRUE_MESSAGE(record > lastRecord, message);
+    return numRecords;
+}
+
+void nextPage_should_return_every_record() {
+    setupEmbedDB(0, 200);
+    uint32_t numRecords = 40 * state->maxRecordsPerPage + 11;
+    insertRecords(numRecords);
+
+    embedDBIterator it;
+    initIterator(&it, NULL, NULL, NULL, NULL);
+    TEST_ASSERT_EQUAL_UINT32(numRecords, assertPages(&it, 0, numRecords - 1, INT32_MIN, INT32_MAX));
+    embedDBCloseIterator(&it);
+}
+
+void nextPage_should_return_records_in_key_range() {
+    setupEmbedDB(0, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numRecords = 100 * recordsPerPage + 11;
+    insertRecords(numRecords);
+
+    for (uint32_t firstRecord = 3; firstRecord < numRecords; firstRecord += 1111) {
+        uint32_t lastRecord = firstRecord + 3 * recordsPerPage < numRecords ? firstRecord + 3 * recordsPerPage : numRecords - 1;
+        uint32_t minKey = keyOf(firstRecord), maxKey = keyOf(lastRecord);
+        embedDBIterator it;
+        initIterator(&it, &minKey, &maxKey, NULL, NULL);
+        TEST_ASSERT_EQUAL_UINT32(lastRecord - firstRecord + 1, assertPages(&it, firstRecord, lastRecord, INT32_MIN, INT32_MAX));
+        embedDBCloseIterator(&it);
+    }
+
+    /* Keys between records */
+    uint32_t minKey = keyOf(500) + 1, maxKey = keyOf(900) - 1;
+    embedDBIterator it;
+    initIterator(&it, &minKey, &maxKey, NULL, NULL);
+    TEST_ASSERT_EQUAL_UINT32(399, assertPages(&it, 501, 899, INT32_MIN, INT32_MAX));
+    embedDBCloseIterator(&it);
+}
+
+void nextPage_should_continue_from_embedDBNext() {
+    setupEmbedDB(0, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(10 * recordsPerPage + 5);
+
+    embedDBIterator it;
+    initIterator(&it, NULL, NULL, NULL, NULL);
+    uint32_t key = 0;
+    int32_t data = 0;
+    for (uint32_t i = 0; i < 7; i++) {
+        TEST_ASSERT_EQUAL_INT8(1, embedDBNext(state, &it, &key, &data));
+    }
+
+    /* The rest of the first page is returned, then the following pages */
+    embedDBPageBatch batch;
+    TEST_ASSERT_EQUAL_INT8(1, embedDBNextPage(state, &it, &batch));
+    TEST_ASSERT_EQUAL_UINT32(7, batch.start);
+    TEST_ASSERT_EQUAL_UINT32(recordsPerPage, batch.end);
+    TEST_ASSERT_EQUAL_UINT32(10 * recordsPerPage + 5 - recordsPerPage, assertPages(&it, recordsPerPage, 10 * recordsPerPage + 4, INT32_MIN, INT32_MAX));
+    embedDBCloseIterator(&it);
+}
+
+void nextPage_should_skip_pages_without_data_in_range() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_ZONE_MAP, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numRecords = 100 * recordsPerPage;
+    insertRecords(numRecords);
+    embedDBFlush(state);
+
+    int32_t minData = 20, maxData = 21;
+    embedDBIterator it;
+    initIterator(&it, NULL, NULL, &minData, &maxData);
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_UINT32(300, assertPages(&it, 0, numRecords - 1, minData, maxData));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(300 / recordsPerPage + 2, state->numReads, "embedDBNextPage read pages with no data in range.");
+    embedDBCloseIterator(&it);
+}
+
+void nextPage_should_return_nothing_for_empty_range() {
+    setupEmbedDB(0, 200);
+    insertRecords(10 * state->maxRecordsPerPage);
+
+    uint32_t minKey = keyOf(100) + 1, maxKey = keyOf(101) - 1;
+    embedDBIterator it;
+    embedDBPageBatch batch;
+    initIterator(&it, &minKey, &maxKey, NULL, NULL);
+    TEST_ASSERT_EQUAL_INT8(0, embedDBNextPage(state, &it, &batch));
+    embedDBCloseIterator(&it);
+
+    minKey = keyOf(10 * state->maxRecordsPerPage) + 1;
+    initIterator(&it, &minKey, NULL, NULL, NULL);
+    TEST_ASSERT_EQUAL_INT8(0, embedDBNextPage(state, &it, &batch));
+    embedDBCloseIterator(&it);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(nextPage_should_return_every_record);
+    RUN_TEST(nextPage_should_return_records_in_key_range);
+    RUN_TEST(nextPage_should_continue_from_embedDBNext);
+    RUN_TEST(nextPage_should_skip_pages_without_data_in_range);
+    RUN_TEST(nextPage_should_return_nothing_for_empty_range);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,280 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_put_batch.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test inserting batches of records with embedDBPutBatch.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#define COMPARE_DATA_PATH "dataFile2.bin"
+#define COMPARE_INDEX_PATH "indexFile2.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#define COMPARE_DATA_PATH "build/artifacts/dataFile2.bin"
+#define COMPARE_INDEX_PATH "build/artifacts/indexFile2.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+embedDBState *setupEmbedDB(char *dataPath, char *indexPath) {
+    embedDBState *newState = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(newState, "Unable to allocate embedDBState.");
+    newState->keySize = 4;
+    newState->dataSize = 4;
+    newState->pageSize = 512;
+    newState->bufferSizeInBlocks = 4;
+    newState->numSplinePoints = 8;
+    newState->bitmapSize = 8;
+    newState->buffer = malloc((size_t)newState->bufferSizeInBlocks * newState->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(newState->buffer, "Failed to allocate buffer for EmbedDB.");
+    newState->numDataPages = 1000;
+    newState->numIndexPages = 8;
+    newState->eraseSizeInPages = 4;
+    newState->fileInterface = getFileInterface();
+    newState->dataFile = setupFile(dataPath);
+    newState->indexFile = setupFile(indexPath);
+    newState->parameters = EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX | EMBEDDB_RESET_DATA;
+    newState->compareKey = int32Comparator;
+    newState->compareData = int32Comparator;
+    newState->inBitmap = inBitmapInt64;
+    newState->updateBitmap = updateBitmapInt64;
+    newState->buildBitmapFromRange = buildBitmapInt64FromRange;
+    int8_t result = embedDBInit(newState, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+    return newState;
+}
+
+void tearDownEmbedDB(embedDBState *oldState) {
+    free(oldState->buffer);
+    embedDBClose(oldState);
+    tearDownFile(oldState->dataFile);
+    tearDownFile(oldState->indexFile);
+    free(oldState->fileInterface);
+    free(oldState);
+}
+
+void setUp(void) {
+    char dataPath[] = DATA_PATH, indexPath[] = INDEX_PATH;
+    state = setupEmbedDB(dataPath, indexPath);
+}
+
+void tearDown(void) {
+    tearDownEmbedDB(state);
+}
+
+void fillBatch(uint32_t *keys, int32_t *data, uint32_t numRecords, uint32_t startingKey) {
+    for (uint32_t i = 0; i < numRecords; i++) {
+        keys[i] = startingKey + i * 2;
+        data[i] = (int32_t)(300 + (keys[i] * 7) % 700);
+    }
+}
+
+void embedDBPutBatch_should_insert_records_across_multiple_pages() {
+    uint32_t numRecords = 500;
+    uint32_t *keys = (uint32_t *)malloc(numRecords * sizeof(uint32_t));
+    int32_t *data = (int32_t *)malloc(numRecords * sizeof(int32_t));
+    fillBatch(keys, data, numRecords, 10);
+
+    int8_t result = embedDBPutBatch(state, keys, data, numRecords);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPutBatch returned a non-zero value for a valid batch.");
+
+    /* 500 records at 60 records per page should write 8 full pages and leave the rest in the write buffer */
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(8, state->nextDataPageId, "embedDBPutBatch did not write the expected number of data pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(20, EMBEDDB_GET_COUNT(state->buffer), "embedDBPutBatch left the wrong number of records in the write buffer.");
+
+    int32_t actualData = 0;
+    char message[100];
+    for (uint32_t i = 0; i < numRecords; i++) {
+        snprintf(message, 100, "embedDBGet was unable to find key %u inserted by embedDBPutBatch.", keys[i]);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &keys[i], &actualData), message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(data[i], actualData, "embedDBGet returned the wrong data for a record inserted by embedDBPutBatch.");
+    }
+
+    free(keys);
+    free(data);
+}
+
+void embedDBPutBatch_should_produce_same_pages_as_embedDBPut() {
+    char dataPath[] = COMPARE_DATA_PATH, indexPath[] = COMPARE_INDEX_PATH;
+    embedDBState *compareState = setupEmbedDB(dataPath, indexPath);
+
+    uint32_t numRecords = 300;
+    uint32_t *keys = (uint32_t *)malloc(numRecords * sizeof(uint32_t));
+    int32_t *data = (int32_t *)malloc(numRecords * sizeof(int32_t));
+    fillBatch(keys, data, numRecords, 1000);
+
+    /* Split the batch so that it starts in the middle of a page */
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys, data, 17), "embedDBPutBatch failed to insert the first part of the batch.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys + 17, data + 17, numRecords - 17), "embedDBPutBatch failed to insert the second part of the batch.");
+    for (uint32_t i = 0; i < numRecords; i++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(compareState, &keys[i], &data[i]), "embedDBPut failed to insert a record.");
+    }
+    embedDBFlush(state);
+    embedDBFlush(compareState);
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(compareState->nextDataPageId, state->nextDataPageId, "embedDBPutBatch wrote a different number of pages than embedDBPut.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(compareState->nextIdxPageId, state->nextIdxPageId, "embedDBPutBatch wrote a different number of index pages than embedDBPut.");
+    for (uint32_t i = 0; i < state->nextDataPageId; i++) {
+        readPage(state, i);
+        readPage(compareState, i);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE((int8_t *)compareState->buffer + compareState->pageSize * EMBEDDB_DATA_READ_BUFFER,
+                                         (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER,
+                                         state->pageSize, "Data page written by embedDBPutBatch did not match the page written by embedDBPut.");
+    }
+    readIndexPage(state, 0);
+    readIndexPage(compareState, 0);
+    TEST_ASSERT_EQUAL_MEMORY_MESSAGE((int8_t *)compareState->buffer + compareState->pageSize * EMBEDDB_INDEX_READ_BUFFER,
+                                     (int8_t *)state->buffer + state->pageSize * EMBEDDB_INDEX_READ_BUFFER,
+                                     state->pageSize, "Index page written by embedDBPutBatch did not match the page written by embedDBPut.");
+
+    free(keys);
+    free(data);
+    tearDownEmbedDB(compareState);
+}
+
+void embedDBPutBatch_should_reject_batch_with_unordered_keys() {
+    uint32_t keys[] = {1, 2, 3, 5, 4, 6};
+    int32_t data[] = {1, 2, 3, 4, 5, 6};
+    int8_t result = embedDBPutBatch(state, keys, data, 6);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, result, "embedDBPutBatch accepted a batch with keys out of order.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, EMBEDDB_GET_COUNT(state->buffer), "embedDBPutBatch inserted records from a batch that was rejected.");
+}
+
+void embedDBPutBatch_should_reject_keys_smaller_than_stored_keys() {
+    uint32_t numRecords = 100;
+    uint32_t *keys = (uint32_t *)malloc(numRecords * sizeof(uint32_t));
+    int32_t *data = (int32_t *)malloc(numRecords * sizeof(int32_t));
+    fillBatch(keys, data, numRecords, 100);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys, data, numRecords), "embedDBPutBatch failed to insert a valid batch.");
+
+    count_t count = EMBEDDB_GET_COUNT(state->buffer);
+    uint32_t smallKeys[] = {150, 400};
+    int32_t smallData[] = {1, 2};
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPutBatch(state, smallKeys, smallData, 2), "embedDBPutBatch accepted a key smaller than the largest stored key.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(count, EMBEDDB_GET_COUNT(state->buffer), "embedDBPutBatch inserted records from a batch that was rejected.");
+
+    free(keys);
+    free(data);
+}
+
+void embedDBPutBatch_records_should_be_returned_by_iterator_with_single_puts() {
+    uint32_t numRecords = 200;
+    uint32_t *keys = (uint32_t *)malloc(numRecords * sizeof(uint32_t));
+    int32_t *data = (int32_t *)malloc(numRecords * sizeof(int32_t));
+    fillBatch(keys, data, numRecords, 0);
+
+    /* Interleave single inserts and batches */
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &keys[0], &data[0]), "embedDBPut failed to insert a record.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys + 1, data + 1, 120), "embedDBPutBatch failed to insert a valid batch.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &keys[121], &data[121]), "embedDBPut failed to insert a record after a batch.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys + 122, data + 122, numRecords - 122), "embedDBPutBatch failed to insert a valid batch.");
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+
+    uint32_t itKey = 0;
+    int32_t itData = 0;
+    uint32_t numRead = 0;
+    while (embedDBNext(state, &it, &itKey, &itData)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(keys[numRead], itKey, "Iterator returned the wrong key after batch inserts.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(data[numRead], itData, "Iterator returned the wrong data after batch inserts.");
+        numRead++;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords, numRead, "Iterator did not return every record inserted.");
+    embedDBCloseIterator(&it);
+
+    free(keys);
+    free(data);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(embedDBPutBatch_should_insert_records_across_multiple_pages);
+    RUN_TEST(embedDBPutBatch_should_produce_same_pages_as_embedDBPut);
+    RUN_TEST(embedDBPutBatch_should_reject_batch_with_unordered_keys);
+    RUN_TEST(embedDBPutBatch_should_reject_keys_smaller_than_stored_keys);
+    RUN_TEST(embedDBPutBatch_records_should_be_returned_by_iterator_with_single_puts);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,317 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_range_aggregates.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the EmbedDB range count and min and max aggregates.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+
+embedDBState *state;
+
+void setupEmbedDB(int16_t parameters, int8_t bitmapSize, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 32;
+    state->bitmapSize = bitmapSize;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = setupFile(INDEX_PATH);
+    state->parameters = EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    if (bitmapSize == 1) {
+        state->inBitmap = inBitmapInt8;
+        state->updateBitmap = updateBitmapInt8;
+        state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    } else {
+        state->inBitmap = inBitmapInt64;
+        state->updateBitmap = updateBitmapInt64;
+        state->buildBitmapFromRange = buildBitmapInt64FromRange;
+    }
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Data values that go up and down, including negative values */
+int32_t dataOf(uint32_t key) {
+    return (int32_t)(key * 7919 % 10007) - 5000;
+}
+
+/* Inserts keys 0, 2, 4 and so on */
+void insertRecords(uint32_t numRecords) {
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = i * 2;
+        int32_t data = dataOf(key);
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+/* Count, smallest and largest data of the records inserted by insertRecords in [minKey, maxKey] */
+uint32_t expectedRange(uint32_t numRecords, uint32_t minKey, uint32_t maxKey, int32_t *minData, int32_t *maxData) {
+    uint32_t count = 0;
+    for (uint32_t i = state->minDataPageId * state->maxRecordsPerPage; i < numRecords; i++) {
+        uint32_t key = i * 2;
+        if (key < minKey || key > maxKey)
+            continue;
+        int32_t data = dataOf(key);
+        if (count == 0 || data < *minData)
+            *minData = data;
+        if (count == 0 || data > *maxData)
+            *maxData = data;
+        count++;
+    }
+    return count;
+}
+
+void assertRangeMinMax(uint32_t numRecords, uint32_t minKey, uint32_t maxKey) {
+    int32_t expectedMin = 0, expectedMax = 0, minData = 0, maxData = 0;
+    uint32_t expectedCount = expectedRange(numRecords, minKey, maxKey, &expectedMin, &expectedMax);
+    char message[100];
+    snprintf(message, 100, "embedDBRangeMinMax returned the wrong result for keys %lu to %lu.", (unsigned long)minKey, (unsigned long)maxKey);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(expectedCount == 0 ? 1 : 0, embedDBRangeMinMax(state, &minKey, &maxKey, &minData, &maxData), message);
+    if (expectedCount > 0) {
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(expectedMin, minData, message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(expectedMax, maxData, message);
+    }
+}
+
+void assertRangeCount(uint32_t numRecords, uint32_t minKey, uint32_t maxKey) {
+    int32_t minData, maxData;
+    uint32_t count = 0;
+    char message[100];
+    snprintf(message, 100, "embedDBRangeCount returned the wrong count for keys %lu to %lu.", (unsigned long)minKey, (unsigned long)maxKey);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRangeCount(state, &minKey, &maxKey, &count), message);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedRange(numRecords, minKey, maxKey, &minData, &maxData), count, message);
+}
+
+void rangeMinMax_should_match_records_in_range() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX, 8, 64);
+    uint32_t numRecords = 25 * state->maxRecordsPerPage + 30;
+    insertRecords(numRecords);
+
+    uint32_t maxKey = 2 * numRecords;
+    uint32_t ranges[][2] = {{0, maxKey}, {0, 0}, {11, 13}, {100, 900}, {2 * 3 * state->maxRecordsPerPage, 2 * 9 * state->maxRecordsPerPage - 2}, {maxKey - 50, maxKey + 50}, {1500, 5000}};
+    for (uint32_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        assertRangeMinMax(numRecords, ranges[i][0], ranges[i][1]);
+    }
+}
+
+void rangeMinMax_should_not_change_values_for_empty_range() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX, 8, 64);
+    insertRecords(5 * state->maxRecordsPerPage);
+
+    uint32_t minKey = 11, maxKey = 11;
+    int32_t minData = 123, maxData = 456;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBRangeMinMax(state, &minKey, &maxKey, &minData, &maxData), "embedDBRangeMinMax did not report an empty range.");
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(123, minData, "embedDBRangeMinMax changed the smallest value for an empty range.");
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(456, maxData, "embedDBRangeMinMax changed the largest value for an empty range.");
+}
+
+void rangeMinMax_should_use_index_pages_for_long_ranges() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_SUM | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX, 8, 1000);
+    uint32_t numRecords = 600 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+    embedDBFlush(state);
+
+    /* Around 520 data pages are in the range. Only the data pages before the first and after the last index page in the range are read. */
+    embedDBResetStats(state);
+    assertRangeMinMax(numRecords, 2 * 40 * state->maxRecordsPerPage + 3, 2 * 560 * state->maxRecordsPerPage + 9);
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(100, state->numReads + state->numIdxReads, "embedDBRangeMinMax read too many pages for a long range.");
+    embedDBResetStats(state);
+    assertRangeCount(numRecords, 2 * 40 * state->maxRecordsPerPage + 3, 2 * 560 * state->maxRecordsPerPage + 9);
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(100, state->numReads + state->numIdxReads, "embedDBRangeCount read too many pages for a long range.");
+}
+
+void rangeCount_should_count_without_max_min() {
+    setupEmbedDB(0, 8, 64);
+    uint32_t numRecords = 20 * state->maxRecordsPerPage + 7;
+    insertRecords(numRecords);
+
+    uint32_t maxKey = 2 * numRecords;
+    uint32_t ranges[][2] = {{0, maxKey}, {1, 1}, {2, 2}, {101, 2001}, {maxKey - 20, maxKey + 20}};
+    for (uint32_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        assertRangeCount(numRecords, ranges[i][0], ranges[i][1]);
+    }
+
+    uint32_t count = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRangeCount(state, NULL, NULL, &count), "embedDBRangeCount returned an error.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords, count, "embedDBRangeCount did not count every record for an open range.");
+}
+
+void rangeMinMax_should_skip_erased_pages() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_SUM | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX, 8, 64);
+    uint32_t numRecords = 150 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->minDataPageId, "The data file did not wrap.");
+    assertRangeMinMax(numRecords, 0, 2 * numRecords);
+    assertRangeCount(numRecords, 0, 2 * numRecords);
+}
+
+void maxMin_header_should_not_overlap_records_with_small_bitmap() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_BMAP | EMBEDDB_USE_INDEX, 1, 64);
+    uint32_t numRecords = 10 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+    embedDBFlush(state);
+
+    for (uint32_t i = 0; i < numRecords; i += 3) {
+        uint32_t key = i * 2;
+        int32_t data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet could not find a record.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataOf(key), data, "embedDBGet returned the wrong data.");
+    }
+    assertRangeMinMax(numRecords, 0, 2 * numRecords);
+}
+
+void maxMin_header_should_not_overlap_records_without_index() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN, 0, 64);
+    /* The max data ends 8 bytes past 6 + keySize * 2 + dataSize * 2, where the records used to start without a bitmap */
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(EMBEDDB_MIN_OFFSET + 2 * state->keySize + 2 * state->dataSize, state->headerSize, "The header does not end after the max data.");
+    uint32_t numRecords = 3 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+    embedDBFlush(state);
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, readPage(state, 1), "Unable to read the second data page.");
+    void *page = (int8_t *)state->buffer + EMBEDDB_DATA_READ_BUFFER * state->pageSize;
+    uint32_t firstKey = 0;
+    memcpy(&firstKey, (int8_t *)page + state->headerSize, sizeof(uint32_t));
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2 * state->maxRecordsPerPage, firstKey, "The first record of the page was overwritten.");
+    int32_t expectedMin = 0, expectedMax = 0, maxData = 0;
+    expectedRange(numRecords, 2 * state->maxRecordsPerPage, 4 * state->maxRecordsPerPage - 2, &expectedMin, &expectedMax);
+    memcpy(&maxData, EMBEDDB_GET_MAX_DATA(page, state), sizeof(int32_t));
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(expectedMax, maxData, "The max data of the page was overwritten.");
+
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = i * 2;
+        int32_t data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet could not find a record.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataOf(key), data, "embedDBGet returned the wrong data.");
+    }
+}
+
+void rangeMinMax_should_fail_without_max_min() {
+    setupEmbedDB(0, 8, 64);
+    int32_t minData, maxData;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBRangeMinMax(state, NULL, NULL, &minData, &maxData), "embedDBRangeMinMax did not fail without EMBEDDB_USE_MAX_MIN.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(rangeMinMax_should_match_records_in_range);
+    RUN_TEST(rangeMinMax_should_not_change_values_for_empty_range);
+    RUN_TEST(rangeMinMax_should_use_index_pages_for_long_ranges);
+    RUN_TEST(rangeCount_should_count_without_max_min);
+    RUN_TEST(rangeMinMax_should_skip_erased_pages);
+    RUN_TEST(maxMin_header_should_not_overlap_records_with_small_bitmap);
+    RUN_TEST(maxMin_header_should_not_overlap_records_without_index);
+    RUN_TEST(rangeMinMax_should_fail_without_max_min);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,329 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_readahead.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test reading runs of data pages ahead of an iterator.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+/* Counts the single page and multiple page reads made from the data file, so the tests can check how the pages were read */
+int8_t (*storageRead)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+int8_t (*storageReadPages)(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file);
+uint32_t singleReads = 0, multipleReads = 0, pagesInMultipleReads = 0, maxPagesInRead = 0;
+uint8_t readPastEndOfFile = 0;
+
+int8_t countingRead(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    if (file == state->dataFile)
+        singleReads++;
+    return storageRead(buffer, pageNum, pageSize, file);
+}
+
+int8_t countingReadPages(void *buffer, uint32_t pageNum, uint32_t numPages, uint32_t pageSize, void *file) {
+    if (file == state->dataFile) {
+        multipleReads++;
+        pagesInMultipleReads += numPages;
+        if (numPages > maxPagesInRead)
+            maxPagesInRead = numPages;
+        if (pageNum + numPages > state->numDataPages)
+            readPastEndOfFile = 1;
+    }
+    return storageReadPages(buffer, pageNum, numPages, pageSize, file);
+}
+
+void resetReadCounts() {
+    singleReads = 0;
+    multipleReads = 0;
+    pagesInMultipleReads = 0;
+    maxPagesInRead = 0;
+    readPastEndOfFile = 0;
+}
+
+void setupEmbedDB(uint32_t parameters, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 256;
+    state->bitmapSize = EMBEDDB_USING_BMAP(parameters) ? 1 : 0;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    storageRead = state->fileInterface->read;
+    storageReadPages = state->fileInterface->readPages;
+    state->fileInterface->read = countingRead;
+    state->fileInterface->readPages = countingReadPages;
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = EMBEDDB_USING_INDEX(parameters) ? setupFile(INDEX_PATH) : NULL;
+    state->parameters = EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {
+    resetReadCounts();
+}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Data values from 0 to 99 that change slowly, so some runs of pages have no data in a small range */
+int32_t dataOf(uint32_t key) {
+    return (int32_t)(key / 300 % 100);
+}
+
+void insertRecords(uint32_t numRecords) {
+    for (uint32_t key = 0; key < numRecords; key++) {
+        int32_t data = dataOf(key);
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+/*
+ * Scans with an iterator, using a readahead window of readaheadPages pages if it is not 0, and checks it returns every key from firstKey to lastKey
+ * with data in [minData, maxData]. Returns the number of data pages read.
+ */
+uint32_t assertScan(uint32_t readaheadPages, uint32_t *minKey, uint32_t *maxKey, int32_t *minData, int32_t *maxData, uint32_t firstKey, uint32_t lastKey) {
+    embedDBIterator it;
+    it.minKey = minKey;
+    it.maxKey = maxKey;
+    it.minData = minData;
+    it.maxData = maxData;
+    embedDBInitIterator(state, &it);
+    void *window = readaheadPages > 0 ? malloc((size_t)readaheadPages * state->pageSize) : NULL;
+    embedDBIteratorSetReadahead(&it, window, readaheadPages);
+
+    uint32_t key = 0, expectedKey = firstKey;
+    int32_t data = 0;
+    id_t readsBefore = state->numReads;
+    char message[100];
+    while (embedDBNext(state, &it, &key, &data)) {
+        while (expectedKey <= lastKey && ((minData != NULL && dataOf(expectedKey) < *minData) || (maxData != NULL && dataOf(expectedKey) > *maxData)))
+            expectedKey++;
+        snprintf(message, 100, "Iterator returned the wrong key after key %u.", expectedKey - 1);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKey, key, message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataOf(key), data, "Iterator returned the wrong data.");
+        expectedKey++;
+    }
+    while (expectedKey <= lastKey && ((minData != NULL && dataOf(expectedKey) < *minData) || (maxData != NULL && dataOf(expectedKey) > *maxData)))
+        expectedKey++;
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(lastKey + 1, expectedKey, "Iterator did not return every record.");
+    embedDBCloseIterator(&it);
+    free(window);
+    return state->numReads - readsBefore;
+}
+
+void readahead_should_read_full_scan_in_windows(void) {
+    setupEmbedDB(0, 200);
+    insertRecords(6000);
+
+    uint32_t pagesWithoutReadahead = assertScan(0, NULL, NULL, NULL, NULL, 0, 5999);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(pagesWithoutReadahead, singleReads, "Without readahead every page should be read on its own.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, multipleReads, "Without readahead no pages should be read together.");
+
+    resetReadCounts();
+    uint32_t pagesWithReadahead = assertScan(16, NULL, NULL, NULL, NULL, 0, 5999);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(pagesWithoutReadahead, pagesWithReadahead, "Readahead should read every page once.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(pagesWithoutReadahead, pagesInMultipleReads + singleReads, "Pages read do not match the read counts.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE((pagesWithoutReadahead + 15) / 16, multipleReads + singleReads, "Readahead should read 16 pages per request.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(16, maxPagesInRead, "Readahead read more pages than its window holds.");
+}
+
+void readahead_should_read_one_page_at_a_time_without_readPages(void) {
+    setupEmbedDB(0, 200);
+    state->fileInterface->readPages = NULL;
+    insertRecords(6000);
+
+    uint32_t pagesRead = assertScan(16, NULL, NULL, NULL, NULL, 0, 5999);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(pagesRead, singleReads, "Without readPages every page should be read on its own.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, multipleReads, "readPages should not be called when it is NULL.");
+}
+
+void readahead_should_not_read_past_max_key(void) {
+    /* Fence keys give the exact page of the max key, so readahead stops where the scan does */
+    setupEmbedDB(EMBEDDB_USE_FENCE_KEYS, 200);
+    insertRecords(6000);
+
+    uint32_t minKey = 1000, maxKey = 2500;
+    uint32_t pagesWithoutReadahead = assertScan(0, &minKey, &maxKey, NULL, NULL, 1000, 2500);
+    resetReadCounts();
+    uint32_t pagesWithReadahead = assertScan(16, &minKey, &maxKey, NULL, NULL, 1000, 2500);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(pagesWithoutReadahead, pagesWithReadahead, "Readahead read pages the key range does not need.");
+    TEST_ASSERT_TRUE_MESSAGE(multipleReads > 0, "Readahead should read pages together.");
+}
+
+void readahead_should_stop_at_pages_skipped_by_zone_map(void) {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_ZONE_MAP, 600);
+    insertRecords(24000);
+
+    int32_t minData = 20, maxData = 25;
+    uint32_t pagesWithoutReadahead = assertScan(0, NULL, NULL, &minData, &maxData, 0, 23999);
+    resetReadCounts();
+    uint32_t pagesWithReadahead = assertScan(16, NULL, NULL, &minData, &maxData, 0, 23999);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(pagesWithoutReadahead, pagesWithReadahead, "Readahead read pages the zone map skips.");
+    TEST_ASSERT_TRUE_MESSAGE(multipleReads > 0, "Readahead should read pages together.");
+}
+
+void readahead_should_stop_at_pages_skipped_by_index(void) {
+    /* Enough pages to fill an index page, so the index can skip data pages */
+    setupEmbedDB(EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP, 1600);
+    insertRecords(48000);
+
+    int32_t minData = 40, maxData = 45;
+    uint32_t pagesWithoutReadahead = assertScan(0, NULL, NULL, &minData, &maxData, 0, 47999);
+    resetReadCounts();
+    uint32_t pagesWithReadahead = assertScan(16, NULL, NULL, &minData, &maxData, 0, 47999);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(pagesWithoutReadahead, pagesWithReadahead, "Readahead read pages the index skips.");
+    TEST_ASSERT_TRUE_MESSAGE(multipleReads > 0, "Readahead should read pages together.");
+}
+
+void readahead_should_not_wrap_around_end_of_file(void) {
+    setupEmbedDB(0, 40);
+    insertRecords(4000);
+
+    uint32_t firstKey = 0;
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key = 0;
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBNext(state, &it, &firstKey, &data), "Iterator did not return any records.");
+    embedDBCloseIterator(&it);
+
+    /* A window of 12 pages does not line up with the end of the file */
+    resetReadCounts();
+    assertScan(12, NULL, NULL, NULL, NULL, firstKey, 3999);
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(0, readPastEndOfFile, "Readahead read past the end of the data file.");
+    TEST_ASSERT_TRUE_MESSAGE(multipleReads > 0, "Readahead should read pages together.");
+}
+
+void readahead_should_read_pages_queued_by_background_writer(void) {
+    setupEmbedDB(EMBEDDB_USE_BACKGROUND_WRITER, 200);
+    insertRecords(6000);
+
+    uint32_t pagesRead = assertScan(16, NULL, NULL, NULL, NULL, 0, 5999);
+    TEST_ASSERT_TRUE_MESSAGE(pagesRead > 0, "Iterator should read pages from storage.");
+    TEST_ASSERT_TRUE_MESSAGE(multipleReads > 0, "Readahead should read pages together.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(readahead_should_read_full_scan_in_windows);
+    RUN_TEST(readahead_should_read_one_page_at_a_time_without_readPages);
+    RUN_TEST(readahead_should_not_read_past_max_key);
+    RUN_TEST(readahead_should_stop_at_pages_skipped_by_zone_map);
+    RUN_TEST(readahead_should_stop_at_pages_skipped_by_index);
+    RUN_TEST(readahead_should_not_wrap_around_end_of_file);
+#if defined(EMBEDDB_THREADS_SUPPORTED)
+    RUN_TEST(readahead_should_read_pages_queued_by_background_writer);
+#endif
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
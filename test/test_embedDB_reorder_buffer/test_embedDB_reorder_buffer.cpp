@@ -0,0 +1,393 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_reorder_buffer.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB inserts of records that arrive out of order through the reorder buffer.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#define VAR_DATA_FILE_PATH "varFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#define VAR_DATA_FILE_PATH "build/artifacts/varFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+/* Settings rejected by embedDBInit leave the files unopened, so the state is freed without closing it */
+int8_t embedDBOpened = 0;
+
+/* Data pages to allocate, changed to make embedDBInit fail after the reorder buffer is allocated */
+uint32_t numDataPages = 100;
+
+int8_t openEmbedDB(uint32_t parameters, count_t reorderBufferSize) {
+    state = (embedDBState *)calloc(1, sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->pageSize = 512;
+    state->reorderBufferSize = reorderBufferSize;
+    state->bufferSizeInBlocks = EMBEDDB_USING_VDATA(parameters) ? 6 : 4;
+    state->numSplinePoints = 64;
+    state->bitmapSize = 1;
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->numVarPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = setupFile(INDEX_PATH);
+    state->varFile = EMBEDDB_USING_VDATA(parameters) ? setupFile(VAR_DATA_FILE_PATH) : NULL;
+    state->parameters = EMBEDDB_USE_REORDER_BUFFER | EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP | EMBEDDB_USE_MAX_MIN | EMBEDDB_RESET_DATA | parameters;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->inBitmap = inBitmapInt8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    int8_t result = embedDBInit(state, 1);
+    embedDBOpened = result == 0;
+    return result;
+}
+
+void tearDownEmbedDB() {
+    if (state == NULL) {
+        return;
+    }
+    free(state->buffer);
+    if (embedDBOpened) {
+        embedDBClose(state);
+    }
+    tearDownFile(state->dataFile);
+    tearDownFile(state->indexFile);
+    if (state->varFile != NULL) {
+        tearDownFile(state->varFile);
+    }
+    free(state->fileInterface);
+    free(state);
+    state = NULL;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Records arrive in groups of 5 with the keys of each group in reverse order, so a record is up to 4 records late */
+uint32_t arrivalKey(uint32_t arrival) {
+    return (arrival / 5) * 5 + 4 - arrival % 5;
+}
+
+int32_t dataOf(uint32_t key) {
+    return (int32_t)((key * 7919u) % 1000u);
+}
+
+void insertLateRecords(uint32_t numRecords) {
+    for (uint32_t arrival = 0; arrival < numRecords; arrival++) {
+        uint32_t key = arrivalKey(arrival);
+        int32_t data = dataOf(key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert a late record.");
+    }
+}
+
+void assertRecordsFound(uint32_t numRecords) {
+    for (uint32_t key = 0; key < numRecords; key++) {
+        int32_t data = -1;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record inserted out of order.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataOf(key), data, "embedDBGet returned the wrong data for a record inserted out of order.");
+    }
+}
+
+/* Checks that the iterator returns every key from firstKey to lastKey in order, and only those */
+void assertIteratorReturns(embedDBIterator *it, uint32_t firstKey, uint32_t lastKey, int8_t reverse) {
+    uint32_t key = 0;
+    int32_t data = 0;
+    uint32_t expectedKey = reverse ? lastKey : firstKey;
+    uint32_t numRecords = 0;
+    while (reverse ? embedDBPrev(state, it, &key, &data) : embedDBNext(state, it, &key, &data)) {
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKey, key, "Iterator did not return the records in key order.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataOf(key), data, "Iterator returned the wrong data.");
+        expectedKey = reverse ? expectedKey - 1 : expectedKey + 1;
+        numRecords++;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(lastKey - firstKey + 1, numRecords, "Iterator did not return every record in range.");
+}
+
+void reorder_buffer_should_store_late_records_in_key_order() {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, openEmbedDB(0, 16), "EmbedDB did not initialize with a reorder buffer.");
+    insertLateRecords(2000);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush did not store the reorder buffer.");
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    assertIteratorReturns(&it, 0, 1999, 0);
+    embedDBCloseIterator(&it);
+    assertRecordsFound(2000);
+
+    /* The flush stored every record on the data pages */
+    embedDBInitIterator(state, &it);
+    embedDBPageBatch batch;
+    uint32_t numStored = 0;
+    while (embedDBNextPage(state, &it, &batch)) {
+        numStored += batch.end - batch.start;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2000, numStored, "embedDBFlush did not store the records in the reorder buffer.");
+
+    /* Records are stored in order, so the data pages are full */
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2000 / state->maxRecordsPerPage + 1, state->nextDataPageId, "Records were not stored on full pages.");
+}
+
+void reorder_buffer_should_find_records_that_are_still_buffered() {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, openEmbedDB(0, 16), "EmbedDB did not initialize with a reorder buffer.");
+    insertLateRecords(1000);
+
+    /* Without a flush, the 16 largest keys are still in the reorder buffer */
+    assertRecordsFound(1000);
+    uint32_t key = 1000;
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key that was never inserted.");
+
+    /* A buffered record that has not arrived yet is not found */
+    uint32_t lateKey = 1003;
+    int32_t lateData = dataOf(lateKey);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &lateKey, &lateData), "embedDBPut did not insert a record.");
+    key = 1002;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &key, &data), "embedDBGet found a key between two buffered keys.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &lateKey, &data), "embedDBGet did not find a buffered record.");
+    TEST_ASSERT_EQUAL_INT32_MESSAGE(lateData, data, "embedDBGet returned the wrong data for a buffered record.");
+}
+
+void reorder_buffer_should_return_buffered_records_from_iterators() {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, openEmbedDB(0, 16), "EmbedDB did not initialize with a reorder buffer.");
+    insertLateRecords(1000);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    assertIteratorReturns(&it, 0, 999, 0);
+    embedDBCloseIterator(&it);
+
+    embedDBInitReverseIterator(state, &it);
+    assertIteratorReturns(&it, 0, 999, 1);
+    embedDBCloseIterator(&it);
+
+    /* Ranges that end before, in and past the reorder buffer, and ranges only in the reorder buffer */
+    uint32_t ranges[][2] = {{900, 990}, {950, 980}, {987, 995}, {990, 999}, {991, 991}, {999, 1500}};
+    for (uint32_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        uint32_t minKey = ranges[i][0], maxKey = ranges[i][1];
+        uint32_t lastKey = maxKey < 999 ? maxKey : 999;
+        it.minKey = &minKey;
+        it.maxKey = &maxKey;
+        embedDBInitIterator(state, &it);
+        assertIteratorReturns(&it, minKey, lastKey, 0);
+        embedDBCloseIterator(&it);
+
+        embedDBInitReverseIterator(state, &it);
+        assertIteratorReturns(&it, minKey, lastKey, 1);
+        embedDBCloseIterator(&it);
+    }
+
+    /* Data filters are checked on the buffered records */
+    int32_t minData = 500, maxData = 700;
+    uint32_t minKey = 950;
+    it.minKey = &minKey;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBInitIterator(state, &it);
+    uint32_t key = 0, numMatches = 0, expectedMatches = 0;
+    int32_t data = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_TRUE_MESSAGE(data >= minData && data <= maxData, "Iterator returned a record outside the data range.");
+        numMatches++;
+    }
+    embedDBCloseIterator(&it);
+    for (key = minKey; key < 1000; key++) {
+        if (dataOf(key) >= minData && dataOf(key) <= maxData)
+            expectedMatches++;
+    }
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedMatches, numMatches, "Iterator did not return every record in the data range.");
+}
+
+void reorder_buffer_should_reject_records_older_than_the_stored_records() {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, openEmbedDB(0, 4), "EmbedDB did not initialize with a reorder buffer.");
+    for (uint32_t key = 10; key < 20; key++) {
+        int32_t data = dataOf(key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert a record.");
+    }
+
+    /* Keys 10 to 15 have been stored and keys 16 to 19 are in the reorder buffer */
+    uint32_t key = 15;
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &key, &data), "embedDBPut inserted a key that was already stored.");
+    key = 5;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &key, &data), "embedDBPut inserted a key older than the stored records.");
+    key = 17;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &key, &data), "embedDBPut inserted a key that is already in the reorder buffer.");
+
+    /* A record older than everything in a full reorder buffer is stored straight away */
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush did not store the reorder buffer.");
+    key = 19;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &key, &data), "embedDBPut inserted a stored key into an empty reorder buffer.");
+    key = 25;
+    data = dataOf(key);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert a record.");
+    for (key = 30; key < 33; key++) {
+        data = dataOf(key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert a record.");
+    }
+    key = 21;
+    data = dataOf(key);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not insert a record older than the reorder buffer.");
+    key = 20;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPut(state, &key, &data), "embedDBPut inserted a key older than the stored records.");
+
+    uint32_t expectedKeys[] = {10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 21, 25, 30, 31, 32};
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t numRecords = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_TRUE_MESSAGE(numRecords < sizeof(expectedKeys) / sizeof(expectedKeys[0]), "Iterator returned a rejected record.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedKeys[numRecords], key, "Iterator did not return the records in key order.");
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataOf(key), data, "Iterator returned the wrong data.");
+        numRecords++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(sizeof(expectedKeys) / sizeof(expectedKeys[0]), numRecords, "Iterator did not return every record.");
+}
+
+void reorder_buffer_should_accept_batches_out_of_order() {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, openEmbedDB(0, 16), "EmbedDB did not initialize with a reorder buffer.");
+    uint32_t keys[1000];
+    int32_t datas[1000];
+    for (uint32_t arrival = 0; arrival < 1000; arrival++) {
+        keys[arrival] = arrivalKey(arrival);
+        datas[arrival] = dataOf(keys[arrival]);
+    }
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys, datas, 500), "embedDBPutBatch did not insert records out of order.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys + 500, datas + 500, 500), "embedDBPutBatch did not insert records out of order.");
+    assertRecordsFound(1000);
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBFlush(state), "embedDBFlush did not store the reorder buffer.");
+    assertRecordsFound(1000);
+}
+
+void reorder_buffer_should_reject_unsupported_settings() {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(0, 0), "EmbedDB initialized with an empty reorder buffer.");
+    tearDownEmbedDB();
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY, 16), "EmbedDB initialized with a reorder buffer and record-level consistency.");
+    tearDownEmbedDB();
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, openEmbedDB(EMBEDDB_USE_VDATA, 16), "EmbedDB initialized with a reorder buffer and variable data.");
+}
+
+void reorder_buffer_should_be_freed_when_init_fails() {
+    /* Too few data pages for the index is only checked after the reorder buffer is allocated */
+    numDataPages = 8;
+    int8_t result = openEmbedDB(0, 16);
+    numDataPages = 100;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, result, "EmbedDB initialized with too few data pages for the index.");
+    TEST_ASSERT_NULL_MESSAGE(state->reorderBuffer, "The reorder buffer was not freed when embedDBInit failed.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(reorder_buffer_should_store_late_records_in_key_order);
+    RUN_TEST(reorder_buffer_should_find_records_that_are_still_buffered);
+    RUN_TEST(reorder_buffer_should_return_buffered_records_from_iterators);
+    RUN_TEST(reorder_buffer_should_reject_records_older_than_the_stored_records);
+    RUN_TEST(reorder_buffer_should_accept_batches_out_of_order);
+    RUN_TEST(reorder_buffer_should_reject_unsupported_settings);
+    RUN_TEST(reorder_buffer_should_be_freed_when_init_fails);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
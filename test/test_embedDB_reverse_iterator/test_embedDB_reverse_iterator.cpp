@@ -0,0 +1,323 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_reverse_iterator.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test iterating over records from the newest to the oldest.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setupEmbedDB(uint32_t parameters, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 256;
+    state->bitmapSize = EMBEDDB_USING_BMAP(parameters) ? 1 : 0;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = EMBEDDB_USING_INDEX(parameters) ? setupFile(INDEX_PATH) : NULL;
+    state->parameters = EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt8;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Keys with gaps that grow every 100 records, so the spline has to interpolate between its points */
+uint32_t keyOf(uint32_t record) {
+    uint32_t step = record / 100;
+    return record * 3 + step * step * 40;
+}
+
+/* Data values from 0 to 99 that change slowly, so some pages have no data in a small range */
+int32_t dataOf(uint32_t record) {
+    return (int32_t)(record / 150 % 100);
+}
+
+void insertRecords(uint32_t numRecords) {
+    for (uint32_t record = 0; record < numRecords; record++) {
+        uint32_t key = keyOf(record);
+        int32_t data = dataOf(record);
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+/*
+ * Reads a reverse iterator to the end and checks it returns every record from lastRecord down to firstRecord with data in [minData, maxData].
+ * Returns the number of records.
+ */
+uint32_t assertReverse(embedDBIterator *it, uint32_t firstRecord, uint32_t lastRecord, int32_t minData, int32_t maxData) {
+    embedDBInitReverseIterator(state, it);
+    uint32_t key = 0, numRecords = 0;
+    int32_t data = 0;
+    int64_t record = lastRecord;
+    char message[100];
+    while (embedDBPrev(state, it, &key, &data)) {
+        while (record >= firstRecord && (dataOf(record) < minData || dataOf(record) > maxData)) {
+            record--;
+        }
+        snprintf(message, 100, "Reverse iterator returned key %lu instead of record %li.", (unsigned long)key, (long)record);
+        TEST_ASSERT_TRUE_MESSAGE(record >= firstRecord, message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(keyOf(record), key, message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataOf(record), data, "Reverse iterator returned the wrong data.");
+        record--;
+        numRecords++;
+    }
+    embedDBCloseIterator(it);
+    while (record >= firstRecord && (dataOf(record) < minData || dataOf(record) > maxData)) {
+        record--;
+    }
+    snprintf(message, 100, "Reverse iterator stopped before record %li.", (long)record);
+    TEST_ASSERT_TRUE_MESSAGE(record < firstRecord, message);
+    return numRecords;
+}
+
+uint32_t assertReverseKeyRange(uint32_t firstRecord, uint32_t lastRecord) {
+    uint32_t minKey = keyOf(firstRecord), maxKey = keyOf(lastRecord);
+    embedDBIterator it;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = NULL;
+    it.maxData = NULL;
+    return assertReverse(&it, firstRecord, lastRecord, INT32_MIN, INT32_MAX);
+}
+
+void reverseIterator_should_return_all_records_newest_first() {
+    setupEmbedDB(0, 200);
+    uint32_t numRecords = 50 * state->maxRecordsPerPage + 17;
+    insertRecords(numRecords);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    TEST_ASSERT_EQUAL_UINT32(numRecords, assertReverse(&it, 0, numRecords - 1, INT32_MIN, INT32_MAX));
+}
+
+void reverseIterator_should_return_key_ranges() {
+    setupEmbedDB(0, 200);
+    uint32_t numRecords = 120 * state->maxRecordsPerPage + 30;
+    insertRecords(numRecords);
+
+    for (uint32_t firstRecord = 0; firstRecord < numRecords; firstRecord += 877) {
+        assertReverseKeyRange(firstRecord, firstRecord);
+        assertReverseKeyRange(firstRecord, firstRecord + 61 < numRecords ? firstRecord + 61 : numRecords - 1);
+        assertReverseKeyRange(firstRecord, firstRecord + 2000 < numRecords ? firstRecord + 2000 : numRecords - 1);
+    }
+    assertReverseKeyRange(numRecords - 40, numRecords - 1);
+}
+
+void reverseIterator_should_read_few_pages_for_last_records_before_key() {
+    setupEmbedDB(0, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(150 * recordsPerPage + 5);
+
+    /* The last 10 records up to a key are on its page and the one before it, plus the spline error */
+    for (uint32_t lastRecord = 25; lastRecord < 140 * recordsPerPage; lastRecord += 1231) {
+        uint32_t maxKey = keyOf(lastRecord);
+        embedDBIterator it;
+        it.minKey = NULL;
+        it.maxKey = &maxKey;
+        it.minData = NULL;
+        it.maxData = NULL;
+        embedDBInitReverseIterator(state, &it);
+
+        embedDBResetStats(state);
+        uint32_t key = 0;
+        int32_t data = 0;
+        for (uint32_t i = 0; i < 10; i++) {
+            TEST_ASSERT_EQUAL_INT8(1, embedDBPrev(state, &it, &key, &data));
+            TEST_ASSERT_EQUAL_UINT32(keyOf(lastRecord - i), key);
+        }
+        embedDBCloseIterator(&it);
+        TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(4, state->numReads, "Reverse iterator read too many pages to find the last records before a key.");
+    }
+}
+
+void reverseIterator_should_skip_pages_with_index_bitmap() {
+    setupEmbedDB(EMBEDDB_USE_INDEX | EMBEDDB_USE_BMAP, 800);
+    uint32_t numRecords = 600 * state->maxRecordsPerPage + 9;
+    insertRecords(numRecords);
+
+    int32_t minData = 61, maxData = 64;
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBResetStats(state);
+    assertReverse(&it, 0, numRecords - 1, minData, maxData);
+
+    /* Only about a third of the pages have data in the bitmap bucket of the range */
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(400, state->numReads, "Reverse iterator did not use the index to skip pages.");
+}
+
+void reverseIterator_should_skip_pages_with_zone_map() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_ZONE_MAP, 200);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numRecords = 100 * recordsPerPage + 9;
+    insertRecords(numRecords);
+
+    int32_t minData = 20, maxData = 20;
+    uint32_t minKey = keyOf(10), maxKey = keyOf(90 * recordsPerPage);
+    embedDBIterator it;
+    it.minKey = &minKey;
+    it.maxKey = &maxKey;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_UINT32(150, assertReverse(&it, 10, 90 * recordsPerPage, minData, maxData));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(150 / recordsPerPage + 2, state->numReads, "Reverse iterator read pages that the zone map showed had no data in range.");
+}
+
+void reverseIterator_should_stop_at_oldest_page_after_wrapping() {
+    setupEmbedDB(0, 100);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numRecords = 230 * recordsPerPage + 3;
+    insertRecords(numRecords);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    uint32_t firstRecord = state->minDataPageId * recordsPerPage;
+    TEST_ASSERT_EQUAL_UINT32(numRecords - firstRecord, assertReverse(&it, firstRecord, numRecords - 1, INT32_MIN, INT32_MAX));
+}
+
+void reverseIterator_should_return_records_in_write_buffer_only() {
+    setupEmbedDB(0, 200);
+    insertRecords(20);
+
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    TEST_ASSERT_EQUAL_UINT32(20, assertReverse(&it, 0, 19, INT32_MIN, INT32_MAX));
+    TEST_ASSERT_EQUAL_UINT32(5, assertReverseKeyRange(7, 11));
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(reverseIterator_should_return_all_records_newest_first);
+    RUN_TEST(reverseIterator_should_return_key_ranges);
+    RUN_TEST(reverseIterator_should_read_few_pages_for_last_records_before_key);
+    RUN_TEST(reverseIterator_should_skip_pages_with_index_bitmap);
+    RUN_TEST(reverseIterator_should_skip_pages_with_zone_map);
+    RUN_TEST(reverseIterator_should_stop_at_oldest_page_after_wrapping);
+    RUN_TEST(reverseIterator_should_return_records_in_write_buffer_only);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
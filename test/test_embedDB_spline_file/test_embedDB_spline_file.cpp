@@ -0,0 +1,359 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_spline_file.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB loading the spline from a spline file.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define SPLINE_PATH "splineFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define SPLINE_PATH "build/artifacts/splineFile.bin"
+/* On the desktop platform, there is a file interface which simulates "erasing" by writing out all 1's to the location in the file ot be erased */
+#define MOCK_ERASE_INTERFACE
+#endif
+
+#include "unity.h"
+
+/* Records per data page with the configuration below */
+#define RECORDS_PER_PAGE 63
+
+/* Records inserted before the gap between keys changes, so the spline needs a point every few pages */
+#define RECORDS_PER_SEGMENT RECORDS_PER_PAGE
+
+embedDBState *state;
+
+/* Counts the reads made from the data file, so the tests can check how much of it is read to rebuild the spline */
+int8_t (*storageRead)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+void *countedFile = NULL;
+uint32_t dataFileReads = 0;
+uint32_t splineFileReads = 0;
+
+int8_t countingRead(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    if (file == countedFile)
+        dataFileReads++;
+    if (file == state->splineFile)
+        splineFileReads++;
+    return storageRead(buffer, pageNum, pageSize, file);
+}
+
+/* Tracks the spline file pages written since their erase block was last erased, to check that no page is written twice without an erase */
+int8_t (*storageWrite)(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file);
+int8_t (*storageErase)(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file);
+uint8_t splinePageWritten[4];
+uint32_t splineFileWrites = 0;
+uint8_t splinePageRewritten = 0;
+
+int8_t recordingWrite(void *buffer, uint32_t pageNum, uint32_t pageSize, void *file) {
+    if (file == state->splineFile) {
+        splineFileWrites++;
+        if (splinePageWritten[pageNum])
+            splinePageRewritten = 1;
+        splinePageWritten[pageNum] = 1;
+    }
+    return storageWrite(buffer, pageNum, pageSize, file);
+}
+
+int8_t recordingErase(uint32_t startPage, uint32_t endPage, uint32_t pageSize, void *file) {
+    if (file == state->splineFile) {
+        for (uint32_t page = startPage; page < endPage; page++)
+            splinePageWritten[page] = 0;
+    }
+    return storageErase(startPage, endPage, pageSize, file);
+}
+
+void setupEmbedDB(int16_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 2;
+    state->numSplinePoints = 32;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 64;
+    state->numSplinePages = 4;
+    state->eraseSizeInPages = 2;
+#ifdef MOCK_ERASE_INTERFACE
+    state->fileInterface = getMockEraseFileInterface();
+#else
+    state->fileInterface = getFileInterface();
+#endif
+    storageRead = state->fileInterface->read;
+    state->fileInterface->read = countingRead;
+    storageWrite = state->fileInterface->write;
+    state->fileInterface->write = recordingWrite;
+    storageErase = state->fileInterface->erase;
+    state->fileInterface->erase = recordingErase;
+    state->dataFile = setupFile(DATA_PATH);
+    state->splineFile = setupFile(SPLINE_PATH);
+    state->parameters = parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    countedFile = state->dataFile;
+    dataFileReads = 0;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    tearDownFile(state->splineFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Key of the given record. The gap between keys changes every RECORDS_PER_SEGMENT records. */
+int32_t recordKey(int32_t record) {
+    int32_t key = 0;
+    for (int32_t segment = 0; segment < record / RECORDS_PER_SEGMENT; segment++) {
+        key += RECORDS_PER_SEGMENT * (1 + (segment % 4) * 3);
+    }
+    return key + (record % RECORDS_PER_SEGMENT) * (1 + (record / RECORDS_PER_SEGMENT % 4) * 3);
+}
+
+void insertRecords(int32_t startingRecord, int32_t numRecords) {
+    for (int32_t record = startingRecord; record < startingRecord + numRecords; record++) {
+        int32_t key = recordKey(record);
+        int8_t result = embedDBPut(state, &key, &record);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+void queryRecords(int32_t startingRecord, int32_t numRecords) {
+    int32_t data = 0;
+    char message[100];
+    for (int32_t record = startingRecord; record < startingRecord + numRecords; record++) {
+        int32_t key = recordKey(record);
+        snprintf(message, 100, "embedDBGet could not find key %li after loading the spline file.", (long)key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(record, data, "embedDBGet returned the wrong data after loading the spline file.");
+    }
+}
+
+/* Spline points are 8 bytes with 4 byte keys */
+typedef struct {
+    size_t count;
+    uint8_t points[32 * 8];
+} savedSpline;
+
+savedSpline saveSpline() {
+    savedSpline saved;
+    saved.count = state->spl->count;
+    for (size_t i = 0; i < saved.count; i++) {
+        memcpy(saved.points + i * 8, splinePointLocation(state->spl, i), 8);
+    }
+    return saved;
+}
+
+/* Recovery can find a larger minDataPageId than was in memory once the data file wraps, so the loaded spline may be missing the oldest points */
+void assertSplineLoaded(savedSpline saved, size_t maxPointsCleaned) {
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(saved.count, state->spl->count, "The spline was loaded with extra points.");
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(saved.count - maxPointsCleaned, state->spl->count, "The spline was not loaded with the same number of points.");
+    size_t offset = saved.count - state->spl->count;
+    for (size_t i = 0; i < state->spl->count; i++) {
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(saved.points + (i + offset) * 8, splinePointLocation(state->spl, i), 8, "The spline was not loaded with the same points.");
+    }
+}
+
+void embedDB_should_load_spline_from_spline_file() {
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE | EMBEDDB_RESET_DATA);
+    insertRecords(0, 40 * RECORDS_PER_PAGE);
+    embedDBFlush(state);
+    savedSpline saved = saveSpline();
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(4, saved.count, "The test data did not need enough spline points.");
+    id_t lastSavedPage = state->lastSplineFilePointPage;
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE);
+    assertSplineLoaded(saved, 0);
+    /* Finding the write head reads 12 pages at most, then only the pages after the last saved point are read */
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(12 + state->nextDataPageId - lastSavedPage, dataFileReads, "Loading the spline read data pages that were covered by the spline file.");
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(state->nextDataPageId, dataFileReads, "Loading the spline read every data page.");
+    queryRecords(0, 40 * RECORDS_PER_PAGE);
+}
+
+void embedDB_should_load_spline_from_spline_file_after_data_wraps() {
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE | EMBEDDB_RESET_DATA);
+    insertRecords(0, 1500 * RECORDS_PER_PAGE + 30);
+    embedDBFlush(state);
+    savedSpline saved = saveSpline();
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->minDataPageId, "The data file did not wrap.");
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(state->numSplinePages, state->nextSplinePageId, "The spline file did not wrap.");
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE);
+    assertSplineLoaded(saved, 2);
+    queryRecords(state->minDataPageId * RECORDS_PER_PAGE, (1500 - state->minDataPageId) * RECORDS_PER_PAGE);
+}
+
+void embedDB_should_keep_adding_to_spline_file_after_loading_it() {
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE | EMBEDDB_RESET_DATA);
+    insertRecords(0, 20 * RECORDS_PER_PAGE);
+    embedDBFlush(state);
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE);
+    insertRecords(20 * RECORDS_PER_PAGE, 30 * RECORDS_PER_PAGE);
+    embedDBFlush(state);
+    savedSpline saved = saveSpline();
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE);
+    assertSplineLoaded(saved, 0);
+    queryRecords(0, 50 * RECORDS_PER_PAGE);
+}
+
+void embedDB_should_rebuild_spline_when_spline_file_is_empty() {
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE | EMBEDDB_RESET_DATA);
+    tearDownEmbedDB();
+
+    /* Data written without the spline file */
+    setupEmbedDB(0);
+    insertRecords(0, 40 * RECORDS_PER_PAGE);
+    embedDBFlush(state);
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(40, dataFileReads, "The spline was not rebuilt from the data file.");
+    TEST_ASSERT_TRUE_MESSAGE(state->nextSplinePageId > 0 || state->numSplinePagePoints > 0, "The rebuilt spline was not written to the spline file.");
+    queryRecords(0, 40 * RECORDS_PER_PAGE);
+    savedSpline saved = saveSpline();
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE);
+    assertSplineLoaded(saved, 0);
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(40, dataFileReads, "The spline was rebuilt again instead of loaded from the spline file.");
+}
+
+void embedDB_should_write_each_spline_file_page_once() {
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE | EMBEDDB_RESET_DATA);
+    memset(splinePageWritten, 1, sizeof(splinePageWritten));
+    splineFileReads = 0;
+    splineFileWrites = 0;
+    splinePageRewritten = 0;
+
+    /* A point every 4 pages and 63 points per spline file page, so 600 pages fill two spline file pages */
+    insertRecords(0, 600 * RECORDS_PER_PAGE);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(2, splineFileWrites, "Spline file pages were written before they were full.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, splineFileReads, "Adding spline points read the spline file.");
+
+    /* embedDBFlush writes the partly full page, and later points start a new page */
+    embedDBFlush(state);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, splineFileWrites, "embedDBFlush did not write the partly full spline file page.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->numSplinePagePoints, "Points were added to a spline file page that was already written.");
+    embedDBFlush(state);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(3, splineFileWrites, "embedDBFlush wrote a spline file page with no new points.");
+
+    insertRecords(600 * RECORDS_PER_PAGE, 900 * RECORDS_PER_PAGE);
+    embedDBFlush(state);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32_MESSAGE(state->numSplinePages, state->nextSplinePageId, "The spline file did not wrap.");
+    TEST_ASSERT_EQUAL_UINT8_MESSAGE(0, splinePageRewritten, "A spline file page was written again without erasing it first.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, splineFileReads, "Adding spline points read the spline file.");
+}
+
+void embedDB_should_keep_buffered_data_page_when_adding_spline_points() {
+    setupEmbedDB(EMBEDDB_USE_SPLINE_FILE | EMBEDDB_RESET_DATA);
+    insertRecords(0, 20 * RECORDS_PER_PAGE);
+    queryRecords(5 * RECORDS_PER_PAGE, 1);
+    id_t bufferedPageId = state->bufferedPageId;
+    uint32_t splinePoints = state->numSplinePagePoints;
+
+    insertRecords(20 * RECORDS_PER_PAGE, 10 * RECORDS_PER_PAGE);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(splinePoints, state->numSplinePagePoints, "The test data did not add spline points.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(bufferedPageId, state->bufferedPageId, "Adding spline points replaced the buffered data page.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(embedDB_should_load_spline_from_spline_file);
+    RUN_TEST(embedDB_should_load_spline_from_spline_file_after_data_wraps);
+    RUN_TEST(embedDB_should_keep_adding_to_spline_file_after_loading_it);
+    RUN_TEST(embedDB_should_rebuild_spline_when_spline_file_is_empty);
+    RUN_TEST(embedDB_should_write_each_spline_file_page_once);
+    RUN_TEST(embedDB_should_keep_buffered_data_page_when_adding_spline_points);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
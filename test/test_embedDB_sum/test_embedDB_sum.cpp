@@ -0,0 +1,307 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_sum.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test the EmbedDB per page sums and range sums.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+
+embedDBState *state;
+
+void setupEmbedDB(int16_t parameters, int8_t dataSize, uint32_t numDataPages) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = dataSize;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 32;
+    state->bitmapSize = 8;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = numDataPages;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = setupFile(INDEX_PATH);
+    state->parameters = EMBEDDB_USE_SUM | EMBEDDB_USE_BMAP | EMBEDDB_RESET_DATA | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+    state->inBitmap = inBitmapInt64;
+    state->updateBitmap = updateBitmapInt64;
+    state->buildBitmapFromRange = buildBitmapInt64FromRange;
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    if (state->indexFile != NULL) {
+        tearDownFile(state->indexFile);
+    }
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Data values go up and down, and are negative for a third of the records */
+int32_t dataOf(uint32_t key) {
+    return (int32_t)(key * 37 % 301) - 100;
+}
+
+/* Inserts keys 0, 3, 6 and so on, with data that fits in state->dataSize bytes */
+void insertRecords(uint32_t numRecords) {
+    for (uint32_t i = 0; i < numRecords; i++) {
+        uint32_t key = i * 3;
+        int32_t data = dataOf(key);
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+/* Sum and count of the records inserted by insertRecords that are in [minKey, maxKey] and have not been erased */
+void expectedRangeSum(uint32_t numRecords, uint32_t minKey, uint32_t maxKey, int64_t *sum, uint32_t *count) {
+    *sum = 0;
+    *count = 0;
+    uint32_t firstRecord = state->minDataPageId * state->maxRecordsPerPage;
+    for (uint32_t i = firstRecord; i < numRecords; i++) {
+        uint32_t key = i * 3;
+        if (key >= minKey && key <= maxKey) {
+            *sum += dataOf(key);
+            (*count)++;
+        }
+    }
+}
+
+void assertRangeSum(uint32_t numRecords, uint32_t minKey, uint32_t maxKey) {
+    int64_t expectedSum, sum = 1;
+    uint32_t expectedCount, count = 1;
+    expectedRangeSum(numRecords, minKey, maxKey, &expectedSum, &expectedCount);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRangeSum(state, &minKey, &maxKey, &sum, &count), "embedDBRangeSum returned an error.");
+
+    char message[100];
+    snprintf(message, 100, "embedDBRangeSum returned the wrong count for keys %lu to %lu.", (unsigned long)minKey, (unsigned long)maxKey);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedCount, count, message);
+    snprintf(message, 100, "embedDBRangeSum returned the wrong sum for keys %lu to %lu.", (unsigned long)minKey, (unsigned long)maxKey);
+    TEST_ASSERT_TRUE_MESSAGE(expectedSum == sum, message);
+}
+
+/* Checks the sum in the header of every data page against the records on the page */
+void assertPageSums() {
+    void *buf = (int8_t *)state->buffer + state->pageSize * EMBEDDB_DATA_READ_BUFFER;
+    for (id_t pageId = state->minDataPageId; pageId < state->nextDataPageId; pageId++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, readPage(state, pageId % state->numDataPages), "Unable to read data page.");
+        int64_t expectedSum = 0, sum = 0;
+        for (count_t i = 0; i < EMBEDDB_GET_COUNT(buf); i++) {
+            int32_t data = 0;
+            memcpy(&data, (int8_t *)buf + state->headerSize + i * state->recordSize + state->keySize, state->dataSize);
+            if (state->dataSize == 2) {
+                data = (int16_t)data;
+            }
+            expectedSum += data;
+        }
+        memcpy(&sum, EMBEDDB_GET_SUM(buf, state), sizeof(int64_t));
+        TEST_ASSERT_TRUE_MESSAGE(expectedSum == sum, "The sum in a data page header does not match its records.");
+    }
+}
+
+void sum_should_be_stored_in_data_page_headers() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX, 4, 64);
+    insertRecords(20 * state->maxRecordsPerPage + 17);
+    embedDBFlush(state);
+    assertPageSums();
+}
+
+void sum_should_be_stored_by_embedDBPutBatch() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX, 4, 64);
+    uint32_t numRecords = 10 * state->maxRecordsPerPage + 5;
+    uint32_t *keys = (uint32_t *)malloc(numRecords * sizeof(uint32_t));
+    int32_t *data = (int32_t *)malloc(numRecords * sizeof(int32_t));
+    for (uint32_t i = 0; i < numRecords; i++) {
+        keys[i] = i * 3;
+        data[i] = dataOf(keys[i]);
+    }
+    /* Two batches, so the second starts part way through a page */
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys, data, 100), "embedDBPutBatch returned an error.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPutBatch(state, keys + 100, data + 100, numRecords - 100), "embedDBPutBatch returned an error.");
+    embedDBFlush(state);
+    assertPageSums();
+    assertRangeSum(numRecords, 0, INT32_MAX);
+    free(keys);
+    free(data);
+}
+
+void rangeSum_should_match_records_in_range() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX, 4, 64);
+    uint32_t numRecords = 30 * state->maxRecordsPerPage + 20;
+    insertRecords(numRecords);
+
+    /* The last records are still in the write buffer */
+    uint32_t maxKey = 3 * numRecords;
+    uint32_t ranges[][2] = {{0, maxKey}, {10, 500}, {301, 302}, {1000, 1001}, {3 * 7 * state->maxRecordsPerPage, maxKey - 30}, {maxKey - 100, maxKey + 100}, {maxKey + 1, maxKey + 900}, {2500, 4000}};
+    for (uint32_t i = 0; i < sizeof(ranges) / sizeof(ranges[0]); i++) {
+        assertRangeSum(numRecords, ranges[i][0], ranges[i][1]);
+    }
+}
+
+void rangeSum_should_accept_open_ranges() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX, 4, 64);
+    uint32_t numRecords = 12 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+
+    int64_t sum = 0, expectedSum = 0;
+    uint32_t count = 0, expectedCount = 0;
+    uint32_t key = 900;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRangeSum(state, NULL, &key, &sum, &count), "embedDBRangeSum returned an error.");
+    expectedRangeSum(numRecords, 0, key, &expectedSum, &expectedCount);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedCount, count, "embedDBRangeSum with no lower bound returned the wrong count.");
+    TEST_ASSERT_TRUE_MESSAGE(expectedSum == sum, "embedDBRangeSum with no lower bound returned the wrong sum.");
+
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBRangeSum(state, &key, NULL, &sum, &count), "embedDBRangeSum returned an error.");
+    expectedRangeSum(numRecords, key, INT32_MAX, &expectedSum, &expectedCount);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedCount, count, "embedDBRangeSum with no upper bound returned the wrong count.");
+    TEST_ASSERT_TRUE_MESSAGE(expectedSum == sum, "embedDBRangeSum with no upper bound returned the wrong sum.");
+}
+
+void rangeSum_should_use_index_pages_for_long_ranges() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX, 4, 1000);
+    uint32_t numRecords = 600 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+    embedDBFlush(state);
+
+    /* A range covering around 500 data pages */
+    embedDBResetStats(state);
+    assertRangeSum(numRecords, 3 * 50 * state->maxRecordsPerPage + 7, 3 * 550 * state->maxRecordsPerPage + 11);
+    TEST_ASSERT_LESS_THAN_UINT32_MESSAGE(50, state->numReads + state->numIdxReads, "embedDBRangeSum read too many pages for a long range.");
+}
+
+void rangeSum_should_sum_small_signed_data_without_index() {
+    setupEmbedDB(0, 2, 64);
+    uint32_t numRecords = 15 * state->maxRecordsPerPage + 3;
+    insertRecords(numRecords);
+    embedDBFlush(state);
+    assertPageSums();
+    assertRangeSum(numRecords, 0, INT32_MAX);
+    assertRangeSum(numRecords, 1234, 2345);
+}
+
+void rangeSum_should_skip_erased_pages() {
+    setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_INDEX, 4, 64);
+    uint32_t numRecords = 150 * state->maxRecordsPerPage;
+    insertRecords(numRecords);
+    embedDBFlush(state);
+    TEST_ASSERT_GREATER_THAN_UINT32_MESSAGE(0, state->minDataPageId, "The data file did not wrap.");
+    assertRangeSum(numRecords, 0, INT32_MAX);
+    assertRangeSum(numRecords, 3 * 100 * state->maxRecordsPerPage, 3 * 140 * state->maxRecordsPerPage);
+}
+
+void rangeSum_should_fail_without_sum() {
+    setupEmbedDB(0, 4, 64);
+    state->parameters &= ~EMBEDDB_USE_SUM;
+    int64_t sum = 0;
+    uint32_t count = 0;
+    TEST_ASSERT_TRUE_MESSAGE(embedDBRangeSum(state, NULL, NULL, &sum, &count) != 0, "embedDBRangeSum did not fail without EMBEDDB_USE_SUM.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(sum_should_be_stored_in_data_page_headers);
+    RUN_TEST(sum_should_be_stored_by_embedDBPutBatch);
+    RUN_TEST(rangeSum_should_match_records_in_range);
+    RUN_TEST(rangeSum_should_accept_open_ranges);
+    RUN_TEST(rangeSum_should_use_index_pages_for_long_ranges);
+    RUN_TEST(rangeSum_should_sum_small_signed_data_without_index);
+    RUN_TEST(rangeSum_should_skip_erased_pages);
+    RUN_TEST(rangeSum_should_fail_without_sum);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
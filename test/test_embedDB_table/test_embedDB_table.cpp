@@ -0,0 +1,370 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_table.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test EmbedDB tables with key and data types fixed at compile time.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDB/embedDBTable.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+EMBEDDB_DEFINE_TABLE(sensor, uint32_t, int32_t)
+EMBEDDB_DEFINE_TABLE(wide, uint64_t, float)
+
+int8_t setupEmbedDB(uint32_t parameters, void (*configure)(embedDBState *)) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    configure(state);
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 64;
+    state->bitmapSize = 1;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 1000;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = NULL;
+    state->parameters = EMBEDDB_RESET_DATA | parameters;
+    state->updateBitmap = updateBitmapInt8;
+    state->buildBitmapFromRange = buildBitmapInt8FromRange;
+    state->inBitmap = inBitmapInt8;
+    return embedDBInit(state, 1);
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+int32_t sensorData(uint32_t record) {
+    return (int32_t)((record * 7919u) % 1000u) - 500;
+}
+
+void insertSensorRecords(uint32_t numRecords) {
+    for (uint32_t record = 0; record < numRecords; record++) {
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, sensorPut(state, record * 3, sensorData(record)), "sensorPut did not insert a record.");
+    }
+}
+
+void table_put_should_store_records_read_by_generic_and_typed_get() {
+    TEST_ASSERT_EQUAL_INT8(0, setupEmbedDB(EMBEDDB_USE_MAX_MIN, sensorConfigure));
+    uint32_t numRecords = 5000;
+    insertSensorRecords(numRecords);
+
+    for (uint32_t record = 0; record < numRecords; record++) {
+        uint32_t key = record * 3;
+        int32_t data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), "embedDBGet did not find a record inserted with sensorPut.");
+        TEST_ASSERT_EQUAL_INT32(sensorData(record), data);
+        data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, sensorGet(state, key, &data), "sensorGet did not find a record.");
+        TEST_ASSERT_EQUAL_INT32(sensorData(record), data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, sensorGet(state, key + 1, &data), "sensorGet found a key that was not inserted.");
+    }
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, sensorGet(state, numRecords * 3, &data), "sensorGet found a key larger than every key.");
+}
+
+void table_get_should_find_records_inserted_with_generic_put() {
+    TEST_ASSERT_EQUAL_INT8(0, setupEmbedDB(EMBEDDB_USE_BINARY_SEARCH, sensorConfigure));
+    for (uint32_t key = 10; key < 3000; key += 2) {
+        int32_t data = (int32_t)key * -2;
+        TEST_ASSERT_EQUAL_INT8(0, embedDBPut(state, &key, &data));
+    }
+    for (uint32_t key = 0; key < 3010; key++) {
+        int32_t data = 0;
+        int8_t expected = key >= 10 && key < 3000 && key % 2 == 0 ? 0 : -1;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(expected, sensorGet(state, key, &data), "sensorGet result was wrong.");
+        if (expected == 0)
+            TEST_ASSERT_EQUAL_INT32((int32_t)key * -2, data);
+    }
+}
+
+void table_put_should_keep_write_buffer_data_range() {
+    TEST_ASSERT_EQUAL_INT8(0, setupEmbedDB(EMBEDDB_USE_MAX_MIN, sensorConfigure));
+    uint32_t numRecords = state->maxRecordsPerPage * 3 + state->maxRecordsPerPage / 2;
+    insertSensorRecords(numRecords);
+
+    count_t count = EMBEDDB_GET_COUNT(state->buffer);
+    TEST_ASSERT_TRUE_MESSAGE(count > 1, "Write buffer should hold several records.");
+    int32_t expectedMin = INT32_MAX, expectedMax = INT32_MIN;
+    for (uint32_t record = numRecords - count; record < numRecords; record++) {
+        int32_t data = sensorData(record);
+        if (data < expectedMin)
+            expectedMin = data;
+        if (data > expectedMax)
+            expectedMax = data;
+    }
+    uint32_t minKey = 0, maxKey = 0;
+    int32_t minData = 0, maxData = 0;
+    memcpy(&minKey, EMBEDDB_GET_MIN_KEY(state->buffer), sizeof(uint32_t));
+    memcpy(&maxKey, EMBEDDB_GET_MAX_KEY(state->buffer, state), sizeof(uint32_t));
+    memcpy(&minData, EMBEDDB_GET_MIN_DATA(state->buffer, state), sizeof(int32_t));
+    memcpy(&maxData, EMBEDDB_GET_MAX_DATA(state->buffer, state), sizeof(int32_t));
+    TEST_ASSERT_EQUAL_UINT32((numRecords - count) * 3, minKey);
+    TEST_ASSERT_EQUAL_UINT32((numRecords - 1) * 3, maxKey);
+    TEST_ASSERT_EQUAL_INT32(expectedMin, minData);
+    TEST_ASSERT_EQUAL_INT32(expectedMax, maxData);
+}
+
+void table_put_should_reject_keys_out_of_order() {
+    TEST_ASSERT_EQUAL_INT8(0, setupEmbedDB(0, sensorConfigure));
+    TEST_ASSERT_EQUAL_INT8(0, sensorPut(state, 10, 1));
+    TEST_ASSERT_EQUAL_INT8(0, sensorPut(state, 20, 2));
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, sensorPut(state, 20, 3), "sensorPut accepted a duplicate key.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, sensorPut(state, 15, 3), "sensorPut accepted a smaller key.");
+    TEST_ASSERT_EQUAL_UINT32(2, EMBEDDB_GET_COUNT(state->buffer));
+
+    /* The first record of a page is checked against the last record of the previous page */
+    for (uint32_t key = 21; EMBEDDB_GET_COUNT(state->buffer) < state->maxRecordsPerPage; key++) {
+        TEST_ASSERT_EQUAL_INT8(0, sensorPut(state, key, 0));
+    }
+    embedDBFlush(state);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, sensorPut(state, 21, 0), "sensorPut accepted a smaller key at the start of a page.");
+}
+
+void checkSensorIteratorMatchesGeneric(uint32_t *minKey, uint32_t *maxKey, int32_t *minData, int32_t *maxData) {
+    embedDBIterator generic, typed;
+    generic.minKey = typed.minKey = minKey;
+    generic.maxKey = typed.maxKey = maxKey;
+    generic.minData = typed.minData = minData;
+    generic.maxData = typed.maxData = maxData;
+    embedDBInitIterator(state, &generic);
+    embedDBInitIterator(state, &typed);
+
+    uint32_t genericKey = 0, typedKey = 0, numRecords = 0;
+    int32_t genericData = 0, typedData = 0;
+    while (1) {
+        int8_t genericResult = embedDBNext(state, &generic, &genericKey, &genericData);
+        int8_t typedResult = sensorNext(state, &typed, &typedKey, &typedData);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(genericResult, typedResult, "sensorNext and embedDBNext returned a different number of records.");
+        if (genericResult == 0)
+            break;
+        TEST_ASSERT_EQUAL_UINT32(genericKey, typedKey);
+        TEST_ASSERT_EQUAL_INT32(genericData, typedData);
+        numRecords++;
+    }
+    TEST_ASSERT_TRUE_MESSAGE(numRecords > 0, "The query should match some records.");
+    embedDBCloseIterator(&generic);
+    embedDBCloseIterator(&typed);
+}
+
+void table_next_should_return_the_same_records_as_generic_next() {
+    TEST_ASSERT_EQUAL_INT8(0, setupEmbedDB(EMBEDDB_USE_MAX_MIN, sensorConfigure));
+    uint32_t numRecords = 8000;
+    insertSensorRecords(numRecords);
+
+    uint32_t minKey = 1001, maxKey = 17000, maxKeyInWriteBuffer = numRecords * 3 - 10;
+    int32_t minData = -100, maxData = 250;
+    checkSensorIteratorMatchesGeneric(NULL, NULL, NULL, NULL);
+    checkSensorIteratorMatchesGeneric(&minKey, NULL, NULL, NULL);
+    checkSensorIteratorMatchesGeneric(NULL, &maxKey, NULL, NULL);
+    checkSensorIteratorMatchesGeneric(&minKey, &maxKeyInWriteBuffer, NULL, NULL);
+    checkSensorIteratorMatchesGeneric(NULL, NULL, &minData, &maxData);
+    checkSensorIteratorMatchesGeneric(&minKey, &maxKey, &minData, NULL);
+    checkSensorIteratorMatchesGeneric(&minKey, &maxKey, NULL, &maxData);
+}
+
+void table_put_should_use_generic_put_for_sums_and_bitmaps() {
+    TEST_ASSERT_EQUAL_INT8(0, setupEmbedDB(EMBEDDB_USE_SUM | EMBEDDB_USE_BMAP | EMBEDDB_USE_MAX_MIN, sensorConfigure));
+    uint32_t numRecords = 3000;
+    int64_t expectedSum = 0;
+    for (uint32_t record = 0; record < numRecords; record++) {
+        int32_t data = (int32_t)(record % 90);
+        expectedSum += data;
+        TEST_ASSERT_EQUAL_INT8(0, sensorPut(state, record, data));
+    }
+    uint32_t minKey = 0, maxKey = numRecords - 1, count = 0;
+    int64_t sum = 0;
+    TEST_ASSERT_EQUAL_INT8(0, embedDBRangeSum(state, &minKey, &maxKey, &sum, &count));
+    TEST_ASSERT_EQUAL_UINT32(numRecords, count);
+    TEST_ASSERT_TRUE_MESSAGE(sum == expectedSum, "Sum of the records inserted with sensorPut was wrong.");
+
+    /* The bitmap of the write buffer must include every record on it */
+    int32_t lastData = (int32_t)((numRecords - 1) % 90);
+    TEST_ASSERT_TRUE_MESSAGE(inBitmapInt8(&lastData, EMBEDDB_GET_BITMAP(state->buffer)), "Bitmap of the write buffer is missing the last record.");
+}
+
+void sensorConfigureReorderBuffer(embedDBState *state) {
+    sensorConfigure(state);
+    state->reorderBufferSize = 8;
+}
+
+void table_should_put_get_and_iterate_records_in_the_reorder_buffer() {
+    TEST_ASSERT_EQUAL_INT8(0, setupEmbedDB(EMBEDDB_USE_MAX_MIN | EMBEDDB_USE_REORDER_BUFFER, sensorConfigureReorderBuffer));
+    uint32_t numRecords = 1000;
+    for (uint32_t arrival = 0; arrival < numRecords; arrival++) {
+        /* Pairs of records arrive swapped */
+        uint32_t record = arrival ^ 1;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, sensorPut(state, record * 3, sensorData(record)), "sensorPut did not insert a late record.");
+    }
+
+    for (uint32_t record = 0; record < numRecords; record++) {
+        int32_t data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, sensorGet(state, record * 3, &data), "sensorGet did not find a record inserted out of order.");
+        TEST_ASSERT_EQUAL_INT32(sensorData(record), data);
+    }
+
+    uint32_t minKey = numRecords * 3 - 100;
+    checkSensorIteratorMatchesGeneric(NULL, NULL, NULL, NULL);
+    checkSensorIteratorMatchesGeneric(&minKey, NULL, NULL, NULL);
+
+    embedDBIterator it;
+    it.minKey = &minKey;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint32_t key = 0, numFound = 0;
+    int32_t data = 0;
+    while (sensorNext(state, &it, &key, &data)) {
+        numFound++;
+    }
+    embedDBCloseIterator(&it);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(numRecords - (minKey + 2) / 3, numFound, "sensorNext did not return the records in the reorder buffer.");
+}
+
+void table_should_order_unsigned_64_bit_keys_and_float_data() {
+    TEST_ASSERT_EQUAL_INT8(0, setupEmbedDB(EMBEDDB_USE_MAX_MIN, wideConfigure));
+    TEST_ASSERT_EQUAL_INT8(8, state->keySize);
+    TEST_ASSERT_EQUAL_INT8(4, state->dataSize);
+    uint64_t base = 0x7FFFFFFFFFFFF000ull;
+    uint32_t numRecords = 4000;
+    for (uint32_t record = 0; record < numRecords; record++) {
+        TEST_ASSERT_EQUAL_INT8(0, widePut(state, base + (uint64_t)record * 5, (float)record / 4));
+    }
+    for (uint32_t record = 0; record < numRecords; record += 7) {
+        float data = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, wideGet(state, base + (uint64_t)record * 5, &data), "wideGet did not find a key.");
+        TEST_ASSERT_EQUAL_FLOAT_MESSAGE((float)record / 4, data, "wideGet returned the wrong data.");
+    }
+
+    /* Keys past the signed range are larger, and floats are compared as floats */
+    uint64_t minKey = 0x8000000000000000ull;
+    float minData = 500.5f;
+    embedDBIterator it;
+    it.minKey = &minKey;
+    it.maxKey = NULL;
+    it.minData = &minData;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    uint64_t key = 0, previousKey = 0;
+    float data = 0;
+    uint32_t numFound = 0;
+    while (wideNext(state, &it, &key, &data)) {
+        TEST_ASSERT_TRUE_MESSAGE(key >= minKey && key > previousKey, "wideNext returned a key out of range or out of order.");
+        TEST_ASSERT_TRUE_MESSAGE(data >= minData, "wideNext returned data below the data filter.");
+        previousKey = key;
+        numFound++;
+    }
+    embedDBCloseIterator(&it);
+    /* Record 820 has the first key past the signed range and record 2002 has the first data of at least 500.5 */
+    TEST_ASSERT_EQUAL_UINT32(numRecords - 2002, numFound);
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(table_put_should_store_records_read_by_generic_and_typed_get);
+    RUN_TEST(table_get_should_find_records_inserted_with_generic_put);
+    RUN_TEST(table_put_should_keep_write_buffer_data_range);
+    RUN_TEST(table_put_should_reject_keys_out_of_order);
+    RUN_TEST(table_next_should_return_the_same_records_as_generic_next);
+    RUN_TEST(table_put_should_use_generic_put_for_sums_and_bitmaps);
+    RUN_TEST(table_should_put_get_and_iterate_records_in_the_reorder_buffer);
+    RUN_TEST(table_should_order_unsigned_64_bit_keys_and_float_data);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -0,0 +1,378 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_uint_keys.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test searching pages of unsigned integer keys with interpolation.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#define INDEX_PATH "indexFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#define INDEX_PATH "build/artifacts/indexFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+/* Counts key comparisons, so the tests can check how many records a search looks at with compareKey */
+uint32_t keyComparisons = 0;
+
+int8_t uint32Comparator(void *a, void *b) {
+    keyComparisons++;
+    uint32_t i1, i2;
+    memcpy(&i1, a, sizeof(uint32_t));
+    memcpy(&i2, b, sizeof(uint32_t));
+    return i1 < i2 ? -1 : (i1 > i2 ? 1 : 0);
+}
+
+int8_t uint64Comparator(void *a, void *b) {
+    uint64_t i1, i2;
+    memcpy(&i1, a, sizeof(uint64_t));
+    memcpy(&i2, b, sizeof(uint64_t));
+    return i1 < i2 ? -1 : (i1 > i2 ? 1 : 0);
+}
+
+/* Size of the data in each record. Larger data spreads the keys further apart on a page */
+int8_t dataSize = 4;
+
+int8_t setupEmbedDB(uint32_t parameters, int8_t keySize) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = keySize;
+    state->dataSize = dataSize;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 256;
+    state->bitmapSize = 0;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 1000;
+    state->numIndexPages = 16;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->indexFile = NULL;
+    state->parameters = EMBEDDB_RESET_DATA | EMBEDDB_USE_UINT_KEYS | parameters;
+    state->compareKey = keySize == 8 ? uint64Comparator : uint32Comparator;
+    state->compareData = int32Comparator;
+    return embedDBInit(state, 1);
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {
+    dataSize = 4;
+}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Keys with runs of small gaps between large jumps, so interpolation within a page can be far off */
+uint32_t clusteredKey(uint32_t record) {
+    return (record / 7) * 100000u + (record % 7) * 3;
+}
+
+void insert32(uint32_t numRecords, uint32_t (*keyOf)(uint32_t)) {
+    for (uint32_t record = 0; record < numRecords; record++) {
+        uint32_t key = keyOf(record);
+        int32_t data = (int32_t)record;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not correctly insert data.");
+    }
+}
+
+/* Checks every inserted key is found, and that the key after it is not found unless it was inserted */
+void assertGet32(uint32_t numRecords, uint32_t (*keyOf)(uint32_t)) {
+    char message[100];
+    int32_t data = 0;
+    for (uint32_t record = 0; record < numRecords; record++) {
+        uint32_t key = keyOf(record);
+        snprintf(message, 100, "embedDBGet did not find key %u.", key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(record, data, "embedDBGet returned the wrong data.");
+
+        uint32_t missingKey = key + 1;
+        if (record + 1 < numRecords && keyOf(record + 1) == missingKey)
+            continue;
+        snprintf(message, 100, "embedDBGet found key %u that was not inserted.", missingKey);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &missingKey, &data), message);
+    }
+}
+
+uint32_t evenKey(uint32_t record) {
+    return record * 10;
+}
+
+uint32_t consecutiveKey(uint32_t record) {
+    return record;
+}
+
+/* Keys above 2^31, which are in a different order when compared as signed integers */
+uint32_t highKey(uint32_t record) {
+    return 2147483000u + record * 5;
+}
+
+void uintKeys_should_find_evenly_spaced_keys(void) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(0, 4), "EmbedDB did not initialize correctly.");
+    insert32(5000, evenKey);
+    assertGet32(5000, evenKey);
+}
+
+void uintKeys_should_find_consecutive_keys(void) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(0, 4), "EmbedDB did not initialize correctly.");
+    insert32(5000, consecutiveKey);
+    assertGet32(5000, consecutiveKey);
+}
+
+void uintKeys_should_find_clustered_keys(void) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(0, 4), "EmbedDB did not initialize correctly.");
+    insert32(5000, clusteredKey);
+    assertGet32(5000, clusteredKey);
+}
+
+void uintKeys_should_find_keys_above_signed_range(void) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(0, 4), "EmbedDB did not initialize correctly.");
+    insert32(5000, highKey);
+    assertGet32(5000, highKey);
+}
+
+void uintKeys_should_find_floor_and_ceiling_between_clustered_keys(void) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(0, 4), "EmbedDB did not initialize correctly.");
+    insert32(5000, clusteredKey);
+
+    char message[100];
+    uint32_t foundKey = 0;
+    int32_t data = 0;
+    for (uint32_t record = 0; record + 1 < 5000; record++) {
+        /* A key between this record and the next one */
+        uint32_t key = clusteredKey(record) + 1;
+        snprintf(message, 100, "embedDBGetFloor did not find a key for %u.", key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetFloor(state, &key, &foundKey, &data), message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(clusteredKey(record), foundKey, "embedDBGetFloor returned the wrong key.");
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetCeiling(state, &key, &foundKey, &data), "embedDBGetCeiling did not find a key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(clusteredKey(record + 1), foundKey, "embedDBGetCeiling returned the wrong key.");
+
+        /* Just below the next key, where the estimate is past the record after a large gap */
+        key = clusteredKey(record + 1) - 1;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetFloor(state, &key, &foundKey, &data), "embedDBGetFloor did not find a key.");
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(clusteredKey(record), foundKey, "embedDBGetFloor returned the wrong key below the next key.");
+    }
+}
+
+/* The first key, then a large gap before keys that are close together */
+uint32_t gapAfterFirstKey(uint32_t record) {
+    return record == 0 ? 0 : 1000000u + record;
+}
+
+void uintKeys_should_find_first_key_before_large_gap(void) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(0, 4), "EmbedDB did not initialize correctly.");
+    insert32(200, gapAfterFirstKey);
+    assertGet32(200, gapAfterFirstKey);
+
+    /* The estimate for a key just below the gap is near the end of the page, so the search has to move back to the first record */
+    uint32_t key = 999999, foundKey = 0;
+    int32_t data = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetFloor(state, &key, &foundKey, &data), "embedDBGetFloor did not find a key.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, foundKey, "embedDBGetFloor returned the wrong key.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetCeiling(state, &key, &foundKey, &data), "embedDBGetCeiling did not find a key.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1000001, foundKey, "embedDBGetCeiling returned the wrong key.");
+}
+
+void uintKeys_should_find_8_byte_keys_with_large_gaps(void) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(0, 8), "EmbedDB did not initialize correctly.");
+
+    /* Gaps that grow to more than 2^48 between keys on the same page */
+    uint64_t key = 0;
+    for (uint32_t record = 0; record < 3000; record++) {
+        key += record % 50 == 0 ? (1ull << 50) : 3 + record % 11;
+        int32_t data = (int32_t)record;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, &data), "embedDBPut did not correctly insert data.");
+    }
+
+    char message[100];
+    int32_t data = 0;
+    key = 0;
+    for (uint32_t record = 0; record < 3000; record++) {
+        key += record % 50 == 0 ? (1ull << 50) : 3 + record % 11;
+        snprintf(message, 100, "embedDBGet did not find the key of record %u.", record);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGet(state, &key, &data), message);
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(record, data, "embedDBGet returned the wrong data.");
+        uint64_t missingKey = key + 1;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBGet(state, &missingKey, &data), "embedDBGet found a key that was not inserted.");
+    }
+}
+
+/* Inserts keys with pseudo-random gaps and checks the floor of random keys against the inserted keys */
+void assertRandomGapFloors(int8_t keySize, uint64_t maxGap) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(0, keySize), "EmbedDB did not initialize correctly.");
+    uint32_t numRecords = 2000;
+    uint64_t *keys = (uint64_t *)malloc(numRecords * sizeof(uint64_t));
+    void *data = calloc(1, dataSize);
+    uint64_t key = 100, random = 12345;
+    for (uint32_t record = 0; record < numRecords; record++) {
+        random = random * 6364136223846793005ull + 1442695040888963407ull;
+        key += 1 + (random >> 8) % maxGap;
+        keys[record] = key;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBPut(state, &key, data), "embedDBPut did not correctly insert data.");
+    }
+
+    char message[100];
+    uint64_t foundKey = 0;
+    for (uint32_t record = 0; record + 1 < numRecords; record++) {
+        random = random * 6364136223846793005ull + 1442695040888963407ull;
+        uint64_t searchKey = keys[record] + (random >> 8) % (keys[record + 1] - keys[record]);
+        snprintf(message, 100, "embedDBGetFloor returned the wrong key for record %u.", record);
+        foundKey = 0;
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBGetFloor(state, &searchKey, &foundKey, data), message);
+        TEST_ASSERT_TRUE_MESSAGE(foundKey == keys[record], message);
+    }
+    free(keys);
+    free(data);
+}
+
+void uintKeys_should_find_floor_with_random_gaps_in_wide_records(void) {
+    dataSize = 100;
+    assertRandomGapFloors(4, 1000);
+}
+
+void uintKeys_should_find_floor_of_8_byte_keys_with_random_gaps(void) {
+    dataSize = 20;
+    assertRandomGapFloors(8, 1ull << 40);
+}
+
+void uintKeys_iterator_should_search_for_first_record_in_key_range(void) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, setupEmbedDB(0, 4), "EmbedDB did not initialize correctly.");
+    insert32(5000, evenKey);
+
+    /* The min key is near the end of its page, so checking every record before it would compare about a page of keys */
+    uint32_t minKey = 0, maxKey = 0, key = 0;
+    int32_t data = 0;
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    minKey = evenKey(20 * recordsPerPage + recordsPerPage - 3);
+    maxKey = evenKey(30 * recordsPerPage + 2);
+    embedDBIterator it;
+    it.minKey = &minKey;
+    it.maxKey = NULL;
+    it.minData = NULL;
+    it.maxData = NULL;
+    embedDBInitIterator(state, &it);
+    keyComparisons = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBNext(state, &it, &key, &data), "Iterator did not return a record.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(minKey, key, "Iterator did not start at the min key.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(5, keyComparisons, "Iterator compared the records before the min key one at a time.");
+    embedDBCloseIterator(&it);
+
+    /* The max key is near the start of its page for the reverse iterator */
+    it.minKey = NULL;
+    it.maxKey = &maxKey;
+    embedDBInitReverseIterator(state, &it);
+    keyComparisons = 0;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(1, embedDBPrev(state, &it, &key, &data), "Reverse iterator did not return a record.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(maxKey, key, "Reverse iterator did not start at the max key.");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(5, keyComparisons, "Reverse iterator compared the records after the max key one at a time.");
+    embedDBCloseIterator(&it);
+}
+
+void uintKeys_should_require_4_or_8_byte_keys(void) {
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, setupEmbedDB(0, 2), "EMBEDDB_USE_UINT_KEYS should not accept 2 byte keys.");
+
+    state->keySize = 4;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(uintKeys_should_find_evenly_spaced_keys);
+    RUN_TEST(uintKeys_should_find_consecutive_keys);
+    RUN_TEST(uintKeys_should_find_clustered_keys);
+    RUN_TEST(uintKeys_should_find_keys_above_signed_range);
+    RUN_TEST(uintKeys_should_find_floor_and_ceiling_between_clustered_keys);
+    RUN_TEST(uintKeys_should_find_first_key_before_large_gap);
+    RUN_TEST(uintKeys_should_find_8_byte_keys_with_large_gaps);
+    RUN_TEST(uintKeys_should_find_floor_with_random_gaps_in_wide_records);
+    RUN_TEST(uintKeys_should_find_floor_of_8_byte_keys_with_random_gaps);
+    RUN_TEST(uintKeys_iterator_should_search_for_first_record_in_key_range);
+    RUN_TEST(uintKeys_should_require_4_or_8_byte_keys);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
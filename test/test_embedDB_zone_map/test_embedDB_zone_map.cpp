@@ -0,0 +1,301 @@
+/******************************************************************************/
+/**
+ * @file        test_embedDB_zone_map.cpp
+ * @author      EmbedDB Team (See Authors.md)
+ * @brief       Test skipping data pages by their data range during filtered iteration.
+ * @copyright   Copyright 2024
+ *              EmbedDB Team
+ * @par Redistribution and use in source and binary forms, with or without
+ *  modification, are permitted provided that the following conditions are met:
+ *
+ * @par 1.Redistributions of source code must retain the above copyright notice,
+ *  this list of conditions and the following disclaimer.
+ *
+ * @par 2.Redistributions in binary form must reproduce the above copyright notice,
+ *  this list of conditions and the following disclaimer in the documentation
+ *  and/or other materials provided with the distribution.
+ *
+ * @par 3.Neither the name of the copyright holder nor the names of its contributors
+ *  may be used to endorse or promote products derived from this software without
+ *  specific prior written permission.
+ *
+ * @par THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+/*****************************************************************************/
+#include <math.h>
+#include <string.h>
+
+#ifdef DIST
+#include "embedDB.h"
+#else
+#include "embedDB/embedDB.h"
+#include "embedDBUtility.h"
+#endif
+
+#if defined(MEMBOARD)
+#include "memboardTestSetup.h"
+#endif
+
+#if defined(MEGA)
+#include "megaTestSetup.h"
+#endif
+
+#if defined(DUE)
+#include "dueTestSetup.h"
+#endif
+
+#ifdef ARDUINO
+#include "SDFileInterface.h"
+#define getFileInterface getSDInterface
+#define setupFile setupSDFile
+#define tearDownFile tearDownSDFile
+#define DATA_PATH "dataFile.bin"
+#else
+#include "desktopFileInterface.h"
+#define DATA_PATH "build/artifacts/dataFile.bin"
+#endif
+
+#include "unity.h"
+
+embedDBState *state;
+
+void setupState(uint32_t parameters) {
+    state = (embedDBState *)malloc(sizeof(embedDBState));
+    TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
+    state->keySize = 4;
+    state->dataSize = 4;
+    state->pageSize = 512;
+    state->bufferSizeInBlocks = 4;
+    state->numSplinePoints = 64;
+    state->bitmapSize = 0;
+    state->buffer = malloc((size_t)state->bufferSizeInBlocks * state->pageSize);
+    TEST_ASSERT_NOT_NULL_MESSAGE(state->buffer, "Failed to allocate buffer for EmbedDB.");
+    state->numDataPages = 100;
+    state->eraseSizeInPages = 4;
+    state->fileInterface = getFileInterface();
+    state->dataFile = setupFile(DATA_PATH);
+    state->parameters = EMBEDDB_USE_MAX_MIN | parameters;
+    state->compareKey = int32Comparator;
+    state->compareData = int32Comparator;
+}
+
+void setupEmbedDB(uint32_t parameters) {
+    setupState(parameters);
+    int8_t result = embedDBInit(state, 1);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "EmbedDB did not initialize correctly.");
+}
+
+void tearDownEmbedDB() {
+    free(state->buffer);
+    embedDBClose(state);
+    tearDownFile(state->dataFile);
+    free(state->fileInterface);
+    free(state);
+}
+
+void setUp(void) {}
+
+void tearDown(void) {
+    tearDownEmbedDB();
+}
+
+/* Data values that move between ranges of 1000 every 200 records, so most pages only hold values from one range */
+int32_t dataOf(uint32_t record) {
+    return (int32_t)((record / 200) % 5 * 1000 + record % 37);
+}
+
+void insertRecords(uint32_t startingRecord, uint32_t numRecords) {
+    for (uint32_t record = startingRecord; record < startingRecord + numRecords; record++) {
+        uint32_t key = record;
+        int32_t data = dataOf(record);
+        int8_t result = embedDBPut(state, &key, &data);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, result, "embedDBPut did not correctly insert data.");
+    }
+}
+
+/* Number of records from firstRecord to lastRecord with data in [minData, maxData] */
+uint32_t expectedMatches(uint32_t firstRecord, uint32_t lastRecord, int32_t minData, int32_t maxData) {
+    uint32_t matches = 0;
+    for (uint32_t record = firstRecord; record <= lastRecord; record++) {
+        if (dataOf(record) >= minData && dataOf(record) <= maxData)
+            matches++;
+    }
+    return matches;
+}
+
+/* Number of full data pages, starting at the page with firstRecord, whose range of data overlaps [minData, maxData] */
+uint32_t overlappingPages(uint32_t firstRecord, uint32_t numPages, int32_t minData, int32_t maxData) {
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t pages = 0;
+    for (uint32_t page = 0; page < numPages; page++) {
+        uint32_t pageStart = firstRecord + page * recordsPerPage;
+        int32_t pageMin = dataOf(pageStart), pageMax = dataOf(pageStart);
+        for (uint32_t record = pageStart; record < pageStart + recordsPerPage; record++) {
+            pageMin = dataOf(record) < pageMin ? dataOf(record) : pageMin;
+            pageMax = dataOf(record) > pageMax ? dataOf(record) : pageMax;
+        }
+        if (pageMax >= minData && pageMin <= maxData)
+            pages++;
+    }
+    return pages;
+}
+
+/* Iterates over the records with data in [minData, maxData], checking each one, and returns how many there were */
+uint32_t iterateDataRange(int32_t minData, int32_t maxData, uint32_t *maxKey) {
+    embedDBIterator it;
+    it.minKey = NULL;
+    it.maxKey = maxKey;
+    it.minData = &minData;
+    it.maxData = &maxData;
+    embedDBInitIterator(state, &it);
+
+    uint32_t key = 0, numRecords = 0, lastKey = 0;
+    int32_t data = 0;
+    while (embedDBNext(state, &it, &key, &data)) {
+        TEST_ASSERT_EQUAL_INT32_MESSAGE(dataOf(key), data, "Iterator returned the wrong data for a key.");
+        TEST_ASSERT_TRUE_MESSAGE(data >= minData && data <= maxData, "Iterator returned a record outside of the data range.");
+        TEST_ASSERT_TRUE_MESSAGE(numRecords == 0 || key > lastKey, "Iterator returned keys out of order.");
+        lastKey = key;
+        numRecords++;
+    }
+    embedDBCloseIterator(&it);
+    return numRecords;
+}
+
+void zoneMap_should_return_same_records_as_header_check() {
+    setupEmbedDB(EMBEDDB_RESET_DATA);
+    uint32_t numRecords = 30 * state->maxRecordsPerPage + 17;
+    insertRecords(0, numRecords);
+
+    uint32_t expected = expectedMatches(0, numRecords - 1, 2000, 2020);
+    TEST_ASSERT_TRUE_MESSAGE(expected > 0, "Test data has no records in the data range.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected, iterateDataRange(2000, 2020, NULL), "Iterator using page headers returned the wrong number of records.");
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_ZONE_MAP);
+    insertRecords(0, numRecords);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expected, iterateDataRange(2000, 2020, NULL), "Iterator using the zone map returned the wrong number of records.");
+}
+
+void zoneMap_should_only_read_pages_with_data_in_range() {
+    setupEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_ZONE_MAP);
+    uint32_t numPages = 30;
+    insertRecords(0, numPages * state->maxRecordsPerPage);
+    embedDBFlush(state);
+
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_UINT32(expectedMatches(0, numPages * state->maxRecordsPerPage - 1, 3000, 3999), iterateDataRange(3000, 3999, NULL));
+    uint32_t expectedReads = overlappingPages(0, numPages, 3000, 3999);
+    TEST_ASSERT_TRUE_MESSAGE(expectedReads < numPages, "Test data has every page in the data range.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(expectedReads, state->numReads, "Iterator read data pages that the zone map showed had no data in range.");
+}
+
+void headerCheck_should_stop_at_max_key_when_skipping_pages() {
+    setupEmbedDB(EMBEDDB_RESET_DATA);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numRecords = 30 * recordsPerPage;
+    insertRecords(0, numRecords);
+    embedDBFlush(state);
+
+    /* The pages after the max key have no data in the range, so the scan must stop at the first one rather than skipping them all */
+    uint32_t maxKey = 250;
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_UINT32(expectedMatches(0, maxKey, 0, 36), iterateDataRange(0, 36, &maxKey));
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32_MESSAGE(maxKey / recordsPerPage + 2, state->numReads, "Iterator read pages past the max key.");
+}
+
+void zoneMap_should_skip_pages_after_wrapping() {
+    setupEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_ZONE_MAP);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    uint32_t numRecords = 250 * recordsPerPage;
+    insertRecords(0, numRecords);
+    embedDBFlush(state);
+
+    /* Only records on pages still in the data file are returned */
+    uint32_t firstRecord = state->minDataPageId * recordsPerPage;
+    uint32_t numPages = state->nextDataPageId - state->minDataPageId;
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_UINT32(expectedMatches(firstRecord, numRecords - 1, 4000, 4036), iterateDataRange(4000, 4036, NULL));
+    TEST_ASSERT_EQUAL_UINT32(overlappingPages(firstRecord, numPages, 4000, 4036), state->numReads);
+}
+
+void zoneMap_should_read_recovered_pages() {
+    setupEmbedDB(EMBEDDB_RESET_DATA | EMBEDDB_USE_ZONE_MAP);
+    uint32_t recordsPerPage = state->maxRecordsPerPage;
+    insertRecords(0, 20 * recordsPerPage);
+    embedDBFlush(state);
+    tearDownEmbedDB();
+
+    setupEmbedDB(EMBEDDB_USE_ZONE_MAP);
+    insertRecords(20 * recordsPerPage, 20 * recordsPerPage);
+    embedDBFlush(state);
+
+    /* Recovered pages are not in the zone map, so they are read and checked with their headers */
+    embedDBResetStats(state);
+    TEST_ASSERT_EQUAL_UINT32(expectedMatches(0, 40 * recordsPerPage - 1, 0, 999), iterateDataRange(0, 999, NULL));
+    TEST_ASSERT_EQUAL_UINT32(20 + overlappingPages(20 * recordsPerPage, 20, 0, 999), state->numReads);
+}
+
+void zoneMap_should_require_max_min() {
+    setupState(EMBEDDB_RESET_DATA | EMBEDDB_USE_ZONE_MAP);
+    state->parameters &= ~EMBEDDB_USE_MAX_MIN;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "EmbedDB initialized a zone map without EMBEDDB_USE_MAX_MIN.");
+
+    state->parameters |= EMBEDDB_USE_MAX_MIN;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+}
+
+void zoneMap_should_be_freed_with_fence_keys_when_index_init_fails() {
+    /* Too few buffers for an index, so embedDBInit fails after the fence keys and zone map are allocated */
+    setupState(EMBEDDB_RESET_DATA | EMBEDDB_USE_BINARY_SEARCH | EMBEDDB_USE_FENCE_KEYS | EMBEDDB_USE_ZONE_MAP | EMBEDDB_USE_INDEX);
+    state->indexFile = NULL;
+    state->numIndexPages = 8;
+    state->bufferSizeInBlocks = 2;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, embedDBInit(state, 1), "EmbedDB initialized an index with two page buffers.");
+    TEST_ASSERT_NULL_MESSAGE(state->fenceKeys, "The fence key directory was not freed when embedDBInit failed.");
+    TEST_ASSERT_NULL_MESSAGE(state->zoneMap, "The zone map was not freed when embedDBInit failed.");
+
+    state->bufferSizeInBlocks = 4;
+    state->parameters &= ~EMBEDDB_USE_INDEX;
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBInit(state, 1), "EmbedDB did not initialize correctly.");
+}
+
+int runUnityTests() {
+    UNITY_BEGIN();
+    RUN_TEST(zoneMap_should_return_same_records_as_header_check);
+    RUN_TEST(zoneMap_should_only_read_pages_with_data_in_range);
+    RUN_TEST(headerCheck_should_stop_at_max_key_when_skipping_pages);
+    RUN_TEST(zoneMap_should_skip_pages_after_wrapping);
+    RUN_TEST(zoneMap_should_read_recovered_pages);
+    RUN_TEST(zoneMap_should_require_max_min);
+    RUN_TEST(zoneMap_should_be_freed_with_fence_keys_when_index_init_fails);
+    return UNITY_END();
+}
+
+#ifdef ARDUINO
+
+void setup() {
+    delay(2000);
+    setupBoard();
+    runUnityTests();
+}
+
+void loop() {}
+
+#else
+
+int main() {
+    return runUnityTests();
+}
+
+#endif
@@ -1,3 +1,5 @@
+#include <time.h>
+
 #ifdef DIST
 #include "embedDB.h"
 #else
@@ -34,7 +36,7 @@
 
 embedDBState *state;
 
-void setupEmbedDB(int8_t parameters) {
+void setupEmbedDB(uint32_t parameters) {
     /* The setup below will result in having 42 records per page */
     state = (embedDBState *)malloc(sizeof(embedDBState));
     TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
@@ -58,6 +60,8 @@ void setupEmbedDB(int8_t parameters) {
     state->numDataPages = 32;
     state->eraseSizeInPages = 4;
     state->parameters = parameters;
+    state->rlcGroupCommitRecords = 10;
+    state->rlcGroupCommitWindow = 0;
     state->compareKey = int32Comparator;
     state->compareData = int64Comparator;
     int8_t result = embedDBInit(state, 1);
@@ -544,6 +548,105 @@ void embedDBInit_should_recover_correctly_after_wrapping_several_times() {
     TEST_ASSERT_EQUAL_UINT32_MESSAGE(13, state->nextRLCPhysicalPageLocation, "embedDBInit did not set the correct value of nextRLCPhysicalPageLocation after recovering when it wrapped several times.");
 }
 
+void waitMilliseconds(uint32_t milliseconds) {
+#ifdef ARDUINO
+    delay(milliseconds);
+#else
+    /* Sleep rather than spin so no processor time passes while waiting */
+    struct timespec duration;
+    duration.tv_sec = milliseconds / 1000;
+    duration.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+    nanosleep(&duration, NULL);
+#endif
+}
+
+void groupCommit_should_write_temporary_page_once_per_group_of_records() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA);
+
+    insertRecords(400, 204021, 9);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->nextRLCPhysicalPageLocation, "Group commit wrote a temporary page before the group of records was full.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(9, state->rlcUncommittedRecords, "Group commit did not count the uncommitted records.");
+
+    insertRecords(409, 204030, 1);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->nextRLCPhysicalPageLocation, "Group commit did not write a temporary page when the group of records was full.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, state->rlcUncommittedRecords, "Group commit did not reset the uncommitted record count after writing a temporary page.");
+
+    /* Check the temporary page holds the whole group */
+    int8_t readResult = readPage(state, 4);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, readResult, "Unable to read the temporary page written by group commit.");
+    int8_t *buffer = (int8_t *)(state->buffer) + (state->pageSize * EMBEDDB_DATA_READ_BUFFER);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(10, EMBEDDB_GET_COUNT(buffer), "The temporary page written by group commit did not contain the whole group of records.");
+
+    /* 42 records per page, so filling a page takes four temporary page writes instead of 42. The 43rd record writes the page. */
+    insertRecords(410, 204031, 33);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->nextDataPageId, "Group commit changed when the data page was written.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(8, state->nextRLCPhysicalPageLocation, "Group commit wrote the wrong number of temporary pages.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->rlcUncommittedRecords, "Writing a data page did not commit the records on it.");
+}
+
+void embedDBSync_should_write_uncommitted_records() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA);
+
+    insertRecords(1000, 5, 3);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->nextRLCPhysicalPageLocation, "Group commit wrote a temporary page before the group of records was full.");
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBSync(state), "embedDBSync returned an error.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->nextRLCPhysicalPageLocation, "embedDBSync did not write a temporary page for the uncommitted records.");
+
+    /* Nothing new to write */
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBSync(state), "embedDBSync returned an error.");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->nextRLCPhysicalPageLocation, "embedDBSync wrote a temporary page when there were no uncommitted records.");
+}
+
+void groupCommit_should_write_temporary_page_when_time_window_expires() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA);
+    state->rlcGroupCommitRecords = 0;
+    /* Wide enough that a slow or busy machine does not take longer than the window to insert the first records */
+    state->rlcGroupCommitWindow = 200;
+
+    insertRecords(1000, 5, 3);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(4, state->nextRLCPhysicalPageLocation, "Group commit wrote a temporary page before the time window expired.");
+    waitMilliseconds(300);
+    insertRecords(1003, 8, 1);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->nextRLCPhysicalPageLocation, "Group commit did not write a temporary page after the time window expired.");
+}
+
+void embedDBInit_should_recover_records_up_to_last_group_commit() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA);
+
+    /* 42 records per page, so this writes one full page and two groups of records on the second page, with five records left uncommitted */
+    insertRecords(5000, 77, 67);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->rlcUncommittedRecords, "Group commit did not count the uncommitted records.");
+
+    /* close embedDB and recover */
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(1, state->nextDataPageId, "embedDBInit did not recover the permanent page written with group commit.");
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(20, EMBEDDB_GET_COUNT(state->buffer), "embedDBInit did not recover the records up to the last group commit.");
+
+    uint32_t key = 5001;
+    uint64_t expectedData = 78;
+    uint64_t actualData = 0;
+    char message[100];
+    for (uint32_t i = 0; i < 62; i++) {
+        int8_t getResult = embedDBGet(state, &key, &actualData);
+        snprintf(message, 100, "embedDBGet was unable to fetch the data for key %u.", key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, getResult, message);
+        snprintf(message, 100, "embedDBGet returned the wrong data for key %u.", key);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&expectedData, &actualData, sizeof(uint64_t), message);
+        key++;
+        expectedData++;
+    }
+
+    /* Records after the last group commit were not durable */
+    int8_t getResult = embedDBGet(state, &key, &actualData);
+    snprintf(message, 100, "embedDBGet fetched data for a record that was never committed %u.", key);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, getResult, message);
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
     RUN_TEST(embedDBInit_should_initialize_with_correct_values_for_record_level_consistency);
@@ -563,6 +666,10 @@ int runUnityTests() {
     RUN_TEST(embedDBInit_should_recover_correctly_after_wrapping_with_one_page_of_data_at_start_of_data_file);
     RUN_TEST(embedDBInit_should_recover_correctly_when_old_permanent_records_in_record_level_consistency_area);
     RUN_TEST(embedDBInit_should_recover_correctly_after_wrapping_several_times);
+    RUN_TEST(groupCommit_should_write_temporary_page_once_per_group_of_records);
+    RUN_TEST(embedDBSync_should_write_uncommitted_records);
+    RUN_TEST(groupCommit_should_write_temporary_page_when_time_window_expires);
+    RUN_TEST(embedDBInit_should_recover_records_up_to_last_group_commit);
     return UNITY_END();
 }
 
@@ -38,7 +38,7 @@
 
 embedDBState *state;
 
-void setupEmbedDB(int8_t parameters) {
+void setupEmbedDB(uint32_t parameters) {
     /* The setup below will result in having 42 records per page */
     state = (embedDBState *)malloc(sizeof(embedDBState));
     TEST_ASSERT_NOT_NULL_MESSAGE(state, "Unable to allocate embedDBState.");
@@ -66,6 +66,8 @@ void setupEmbedDB(int8_t parameters) {
     state->numVarPages = 64;
     state->eraseSizeInPages = 4;
     state->parameters = parameters;
+    state->rlcGroupCommitRecords = 10;
+    state->rlcGroupCommitWindow = 0;
     state->compareKey = int32Comparator;
     state->compareData = int64Comparator;
     int8_t result = embedDBInit(state, 1);
@@ -468,6 +470,47 @@ void variable_data_record_level_consistency_should_recover_after_inserting_131_p
     TEST_ASSERT_EQUAL_INT8_MESSAGE(-1, getResult, message);
 }
 
+void variable_data_group_commit_should_recover_records_up_to_last_sync() {
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_RESET_DATA | EMBEDDB_USE_VDATA);
+
+    uint32_t key = 4412;
+    uint64_t data = 90210;
+    insertRecordsCustomVarData(key, data, 35, 24);
+    TEST_ASSERT_EQUAL_INT8_MESSAGE(0, embedDBSync(state), "embedDBSync returned an error with variable data.");
+
+    /* Variable data is only written once per group rather than one page per record, plus once when the first data page (31 records) is written */
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(5, state->nextVarPageId, "Group commit did not write one variable data page per group of records.");
+
+    /* tear down state and recover */
+    tearDown();
+    setupEmbedDB(EMBEDDB_RECORD_LEVEL_CONSISTENCY | EMBEDDB_RLC_GROUP_COMMIT | EMBEDDB_USE_VDATA);
+
+    uint64_t actualData = 0;
+    char actualVariableData[25];
+    char expectedVariableData[24];
+    char message[120];
+    embedDBVarDataStream *stream = NULL;
+    for (uint32_t i = 0; i < 35; i++) {
+        int8_t getResult = embedDBGetVar(state, &key, &actualData, &stream);
+        snprintf(message, 120, "embedDBGetVar encountered an error fetching the data for key %u.", key);
+        TEST_ASSERT_EQUAL_INT8_MESSAGE(0, getResult, message);
+        snprintf(message, 120, "embedDBGetVar returned null stream for key %u.", key);
+        TEST_ASSERT_NOT_NULL_MESSAGE(stream, message);
+        uint32_t streamBytesRead = embedDBVarDataStreamRead(state, stream, actualVariableData, 25);
+        snprintf(message, 120, "embedDBGetVar did not return correct data for a record inserted before reloading (key %u).", key);
+        TEST_ASSERT_EQUAL_MEMORY_MESSAGE(&data, &actualData, sizeof(uint64_t), message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(24, streamBytesRead, "EmbedDB var data stream did not read the correct number of bytes.");
+        snprintf(expectedVariableData, 24, "Variable Data %u", key);
+        snprintf(message, 120, "embedDBGetVar did not return the correct variable data for key %u.", key);
+        TEST_ASSERT_EQUAL_STRING_MESSAGE(expectedVariableData, actualVariableData, message);
+        key++;
+        data++;
+        free(stream);
+        stream = NULL;
+    }
+}
+
 int runUnityTests() {
     UNITY_BEGIN();
     RUN_TEST(variable_data_record_level_consistency_records_should_be_readable);
@@ -476,6 +519,7 @@ int runUnityTests() {
     RUN_TEST(variable_data_record_level_consistency_should_recover_71_pages_data_and_19_record_level_consistency_records);
     RUN_TEST(variable_data_record_level_consistency_should_recover_variable_data_longer_than_one_page);
     RUN_TEST(variable_data_record_level_consistency_should_recover_after_inserting_131_pages_data);
+    RUN_TEST(variable_data_group_commit_should_recover_records_up_to_last_sync);
     return UNITY_END();
 }
 